@@ -0,0 +1,129 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+namespace esp_modem {
+
+/**
+ * Common unique buffer, which is transferable between DTE and CMUX
+ *
+ */
+struct unique_buffer {
+    explicit unique_buffer(size_t size);
+    unique_buffer (unique_buffer const &) = delete;
+    unique_buffer &operator=(unique_buffer const &) = delete;
+    unique_buffer(unique_buffer &&other) noexcept
+    {
+        data = std::move(other.data);
+        size = other.size;
+        consumed = 0;
+    }
+    unique_buffer &operator=(unique_buffer &&other) noexcept
+    {
+        if (&other == this) {
+            return *this;
+        }
+        data = std::move(other.data);
+        size = other.size;
+        consumed = 0;
+        return *this;
+    }
+    [[nodiscard]] uint8_t *get() const
+    {
+        return data.get();
+    }
+
+    std::unique_ptr<uint8_t[]> data;
+    size_t size{};
+    size_t consumed{};
+};
+
+/**
+ * Fixed-capacity line buffer, which tokenizes incoming data incrementally
+ *
+ * Data are appended at the tail and only the newly appended bytes are scanned for the separator.
+ * Completed lines are provided as a contiguous view to the internal storage and released
+ * once processed, so the space is recycled: the unfinished line is moved back to the front
+ * only when the tail reaches the end of the storage.
+ */
+struct line_buffer {
+    explicit line_buffer(size_t size);
+    line_buffer (line_buffer const &) = delete;
+    line_buffer &operator=(line_buffer const &) = delete;
+
+    /**
+     * @brief Returns pointer to the free space at the tail (to read data directly into the buffer)
+     * Moves the unfinished line to the front if there's no space left at the tail.
+     */
+    [[nodiscard]] uint8_t *tail();
+
+    /**
+     * @brief Returns number of bytes available at the tail
+     */
+    [[nodiscard]] size_t available() const
+    {
+        return size - end;
+    }
+
+    /**
+     * @brief Marks len bytes written directly to tail() as valid data
+     */
+    void commit(size_t len)
+    {
+        end += len;
+    }
+
+    /**
+     * @brief Copies data to the tail
+     * @return true if all data fit into the buffer
+     */
+    [[nodiscard]] bool append(const uint8_t *data, size_t len);
+
+    /**
+     * @brief Scans the newly appended data for the separator
+     * @param separator Line separator
+     * @param[out] lines Beginning of the completed lines
+     * @param[out] len Length of all completed lines (including the last separator)
+     * @return true if at least one line has been completed
+     */
+    [[nodiscard]] bool next_lines(char separator, uint8_t *&lines, size_t &len);
+
+    /**
+     * @brief Releases the lines returned by the last next_lines()
+     */
+    void release()
+    {
+        begin = scanned_lines;
+    }
+
+    /**
+     * @brief Returns true if there are no pending (unfinished) data
+     */
+    [[nodiscard]] bool empty() const
+    {
+        return begin == end;
+    }
+
+    void reset()
+    {
+        begin = end = scanned = scanned_lines = 0;
+    }
+
+    /**
+     * @brief Moves the unreleased data to the front of the buffer
+     */
+    void compact();
+
+    std::unique_ptr<uint8_t[]> data;
+    size_t size{};
+    size_t begin{};         /*!< Beginning of unreleased data */
+    size_t end{};           /*!< End of valid data */
+    size_t scanned{};       /*!< Data up to this offset have been scanned for separators */
+    size_t scanned_lines{}; /*!< End of the lines returned by the last next_lines() */
+};
+
+}
@@ -181,6 +181,18 @@ private:
     } inflatable;
 #endif // CONFIG_ESP_MODEM_USE_INFLATABLE_BUFFER_IF_NEEDED
 
+#ifdef CONFIG_ESP_MODEM_USE_LINE_BUFFER
+    line_buffer lines;                                      /*!< Fixed buffer to tokenize replies line by line */
+
+    /**
+     * @brief Passes newly completed lines to the command callback, keeps the unfinished line in the line buffer
+     * @param data Data posted by the terminal, or nullptr if the data has to be read from the terminal
+     * @param len Length of the posted data
+     * @return true if the command processing has finished
+     */
+    bool process_lines(uint8_t *data, size_t len);
+#endif // CONFIG_ESP_MODEM_USE_LINE_BUFFER
+
     /**
      * @brief Set internal command callbacks to the underlying terminal.
      * Here we capture command replies to be processed by supplied command callbacks in  struct command_cb.
@@ -198,6 +210,7 @@ private:
         command_result result{};                                /*!< Command return code */
         SignalGroup signal;                                     /*!< Event group used to signal request-response operations */
         bool process_line(uint8_t *data, size_t consumed, size_t len);  /*!< Lets the processing callback handle one line (processing unit) */
+        bool process_lines(uint8_t *data, size_t len);          /*!< Lets the processing callback handle completed lines only */
         bool wait_for_line(uint32_t time_ms)                    /*!< Waiting for command processing */
         {
             return signal.wait_any(command_cb::GOT_LINE, time_ms);
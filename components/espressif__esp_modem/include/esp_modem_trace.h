@@ -0,0 +1,43 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Trace points of the library, reported with CONFIG_ESP_MODEM_TRACE_HOOKS
+ */
+typedef enum esp_modem_trace_point {
+    ESP_MODEM_TRACE_DTE_COMMAND,    /**< DTE::command(), arg: command length, then command_result */
+    ESP_MODEM_TRACE_CMUX_DATA,      /**< CMux::on_cmux_data() processing a read, arg: bytes received, then 1 if all frames were parsed */
+} esp_modem_trace_point_t;
+
+typedef enum esp_modem_trace_phase {
+    ESP_MODEM_TRACE_BEGIN,
+    ESP_MODEM_TRACE_END,
+} esp_modem_trace_phase_t;
+
+/**
+ * @brief Called at the beginning and at the end of each trace point
+ *
+ * The default is a weak no-op, the application overrides it to forward the events to its tracer.
+ * It runs in the task which sends the command, or in the terminal task, with the DTE lock held:
+ * it must not block nor call back into the library.
+ *
+ * @param point Trace point
+ * @param phase Beginning or end
+ * @param arg Argument, depends on the trace point
+ */
+void esp_modem_trace_hook(esp_modem_trace_point_t point, esp_modem_trace_phase_t phase, uint32_t arg);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,49 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "sdkconfig.h"
+
+#ifdef CONFIG_ESP_MODEM_TRACE_HOOKS
+
+#include "esp_modem_trace.h"
+
+namespace esp_modem {
+
+/**
+ * @brief Reports the lifetime of the scope to esp_modem_trace_hook(), from construction to destruction
+ */
+class TraceScope {
+public:
+    TraceScope(esp_modem_trace_point_t point, uint32_t arg): point(point)
+    {
+        esp_modem_trace_hook(point, ESP_MODEM_TRACE_BEGIN, arg);
+    }
+    ~TraceScope()
+    {
+        esp_modem_trace_hook(point, ESP_MODEM_TRACE_END, result);
+    }
+    void set_result(uint32_t arg)
+    {
+        result = arg;
+    }
+private:
+    esp_modem_trace_point_t point;
+    uint32_t result{0};
+};
+
+} // namespace esp_modem
+
+#define ESP_MODEM_TRACE_SCOPE(name, point, arg) ::esp_modem::TraceScope name((point), static_cast<uint32_t>(arg))
+#define ESP_MODEM_TRACE_RESULT(name, arg) name.set_result(static_cast<uint32_t>(arg))
+
+#else
+
+#define ESP_MODEM_TRACE_SCOPE(name, point, arg)
+#define ESP_MODEM_TRACE_RESULT(name, arg)
+
+#endif // CONFIG_ESP_MODEM_TRACE_HOOKS
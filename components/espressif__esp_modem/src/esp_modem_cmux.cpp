@@ -10,6 +10,7 @@
 #include "cxx_include/esp_modem_dte.hpp"
 #include "esp_log.h"
 #include "sdkconfig.h"
+#include "esp_modem_trace.hpp"
 
 using namespace esp_modem;
 
@@ -340,6 +341,7 @@ bool CMux::on_cmux_data(uint8_t *data, size_t actual_len)
         actual_len = term->read(data, buffer.size);
 #endif
     }
+    ESP_MODEM_TRACE_SCOPE(trace, ESP_MODEM_TRACE_CMUX_DATA, actual_len);
     ESP_LOG_BUFFER_HEXDUMP("CMUX Received", data, actual_len, ESP_LOG_VERBOSE);
     CMuxFrame frame = { .ptr = data, .len = actual_len };
     while (frame.len > 0) {
@@ -371,6 +373,7 @@ bool CMux::on_cmux_data(uint8_t *data, size_t actual_len)
             break;
         }
     }
+    ESP_MODEM_TRACE_RESULT(trace, 1);
     return true;
 }
 
@@ -5,10 +5,13 @@
  */
 
 #include <cstring>
+#include <algorithm>
+#include <iterator>
 #include "esp_log.h"
 #include "cxx_include/esp_modem_dte.hpp"
 #include "cxx_include/esp_modem_cmux.hpp"
 #include "esp_modem_config.h"
+#include "esp_modem_trace.hpp"
 
 using namespace esp_modem;
 
@@ -18,6 +21,9 @@ DTE::DTE(const esp_modem_dte_config *config, std::unique_ptr<Terminal> terminal)
     buffer(config->dte_buffer_size),
     cmux_term(nullptr), primary_term(std::move(terminal)), secondary_term(primary_term),
     mode(modem_mode::UNDEF)
+#ifdef CONFIG_ESP_MODEM_USE_LINE_BUFFER
+    , lines(config->dte_buffer_size)
+#endif
 {
     set_command_callbacks();
 }
@@ -26,6 +32,9 @@ DTE::DTE(std::unique_ptr<Terminal> terminal):
     buffer(dte_default_buffer_size),
     cmux_term(nullptr), primary_term(std::move(terminal)), secondary_term(primary_term),
     mode(modem_mode::UNDEF)
+#ifdef CONFIG_ESP_MODEM_USE_LINE_BUFFER
+    , lines(dte_default_buffer_size)
+#endif
 {
     set_command_callbacks();
 }
@@ -34,6 +43,9 @@ DTE::DTE(const esp_modem_dte_config *config, std::unique_ptr<Terminal> t, std::u
     buffer(config->dte_buffer_size),
     cmux_term(nullptr), primary_term(std::move(t)), secondary_term(std::move(s)),
     mode(modem_mode::DUAL_MODE)
+#ifdef CONFIG_ESP_MODEM_USE_LINE_BUFFER
+    , lines(config->dte_buffer_size)
+#endif
 {
     set_command_callbacks();
 }
@@ -42,6 +54,9 @@ DTE::DTE(std::unique_ptr<Terminal> t, std::unique_ptr<Terminal> s):
     buffer(dte_default_buffer_size),
     cmux_term(nullptr), primary_term(std::move(t)), secondary_term(std::move(s)),
     mode(modem_mode::DUAL_MODE)
+#ifdef CONFIG_ESP_MODEM_USE_LINE_BUFFER
+    , lines(dte_default_buffer_size)
+#endif
 {
     set_command_callbacks();
 }
@@ -53,6 +68,9 @@ void DTE::set_command_callbacks()
         if (command_cb.got_line == nullptr) {
             return false;
         }
+#ifdef CONFIG_ESP_MODEM_USE_LINE_BUFFER
+        return process_lines(data, len);
+#else
         if (data) {
             // For terminals which post data directly with the callback (CMUX)
             // we cannot defragment unless we allocate, but
@@ -114,6 +132,7 @@ void DTE::set_command_callbacks()
         command_cb.give_up();
         return true;
 #endif
+#endif // CONFIG_ESP_MODEM_USE_LINE_BUFFER
     });
     primary_term->set_error_cb([this](terminal_error err) {
         if (user_error_cb) {
@@ -133,6 +152,7 @@ void DTE::set_command_callbacks()
 command_result DTE::command(const std::string &command, got_line_cb got_line, uint32_t time_ms, const char separator)
 {
     Scoped<Lock> l1(internal_lock);
+    ESP_MODEM_TRACE_SCOPE(trace, ESP_MODEM_TRACE_DTE_COMMAND, command.length());
     command_cb.set(got_line, separator);
     primary_term->write((uint8_t *)command.c_str(), command.length());
     command_cb.wait_for_line(time_ms);
@@ -141,6 +161,10 @@ command_result DTE::command(const std::string &command, got_line_cb got_line, ui
 #ifdef CONFIG_ESP_MODEM_USE_INFLATABLE_BUFFER_IF_NEEDED
     inflatable.deflate();
 #endif
+#ifdef CONFIG_ESP_MODEM_USE_LINE_BUFFER
+    lines.reset();
+#endif
+    ESP_MODEM_TRACE_RESULT(trace, command_cb.result);
     return command_cb.result;
 }
 
@@ -360,6 +384,66 @@ bool DTE::command_cb::process_line(uint8_t *data, size_t consumed, size_t len)
     return false;
 }
 
+bool DTE::command_cb::process_lines(uint8_t *data, size_t len)
+{
+    if (result != command_result::TIMEOUT) {
+        return false;   // the reply has been processed already (got OK or FAIL previously)
+    }
+    result = got_line(data, len);
+    if (result == command_result::OK || result == command_result::FAIL) {
+        signal.set(GOT_LINE);
+        return true;
+    }
+    return false;
+}
+
+#ifdef CONFIG_ESP_MODEM_USE_LINE_BUFFER
+bool DTE::process_lines(uint8_t *data, size_t len)
+{
+    if (data && lines.empty()) {
+        // Terminals which post data directly (CMUX): no unfinished line pending,
+        // so we pass the completed lines to the callback directly from the terminal's buffer
+        // and keep only the trailing unfinished line (if any)
+        auto last = std::find(std::make_reverse_iterator(data + len), std::make_reverse_iterator(data), command_cb.separator);
+        size_t completed = std::distance(last, std::make_reverse_iterator(data));
+        if (completed > 0 && command_cb.process_lines(data, completed)) {
+            return true;
+        }
+        if (!lines.append(data + completed, len - completed)) {
+            command_cb.give_up();
+            return true;
+        }
+        return false;
+    }
+    if (data) {
+        // append the posted fragment to the unfinished line
+        if (!lines.append(data, len)) {
+            command_cb.give_up();
+            return true;
+        }
+    } else {
+        // data == nullptr: Terminals which request users to read current data,
+        // we read directly to the tail of the line buffer
+        auto tail = lines.tail();
+        if (lines.available() == 0) {
+            // a single line doesn't fit into the buffer -> report a failure
+            command_cb.give_up();
+            return true;
+        }
+        lines.commit(primary_term->read(tail, lines.available()));
+    }
+    uint8_t *completed_lines;
+    size_t completed_len;
+    if (lines.next_lines(command_cb.separator, completed_lines, completed_len)) {
+        if (command_cb.process_lines(completed_lines, completed_len)) {
+            return true;
+        }
+        lines.release();
+    }
+    return false;
+}
+#endif // CONFIG_ESP_MODEM_USE_LINE_BUFFER
+
 bool DTE::recover()
 {
     if (mode == modem_mode::CMUX_MODE || mode == modem_mode::CMUX_MANUAL_MODE || mode == modem_mode::DUAL_MODE) {
@@ -396,3 +480,58 @@ void DTE::extra_buffer::grow(size_t need_size)
  */
 unique_buffer::unique_buffer(size_t size):
     data(std::make_unique<uint8_t[]>(size)), size(size), consumed(0) {}
+
+line_buffer::line_buffer(size_t size):
+    data(std::make_unique<uint8_t[]>(size)), size(size) {}
+
+void line_buffer::compact()
+{
+    // move the unfinished line to the front to recycle the space of released lines
+    if (begin == 0) {
+        return;
+    }
+    std::memmove(data.get(), data.get() + begin, end - begin);
+    end -= begin;
+    scanned -= begin;
+    scanned_lines -= std::min(scanned_lines, begin);
+    begin = 0;
+}
+
+uint8_t *line_buffer::tail()
+{
+    if (available() == 0) {
+        compact();
+    }
+    return data.get() + end;
+}
+
+bool line_buffer::append(const uint8_t *d, size_t len)
+{
+    if (len > available()) {
+        compact();
+        if (len > available()) {
+            return false;
+        }
+    }
+    std::memcpy(data.get() + end, d, len);
+    end += len;
+    return true;
+}
+
+bool line_buffer::next_lines(char separator, uint8_t *&lines, size_t &len)
+{
+    // scan only the bytes we haven't seen yet, looking for the last separator
+    auto first = data.get() + scanned;
+    auto last = data.get() + end;
+    scanned = end;
+    while (last != first) {
+        if (*(last - 1) == separator) {
+            scanned_lines = last - data.get();
+            lines = data.get() + begin;
+            len = scanned_lines - begin;
+            return true;
+        }
+        --last;
+    }
+    return false;
+}
@@ -0,0 +1,11 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "esp_modem_trace.h"
+
+extern "C" __attribute__((weak)) void esp_modem_trace_hook(esp_modem_trace_point_t point, esp_modem_trace_phase_t phase, uint32_t arg)
+{
+}
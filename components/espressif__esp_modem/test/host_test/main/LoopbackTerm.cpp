@@ -20,6 +20,9 @@ void LoopbackTerm::stop()
 
 int LoopbackTerm::write(uint8_t *data, size_t len)
 {
+    if (unresponsive) {
+        return len;
+    }
     if (inject_by) {    // injection test: ignore what we write, but respond with injected data
         signal.clear(1);
         auto ret = std::async(&LoopbackTerm::batch_read, this);
@@ -108,12 +111,12 @@ int LoopbackTerm::read(uint8_t *data, size_t len)
     return read_len;
 }
 
-LoopbackTerm::LoopbackTerm(bool is_bg96): loopback_data(), data_len(0), pin_ok(false), is_bg96(is_bg96), inject_by(0)
+LoopbackTerm::LoopbackTerm(bool is_bg96): loopback_data(), data_len(0), pin_ok(false), is_bg96(is_bg96), unresponsive(false), inject_by(0)
 {
     init_signal();
 }
 
-LoopbackTerm::LoopbackTerm(): loopback_data(), data_len(0), pin_ok(false), is_bg96(false), inject_by(0)
+LoopbackTerm::LoopbackTerm(): loopback_data(), data_len(0), pin_ok(false), is_bg96(false), unresponsive(false), inject_by(0)
 {
     init_signal();
 }
@@ -134,6 +137,18 @@ int LoopbackTerm::inject(uint8_t *data, size_t len, size_t injected_by, size_t d
     return len;
 }
 
+void LoopbackTerm::set_unresponsive(bool is_unresponsive)
+{
+    unresponsive = is_unresponsive;
+}
+
+void LoopbackTerm::raise_error(terminal_error err)
+{
+    if (on_error) {
+        on_error(err);
+    }
+}
+
 void LoopbackTerm::batch_read()
 {
     while (data_len > 0) {
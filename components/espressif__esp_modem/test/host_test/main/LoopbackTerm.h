@@ -5,6 +5,7 @@
  */
 #pragma once
 
+#include <atomic>
 #include "cxx_include/esp_modem_api.hpp"
 #include "cxx_include/esp_modem_terminal.hpp"
 
@@ -24,6 +25,17 @@ public:
      */
     int inject(uint8_t *data, size_t len, size_t inject_by, size_t delay_before = 0, size_t delay_after = 1);
 
+    /**
+     * @brief Failure injection: while unresponsive, everything written to the terminal is dropped
+     * and nothing is replied (emulates a hung modem or a broken link), so commands time out
+     */
+    void set_unresponsive(bool unresponsive);
+
+    /**
+     * @brief Failure injection: reports a terminal error to the DTE (e.g. device gone, corrupted CMUX frame)
+     */
+    void raise_error(terminal_error err);
+
     void start() override;
     void stop() override;
 
@@ -47,6 +59,7 @@ private:
     size_t data_len;
     bool pin_ok;
     bool is_bg96;
+    std::atomic<bool> unresponsive;
     size_t inject_by;
     size_t delay_before_inject;
     size_t delay_after_inject;
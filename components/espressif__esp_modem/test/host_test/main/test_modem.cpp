@@ -346,3 +346,181 @@ TEST_CASE("CMUX manual mode transitions", "[esp_modem][transitions]")
     CHECK(dce->set_mode(esp_modem::modem_mode::UNDEF) == true);             // Succeeds from any state
 
 }
+
+TEST_CASE("Line buffer tokenization", "[esp_modem][line_buffer]")
+{
+    line_buffer lines(16);
+    uint8_t *data;
+    size_t len;
+    const uint8_t part1[] = {'+', 'C', 'S', 'Q', ':', ' ', '1'};
+    const uint8_t part2[] = {',', '2', '\r', '\n', 'O', 'K'};
+    const uint8_t part3[] = {'\r', '\n'};
+
+    CHECK(lines.append(part1, sizeof(part1)) == true);
+    CHECK(lines.next_lines('\n', data, len) == false);
+    CHECK(lines.append(part2, sizeof(part2)) == true);
+    CHECK(lines.next_lines('\n', data, len) == true);
+    CHECK(std::string((char *)data, len) == "+CSQ: 1,2\r\n");
+    lines.release();
+    CHECK(lines.empty() == false);  // "OK" is still pending
+    CHECK(lines.next_lines('\n', data, len) == false);
+    // the buffer is full now, the pending "OK" has to move to the front to make space for the separator
+    CHECK(lines.append(part3, sizeof(part3)) == true);
+    CHECK(lines.next_lines('\n', data, len) == true);
+    CHECK(std::string((char *)data, len) == "OK\r\n");
+    lines.release();
+    CHECK(lines.empty() == true);
+
+    // a single line longer than the buffer cannot be processed
+    const uint8_t too_long[17] = {};
+    CHECK(lines.append(too_long, sizeof(too_long)) == false);
+    lines.reset();
+    CHECK(lines.available() == 16);
+}
+
+TEST_CASE("Line buffer compaction", "[esp_modem][line_buffer]")
+{
+    line_buffer lines(16);
+    uint8_t *data;
+    size_t len;
+    const uint8_t part1[] = {'+', 'C', 'R', 'E', 'G', ':', ' ', '0', ',', '1', '\r', '\n', '+', 'C'};
+    const uint8_t part2[] = {'G', 'R', 'E', 'G', ':', ' ', '0', ',', '5', '\r', '\n'};
+
+    CHECK(lines.append(part1, sizeof(part1)) == true);
+    CHECK(lines.next_lines('\n', data, len) == true);
+    CHECK(std::string((char *)data, len) == "+CREG: 0,1\r\n");
+    lines.release();
+    CHECK(lines.available() == 2);
+    // 11 bytes don't fit at the tail: the pending "+C" has to move to the front
+    CHECK(lines.append(part2, sizeof(part2)) == true);
+    CHECK(lines.begin == 0);
+    CHECK(lines.end == 13);
+    CHECK(lines.next_lines('\n', data, len) == true);
+    CHECK(data == lines.data.get());
+    CHECK(std::string((char *)data, len) == "+CGREG: 0,5\r\n");
+    lines.release();
+    CHECK(lines.empty() == true);
+
+    // reading directly to the tail compacts the buffer, too
+    const uint8_t part3[] = {'O', 'K'};
+    lines.reset();
+    CHECK(lines.append(part1, sizeof(part1)) == true);
+    CHECK(lines.next_lines('\n', data, len) == true);
+    lines.release();
+    CHECK(lines.append(part3, sizeof(part3)) == true);
+    CHECK(lines.available() == 0);
+    auto tail = lines.tail();
+    CHECK(tail == lines.data.get() + 4);
+    CHECK(lines.available() == 12);
+    std::memcpy(tail, "\r\n", 2);
+    lines.commit(2);
+    CHECK(lines.next_lines('\n', data, len) == true);
+    CHECK(std::string((char *)data, len) == "+COK\r\n");
+}
+
+#if defined(CONFIG_ESP_MODEM_USE_LINE_BUFFER) || defined(CONFIG_ESP_MODEM_USE_INFLATABLE_BUFFER_IF_NEEDED)
+TEST_CASE("DTE multi-KB reply processing", "[esp_modem][benchmark]")
+{
+    auto term = std::make_unique<LoopbackTerm>();
+    auto loopback = term.get();
+    auto dte = std::make_shared<DTE>(std::move(term));
+    CHECK(term == nullptr);
+
+    for (size_t lines: {
+                64, 256, 1024
+            }) {
+        // simulates a long AT+COPS=? like reply: many lines followed by OK
+        std::string reply;
+        for (size_t i = 0; i < lines; ++i) {
+            reply += "+COPS: (2,\"Operator " + std::to_string(i) + "\",\"OP\",\"26201\",7)\r\n";
+        }
+        reply += "\r\nOK\r\n";
+        size_t parsed_bytes = 0;
+        loopback->inject((uint8_t *)reply.data(), reply.size(), 64, 0, 0);
+        auto start = std::chrono::steady_clock::now();
+        auto ret = dte->command("AT+COPS=?\r", [&](uint8_t *data, size_t len) {
+            // line oriented parser, similar to the command library ones
+            std::string_view response((char *)data, len);
+            size_t pos;
+            parsed_bytes += len;
+            while ((pos = response.find('\n')) != std::string::npos) {
+                auto token = response.substr(0, pos);
+                if (token.find("OK") == 0) {
+                    return command_result::OK;
+                }
+                response = response.substr(pos + 1);
+            }
+            return command_result::TIMEOUT;
+        }, 10000);
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        CHECK(ret == command_result::OK);
+#ifdef CONFIG_ESP_MODEM_USE_LINE_BUFFER
+        CHECK(parsed_bytes == reply.size());    // every byte passed to the parser only once
+#endif
+        std::cout << "Reply of " << reply.size() << " bytes (" << lines << " lines): "
+                  << elapsed.count() << " us, parser processed " << parsed_bytes << " bytes" << std::endl;
+        loopback->inject(nullptr, 0, 0, 0, 0);
+    }
+}
+#endif
+
+TEST_CASE("Link recovery with injected failures", "[esp_modem][recovery]")
+{
+    auto term = std::make_unique<LoopbackTerm>();
+    auto loopback = term.get();
+    auto dte = std::make_shared<DTE>(std::move(term));
+    CHECK(term == nullptr);
+
+    esp_modem_dce_config_t dce_config = ESP_MODEM_DCE_DEFAULT_CONFIG("APN");
+    esp_netif_t netif{};
+    auto dce = create_SIM7600_dce(&dce_config, dte, &netif);
+    CHECK(dce != nullptr);
+
+    std::vector<terminal_error> reported;
+    dte->set_error_cb([&](terminal_error err) {
+        reported.push_back(err);
+    });
+    // the CMUX loopback echoes the command payload, so a command succeeds if we read our request back
+    auto cmux_echo = [&]() {
+        const std::string request = "Test\n";
+        return dce->command(request, [&](uint8_t *data, size_t len) {
+            return std::string((char *)data, len) == request ? command_result::OK : command_result::TIMEOUT;
+        }, 200);
+    };
+
+    // Bring-up: SYNC -> DATA (over CMUX)
+    CHECK(dce->sync() == command_result::OK);
+    CHECK(dce->set_mode(esp_modem::modem_mode::CMUX_MODE) == true);
+    CHECK(cmux_echo() == command_result::OK);
+
+    // Modem hangs: the command channel times out
+    loopback->set_unresponsive(true);
+    CHECK(cmux_echo() == command_result::TIMEOUT);
+
+    // Corrupted frame reported by the terminal: the DTE recovers the CMUX protocol by itself
+    loopback->set_unresponsive(false);
+    loopback->raise_error(terminal_error::CHECKSUM_ERROR);
+    CHECK(reported.size() == 1);
+    CHECK(cmux_echo() == command_result::OK);
+
+    // Link-level recovery: leave CMUX, re-sync, re-enter CMUX
+    CHECK(dce->set_mode(esp_modem::modem_mode::COMMAND_MODE) == true);
+    CHECK(dce->sync() == command_result::OK);
+    CHECK(dce->set_mode(esp_modem::modem_mode::CMUX_MODE) == true);
+    CHECK(cmux_echo() == command_result::OK);
+
+    // Modem hangs in CMUX: leaving CMUX fails, the CMUX terminal stays attached
+    loopback->set_unresponsive(true);
+    CHECK(dce->set_mode(esp_modem::modem_mode::COMMAND_MODE) == false);
+    // Modem is back: force the DTE state and close the CMUX terminal explicitly
+    loopback->set_unresponsive(false);
+    CHECK(dce->set_mode(esp_modem::modem_mode::UNDEF) == true);
+    CHECK(dce->set_mode(esp_modem::modem_mode::CMUX_MANUAL_EXIT) == true);
+    CHECK(dce->sync() == command_result::OK);
+    CHECK(dce->set_mode(esp_modem::modem_mode::CMUX_MODE) == true);
+    CHECK(cmux_echo() == command_result::OK);
+
+    // USB device gone is reported to the user callback (the DCE has to be recreated)
+    loopback->raise_error(terminal_error::DEVICE_GONE);
+    CHECK(reported.back() == terminal_error::DEVICE_GONE);
+}
@@ -119,6 +119,17 @@ esp_err_t esp_secure_cert_get_tlv_info_from_iterator(esp_secure_cert_tlv_iterato
  */
 void esp_secure_cert_list_tlv_entries(void);
 
+/*
+ * Release the decrypted and derived TLV data cache
+ *
+ * @note
+ * With CONFIG_ESP_SECURE_CERT_CACHE_DECRYPTED_TLV the data returned for encrypted TLV entries
+ * and HMAC derived keys is kept in internal RAM and returned again on later reads.
+ * This API zeroizes and frees it, buffers obtained earlier must not be used afterwards.
+ * The next read decrypts or derives the data again.
+ */
+void esp_secure_cert_release_cache(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,73 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_secure_cert_tlv_config.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Number of slots of the index, the partition holds a few tens of TLV entries at most */
+#define ESP_SECURE_CERT_TLV_INDEX_SLOTS         64
+
+/*
+ * Index slot, maps a (type, subtype) pair to the offset of its TLV entry.
+ * The (type, ESP_SECURE_CERT_SUBTYPE_MAX) slot holds the latest entry of the type.
+ */
+typedef struct esp_secure_cert_tlv_index_slot {
+    uint8_t type;
+    uint8_t subtype;
+    uint8_t used: 1;
+    uint8_t verified: 1;                /* crc of the entry matched when the index was built */
+    uint16_t offset;                    /* offset of the TLV header from the base of the partition */
+} esp_secure_cert_tlv_index_slot_t;
+
+typedef struct esp_secure_cert_tlv_index {
+    const void *base;                   /* base address the index was built from, NULL if not built */
+    uint16_t end_offset;                /* offset of the first byte after the last valid TLV entry */
+    uint16_t entries;                   /* number of TLV entries found */
+    esp_secure_cert_tlv_index_slot_t slots[ESP_SECURE_CERT_TLV_INDEX_SLOTS];
+} esp_secure_cert_tlv_index_t;
+
+/*
+ * Build the index of the TLV entries of the esp_secure_cert partition
+ *
+ * @note
+ *      The partition is walked once and the crc of every entry is verified on the way,
+ *      lookups done through the index then never read the partition again.
+ * @input
+ * index                    Index to build
+ * base                     Memory mapped address of the esp_secure_cert partition
+ * size                     Size of the partition
+ *
+ * @return
+ *      - ESP_OK            On success
+ *      - ESP_ERR_NO_MEM    The partition has more entries than the index can hold,
+ *                          esp_secure_cert_find_tlv() has to be used instead
+ */
+esp_err_t esp_secure_cert_tlv_index_build(esp_secure_cert_tlv_index_t *index, const void *base, size_t size);
+
+/*
+ * Find the TLV entry of given type and subtype in the index
+ *
+ * @note
+ *      Same results as esp_secure_cert_find_tlv(): the first entry of given subtype,
+ *      or the latest entry of the type with ESP_SECURE_CERT_SUBTYPE_MAX, and the end
+ *      of the TLV entries with ESP_SECURE_CERT_TLV_END.
+ * @return
+ *      - ESP_OK            On success
+ *      - ESP_FAIL          Entry not found, or found with a crc mismatch
+ */
+esp_err_t esp_secure_cert_tlv_index_find(const esp_secure_cert_tlv_index_t *index, esp_secure_cert_tlv_type_t type, uint8_t subtype, void **tlv_address);
+
+#ifdef __cplusplus
+}
+#endif
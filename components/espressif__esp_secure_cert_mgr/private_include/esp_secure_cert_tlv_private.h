@@ -125,6 +125,16 @@ const void *esp_secure_cert_get_mapped_addr(void);
  */
 esp_err_t esp_secure_cert_find_tlv(const void *esp_secure_cert_addr, esp_secure_cert_tlv_type_t type, uint8_t subtype, void **tlv_address);
 
+/*
+ * Get the total length of the TLV entry, header, padded data and footer
+ */
+uint16_t esp_secure_cert_get_tlv_total_length(esp_secure_cert_tlv_header_t *tlv_header);
+
+/*
+ * Verify the magic and the crc of the TLV entry
+ */
+bool esp_secure_cert_verify_tlv_integrity(esp_secure_cert_tlv_header_t *tlv_header);
+
 /*
  *  Get the flash address of the data of a TLV entry
  *
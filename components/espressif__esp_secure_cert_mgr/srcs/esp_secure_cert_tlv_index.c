@@ -0,0 +1,128 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_crc.h"
+#include "esp_secure_cert_tlv_index.h"
+#include "esp_secure_cert_tlv_private.h"
+
+static const char *TAG = "esp_secure_cert_index";
+
+#define MIN_ALIGNMENT_REQUIRED 16
+
+_Static_assert((ESP_SECURE_CERT_TLV_INDEX_SLOTS & (ESP_SECURE_CERT_TLV_INDEX_SLOTS - 1)) == 0, "Index slots must be a power of two");
+
+/* Same layout computations as esp_secure_cert_tlv_find.c */
+static size_t esp_secure_cert_index_tlv_total_length(const esp_secure_cert_tlv_header_t *tlv_header)
+{
+    size_t padding_length = (MIN_ALIGNMENT_REQUIRED - (tlv_header->length % MIN_ALIGNMENT_REQUIRED)) % MIN_ALIGNMENT_REQUIRED;
+    return sizeof(esp_secure_cert_tlv_header_t) + tlv_header->length + padding_length + sizeof(esp_secure_cert_tlv_footer_t);
+}
+
+static bool esp_secure_cert_index_verify_crc(const esp_secure_cert_tlv_header_t *tlv_header, size_t total_length)
+{
+    size_t crc_data_len = total_length - sizeof(esp_secure_cert_tlv_footer_t);
+    esp_secure_cert_tlv_footer_t tlv_footer;
+    /* The footer is not necessarily aligned in a synthetic image */
+    memcpy(&tlv_footer, (const uint8_t *)tlv_header + crc_data_len, sizeof(tlv_footer));
+    return tlv_footer.crc == esp_crc32_le(UINT32_MAX, (const uint8_t *)tlv_header, crc_data_len);
+}
+
+static size_t esp_secure_cert_index_hash(uint8_t type, uint8_t subtype)
+{
+    /* Fibonacci hashing of the 16 bit key, the top bits are the best mixed */
+    uint32_t key = ((uint32_t)type << 8) | subtype;
+    return (key * 2654435761u) >> 16;
+}
+
+/*
+ * Find the slot of the key, or the empty slot where it goes
+ * @return NULL when the index is full and the key is not in it
+ */
+static esp_secure_cert_tlv_index_slot_t *esp_secure_cert_index_slot(esp_secure_cert_tlv_index_t *index, uint8_t type, uint8_t subtype)
+{
+    size_t slot = esp_secure_cert_index_hash(type, subtype);
+    for (size_t probe = 0; probe < ESP_SECURE_CERT_TLV_INDEX_SLOTS; probe++) {
+        esp_secure_cert_tlv_index_slot_t *entry = &index->slots[(slot + probe) & (ESP_SECURE_CERT_TLV_INDEX_SLOTS - 1)];
+        if (!entry->used || (entry->type == type && entry->subtype == subtype)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+esp_err_t esp_secure_cert_tlv_index_build(esp_secure_cert_tlv_index_t *index, const void *base, size_t size)
+{
+    if (index == NULL || base == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(index, 0, sizeof(*index));
+
+    size_t tlv_offset = 0;
+    while (tlv_offset + sizeof(esp_secure_cert_tlv_header_t) <= size) {
+        const esp_secure_cert_tlv_header_t *tlv_header = (const esp_secure_cert_tlv_header_t *)((const uint8_t *)base + tlv_offset);
+        if (tlv_header->magic != ESP_SECURE_CERT_TLV_MAGIC) {
+            break;
+        }
+        size_t total_length = esp_secure_cert_index_tlv_total_length(tlv_header);
+        if (tlv_offset + total_length > size || tlv_offset > UINT16_MAX) {
+            ESP_LOGD(TAG, "TLV entry at offset %d runs past the end of the partition", (int)tlv_offset);
+            break;
+        }
+        bool verified = esp_secure_cert_index_verify_crc(tlv_header, total_length);
+
+        /* Only the first entry of a subtype is ever returned, as with the linear search */
+        esp_secure_cert_tlv_index_slot_t *entry = esp_secure_cert_index_slot(index, tlv_header->type, tlv_header->subtype);
+        if (entry != NULL && !entry->used) {
+            *entry = (esp_secure_cert_tlv_index_slot_t) {
+                .type = tlv_header->type, .subtype = tlv_header->subtype, .used = 1, .verified = verified, .offset = (uint16_t)tlv_offset,
+            };
+        }
+        /* The latest entry of the type is kept under ESP_SECURE_CERT_SUBTYPE_MAX */
+        esp_secure_cert_tlv_index_slot_t *latest = esp_secure_cert_index_slot(index, tlv_header->type, ESP_SECURE_CERT_SUBTYPE_MAX);
+        if (entry == NULL || latest == NULL) {
+            ESP_LOGW(TAG, "Too many TLV entries for the index");
+            index->base = NULL;
+            return ESP_ERR_NO_MEM;
+        }
+        *latest = (esp_secure_cert_tlv_index_slot_t) {
+            .type = tlv_header->type, .subtype = ESP_SECURE_CERT_SUBTYPE_MAX, .used = 1, .verified = verified, .offset = (uint16_t)tlv_offset,
+        };
+
+        index->entries++;
+        tlv_offset += total_length;
+    }
+
+    index->end_offset = (uint16_t)tlv_offset;
+    index->base = base;
+    ESP_LOGD(TAG, "Indexed %d TLV entries", index->entries);
+    return ESP_OK;
+}
+
+esp_err_t esp_secure_cert_tlv_index_find(const esp_secure_cert_tlv_index_t *index, esp_secure_cert_tlv_type_t type, uint8_t subtype, void **tlv_address)
+{
+    if (index == NULL || index->base == NULL || tlv_address == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (type == ESP_SECURE_CERT_TLV_END) {
+        *tlv_address = (void *)((const uint8_t *)index->base + index->end_offset);
+        return ESP_OK;
+    }
+
+    const esp_secure_cert_tlv_index_slot_t *entry = esp_secure_cert_index_slot((esp_secure_cert_tlv_index_t *)index, (uint8_t)type, subtype);
+    if (entry == NULL || !entry->used) {
+        ESP_LOGD(TAG, "Unable to find tlv of type: %d and subtype: %d", type, subtype);
+        return ESP_FAIL;
+    }
+    if (!entry->verified) {
+        ESP_LOGD(TAG, "tlv of type: %d and subtype: %d failed the crc check", type, subtype);
+        return ESP_FAIL;
+    }
+    *tlv_address = (void *)((const uint8_t *)index->base + entry->offset);
+    return ESP_OK;
+}
@@ -5,6 +5,7 @@
  */
 
 #include <string.h>
+#include <sys/lock.h>
 #include "esp_log.h"
 #include "esp_err.h"
 #include "esp_partition.h"
@@ -32,12 +33,14 @@
 #include "mbedtls/ecdsa.h"
 #include "mbedtls/pk.h"
 #include "mbedtls/version.h"
+#include "mbedtls/platform_util.h"
 
 #include "esp_secure_cert_read.h"
 #include "esp_secure_cert_tlv_config.h"
 #include "esp_secure_cert_tlv_read.h"
 #include "esp_secure_cert_tlv_private.h"
 #include "esp_secure_cert_crypto.h"
+#include "esp_secure_cert_tlv_index.h"
 
 #if SOC_HMAC_SUPPORTED
 #include "esp_hmac.h"
@@ -67,7 +70,28 @@
 
 static const char *TAG = "esp_secure_cert_tlv";
 
-#define MIN_ALIGNMENT_REQUIRED 16
+/* (type, subtype) -> offset of the verified TLV entry, built when the partition is mapped */
+static esp_secure_cert_tlv_index_t s_tlv_index;
+
+#ifdef CONFIG_ESP_SECURE_CERT_CACHE_DECRYPTED_TLV
+#define ESP_SECURE_CERT_CACHE_ENTRIES 4
+
+/*
+ * Decrypted or derived TLV data, kept in internal RAM so that
+ * the HMAC based decryption and key derivation only run once.
+ */
+typedef struct esp_secure_cert_cache_entry {
+    uint8_t type;
+    uint8_t subtype;
+    uint32_t len;
+    char *data;                         /* NULL when the entry is free */
+} esp_secure_cert_cache_entry_t;
+
+static esp_secure_cert_cache_entry_t s_tlv_cache[ESP_SECURE_CERT_CACHE_ENTRIES];
+#endif
+
+/* Guards the index and the cache */
+static _lock_t s_tlv_lock;
 
 
 #if SOC_HMAC_SUPPORTED
@@ -112,160 +136,20 @@ const void *esp_secure_cert_get_mapped_addr(void)
     esp_err_t err;
 
     /* Map the entire partition */
-    err = esp_partition_mmap(partition, 0, partition->size, SPI_FLASH_MMAP_DATA, &esp_secure_cert_mapped_addr, &handle);
+    const void *mapped_addr;
+    err = esp_partition_mmap(partition, 0, partition->size, SPI_FLASH_MMAP_DATA, &mapped_addr, &handle);
     if (err != ESP_OK) {
         return NULL;
     }
-    return esp_secure_cert_mapped_addr;
-}
-
-/*
- * Get the padding length applicable for the given TLV
- *
- * @input   The pointer to the start of the TLV (TLV Header)
- * @note    The padding length is defined in the design of the TLV.
- *          It says that each TLV data entry should be a multiple of MIN_ALIGNMENT_REQUIRED
- *          The actual tlv data is automatically padded to the nearest multiple of MIN_ALIGNMENT_REQUIRED
- */
-static uint8_t esp_secure_cert_get_padding_length(esp_secure_cert_tlv_header_t *tlv_header)
-{
-    return ((MIN_ALIGNMENT_REQUIRED - (tlv_header->length % MIN_ALIGNMENT_REQUIRED)) % MIN_ALIGNMENT_REQUIRED);
-}
-
-/*
- * Get the total length of the TLV pointed by tlv_header
- * @input
- * tlv_header   The pointer to the start of the TLV (TLV Header)
- *
- * @note
- *          The total length of the TLV consists of following parts
- *          1) TLV Header
- *          2) TLV data
- *          3) Padding
- *          4) TLV footer
- *
- *          It is ensured by design that this length shall always be a multiple of MIN_ALIGNMENT_REQUIRED
- *
- */
-static uint16_t esp_secure_cert_get_tlv_total_length(esp_secure_cert_tlv_header_t *tlv_header)
-{
-    uint16_t padding_length = esp_secure_cert_get_padding_length(tlv_header);
-    uint16_t total_length = sizeof(esp_secure_cert_tlv_header_t) + tlv_header->length + padding_length + sizeof(esp_secure_cert_tlv_footer_t);
-    return total_length;
-}
-
-/*
- * Verify the TLV integrity
- *
- * @input
- * tlv_header   The pointer to the start of the TLV (TLV header)
- *
- * @note
- *      This API calculates the crc value of header + tlv_data + padding
- *      This value is compared with the value stored in the TLV footer.
- *
- * @return
- *      True    TLV integrity verified
- *      False   TLV intefrity could not be verified
- */
-static bool esp_secure_cert_verify_tlv_integrity(esp_secure_cert_tlv_header_t *tlv_header)
-{
-    ESP_LOGD(TAG, "Verifying the TLV integrity");
-    if (!(tlv_header->magic == ESP_SECURE_CERT_TLV_MAGIC)) {
-        return false;
-    }
-
-    uint8_t padding_length = esp_secure_cert_get_padding_length(tlv_header);
-    ESP_LOGD(TAG, "Padding length obtained = %u", padding_length);
-    size_t crc_data_len = sizeof(esp_secure_cert_tlv_header_t) + tlv_header->length + padding_length;
-    uint32_t data_crc = esp_crc32_le(UINT32_MAX, (const uint8_t * )tlv_header, crc_data_len);
-    esp_secure_cert_tlv_footer_t *tlv_footer = (esp_secure_cert_tlv_footer_t *)((void*)tlv_header + crc_data_len);
-    if (tlv_footer->crc != data_crc) {
-        ESP_LOGD(TAG, "Calculated crc = %04X does not match with crc"
-                 " read from esp_secure_cert partition = %04X", (unsigned int)data_crc, (unsigned int)tlv_footer->crc);
-        return false;
-    }
-    return true;
-}
-
-/*
- * Find the offset of tlv structure of given type in the esp_secure_cert partition
- *
- * Note: This API also validates the crc of the respective tlv before returning the offset
- * @input
- * esp_secure_cert_addr     Memory mapped address of the esp_secure_cert partition
- * type                     Type of the tlv structure.
- *                          for calculating current crc for esp_secure_cert
- * subtype                  Subtype of the given tlv structure. If subtype is given as ESP_SECURE_CERT_SUBTYPE_MAX then the entry with highest value of subtype is given as output
- *
- * tlv_address              Void pointer to store tlv address
- *
- */
-esp_err_t esp_secure_cert_find_tlv(const void *esp_secure_cert_addr, esp_secure_cert_tlv_type_t type, uint8_t subtype, void **tlv_address)
-{
-    /* start from the begining of the partition */
-    uint16_t tlv_offset = 0;
-    uint8_t latest_subtype = 0;
-    esp_secure_cert_tlv_header_t *latest_tlv_header = NULL;
-    bool read_latest_tlv = 0;
-
-    if (subtype == ESP_SECURE_CERT_SUBTYPE_MAX) {
-        read_latest_tlv = 1;
-    }
-
-    while (1) {
-        esp_secure_cert_tlv_header_t *tlv_header = (esp_secure_cert_tlv_header_t *)(esp_secure_cert_addr + tlv_offset);
-        ESP_LOGD(TAG, "Reading from offset of %d from base of esp_secure_cert", tlv_offset);
-        if (tlv_header->magic != ESP_SECURE_CERT_TLV_MAGIC) {
-            if (read_latest_tlv) {
-                if (latest_tlv_header != NULL) {
-                    // Verifying the latest TLV here because we only need to verify the last TLV entry of given subtype
-                    // instead of all available entries of the given subtype
-                    ESP_LOGD(TAG, "Verify integrity of latest tlv obtained of subtype = %d", latest_subtype);
-                    if (esp_secure_cert_verify_tlv_integrity(latest_tlv_header)) {
-                        ESP_LOGD(TAG, "tlv structure of type %d and subtype %d found and verified", type, latest_subtype);
-                        *tlv_address = (void *)latest_tlv_header;
-                        return ESP_OK;
-                    } else {
-                        return ESP_FAIL;
-                    }
-                }
-            }
-            if (type == ESP_SECURE_CERT_TLV_END) {
-                /* The invalid magic means last tlv read successfully was the last valid tlv structure present,
-                 * so send the end address of the tlv.
-                 * This address can be used to add a new tlv structure. */
-                *tlv_address = (void *)tlv_header;
-                return ESP_OK;
-            }
-            ESP_LOGD(TAG, "Unable to find tlv of type: %d", type);
-            ESP_LOGD(TAG, "Expected magic byte is %04X, obtained magic byte = %04X", ESP_SECURE_CERT_TLV_MAGIC, (unsigned int) tlv_header->magic);
-            return ESP_FAIL;
-        }
 
-        if (((esp_secure_cert_tlv_type_t)tlv_header->type) == type) {
-            if (read_latest_tlv) {
-                ESP_LOGD(TAG, "TLV entry of type: %d and subtype:%d found", tlv_header->type, tlv_header->subtype);
-                ESP_LOGD(TAG, "Continuing to find more recent entry of given subtype");
-                latest_subtype = tlv_header->subtype;
-                // Store the tlv address of the latest entry found with given type
-                latest_tlv_header = (void *)tlv_header;
-                // Dont stop here and keep traversing till last TLV entry
-            } else {
-                if (tlv_header->subtype == subtype) {
-                    if (esp_secure_cert_verify_tlv_integrity(tlv_header)) {
-                        ESP_LOGD(TAG, "tlv structure of type %d and subtype %d found and verified", type, subtype);
-                        *tlv_address = (void *)tlv_header;
-                        return ESP_OK;
-                    } else {
-                        return ESP_FAIL;
-                    }
-                }
-            }
-        }
-        // Move the offset to the start of the next tlv entry
-        tlv_offset = tlv_offset + esp_secure_cert_get_tlv_total_length(tlv_header);
+    /* Verify the TLV entries once here, lookups then go through the index */
+    _lock_acquire(&s_tlv_lock);
+    if (esp_secure_cert_tlv_index_build(&s_tlv_index, mapped_addr, partition->size) != ESP_OK) {
+        ESP_LOGW(TAG, "Could not index the TLV entries, falling back to linear search");
     }
+    _lock_release(&s_tlv_lock);
+    esp_secure_cert_mapped_addr = mapped_addr;
+    return esp_secure_cert_mapped_addr;
 }
 
 /**
@@ -286,7 +170,13 @@ static esp_err_t esp_secure_cert_tlv_get_header(esp_secure_cert_tlv_type_t type,
         ESP_LOGE(TAG, "Error in obtaining esp_secure_cert memory mapped address");
         return ESP_FAIL;
     }
-    err = esp_secure_cert_find_tlv(esp_secure_cert_addr, type, subtype, (void **)tlv_header);
+    _lock_acquire(&s_tlv_lock);
+    if (s_tlv_index.base == esp_secure_cert_addr) {
+        err = esp_secure_cert_tlv_index_find(&s_tlv_index, type, subtype, (void **)tlv_header);
+    } else {
+        err = esp_secure_cert_find_tlv(esp_secure_cert_addr, type, subtype, (void **)tlv_header);
+    }
+    _lock_release(&s_tlv_lock);
     if (err != ESP_OK) {
         ESP_LOGD(TAG, "Could not find the tlv of type %d and subtype %d", type, subtype);
         return err;
@@ -294,6 +184,79 @@ static esp_err_t esp_secure_cert_tlv_get_header(esp_secure_cert_tlv_type_t type,
     return err;
 }
 
+#ifdef CONFIG_ESP_SECURE_CERT_CACHE_DECRYPTED_TLV
+static bool esp_secure_cert_cache_get(const esp_secure_cert_tlv_header_t *tlv_header, char **buffer, uint32_t *len)
+{
+    bool found = false;
+    _lock_acquire(&s_tlv_lock);
+    for (int i = 0; i < ESP_SECURE_CERT_CACHE_ENTRIES; i++) {
+        if (s_tlv_cache[i].data != NULL && s_tlv_cache[i].type == tlv_header->type && s_tlv_cache[i].subtype == tlv_header->subtype) {
+            *buffer = s_tlv_cache[i].data;
+            *len = s_tlv_cache[i].len;
+            found = true;
+            break;
+        }
+    }
+    _lock_release(&s_tlv_lock);
+    return found;
+}
+
+/*
+ * Hand the decrypted data over to the cache
+ * @return false if the cache is full, the data then stays owned by the caller
+ */
+static bool esp_secure_cert_cache_put(const esp_secure_cert_tlv_header_t *tlv_header, char *data, uint32_t len)
+{
+    bool stored = false;
+    _lock_acquire(&s_tlv_lock);
+    for (int i = 0; i < ESP_SECURE_CERT_CACHE_ENTRIES; i++) {
+        if (s_tlv_cache[i].data == NULL) {
+            s_tlv_cache[i] = (esp_secure_cert_cache_entry_t) {
+                .type = tlv_header->type, .subtype = tlv_header->subtype, .len = len, .data = data,
+            };
+            stored = true;
+            break;
+        }
+    }
+    _lock_release(&s_tlv_lock);
+    return stored;
+}
+#endif /* CONFIG_ESP_SECURE_CERT_CACHE_DECRYPTED_TLV */
+
+/* Buffers owned by the cache are only freed by esp_secure_cert_release_cache() */
+static bool esp_secure_cert_cache_owns(const char *buffer)
+{
+    bool owned = false;
+#ifdef CONFIG_ESP_SECURE_CERT_CACHE_DECRYPTED_TLV
+    _lock_acquire(&s_tlv_lock);
+    for (int i = 0; i < ESP_SECURE_CERT_CACHE_ENTRIES; i++) {
+        if (buffer != NULL && s_tlv_cache[i].data == buffer) {
+            owned = true;
+            break;
+        }
+    }
+    _lock_release(&s_tlv_lock);
+#else
+    (void) buffer;
+#endif
+    return owned;
+}
+
+void esp_secure_cert_release_cache(void)
+{
+#ifdef CONFIG_ESP_SECURE_CERT_CACHE_DECRYPTED_TLV
+    _lock_acquire(&s_tlv_lock);
+    for (int i = 0; i < ESP_SECURE_CERT_CACHE_ENTRIES; i++) {
+        if (s_tlv_cache[i].data != NULL) {
+            mbedtls_platform_zeroize(s_tlv_cache[i].data, s_tlv_cache[i].len);
+            free(s_tlv_cache[i].data);
+        }
+        memset(&s_tlv_cache[i], 0, sizeof(s_tlv_cache[i]));
+    }
+    _lock_release(&s_tlv_lock);
+#endif
+}
+
 esp_err_t esp_secure_cert_tlv_get_addr(esp_secure_cert_tlv_type_t type, esp_secure_cert_tlv_subtype_t subtype, char **buffer, uint32_t *len)
 {
     esp_err_t err;
@@ -317,6 +280,14 @@ esp_err_t esp_secure_cert_tlv_get_addr(esp_secure_cert_tlv_type_t type, esp_secu
     *buffer = (char *)&tlv_header->value;
     *len = tlv_header->length;
 
+#if SOC_HMAC_SUPPORTED && defined(CONFIG_ESP_SECURE_CERT_CACHE_DECRYPTED_TLV)
+    if ((ESP_SECURE_CERT_IS_TLV_ENCRYPTED(tlv_header->flags) || ESP_SECURE_CERT_HMAC_ECDSA_KEY_DERIVATION(tlv_header->flags)) &&
+            esp_secure_cert_cache_get(tlv_header, buffer, len)) {
+        ESP_LOGD(TAG, "TLV data of type %d and subtype %d found in the cache", tlv_header->type, tlv_header->subtype);
+        return ESP_OK;
+    }
+#endif
+
     if (ESP_SECURE_CERT_IS_TLV_ENCRYPTED(tlv_header->flags)) {
 #if SOC_HMAC_SUPPORTED
         ESP_LOGD(TAG, "TLV data is encrypted");
@@ -335,6 +306,9 @@ esp_err_t esp_secure_cert_tlv_get_addr(esp_secure_cert_tlv_type_t type, esp_secu
         ESP_FAULT_ASSERT(err == ESP_OK);
         *buffer = output_buf;
         *len =  *len - HMAC_ENCRYPTION_TAG_LEN;
+#ifdef CONFIG_ESP_SECURE_CERT_CACHE_DECRYPTED_TLV
+        esp_secure_cert_cache_put(tlv_header, output_buf, *len);
+#endif
 #else
         return ESP_ERR_NOT_SUPPORTED;
 #endif
@@ -355,6 +329,9 @@ esp_err_t esp_secure_cert_tlv_get_addr(esp_secure_cert_tlv_type_t type, esp_secu
         ESP_FAULT_ASSERT(err == ESP_OK);
         *buffer = output_buf;
         *len = ESP_SECURE_CERT_ECDSA_DER_KEY_SIZE;
+#ifdef CONFIG_ESP_SECURE_CERT_CACHE_DECRYPTED_TLV
+        esp_secure_cert_cache_put(tlv_header, output_buf, *len);
+#endif
 #else
         return ESP_ERR_NOT_SUPPORTED;
 #endif
@@ -406,7 +383,7 @@ esp_err_t esp_secure_cert_get_tlv_info(esp_secure_cert_tlv_config_t *tlv_config,
 esp_err_t esp_secure_cert_free_tlv_info(esp_secure_cert_tlv_info_t *tlv_info)
 {
     if (tlv_info) {
-        if (!esp_ptr_in_drom((const void *) tlv_info->data)) {
+        if (!esp_ptr_in_drom((const void *) tlv_info->data) && !esp_secure_cert_cache_owns(tlv_info->data)) {
             /* Free the buffer only if it is not from the drom section */
             free(tlv_info->data);
         }
@@ -816,7 +793,7 @@ esp_err_t esp_secure_cert_get_priv_key(char **buffer, uint32_t *len)
 
 esp_err_t esp_secure_cert_free_priv_key(char *buffer)
 {
-    if (!esp_ptr_in_drom((const void *) buffer)) {
+    if (!esp_ptr_in_drom((const void *) buffer) && !esp_secure_cert_cache_owns(buffer)) {
         free(buffer);
         return ESP_OK;
     }
@@ -0,0 +1,223 @@
+#define CATCH_CONFIG_MAIN // This tells the catch header to generate a main
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <vector>
+#include "catch.hpp"
+#include "esp_crc.h"
+#include "esp_secure_cert_tlv_index.h"
+
+using namespace std::chrono;
+
+// From esp_secure_cert_tlv_private.h, which only builds as C
+extern "C" esp_err_t esp_secure_cert_find_tlv(const void *esp_secure_cert_addr, esp_secure_cert_tlv_type_t type, uint8_t subtype, void **tlv_address);
+
+static constexpr uint32_t tlv_magic = 0xBA5EBA11;
+static constexpr size_t header_len = 12;
+static constexpr size_t footer_len = 4;
+static constexpr size_t partition_size = 8192;
+
+/**
+ * Synthetic esp_secure_cert partition: TLV entries laid out as by the provisioning tools,
+ * header, data padded to 16 bytes, crc footer, and erased flash after the last one.
+ */
+class TlvImage {
+public:
+    TlvImage(): data(partition_size, 0xFF) {}
+
+    size_t add(uint8_t type, uint8_t subtype, uint16_t length, bool corrupt = false)
+    {
+        size_t offset = end;
+        uint8_t *tlv = &data[offset];
+        put32(tlv, tlv_magic);
+        tlv[4] = 0;                             // flags
+        memset(tlv + 5, 0, 3);                  // reserved
+        tlv[8] = type;
+        tlv[9] = subtype;
+        tlv[10] = length & 0xFF;
+        tlv[11] = length >> 8;
+        size_t padded = (length + 15) & ~15;
+        for (size_t i = 0; i < padded; i++) {
+            tlv[header_len + i] = i < length ? (uint8_t)(type + subtype + i) : 0;
+        }
+        uint32_t crc = esp_crc32_le(UINT32_MAX, tlv, header_len + padded);
+        put32(tlv + header_len + padded, corrupt ? ~crc : crc);
+        end += header_len + padded + footer_len;
+        return offset;
+    }
+
+    const void *base() const
+    {
+        return data.data();
+    }
+
+    std::vector<uint8_t> data;
+    size_t end = 0;
+
+private:
+    static void put32(uint8_t *p, uint32_t value)
+    {
+        memcpy(p, &value, sizeof(value));
+    }
+};
+
+/**
+ * Linear search of the component, the reference the index has to match
+ * @return offset of the entry, -1 if not found or corrupt
+ */
+static long linear_find(const TlvImage &image, uint8_t type, uint8_t subtype)
+{
+    void *address = nullptr;
+    if (esp_secure_cert_find_tlv(image.base(), (esp_secure_cert_tlv_type_t)type, subtype, &address) != ESP_OK) {
+        return -1;
+    }
+    return (const uint8_t *)address - image.data.data();
+}
+
+static long index_find(const esp_secure_cert_tlv_index_t &index, const TlvImage &image, uint8_t type, uint8_t subtype)
+{
+    void *address = nullptr;
+    if (esp_secure_cert_tlv_index_find(&index, (esp_secure_cert_tlv_type_t)type, subtype, &address) != ESP_OK) {
+        return -1;
+    }
+    return (const uint8_t *)address - image.data.data();
+}
+
+// Layout of a provisioned partition, with a certificate rotated to a second entry
+static TlvImage provisioned_image()
+{
+    TlvImage image;
+    image.add(ESP_SECURE_CERT_CA_CERT_TLV, 0, 1200);
+    image.add(ESP_SECURE_CERT_DEV_CERT_TLV, 0, 900);
+    image.add(ESP_SECURE_CERT_PRIV_KEY_TLV, 0, 121);
+    image.add(ESP_SECURE_CERT_DS_DATA_TLV, 0, 1200);
+    image.add(ESP_SECURE_CERT_DS_CONTEXT_TLV, 0, 13);
+    image.add(ESP_SECURE_CERT_TLV_SEC_CFG, 0, 40);
+    image.add(ESP_SECURE_CERT_DEV_CERT_TLV, 1, 905);
+    image.add(ESP_SECURE_CERT_USER_DATA_1, 3, 7);
+    image.add(ESP_SECURE_CERT_USER_DATA_1, 0, 64);
+    return image;
+}
+
+TEST_CASE("Index finds the same entries as the linear search", "[index]")
+{
+    TlvImage image = provisioned_image();
+    esp_secure_cert_tlv_index_t index;
+    REQUIRE(esp_secure_cert_tlv_index_build(&index, image.base(), image.data.size()) == ESP_OK);
+    CHECK(index.entries == 9);
+
+    const uint8_t subtypes[] = { 0, 1, 2, 3, ESP_SECURE_CERT_SUBTYPE_MAX };
+    for (int type = 0; type < 60; type++) {
+        for (uint8_t subtype : subtypes) {
+            INFO("type " << type << " subtype " << (int)subtype);
+            CHECK(index_find(index, image, type, subtype) == linear_find(image, type, subtype));
+        }
+    }
+    CHECK(index_find(index, image, ESP_SECURE_CERT_TLV_END, 0) == (long)image.end);
+    // The latest entry of a type, not the one with the highest subtype
+    CHECK(index_find(index, image, ESP_SECURE_CERT_USER_DATA_1, ESP_SECURE_CERT_SUBTYPE_MAX) ==
+          index_find(index, image, ESP_SECURE_CERT_USER_DATA_1, 0));
+}
+
+TEST_CASE("Entries with a crc mismatch are not returned", "[index]")
+{
+    TlvImage image;
+    image.add(ESP_SECURE_CERT_DEV_CERT_TLV, 0, 900);
+    image.add(ESP_SECURE_CERT_PRIV_KEY_TLV, 0, 121, true);
+    image.add(ESP_SECURE_CERT_DEV_CERT_TLV, 1, 900, true);
+    image.add(ESP_SECURE_CERT_CA_CERT_TLV, 0, 1200);
+
+    esp_secure_cert_tlv_index_t index;
+    REQUIRE(esp_secure_cert_tlv_index_build(&index, image.base(), image.data.size()) == ESP_OK);
+
+    CHECK(index_find(index, image, ESP_SECURE_CERT_PRIV_KEY_TLV, 0) == -1);
+    CHECK(index_find(index, image, ESP_SECURE_CERT_DEV_CERT_TLV, 0) == 0);
+    // Like the linear search, no fallback to an older entry when the latest one is corrupt
+    CHECK(index_find(index, image, ESP_SECURE_CERT_DEV_CERT_TLV, ESP_SECURE_CERT_SUBTYPE_MAX) == -1);
+    CHECK(linear_find(image, ESP_SECURE_CERT_DEV_CERT_TLV, ESP_SECURE_CERT_SUBTYPE_MAX) == -1);
+    // Entries after a corrupt one are still found
+    CHECK(index_find(index, image, ESP_SECURE_CERT_CA_CERT_TLV, 0) == linear_find(image, ESP_SECURE_CERT_CA_CERT_TLV, 0));
+}
+
+TEST_CASE("Lookups don't read the partition", "[index]")
+{
+    TlvImage image = provisioned_image();
+    esp_secure_cert_tlv_index_t index;
+    REQUIRE(esp_secure_cert_tlv_index_build(&index, image.base(), image.data.size()) == ESP_OK);
+    long dev_cert = index_find(index, image, ESP_SECURE_CERT_DEV_CERT_TLV, ESP_SECURE_CERT_SUBTYPE_MAX);
+    long priv_key = index_find(index, image, ESP_SECURE_CERT_PRIV_KEY_TLV, 0);
+    REQUIRE(dev_cert > 0);
+    REQUIRE(priv_key > 0);
+
+    // Neither the headers nor the crc are looked at again once the index is built
+    std::fill(image.data.begin(), image.data.end(), 0xFF);
+    CHECK(index_find(index, image, ESP_SECURE_CERT_DEV_CERT_TLV, ESP_SECURE_CERT_SUBTYPE_MAX) == dev_cert);
+    CHECK(index_find(index, image, ESP_SECURE_CERT_PRIV_KEY_TLV, 0) == priv_key);
+}
+
+TEST_CASE("Walk stops at the end of the partition", "[index]")
+{
+    TlvImage image;
+    image.add(ESP_SECURE_CERT_CA_CERT_TLV, 0, 100);
+    // Length running past the partition, as left by an interrupted write
+    size_t offset = image.add(ESP_SECURE_CERT_DEV_CERT_TLV, 0, 16);
+    image.data[offset + 10] = 0xF0;
+    image.data[offset + 11] = 0xFF;
+
+    esp_secure_cert_tlv_index_t index;
+    REQUIRE(esp_secure_cert_tlv_index_build(&index, image.base(), image.data.size()) == ESP_OK);
+    CHECK(index.entries == 1);
+    CHECK(index_find(index, image, ESP_SECURE_CERT_DEV_CERT_TLV, 0) == -1);
+    CHECK(index_find(index, image, ESP_SECURE_CERT_TLV_END, 0) == (long)offset);
+}
+
+TEST_CASE("Index reports partitions with too many entries", "[index]")
+{
+    TlvImage image;
+    // Every type takes two slots, one for its subtype and one for its latest entry
+    for (int type = 0; type < ESP_SECURE_CERT_TLV_INDEX_SLOTS / 2 + 1; type++) {
+        image.add(type, 0, 16);
+    }
+    esp_secure_cert_tlv_index_t index;
+    CHECK(esp_secure_cert_tlv_index_build(&index, image.base(), image.data.size()) == ESP_ERR_NO_MEM);
+    void *address;
+    CHECK(esp_secure_cert_tlv_index_find(&index, ESP_SECURE_CERT_CA_CERT_TLV, 0, &address) == ESP_ERR_INVALID_ARG);
+}
+
+TEST_CASE("Lookup cost doesn't depend on the position of the entry", "[index][benchmark]")
+{
+    // As many entries as the index takes, the one looked up being last
+    TlvImage image;
+    int types = ESP_SECURE_CERT_TLV_INDEX_SLOTS / 2 - 1;
+    for (int type = 0; type < types; type++) {
+        image.add(type, 0, 64);
+    }
+    esp_secure_cert_tlv_index_t index;
+    REQUIRE(esp_secure_cert_tlv_index_build(&index, image.base(), image.data.size()) == ESP_OK);
+
+    // Best of several runs, so that a preempted run doesn't decide the result
+    constexpr int rounds = 20000;
+    constexpr int runs = 15;
+    volatile long sink = 0;
+    auto time_ns = [&](auto &&lookup) {
+        long best = LONG_MAX;
+        for (int run = 0; run < runs; run++) {
+            auto start = steady_clock::now();
+            for (int i = 0; i < rounds; i++) {
+                sink = sink + lookup();
+            }
+            best = std::min(best, (long)duration_cast<nanoseconds>(steady_clock::now() - start).count() / rounds);
+        }
+        return best;
+    };
+    auto first_ns = time_ns([&] { return index_find(index, image, 0, 0); });
+    auto last_ns = time_ns([&] { return index_find(index, image, types - 1, 0); });
+    auto linear_ns = time_ns([&] { return linear_find(image, types - 1, 0); });
+    INFO("index: first entry " << first_ns << " ns, last entry " << last_ns << " ns, linear search " << linear_ns << " ns");
+
+    CHECK(index_find(index, image, types - 1, 0) == linear_find(image, types - 1, 0));
+    // The linear search walks every header and checks the crc of the entry, the index does neither
+    CHECK(last_ns * 4 < linear_ns);
+    CHECK(last_ns <= first_ns * 4 + 50);
+}
@@ -5,6 +5,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <esp_err.h>
 #include "esp_log.h"
 
@@ -60,54 +61,81 @@ void esp_qrcode_print_console(esp_qrcode_handle_t qrcode)
     printf("\n");
 }
 
-esp_err_t esp_qrcode_generate(esp_qrcode_config_t *cfg, const char *text)
+static enum qrcodegen_Ecc get_ecc_level(int qrcode_ecc_level)
+{
+    switch (qrcode_ecc_level) {
+    case ESP_QRCODE_ECC_MED:
+        return qrcodegen_Ecc_MEDIUM;
+    case ESP_QRCODE_ECC_QUART:
+        return qrcodegen_Ecc_QUARTILE;
+    case ESP_QRCODE_ECC_HIGH:
+        return qrcodegen_Ecc_HIGH;
+    case ESP_QRCODE_ECC_LOW:
+    default:
+        return qrcodegen_Ecc_LOW;
+    }
+}
+
+esp_err_t esp_qrcode_encode(const esp_qrcode_config_t *cfg, const char *text, uint8_t *qrcode)
 {
-    enum qrcodegen_Ecc ecc_lvl;
-    uint8_t *qrcode, *tempbuf;
-    esp_err_t err = ESP_FAIL;
+    enum qrcodegen_Ecc ecc_lvl = get_ecc_level(cfg->qrcode_ecc_level);
+    enum qrcodegen_Mask mask = qrcodegen_Mask_AUTO;
+    int version = cfg->qrcode_version;
+    uint8_t *tempbuf;
+    bool ok;
 
-    qrcode = calloc(1, qrcodegen_BUFFER_LEN_FOR_VERSION(cfg->max_qrcode_version));
-    if (!qrcode) {
-        return ESP_ERR_NO_MEM;
+    if (cfg->qrcode_mask > ESP_QRCODE_MASK_AUTO && cfg->qrcode_mask <= ESP_QRCODE_MASK_7) {
+        mask = (enum qrcodegen_Mask)(cfg->qrcode_mask - ESP_QRCODE_MASK_0);
+    }
+    if (version < qrcodegen_VERSION_MIN || version > cfg->max_qrcode_version) {
+        version = 0;
+    }
+
+    if (version) {
+        // Only this version is built, the work buffer is sized for it
+        tempbuf = calloc(1, qrcodegen_BUFFER_LEN_FOR_VERSION(version));
+        if (!tempbuf) {
+            return ESP_ERR_NO_MEM;
+        }
+        ok = qrcodegen_encodeText(text, tempbuf, qrcode, ecc_lvl, version, version, mask, true);
+        free(tempbuf);
+        if (ok) {
+            return ESP_OK;
+        }
+        ESP_LOGW(TAG, "Text does not fit QR Code Version %d", version);
     }
 
     tempbuf = calloc(1, qrcodegen_BUFFER_LEN_FOR_VERSION(cfg->max_qrcode_version));
     if (!tempbuf) {
-        free(qrcode);
         return ESP_ERR_NO_MEM;
     }
+    ok = qrcodegen_encodeText(text, tempbuf, qrcode, ecc_lvl,
+                              qrcodegen_VERSION_MIN, cfg->max_qrcode_version, mask, true);
+    free(tempbuf);
+    return ok ? ESP_OK : ESP_FAIL;
+}
 
-    switch (cfg->qrcode_ecc_level) {
-    case ESP_QRCODE_ECC_LOW:
-        ecc_lvl = qrcodegen_Ecc_LOW;
-        break;
-    case ESP_QRCODE_ECC_MED:
-        ecc_lvl = qrcodegen_Ecc_MEDIUM;
-        break;
-    case ESP_QRCODE_ECC_QUART:
-        ecc_lvl = qrcodegen_Ecc_QUARTILE;
-        break;
-    case ESP_QRCODE_ECC_HIGH:
-        ecc_lvl = qrcodegen_Ecc_HIGH;
-        break;
-    default:
-        ecc_lvl = qrcodegen_Ecc_LOW;
-        break;
+esp_err_t esp_qrcode_generate(esp_qrcode_config_t *cfg, const char *text)
+{
+    uint8_t *qrcode;
+    esp_err_t err;
+
+    qrcode = calloc(1, qrcodegen_BUFFER_LEN_FOR_VERSION(cfg->max_qrcode_version));
+    if (!qrcode) {
+        return ESP_ERR_NO_MEM;
     }
 
     ESP_LOGI(TAG, "Encoding below text with ECC LVL %d & QR Code Version %d",
-             ecc_lvl, cfg->max_qrcode_version);
+             get_ecc_level(cfg->qrcode_ecc_level), cfg->max_qrcode_version);
     ESP_LOGI(TAG, "%s", text);
     // Make and print the QR Code symbol
-    bool ok = qrcodegen_encodeText(text, tempbuf, qrcode, ecc_lvl,
-                                   qrcodegen_VERSION_MIN, cfg->max_qrcode_version,
-                                   qrcodegen_Mask_AUTO, true);
-    if (ok && cfg->display_func) {
+    err = esp_qrcode_encode(cfg, text, qrcode);
+    if (err == ESP_OK && cfg->display_func) {
         cfg->display_func((esp_qrcode_handle_t)qrcode);
-        err = ESP_OK;
+    } else if (err == ESP_OK) {
+        err = ESP_FAIL;
     }
 
     free(qrcode);
-    free(tempbuf);
     return err;
 }
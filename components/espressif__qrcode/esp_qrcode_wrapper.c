@@ -19,3 +19,9 @@ bool esp_qrcode_get_module(esp_qrcode_handle_t qrcode, int x, int y)
 {
     return qrcodegen_getModule(qrcode, x, y);
 }
+
+size_t esp_qrcode_get_len(esp_qrcode_handle_t qrcode)
+{
+    int size = qrcodegen_getSize(qrcode);
+    return (size_t)(size * size + 7) / 8 + 1;
+}
@@ -6,6 +6,9 @@
 
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <esp_err.h>
 
 #ifdef __cplusplus
@@ -24,6 +27,8 @@ typedef struct {
     void (*display_func)(esp_qrcode_handle_t qrcode);   /**< Function called for displaying the QR Code after encoding is complete */
     int max_qrcode_version;                             /**< Max QR Code Version to be used. Range: 2 - 40 */
     int qrcode_ecc_level;                               /**< Error Correction Level for QR Code */
+    int qrcode_version;                                 /**< QR Code Version tried first, 0 for the smallest one that fits. Range: 0 - max_qrcode_version */
+    int qrcode_mask;                                    /**< Mask pattern, ESP_QRCODE_MASK_AUTO to pick the one with the lowest penalty score */
 } esp_qrcode_config_t;
 
 /**
@@ -36,6 +41,26 @@ enum {
     ESP_QRCODE_ECC_HIGH     /**< QR Code Error Tolerance of 30% */
 };
 
+/**
+  * @brief  Mask pattern of a QR Code Symbol
+  */
+enum {
+    ESP_QRCODE_MASK_AUTO,   /**< Try the 8 mask patterns and keep the one with the lowest penalty score */
+    ESP_QRCODE_MASK_0,      /**< Mask pattern 0 */
+    ESP_QRCODE_MASK_1,      /**< Mask pattern 1 */
+    ESP_QRCODE_MASK_2,      /**< Mask pattern 2 */
+    ESP_QRCODE_MASK_3,      /**< Mask pattern 3 */
+    ESP_QRCODE_MASK_4,      /**< Mask pattern 4 */
+    ESP_QRCODE_MASK_5,      /**< Mask pattern 5 */
+    ESP_QRCODE_MASK_6,      /**< Mask pattern 6 */
+    ESP_QRCODE_MASK_7,      /**< Mask pattern 7 */
+};
+
+/**
+  * @brief  Size in bytes of a buffer holding any QR Code up to the given version
+  */
+#define ESP_QRCODE_BUFFER_LEN_FOR_VERSION(n) ((((n) * 4 + 17) * ((n) * 4 + 17) + 7) / 8 + 1)
+
 /**
   * @brief  Encodes the given string into a QR Code and calls the display function
   *
@@ -52,6 +77,38 @@ enum {
   */
 esp_err_t esp_qrcode_generate(esp_qrcode_config_t *cfg, const char *text);
 
+/**
+  * @brief  Encodes the given string into a QR Code in a buffer of the caller
+  *
+  * The QR Code is a packed bit matrix: its side length, then the modules row by row,
+  * 8 per byte. Its first esp_qrcode_get_len() bytes can be stored and used later as
+  * a handle, without encoding again.
+  *
+  * With a fixed `qrcode_version` and `qrcode_mask` the encoder only builds that one
+  * symbol. If the text does not fit the version, the smallest version up to
+  * `max_qrcode_version` is used instead.
+  *
+  * @param  cfg     Configuration used for QR Code encoding, `display_func` is not used.
+  * @param  text    String to encode into a QR Code.
+  * @param  qrcode  Buffer of at least ESP_QRCODE_BUFFER_LEN_FOR_VERSION(max_qrcode_version) bytes.
+  *
+  * @return
+  *    - ESP_OK: succeed
+  *    - ESP_FAIL: Failed to encode string into a QR Code
+  *    - ESP_ERR_NO_MEM: Failed to allocate the work buffer
+  */
+esp_err_t esp_qrcode_encode(const esp_qrcode_config_t *cfg, const char *text, uint8_t *qrcode);
+
+/**
+  * @brief  Returns the number of bytes used by the given QR Code
+  *
+  * @param  qrcode  QR Code handle used by the display function.
+  *
+  * @return
+  *    - val[57, 3918]: Length of the QR Code
+  */
+size_t esp_qrcode_get_len(esp_qrcode_handle_t qrcode);
+
 /**
   * @brief  Displays QR Code on the console
   *
@@ -90,6 +147,8 @@ bool esp_qrcode_get_module(esp_qrcode_handle_t qrcode, int x, int y);
     .display_func = esp_qrcode_print_console, \
     .max_qrcode_version = 10, \
     .qrcode_ecc_level = ESP_QRCODE_ECC_LOW, \
+    .qrcode_version = 0, \
+    .qrcode_mask = ESP_QRCODE_MASK_AUTO, \
 }
 
 #ifdef __cplusplus
@@ -0,0 +1,158 @@
+#define CATCH_CONFIG_MAIN // This tells the catch header to generate a main
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "qrcodegen.h"
+#include "qrcode.h"
+
+using namespace std::chrono;
+
+static constexpr int max_version = 10;
+static constexpr size_t buffer_len = ESP_QRCODE_BUFFER_LEN_FOR_VERSION(max_version);
+
+// Provisioning payloads as built by app_wifi_print_qr(), and a few others
+static std::vector<std::string> payloads()
+{
+    std::vector<std::string> texts;
+    const char *transports[] = { "ble", "softap" };
+    for (unsigned i = 0; i < 16; i++)
+    {
+        char text[150];
+        snprintf(text, sizeof(text), "{\"ver\":\"v1\",\"name\":\"PROV_%06x\",\"pop\":\"%08x\",\"transport\":\"%s\"}",
+                 i * 0x10f3a1u, i * 0x9e3779b9u, transports[i % 2]);
+        texts.push_back(text);
+    }
+    texts.push_back("0123456789");
+    texts.push_back("HTTPS://EXAMPLE.COM/A");
+    texts.push_back("x");
+    return texts;
+}
+
+static std::vector<uint8_t> reference(const std::string &text, int min_version, int max, qrcodegen_Mask mask)
+{
+    std::vector<uint8_t> qrcode(buffer_len), temp(buffer_len);
+    REQUIRE(qrcodegen_encodeText(text.c_str(), temp.data(), qrcode.data(), qrcodegen_Ecc_LOW, min_version, max, mask,
+                                 true));
+    return qrcode;
+}
+
+static std::vector<uint8_t> encode(const std::string &text, int version, int mask)
+{
+    esp_qrcode_config_t cfg = ESP_QRCODE_CONFIG_DEFAULT();
+    cfg.max_qrcode_version = max_version;
+    cfg.qrcode_version = version;
+    cfg.qrcode_mask = mask;
+    std::vector<uint8_t> qrcode(buffer_len);
+    REQUIRE(esp_qrcode_encode(&cfg, text.c_str(), qrcode.data()) == ESP_OK);
+    return qrcode;
+}
+
+static bool same(const std::vector<uint8_t> &a, const std::vector<uint8_t> &b)
+{
+    int size = esp_qrcode_get_size(a.data());
+    if (size != esp_qrcode_get_size(b.data()))
+        return false;
+    for (int y = 0; y < size; y++)
+        for (int x = 0; x < size; x++)
+            if (esp_qrcode_get_module(a.data(), x, y) != esp_qrcode_get_module(b.data(), x, y))
+                return false;
+    return true;
+}
+
+TEST_CASE("Automatic settings match qrcodegen_encodeText", "[qrcode]")
+{
+    for (const auto &text : payloads())
+        CHECK(same(encode(text, 0, ESP_QRCODE_MASK_AUTO),
+                   reference(text, qrcodegen_VERSION_MIN, max_version, qrcodegen_Mask_AUTO)));
+}
+
+TEST_CASE("Fixed version and mask match qrcodegen_encodeText", "[qrcode]")
+{
+    for (const auto &text : payloads())
+    {
+        const auto automatic = reference(text, qrcodegen_VERSION_MIN, max_version, qrcodegen_Mask_AUTO);
+        const int version = (esp_qrcode_get_size(automatic.data()) - 17) / 4;
+
+        // One of the masks gives the code of the automatic search
+        int found = 0;
+        for (int mask = 0; mask < 8; mask++)
+        {
+            const auto fixed = encode(text, version, ESP_QRCODE_MASK_0 + mask);
+            CHECK(same(fixed, reference(text, version, version, (qrcodegen_Mask)mask)));
+            found += same(fixed, automatic);
+        }
+        CHECK(found == 1);
+
+        // A larger version than needed is kept
+        if (version < max_version)
+        {
+            const auto larger = encode(text, version + 1, ESP_QRCODE_MASK_3);
+            CHECK(esp_qrcode_get_size(larger.data()) == esp_qrcode_get_size(automatic.data()) + 4);
+            CHECK(same(larger, reference(text, version + 1, version + 1, qrcodegen_Mask_3)));
+        }
+    }
+}
+
+TEST_CASE("Too small a version falls back to the smallest one that fits", "[qrcode]")
+{
+    const std::string text = payloads()[1];
+    CHECK(same(encode(text, 1, ESP_QRCODE_MASK_5), reference(text, qrcodegen_VERSION_MIN, max_version, qrcodegen_Mask_5)));
+    CHECK(same(encode(text, 1, ESP_QRCODE_MASK_AUTO),
+               reference(text, qrcodegen_VERSION_MIN, max_version, qrcodegen_Mask_AUTO)));
+
+    esp_qrcode_config_t cfg = ESP_QRCODE_CONFIG_DEFAULT();
+    cfg.max_qrcode_version = 2;
+    cfg.qrcode_version = 2;
+    std::vector<uint8_t> qrcode(ESP_QRCODE_BUFFER_LEN_FOR_VERSION(2));
+    CHECK(esp_qrcode_encode(&cfg, text.c_str(), qrcode.data()) == ESP_FAIL);
+}
+
+TEST_CASE("A stored copy of esp_qrcode_get_len bytes is the same code", "[qrcode]")
+{
+    for (const auto &text : payloads())
+    {
+        const auto qrcode = encode(text, 4, ESP_QRCODE_MASK_0);
+        const int size = esp_qrcode_get_size(qrcode.data());
+        const size_t len = esp_qrcode_get_len(qrcode.data());
+        CHECK(len == (size_t)(size * size + 7) / 8 + 1);
+
+        // Bytes past the length are not part of the code
+        std::vector<uint8_t> stored(qrcode.begin(), qrcode.begin() + len);
+        stored.resize(buffer_len, 0xff);
+        CHECK(same(stored, qrcode));
+    }
+}
+
+// Runs the encoding for about 200 ms, returns the codes per second
+static double codes_per_second(const std::function<void()> &encode)
+{
+    size_t codes = 0;
+    auto start = steady_clock::now();
+    auto elapsed = steady_clock::duration::zero();
+    do
+    {
+        encode();
+        codes++;
+        elapsed = steady_clock::now() - start;
+    } while (elapsed < milliseconds(200));
+    return codes / duration<double>(elapsed).count();
+}
+
+TEST_CASE("Encoding throughput", "[bench]")
+{
+    const std::string text = payloads()[1];
+    esp_qrcode_config_t cfg = ESP_QRCODE_CONFIG_DEFAULT();
+    cfg.max_qrcode_version = max_version;
+    std::vector<uint8_t> qrcode(buffer_len);
+
+    double automatic = codes_per_second([&] { esp_qrcode_encode(&cfg, text.c_str(), qrcode.data()); });
+    cfg.qrcode_version = 4;
+    cfg.qrcode_mask = ESP_QRCODE_MASK_0;
+    double fixed = codes_per_second([&] { esp_qrcode_encode(&cfg, text.c_str(), qrcode.data()); });
+    printf("automatic %8.0f codes/s, fixed version and mask %8.0f codes/s, x%.1f\n", automatic, fixed,
+           fixed / automatic);
+    CHECK(fixed > 0);
+}
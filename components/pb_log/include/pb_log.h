@@ -0,0 +1,75 @@
+#ifndef PB_LOG_H
+#define PB_LOG_H
+
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+/*
+ * Logging for hot paths, on top of esp_log:
+ * - PB_LOGx are ESP_LOGx rate limited per tag (CONFIG_PB_LOG_THROTTLE). The
+ *   messages dropped are counted and reported with the next one let through.
+ * - pb_log_init() moves the console output to a low priority task
+ *   (CONFIG_PB_LOG_DEFERRED), for ESP_LOGx and PB_LOGx alike.
+ * Both ESP_LOGx and PB_LOGx above LOG_LOCAL_LEVEL are not compiled in, main sets
+ * it per module from the "Log level caps" options.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Installs the deferred console output
+ *
+ * Creates the ring buffer and the log task, and redirects esp_log to them. Without
+ * CONFIG_PB_LOG_DEFERRED, does nothing.
+ *
+ * @return ESP_OK, ESP_ERR_NO_MEM
+ */
+esp_err_t pb_log_init(void);
+
+/**
+ * @brief Writes the queued messages from the calling task
+ *
+ * Registered as a shutdown handler, so that esp_restart() doesn't lose them.
+ */
+void pb_log_flush(void);
+
+/**
+ * @brief Takes a message from the budget of the tag
+ *
+ * Messages below the run time level of the tag are dropped without taking from it.
+ *
+ * @return false when the message must be dropped
+ */
+bool pb_log_allow(esp_log_level_t level, const char *tag);
+
+#ifdef __cplusplus
+}
+#endif
+
+#if CONFIG_PB_LOG_THROTTLE
+
+#define PB_LOG_LEVEL(level, tag, format, ...) do {                        \
+        if (LOG_LOCAL_LEVEL >= (level) && pb_log_allow((level), (tag))) { \
+            ESP_LOG_LEVEL((level), (tag), format, ##__VA_ARGS__);         \
+        }                                                                 \
+    } while (0)
+
+#define PB_LOGE(tag, format, ...) PB_LOG_LEVEL(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define PB_LOGW(tag, format, ...) PB_LOG_LEVEL(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define PB_LOGI(tag, format, ...) PB_LOG_LEVEL(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define PB_LOGD(tag, format, ...) PB_LOG_LEVEL(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+
+#else
+
+#define PB_LOGE(tag, format, ...) ESP_LOGE(tag, format, ##__VA_ARGS__)
+#define PB_LOGW(tag, format, ...) ESP_LOGW(tag, format, ##__VA_ARGS__)
+#define PB_LOGI(tag, format, ...) ESP_LOGI(tag, format, ##__VA_ARGS__)
+#define PB_LOGD(tag, format, ...) ESP_LOGD(tag, format, ##__VA_ARGS__)
+
+#endif /* CONFIG_PB_LOG_THROTTLE */
+
+#endif // PB_LOG_H
@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/ringbuf.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "pb_log.h"
+
+#if CONFIG_PB_LOG_THROTTLE
+#define PB_LOG_THROTTLE_PERIOD_US (1000000 / CONFIG_PB_LOG_THROTTLE_RATE)
+
+/* Token bucket of a tag, the credit is in microseconds of PB_LOG_THROTTLE_PERIOD_US each */
+typedef struct {
+    const char *tag;
+    int64_t credit_us;
+    int64_t last_us;
+    uint32_t suppressed;
+} pb_log_bucket_t;
+
+static pb_log_bucket_t s_buckets[CONFIG_PB_LOG_THROTTLE_MAX_TAGS];
+static size_t s_bucket_count;
+static portMUX_TYPE s_bucket_lock = portMUX_INITIALIZER_UNLOCKED;
+#endif
+
+#if CONFIG_PB_LOG_DEFERRED
+static const char *TAG = "pb_log";
+static RingbufHandle_t s_ring;
+static vprintf_like_t s_console_vprintf;
+static atomic_uint s_dropped;
+#endif
+
+#if CONFIG_PB_LOG_THROTTLE
+static pb_log_bucket_t *prv_find_bucket(const char *tag)
+{
+    for (size_t i = 0; i < s_bucket_count; i++) {
+        /* The tags are string literals, compared by content as each file has its own */
+        if (s_buckets[i].tag == tag || strcmp(s_buckets[i].tag, tag) == 0) {
+            return &s_buckets[i];
+        }
+    }
+    if (s_bucket_count == CONFIG_PB_LOG_THROTTLE_MAX_TAGS) {
+        return NULL;
+    }
+
+    pb_log_bucket_t *bucket = &s_buckets[s_bucket_count++];
+    bucket->tag = tag;
+    bucket->credit_us = (int64_t)CONFIG_PB_LOG_THROTTLE_BURST * PB_LOG_THROTTLE_PERIOD_US;
+    bucket->last_us = esp_timer_get_time();
+    return bucket;
+}
+#endif
+
+bool pb_log_allow(esp_log_level_t level, const char *tag)
+{
+#if CONFIG_PB_LOG_THROTTLE
+    bool allowed = true;
+    uint32_t suppressed = 0;
+
+    /* Messages disabled at run time don't take from the budget */
+    if (esp_log_level_get(tag) < level) {
+        return false;
+    }
+
+    int64_t now = esp_timer_get_time();
+
+    taskENTER_CRITICAL(&s_bucket_lock);
+    pb_log_bucket_t *bucket = prv_find_bucket(tag);
+    if (bucket != NULL) {
+        bucket->credit_us += now - bucket->last_us;
+        bucket->last_us = now;
+        if (bucket->credit_us > (int64_t)CONFIG_PB_LOG_THROTTLE_BURST * PB_LOG_THROTTLE_PERIOD_US) {
+            bucket->credit_us = (int64_t)CONFIG_PB_LOG_THROTTLE_BURST * PB_LOG_THROTTLE_PERIOD_US;
+        }
+
+        if (bucket->credit_us >= PB_LOG_THROTTLE_PERIOD_US) {
+            bucket->credit_us -= PB_LOG_THROTTLE_PERIOD_US;
+            suppressed = bucket->suppressed;
+            bucket->suppressed = 0;
+        } else {
+            bucket->suppressed++;
+            allowed = false;
+        }
+    }
+    taskEXIT_CRITICAL(&s_bucket_lock);
+
+    if (suppressed > 0) {
+        ESP_LOG_LEVEL(ESP_LOG_WARN, tag, "Suppressed %" PRIu32 " messages", suppressed);
+    }
+    return allowed;
+#else
+    (void)level;
+    (void)tag;
+    return true;
+#endif
+}
+
+#if CONFIG_PB_LOG_DEFERRED
+static void prv_console_write(const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    s_console_vprintf(format, args);
+    va_end(args);
+}
+
+/* Called by esp_log in the logging task, formats in place in the ring and never blocks */
+static int prv_deferred_vprintf(const char *format, va_list args)
+{
+    va_list measure;
+    char *line;
+
+    va_copy(measure, args);
+    int len = vsnprintf(NULL, 0, format, measure);
+    va_end(measure);
+
+    if (len < 0) {
+        return len;
+    }
+    if (len >= CONFIG_PB_LOG_LINE_MAX) {
+        len = CONFIG_PB_LOG_LINE_MAX - 1;
+    }
+
+    /* The item holds the terminating null, written by vsnprintf */
+    if (xPortInIsrContext() || xRingbufferSendAcquire(s_ring, (void **)&line, len + 1, 0) != pdTRUE) {
+        atomic_fetch_add(&s_dropped, 1);
+        return len;
+    }
+    if (vsnprintf(line, len + 1, format, args) > len) {
+        line[len - 1] = '\n';
+    }
+    xRingbufferSendComplete(s_ring, line);
+    return len;
+}
+
+static void prv_write_queued(TickType_t xTicksToWait)
+{
+    size_t size;
+    char *item;
+
+    while ((item = xRingbufferReceive(s_ring, &size, xTicksToWait)) != NULL) {
+        prv_console_write("%s", item);
+        vRingbufferReturnItem(s_ring, item);
+
+        uint32_t dropped = atomic_exchange(&s_dropped, 0);
+        if (dropped > 0) {
+            prv_console_write("W (%" PRIu32 ") %s: Dropped %" PRIu32 " messages, the log ring is full\n",
+                              esp_log_timestamp(), TAG, dropped);
+        }
+        xTicksToWait = 0;
+    }
+}
+
+static void prv_log_task(void *pvParameters)
+{
+    while (1) {
+        prv_write_queued(portMAX_DELAY);
+    }
+}
+#endif /* CONFIG_PB_LOG_DEFERRED */
+
+void pb_log_flush(void)
+{
+#if CONFIG_PB_LOG_DEFERRED
+    if (s_ring != NULL) {
+        prv_write_queued(0);
+    }
+#endif
+}
+
+esp_err_t pb_log_init(void)
+{
+#if CONFIG_PB_LOG_DEFERRED
+    s_ring = xRingbufferCreate(CONFIG_PB_LOG_RING_SIZE, RINGBUF_TYPE_NOSPLIT);
+    if (s_ring == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreate(prv_log_task, "Log", CONFIG_PB_LOG_TASK_STACK_SIZE, NULL, CONFIG_PB_LOG_TASK_PRIORITY, NULL) != pdPASS) {
+        vRingbufferDelete(s_ring);
+        s_ring = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    s_console_vprintf = esp_log_set_vprintf(prv_deferred_vprintf);
+    esp_register_shutdown_handler(pb_log_flush);
+#endif
+    return ESP_OK;
+}
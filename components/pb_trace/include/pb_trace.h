@@ -0,0 +1,104 @@
+#ifndef PB_TRACE_H
+#define PB_TRACE_H
+
+#include <stdint.h>
+#include "sdkconfig.h"
+
+/*
+ * Trace points on the paths between a sensor sample and the broker. Each core
+ * writes to its own ring of CONFIG_PB_TRACE_RING_SIZE events, the oldest are
+ * overwritten. An event is the cycle count, the task, the event ID, the phase
+ * and a 32 bit argument.
+ *
+ * Without CONFIG_PB_TRACE the macros compile to nothing, so trace points can stay
+ * in the drivers and in the host build.
+ */
+
+typedef enum {
+    PB_TRACE_AGENT_ENQUEUE,         /* arg: command, paired with its dequeue, then 1 when queued */
+    PB_TRACE_AGENT_DEQUEUE,         /* arg: command */
+    PB_TRACE_MQTT_INCOMING_PUBLISH, /* arg: payload length, then 1 when a subscriber handled it */
+    PB_TRACE_TLS_SEND,              /* arg: length, then bytes sent or error */
+    PB_TRACE_TLS_RECV,              /* arg: bytes received */
+    PB_TRACE_CMUX_DATA,             /* arg: bytes received, then 1 when parsed */
+    PB_TRACE_DTE_COMMAND,           /* arg: command length, then command_result */
+    PB_TRACE_BARRIER_OPEN,          /* arg: 0, then esp_err_t */
+    PB_TRACE_BARRIER_CLOSE,         /* arg: 0, then esp_err_t */
+    PB_TRACE_HCSR04_MEASURE,        /* arg: trigger GPIO, then echo time in us or esp_err_t */
+    PB_TRACE_ID_MAX
+} pb_trace_id_t;
+
+typedef enum {
+    PB_TRACE_PHASE_BEGIN,
+    PB_TRACE_PHASE_END,
+    PB_TRACE_PHASE_INSTANT,
+} pb_trace_phase_t;
+
+/* Called with each line of a dump, without the line feed */
+typedef void (*pb_trace_writer_t)(const char *line, void *ctx);
+
+#if CONFIG_PB_TRACE
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Allocates the rings and starts recording
+ *
+ * Registers a tick hook on each core, which extends the cycle counter to 64
+ * bits and relates it to esp_timer. Call once, early in app_main().
+ *
+ * @return ESP_OK, ESP_ERR_NO_MEM or the error of the tick hook registration
+ */
+esp_err_t pb_trace_init(void);
+
+/**
+ * @brief Records an event on the ring of the calling core
+ *
+ * Safe from tasks and ISRs, and placed in IRAM. Use the macros below.
+ */
+void pb_trace_record(pb_trace_id_t id, pb_trace_phase_t phase, uint32_t arg);
+
+/**
+ * @brief Writes the events of both rings, oldest first
+ *
+ * Recording is paused for the whole dump, so the writer may publish or log
+ * without its own events overwriting the ones being dumped. The lines are:
+ *   pbt H <format> <cores> <ring size> <record cost in cycles> <cpu MHz>
+ *   pbt N <id> <name>
+ *   pbt K <task> <name>
+ *   pbt E <core> <us> <task> <B|E|I> <id> <arg>
+ *   pbt Z <events overwritten since the previous dump>
+ * The rings are emptied afterwards.
+ *
+ * @param writer Called for each line
+ * @param ctx Passed to the writer
+ * @return ESP_OK, ESP_ERR_INVALID_STATE when not initialized
+ */
+esp_err_t pb_trace_dump(pb_trace_writer_t writer, void *ctx);
+
+/**
+ * @brief pb_trace_dump() to the console, for tools/pb_trace_to_chrome.py
+ */
+esp_err_t pb_trace_dump_to_console(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define PB_TRACE_BEGIN(id, arg) pb_trace_record((id), PB_TRACE_PHASE_BEGIN, (uint32_t)(arg))
+#define PB_TRACE_END(id, arg) pb_trace_record((id), PB_TRACE_PHASE_END, (uint32_t)(arg))
+#define PB_TRACE_INSTANT(id, arg) pb_trace_record((id), PB_TRACE_PHASE_INSTANT, (uint32_t)(arg))
+
+#else
+
+#define PB_TRACE_BEGIN(id, arg) do { } while (0)
+#define PB_TRACE_END(id, arg) do { } while (0)
+#define PB_TRACE_INSTANT(id, arg) do { } while (0)
+
+#endif /* CONFIG_PB_TRACE */
+
+#endif // PB_TRACE_H
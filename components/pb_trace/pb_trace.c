@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_cpu.h"
+#include "esp_freertos_hooks.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "pb_trace.h"
+
+#define PB_TRACE_FORMAT_VERSION 1
+#define PB_TRACE_RING_MASK (CONFIG_PB_TRACE_RING_SIZE - 1)
+#define PB_TRACE_LINE_LENGTH 96
+#define PB_TRACE_COST_SAMPLES 32
+/* Power management is disabled (see Kconfig), so the CPU runs at its default frequency */
+#define PB_TRACE_CPU_MHZ CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ
+
+_Static_assert((CONFIG_PB_TRACE_RING_SIZE & PB_TRACE_RING_MASK) == 0, "PB_TRACE_RING_SIZE must be a power of two");
+
+static const char *TAG = "pb_trace";
+
+typedef struct {
+    uint64_t cycles;
+    TaskHandle_t task;
+    uint32_t arg;
+    uint16_t id;
+    uint8_t phase;
+} pb_trace_event_t;
+
+/* Only written by its own core, with interrupts masked */
+typedef struct {
+    pb_trace_event_t *events;
+    uint32_t head;          /* Events recorded since the last dump */
+    uint32_t cycles_high;   /* Wraps of the 32 bit cycle counter */
+    uint32_t cycles_last;
+    uint64_t sync_cycles;   /* Cycle count and esp_timer time taken in the same tick */
+    int64_t sync_us;
+    bool synced;
+} pb_trace_ring_t;
+
+static pb_trace_ring_t s_rings[portNUM_PROCESSORS];
+static volatile bool s_recording;
+static uint32_t s_record_cycles;
+
+static const char *const s_names[PB_TRACE_ID_MAX] = {
+    [PB_TRACE_AGENT_ENQUEUE] = "agent_enqueue",
+    [PB_TRACE_AGENT_DEQUEUE] = "agent_dequeue",
+    [PB_TRACE_MQTT_INCOMING_PUBLISH] = "mqtt_incoming_publish",
+    [PB_TRACE_TLS_SEND] = "tls_send",
+    [PB_TRACE_TLS_RECV] = "tls_recv",
+    [PB_TRACE_CMUX_DATA] = "cmux_data",
+    [PB_TRACE_DTE_COMMAND] = "dte_command",
+    [PB_TRACE_BARRIER_OPEN] = "barrier_open",
+    [PB_TRACE_BARRIER_CLOSE] = "barrier_close",
+    [PB_TRACE_HCSR04_MEASURE] = "hcsr04_measure",
+};
+
+/* The counter wraps every 27 s at 160 MHz, the tick hook sees every wrap */
+static FORCE_INLINE_ATTR uint64_t prv_cycles(pb_trace_ring_t *ring)
+{
+    uint32_t now = esp_cpu_get_cycle_count();
+
+    if (now < ring->cycles_last) {
+        ring->cycles_high++;
+    }
+    ring->cycles_last = now;
+    return ((uint64_t)ring->cycles_high << 32) | now;
+}
+
+static void IRAM_ATTR prv_tick_hook(void)
+{
+    UBaseType_t state = portSET_INTERRUPT_MASK_FROM_ISR();
+    pb_trace_ring_t *ring = &s_rings[esp_cpu_get_core_id()];
+    uint64_t cycles = prv_cycles(ring);
+
+    /* The cycle counters of the cores differ, each is related to esp_timer once */
+    if (!ring->synced) {
+        ring->sync_cycles = cycles;
+        ring->sync_us = esp_timer_get_time();
+        ring->synced = true;
+    }
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(state);
+}
+
+void IRAM_ATTR pb_trace_record(pb_trace_id_t id, pb_trace_phase_t phase, uint32_t arg)
+{
+    if (!s_recording) {
+        return;
+    }
+
+    UBaseType_t state = portSET_INTERRUPT_MASK_FROM_ISR();
+    pb_trace_ring_t *ring = &s_rings[esp_cpu_get_core_id()];
+    pb_trace_event_t *event = &ring->events[ring->head & PB_TRACE_RING_MASK];
+
+    event->cycles = prv_cycles(ring);
+    event->task = xTaskGetCurrentTaskHandle();
+    event->arg = arg;
+    event->id = id;
+    event->phase = phase;
+    ring->head++;
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(state);
+}
+
+esp_err_t pb_trace_init(void)
+{
+    esp_err_t ret;
+
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        s_rings[core].events = heap_caps_calloc(CONFIG_PB_TRACE_RING_SIZE, sizeof(pb_trace_event_t),
+                                                MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (s_rings[core].events == NULL) {
+            ESP_LOGE(TAG, "No memory for %d events", CONFIG_PB_TRACE_RING_SIZE);
+            return ESP_ERR_NO_MEM;
+        }
+        ret = esp_register_freertos_tick_hook_for_cpu(prv_tick_hook, core);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to register the tick hook of core %d: %s", core, esp_err_to_name(ret));
+            return ret;
+        }
+    }
+
+    /* Cost of a trace point, reported in the dumps. The samples are dropped from the ring */
+    UBaseType_t state = portSET_INTERRUPT_MASK_FROM_ISR();
+    pb_trace_ring_t *ring = &s_rings[esp_cpu_get_core_id()];
+    uint32_t head = ring->head;
+
+    s_recording = true;
+    uint32_t start = esp_cpu_get_cycle_count();
+    for (int i = 0; i < PB_TRACE_COST_SAMPLES; i++) {
+        pb_trace_record(PB_TRACE_AGENT_ENQUEUE, PB_TRACE_PHASE_INSTANT, i);
+    }
+    s_record_cycles = (esp_cpu_get_cycle_count() - start) / PB_TRACE_COST_SAMPLES;
+    ring->head = head;
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(state);
+
+    ESP_LOGI(TAG, "Tracing %d events per core, %" PRIu32 " cycles per trace point",
+             CONFIG_PB_TRACE_RING_SIZE, s_record_cycles);
+    return ESP_OK;
+}
+
+static void prv_dump_tasks(pb_trace_writer_t writer, void *ctx, char *line)
+{
+#if configUSE_TRACE_FACILITY
+    /* Some room for the tasks created meanwhile */
+    UBaseType_t capacity = uxTaskGetNumberOfTasks() + 4;
+    TaskStatus_t *status = malloc(capacity * sizeof(TaskStatus_t));
+
+    if (status == NULL) {
+        return;
+    }
+
+    UBaseType_t count = uxTaskGetSystemState(status, capacity, NULL);
+    for (UBaseType_t i = 0; i < count; i++) {
+        snprintf(line, PB_TRACE_LINE_LENGTH, "pbt K %08" PRIx32 " %s",
+                 (uint32_t)(uintptr_t)status[i].xHandle, status[i].pcTaskName);
+        writer(line, ctx);
+    }
+    free(status);
+#else
+    /* Without the trace facility, the tasks are named by their handle */
+    (void)writer;
+    (void)ctx;
+    (void)line;
+#endif
+}
+
+esp_err_t pb_trace_dump(pb_trace_writer_t writer, void *ctx)
+{
+    char line[PB_TRACE_LINE_LENGTH];
+    uint32_t overwritten = 0;
+
+    if (s_rings[0].events == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    s_recording = false;
+    /* Lets a trace point in progress on the other core complete */
+    vTaskDelay(1);
+
+    snprintf(line, sizeof(line), "pbt H %d %d %d %" PRIu32 " %d", PB_TRACE_FORMAT_VERSION, portNUM_PROCESSORS,
+             CONFIG_PB_TRACE_RING_SIZE, s_record_cycles, PB_TRACE_CPU_MHZ);
+    writer(line, ctx);
+    for (int id = 0; id < PB_TRACE_ID_MAX; id++) {
+        snprintf(line, sizeof(line), "pbt N %d %s", id, s_names[id]);
+        writer(line, ctx);
+    }
+    prv_dump_tasks(writer, ctx, line);
+
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        pb_trace_ring_t *ring = &s_rings[core];
+        uint32_t count = ring->head < CONFIG_PB_TRACE_RING_SIZE ? ring->head : CONFIG_PB_TRACE_RING_SIZE;
+
+        overwritten += ring->head - count;
+        for (uint32_t i = ring->head - count; i != ring->head; i++) {
+            const pb_trace_event_t *event = &ring->events[i & PB_TRACE_RING_MASK];
+            /* Events recorded before the first tick of the core come out before the sync point */
+            int64_t us = ring->sync_us + (int64_t)(event->cycles - ring->sync_cycles) / PB_TRACE_CPU_MHZ;
+
+            snprintf(line, sizeof(line), "pbt E %d %" PRId64 " %08" PRIx32 " %c %u %" PRIu32, core, us,
+                     (uint32_t)(uintptr_t)event->task, "BEI"[event->phase], (unsigned)event->id, event->arg);
+            writer(line, ctx);
+        }
+        ring->head = 0;
+    }
+
+    snprintf(line, sizeof(line), "pbt Z %" PRIu32, overwritten);
+    writer(line, ctx);
+
+    s_recording = true;
+    return ESP_OK;
+}
+
+static void prv_console_writer(const char *line, void *ctx)
+{
+    (void)ctx;
+    printf("%s\n", line);
+}
+
+esp_err_t pb_trace_dump_to_console(void)
+{
+    return pb_trace_dump(prv_console_writer, NULL);
+}
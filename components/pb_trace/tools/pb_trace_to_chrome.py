@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+"""
+Converts pb_trace dumps to the Chrome trace event format, for chrome://tracing or
+https://ui.perfetto.dev. The input is the console output of pb_trace_dump_to_console(),
+or the payloads published on .../system/trace, concatenated. Other lines are ignored.
+Prints the duration of the spans per trace point.
+"""
+import argparse
+import json
+import sys
+from collections import defaultdict
+
+
+def parse(lines):
+    names, tasks, events = {}, {}, []
+    header = None
+    overwritten = 0
+    for line in lines:
+        start = line.find('pbt ')
+        if start < 0:
+            continue
+        fields = line[start:].split()
+        kind = fields[1] if len(fields) > 1 else ''
+        try:
+            if kind == 'H':
+                if fields[2] != '1':
+                    sys.exit(f'unsupported pb_trace format {fields[2]}')
+                header = {'cores': int(fields[3]), 'ring_size': int(fields[4]),
+                          'record_cycles': int(fields[5]), 'cpu_mhz': int(fields[6])}
+            elif kind == 'N':
+                names[int(fields[2])] = fields[3]
+            elif kind == 'K':
+                tasks[int(fields[2], 16)] = ' '.join(fields[3:])
+            elif kind == 'E':
+                events.append({'core': int(fields[2]), 'us': int(fields[3]), 'task': int(fields[4], 16),
+                               'phase': fields[5], 'id': int(fields[6]), 'arg': int(fields[7])})
+            elif kind == 'Z':
+                overwritten += int(fields[2])
+        except (IndexError, ValueError):
+            print(f'skipping malformed line: {line.strip()}', file=sys.stderr)
+    return header, names, tasks, events, overwritten
+
+
+def convert(names, tasks, events):
+    trace = []
+    enqueued = {}
+    for event in sorted(events, key=lambda e: e['us']):
+        name = names.get(event['id'], f"id{event['id']}")
+        common = {'name': name, 'pid': 0, 'tid': event['task'], 'ts': event['us'],
+                  'args': {'arg': event['arg'], 'core': event['core']}}
+        if event['phase'] == 'B':
+            trace.append(dict(common, ph='B'))
+            if name == 'agent_enqueue':
+                enqueued[event['arg']] = event['us']
+        elif event['phase'] == 'E':
+            trace.append(dict(common, ph='E'))
+        else:
+            trace.append(dict(common, ph='i', s='t'))
+            # The command is the argument of both, the wait in the agent queue is an async span
+            if name == 'agent_dequeue' and event['arg'] in enqueued:
+                command = f"{event['arg']:#x}"
+                trace.append({'name': 'agent_queue', 'cat': 'agent_queue', 'ph': 'b', 'id': command, 'pid': 0,
+                              'ts': enqueued.pop(event['arg'])})
+                trace.append({'name': 'agent_queue', 'cat': 'agent_queue', 'ph': 'e', 'id': command, 'pid': 0,
+                              'ts': event['us']})
+    for handle, task in tasks.items():
+        trace.append({'name': 'thread_name', 'ph': 'M', 'pid': 0, 'tid': handle, 'args': {'name': task}})
+    return trace
+
+
+def spans(trace):
+    """Durations of the B/E pairs per name, and of the async agent queue spans"""
+    durations = defaultdict(list)
+    open_spans = defaultdict(list)
+    async_begin = {}
+    for event in trace:
+        if event['ph'] == 'B':
+            open_spans[(event['tid'], event['name'])].append(event['ts'])
+        elif event['ph'] == 'E':
+            stack = open_spans[(event['tid'], event['name'])]
+            # An end without begin was recorded before the ring wrapped
+            if stack:
+                durations[event['name']].append(event['ts'] - stack.pop())
+        elif event['ph'] == 'b':
+            async_begin[event['id']] = event['ts']
+        elif event['ph'] == 'e' and event['id'] in async_begin:
+            durations[event['name']].append(event['ts'] - async_begin.pop(event['id']))
+    return durations
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('input', nargs='*', help='dump files (default: standard input)')
+    parser.add_argument('-o', '--output', default='trace.json', help='Chrome trace file (default: trace.json)')
+    args = parser.parse_args()
+
+    lines = []
+    if args.input:
+        for path in args.input:
+            with open(path, errors='replace') as f:
+                lines.extend(f)
+    else:
+        lines = sys.stdin.readlines()
+
+    header, names, tasks, events, overwritten = parse(lines)
+    if header is None or not events:
+        sys.exit('no pb_trace dump found')
+
+    trace = convert(names, tasks, events)
+    with open(args.output, 'w') as f:
+        json.dump({'traceEvents': trace, 'displayTimeUnit': 'ms', 'otherData': header}, f)
+
+    cost_us = header['record_cycles'] / header['cpu_mhz']
+    print(f"{len(events)} events, {overwritten} overwritten, {header['record_cycles']} cycles "
+          f"({cost_us:.2f} us) per trace point, written to {args.output}")
+    print(f"{'span':<24} {'count':>6} {'mean us':>10} {'max us':>10}")
+    for name, values in sorted(spans(trace).items()):
+        print(f'{name:<24} {len(values):>6} {sum(values) / len(values):>10.0f} {max(values):>10}')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -34,20 +34,249 @@
  */
 #include "button.h"
 #include <esp_timer.h>
+#if CONFIG_BUTTON_INTERRUPT
+#include <esp_attr.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#endif
 
 #define DEAD_TIME_US 50000 // 50ms
 
+#if !CONFIG_BUTTON_INTERRUPT
 #define POLL_TIMEOUT_US        (CONFIG_BUTTON_POLL_TIMEOUT * 1000)
+#endif
 #define AUTOREPEAT_TIMEOUT_US  (CONFIG_BUTTON_AUTOREPEAT_TIMEOUT * 1000)
 #define AUTOREPEAT_INTERVAL_US (CONFIG_BUTTON_AUTOREPEAT_INTERVAL * 1000)
 #define LONG_PRESS_TIMEOUT_US  (CONFIG_BUTTON_LONG_PRESS_TIMEOUT * 1000)
 
 static button_t *buttons[CONFIG_BUTTON_MAX] = { NULL };
-static esp_timer_handle_t timer = NULL;
 
 #define CHECK(x) do { esp_err_t __; if ((__ = x) != ESP_OK) return __; } while (0)
 #define CHECK_ARG(VAL) do { if (!(VAL)) return ESP_ERR_INVALID_ARG; } while (0)
 
+#if CONFIG_BUTTON_INTERRUPT
+
+#define EDGE_QUEUE_LEN (CONFIG_BUTTON_MAX * 8)
+#define NO_DEADLINE INT64_MAX
+
+typedef struct
+{
+    button_t *btn;
+    int level;
+    int64_t time_us;
+} edge_t;
+
+static QueueHandle_t edges = NULL;
+static TaskHandle_t task = NULL;
+
+static void IRAM_ATTR isr_handler(void *arg)
+{
+    button_t *btn = (button_t *)arg;
+    edge_t edge = {
+        .btn = btn,
+        .level = gpio_get_level(btn->gpio),
+        .time_us = esp_timer_get_time(),
+    };
+    BaseType_t woken = pdFALSE;
+
+    // a lost edge is caught up by the level check at the end of the dead time
+    xQueueSendFromISR(edges, &edge, &woken);
+    if (woken)
+        portYIELD_FROM_ISR();
+}
+
+static void report(button_t *btn, button_state_t state, int64_t time_us)
+{
+    btn->event_time_us = time_us;
+    btn->callback(btn, state);
+}
+
+static void set_pressed(button_t *btn, bool pressed, int64_t time_us)
+{
+    if (pressed && btn->internal.state == BUTTON_RELEASED)
+    {
+        btn->internal.state = BUTTON_PRESSED;
+        btn->internal.pressed_us = time_us;
+        btn->internal.repeat_us = time_us + AUTOREPEAT_TIMEOUT_US + AUTOREPEAT_INTERVAL_US;
+        report(btn, BUTTON_PRESSED, time_us);
+    }
+    else if (!pressed && btn->internal.state != BUTTON_RELEASED)
+    {
+        bool clicked = btn->internal.state == BUTTON_PRESSED;
+        btn->internal.state = BUTTON_RELEASED;
+        report(btn, BUTTON_RELEASED, time_us);
+        if (clicked)
+            report(btn, BUTTON_CLICKED, time_us);
+    }
+    else
+        return;
+
+    // edges until then are contact bounce
+    btn->internal.settle_us = time_us + DEAD_TIME_US;
+}
+
+static void handle_edge(const edge_t *edge)
+{
+    button_t *btn = edge->btn;
+
+    if (edge->time_us < btn->internal.settle_us)
+        return;
+    set_pressed(btn, edge->level == btn->pressed_level, edge->time_us);
+}
+
+static void handle_timeouts(button_t *btn, int64_t now)
+{
+    if (btn->internal.settle_us && now >= btn->internal.settle_us)
+    {
+        // the level may have changed during the dead time
+        btn->internal.settle_us = 0;
+        set_pressed(btn, gpio_get_level(btn->gpio) == btn->pressed_level, now);
+    }
+    if (btn->internal.state != BUTTON_PRESSED)
+        return;
+
+    if (btn->autorepeat)
+    {
+        if (now < btn->internal.repeat_us)
+            return;
+        btn->internal.repeat_us += AUTOREPEAT_INTERVAL_US;
+        if (btn->internal.repeat_us <= now)
+            btn->internal.repeat_us = now + AUTOREPEAT_INTERVAL_US;
+        report(btn, BUTTON_CLICKED, now);
+    }
+    else if (now >= btn->internal.pressed_us + LONG_PRESS_TIMEOUT_US)
+    {
+        btn->internal.state = BUTTON_PRESSED_LONG;
+        report(btn, BUTTON_PRESSED_LONG, now);
+    }
+}
+
+static int64_t next_deadline(const button_t *btn)
+{
+    int64_t deadline = btn->internal.settle_us ? btn->internal.settle_us : NO_DEADLINE;
+
+    if (btn->internal.state == BUTTON_PRESSED)
+    {
+        int64_t timeout = btn->autorepeat
+            ? btn->internal.repeat_us
+            : btn->internal.pressed_us + LONG_PRESS_TIMEOUT_US;
+        if (timeout < deadline)
+            deadline = timeout;
+    }
+    return deadline;
+}
+
+static bool registered(const button_t *btn)
+{
+    for (size_t i = 0; i < CONFIG_BUTTON_MAX; i++)
+        if (buttons[i] == btn)
+            return true;
+    return false;
+}
+
+static void button_task(void *arg)
+{
+    edge_t edge;
+
+    while (1)
+    {
+        int64_t now = esp_timer_get_time();
+        int64_t deadline = NO_DEADLINE;
+        for (size_t i = 0; i < CONFIG_BUTTON_MAX; i++)
+        {
+            button_t *btn = buttons[i];
+            if (!btn || !btn->callback)
+                continue;
+            handle_timeouts(btn, now);
+            int64_t next = next_deadline(btn);
+            if (next < deadline)
+                deadline = next;
+        }
+
+        // no button held, sleep until the next edge
+        TickType_t ticks = portMAX_DELAY;
+        if (deadline != NO_DEADLINE)
+        {
+            const int64_t tick_us = portTICK_PERIOD_MS * 1000;
+            ticks = deadline > now ? (deadline - now + tick_us - 1) / tick_us : 0;
+        }
+        if (xQueueReceive(edges, &edge, ticks) == pdTRUE && edge.btn && registered(edge.btn) && edge.btn->callback)
+            handle_edge(&edge);
+    }
+}
+
+static esp_err_t start(void)
+{
+    if (task)
+        return ESP_OK;
+
+    esp_err_t res = gpio_install_isr_service(0);
+    // already installed by the application
+    if (res != ESP_OK && res != ESP_ERR_INVALID_STATE)
+        return res;
+    edges = xQueueCreate(EDGE_QUEUE_LEN, sizeof(edge_t));
+    if (!edges)
+        return ESP_ERR_NO_MEM;
+    if (xTaskCreate(button_task, "buttons", CONFIG_BUTTON_TASK_STACK_SIZE, NULL, CONFIG_BUTTON_TASK_PRIORITY, &task) != pdPASS)
+    {
+        vQueueDelete(edges);
+        edges = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t button_init(button_t *btn)
+{
+    CHECK_ARG(btn);
+    CHECK(start());
+
+    for (size_t i = 0; i < CONFIG_BUTTON_MAX; i++)
+    {
+        if (buttons[i] == btn)
+            return ESP_OK;
+        if (buttons[i])
+            continue;
+
+        btn->internal.state = BUTTON_RELEASED;
+        // the task checks the initial level
+        btn->internal.settle_us = esp_timer_get_time();
+        CHECK(gpio_set_direction(btn->gpio, GPIO_MODE_INPUT));
+        if (btn->internal_pull)
+            CHECK(gpio_set_pull_mode(btn->gpio, btn->pressed_level ? GPIO_PULLDOWN_ONLY : GPIO_PULLUP_ONLY));
+        CHECK(gpio_set_intr_type(btn->gpio, GPIO_INTR_ANYEDGE));
+        buttons[i] = btn;
+        CHECK(gpio_isr_handler_add(btn->gpio, isr_handler, btn));
+        // an empty edge wakes the task up to check the initial level
+        edge_t wakeup = { .btn = NULL };
+        xQueueSendToBack(edges, &wakeup, 0);
+        return ESP_OK;
+    }
+
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t button_done(button_t *btn)
+{
+    CHECK_ARG(btn);
+
+    for (size_t i = 0; i < CONFIG_BUTTON_MAX; i++)
+        if (buttons[i] == btn)
+        {
+            gpio_isr_handler_remove(btn->gpio);
+            gpio_set_intr_type(btn->gpio, GPIO_INTR_DISABLE);
+            buttons[i] = NULL;
+            return ESP_OK;
+        }
+
+    return ESP_ERR_INVALID_ARG;
+}
+
+#else
+
+static esp_timer_handle_t timer = NULL;
+
 static void poll_button(button_t *btn)
 {
     if (btn->internal.state == BUTTON_PRESSED && btn->internal.pressed_time < DEAD_TIME_US)
@@ -110,9 +339,14 @@ static void poll_button(button_t *btn)
 
 static void poll(void *arg)
 {
+    int64_t now = esp_timer_get_time();
+
     for (size_t i = 0; i < CONFIG_BUTTON_MAX; i++)
         if (buttons[i] && buttons[i]->callback)
+        {
+            buttons[i]->event_time_us = now;
             poll_button(buttons[i]);
+        }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -180,3 +414,5 @@ esp_err_t button_done(button_t *btn)
     CHECK(esp_timer_start_periodic(timer, POLL_TIMEOUT_US));
     return res;
 }
+
+#endif
@@ -30,6 +30,10 @@
  *
  * Supports anti-jitter, auto repeat, long press.
  *
+ * Buttons are polled by a periodic timer, or read on GPIO interrupts when
+ * CONFIG_BUTTON_INTERRUPT is set. In the latter mode, the callbacks are run
+ * by a task that only wakes up on edges and while a button is held.
+ *
  * Copyright (c) 2021 Ruslan V. Uss <unclerus@gmail.com>
  *
  * MIT Licensed as described in the file LICENSE
@@ -80,10 +84,14 @@ struct button_s
     bool autorepeat;                //!< Enable autorepeat
     button_event_cb_t callback;     //!< Button callback
     void *ctx;                      //!< User data
+    int64_t event_time_us;          //!< Time of the event passed to the callback since boot, us
     struct {
         button_state_t state;
         uint32_t pressed_time;
         uint32_t repeating_time;
+        int64_t pressed_us;
+        int64_t settle_us;
+        int64_t repeat_us;
     } internal;                     //!< Internal button state
 };
 
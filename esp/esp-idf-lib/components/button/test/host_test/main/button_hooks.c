@@ -0,0 +1,26 @@
+/*
+ * button.c is built here, so that the test can run the steps of the
+ * button task on synthetic edges without the task and the GPIO interrupts.
+ */
+#include "button.c"
+#include "button_hooks.h"
+
+void button_hook_edge(button_t *btn, int level, int64_t time_us)
+{
+    edge_t edge = {
+        .btn = btn,
+        .level = level,
+        .time_us = time_us,
+    };
+    handle_edge(&edge);
+}
+
+void button_hook_timeouts(button_t *btn, int64_t now)
+{
+    handle_timeouts(btn, now);
+}
+
+int64_t button_hook_deadline(const button_t *btn)
+{
+    return next_deadline(btn);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+#include "button.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// An edge timestamped by the GPIO interrupt, as received by the task
+void button_hook_edge(button_t *btn, int level, int64_t time_us);
+
+// The dead time, long press and autorepeat timeouts due at `now`
+void button_hook_timeouts(button_t *btn, int64_t now);
+
+// When the task wakes up next without an edge, INT64_MAX if it sleeps until one
+int64_t button_hook_deadline(const button_t *btn);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,14 @@
+#pragma once
+
+// The test sets the time of the edges and timeouts
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int64_t esp_timer_get_time(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,245 @@
+#define CATCH_CONFIG_MAIN // This tells the catch header to generate a main
+#include <map>
+#include <vector>
+#include "catch.hpp"
+#include "button_hooks.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+static constexpr int64_t ms = 1000;
+static constexpr int64_t dead_time = 50 * ms;
+
+/**
+ * Simulated hardware and task: the pin levels, the time of the edges and
+ * the events passed to the callback.
+ */
+static std::map<gpio_num_t, int> levels;
+static int64_t now;
+
+struct Event {
+    button_state_t state;
+    int64_t time_us;
+};
+
+static std::vector<Event> events;
+
+static void callback(button_t *btn, button_state_t state)
+{
+    events.push_back({ state, btn->event_time_us });
+}
+
+extern "C" {
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    return levels[gpio_num];
+}
+
+esp_err_t gpio_set_direction(gpio_num_t, gpio_mode_t) { return ESP_OK; }
+esp_err_t gpio_set_pull_mode(gpio_num_t, gpio_pull_mode_t) { return ESP_OK; }
+esp_err_t gpio_set_intr_type(gpio_num_t, gpio_int_type_t) { return ESP_OK; }
+esp_err_t gpio_install_isr_service(int) { return ESP_OK; }
+esp_err_t gpio_isr_handler_add(gpio_num_t, gpio_isr_t, void *) { return ESP_OK; }
+esp_err_t gpio_isr_handler_remove(gpio_num_t) { return ESP_OK; }
+
+int64_t esp_timer_get_time(void)
+{
+    return now;
+}
+
+// The task is not started, the queue only has to exist
+QueueHandle_t xQueueCreate(UBaseType_t, UBaseType_t) { return (QueueHandle_t)&events; }
+void vQueueDelete(QueueHandle_t) {}
+BaseType_t xQueueSendToBack(QueueHandle_t, const void *, TickType_t) { return pdTRUE; }
+BaseType_t xQueueSendFromISR(QueueHandle_t, const void *, BaseType_t *) { return pdTRUE; }
+BaseType_t xQueueReceive(QueueHandle_t, void *, TickType_t) { return pdFALSE; }
+BaseType_t xTaskCreate(TaskFunction_t, const char *, uint32_t, void *, UBaseType_t, TaskHandle_t *task)
+{
+    *task = (TaskHandle_t)&levels;
+    return pdPASS;
+}
+
+}
+
+// Runs the timeouts the task wakes up for until `time_us`
+static void run_until(button_t &btn, int64_t time_us)
+{
+    for (int64_t deadline = button_hook_deadline(&btn); deadline <= time_us; deadline = button_hook_deadline(&btn)) {
+        now = deadline;
+        button_hook_timeouts(&btn, now);
+    }
+    now = time_us;
+}
+
+// Changes the pin level at `time_us` and passes the edge to the task
+static void edge(button_t &btn, int level, int64_t time_us)
+{
+    run_until(btn, time_us);
+    levels[btn.gpio] = level;
+    button_hook_edge(&btn, level, time_us);
+}
+
+static void press(button_t &btn, int64_t time_us)
+{
+    edge(btn, btn.pressed_level, time_us);
+}
+
+static void release(button_t &btn, int64_t time_us)
+{
+    edge(btn, !btn.pressed_level, time_us);
+}
+
+// Initializes the button released at time 0, the task checks the level first
+static void start(button_t &btn, bool autorepeat)
+{
+    btn = {};
+    btn.gpio = 4;
+    btn.pressed_level = 0;
+    btn.autorepeat = autorepeat;
+    btn.callback = callback;
+    levels[btn.gpio] = 1;
+    events.clear();
+    now = 0;
+    REQUIRE(button_init(&btn) == ESP_OK);
+    run_until(btn, 0);
+    REQUIRE(events.empty());
+    REQUIRE(button_hook_deadline(&btn) == INT64_MAX);
+}
+
+static bool happened(const std::vector<Event> &expected)
+{
+    if (events.size() != expected.size())
+        return false;
+    for (size_t i = 0; i < expected.size(); i++)
+        if (events[i].state != expected[i].state || events[i].time_us != expected[i].time_us)
+            return false;
+    return true;
+}
+
+TEST_CASE("Contact bounce inside the dead time is ignored", "[button]")
+{
+    button_t btn;
+    start(btn, false);
+
+    press(btn, 100 * ms);
+    release(btn, 100 * ms + 200);
+    press(btn, 100 * ms + 900);
+    release(btn, 120 * ms);
+    press(btn, 149 * ms);
+    CHECK(happened({ { BUTTON_PRESSED, 100 * ms } }));
+
+    // the level is pressed again when the dead time ends, no event
+    run_until(btn, 300 * ms);
+    CHECK(happened({ { BUTTON_PRESSED, 100 * ms } }));
+
+    // release bounces the same way
+    release(btn, 300 * ms);
+    press(btn, 300 * ms + 500);
+    release(btn, 301 * ms);
+    CHECK(happened({ { BUTTON_PRESSED, 100 * ms }, { BUTTON_RELEASED, 300 * ms }, { BUTTON_CLICKED, 300 * ms } }));
+
+    // the first edge at the end of the dead time counts
+    press(btn, 300 * ms + dead_time);
+    CHECK(happened({ { BUTTON_PRESSED, 100 * ms }, { BUTTON_RELEASED, 300 * ms }, { BUTTON_CLICKED, 300 * ms },
+                     { BUTTON_PRESSED, 350 * ms } }));
+
+    CHECK(button_done(&btn) == ESP_OK);
+}
+
+TEST_CASE("Level changed during the dead time is caught when it ends", "[button]")
+{
+    button_t btn;
+    start(btn, false);
+
+    // a short tap: the release edge is bounce, the level check at the end of the dead time sees it
+    press(btn, 100 * ms);
+    release(btn, 110 * ms);
+    CHECK(button_hook_deadline(&btn) == 100 * ms + dead_time);
+    run_until(btn, 200 * ms);
+    CHECK(happened({ { BUTTON_PRESSED, 100 * ms }, { BUTTON_RELEASED, 150 * ms }, { BUTTON_CLICKED, 150 * ms } }));
+
+    // a lost edge: the pin is pressed again during the next dead time without an edge to the task
+    press(btn, 250 * ms);
+    release(btn, 260 * ms);
+    run_until(btn, 320 * ms);
+    levels[btn.gpio] = btn.pressed_level;
+    run_until(btn, 400 * ms);
+    REQUIRE(events.size() == 7);
+    CHECK(events[3].state == BUTTON_PRESSED);
+    CHECK(events[4].state == BUTTON_RELEASED);
+    CHECK(events[4].time_us == 300 * ms);
+    CHECK(events[5].state == BUTTON_CLICKED);
+    CHECK(events[6].state == BUTTON_PRESSED);
+    CHECK(events[6].time_us == 350 * ms);
+
+    // pressed at boot
+    button_t other = {};
+    other.gpio = 5;
+    other.callback = callback;
+    levels[other.gpio] = 0;
+    events.clear();
+    now = 500 * ms;
+    REQUIRE(button_init(&other) == ESP_OK);
+    run_until(other, 500 * ms);
+    CHECK(happened({ { BUTTON_PRESSED, 500 * ms } }));
+
+    CHECK(button_done(&other) == ESP_OK);
+    CHECK(button_done(&btn) == ESP_OK);
+}
+
+TEST_CASE("Long press", "[button]")
+{
+    button_t btn;
+    start(btn, false);
+
+    press(btn, 100 * ms);
+    run_until(btn, 1099 * ms);
+    CHECK(happened({ { BUTTON_PRESSED, 100 * ms } }));
+    CHECK(button_hook_deadline(&btn) == 1100 * ms);
+    run_until(btn, 1100 * ms);
+    CHECK(happened({ { BUTTON_PRESSED, 100 * ms }, { BUTTON_PRESSED_LONG, 1100 * ms } }));
+
+    // nothing to wait for until the release, which is not a click
+    CHECK(button_hook_deadline(&btn) == INT64_MAX);
+    release(btn, 5000 * ms);
+    run_until(btn, 6000 * ms);
+    CHECK(happened({ { BUTTON_PRESSED, 100 * ms }, { BUTTON_PRESSED_LONG, 1100 * ms }, { BUTTON_RELEASED, 5000 * ms } }));
+
+    // released before the timeout: a click
+    events.clear();
+    press(btn, 7000 * ms);
+    release(btn, 7999 * ms);
+    run_until(btn, 9000 * ms);
+    CHECK(happened({ { BUTTON_PRESSED, 7000 * ms }, { BUTTON_RELEASED, 7999 * ms }, { BUTTON_CLICKED, 7999 * ms } }));
+
+    CHECK(button_done(&btn) == ESP_OK);
+}
+
+TEST_CASE("Autorepeat", "[button]")
+{
+    button_t btn;
+    start(btn, true);
+
+    // first click after the autorepeat timeout and an interval, then every interval, no long press
+    press(btn, 100 * ms);
+    CHECK(button_hook_deadline(&btn) == 100 * ms + dead_time);
+    run_until(btn, 1400 * ms);
+    CHECK(happened({ { BUTTON_PRESSED, 100 * ms }, { BUTTON_CLICKED, 850 * ms }, { BUTTON_CLICKED, 1100 * ms },
+                     { BUTTON_CLICKED, 1350 * ms } }));
+    CHECK(button_hook_deadline(&btn) == 1600 * ms);
+
+    // a late wakeup clicks once and keeps the interval from then on
+    events.clear();
+    now = 2000 * ms;
+    button_hook_timeouts(&btn, now);
+    CHECK(happened({ { BUTTON_CLICKED, 2000 * ms } }));
+    CHECK(button_hook_deadline(&btn) == 2250 * ms);
+
+    release(btn, 2100 * ms);
+    run_until(btn, 3000 * ms);
+    CHECK(happened({ { BUTTON_CLICKED, 2000 * ms }, { BUTTON_RELEASED, 2100 * ms }, { BUTTON_CLICKED, 2100 * ms } }));
+    CHECK(button_hook_deadline(&btn) == INT64_MAX);
+
+    CHECK(button_done(&btn) == ESP_OK);
+}
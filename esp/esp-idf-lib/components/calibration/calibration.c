@@ -38,17 +38,127 @@
 #include <esp_log.h>
 #include <string.h>
 #include <stdlib.h>
+#include <math.h>
 
 #define CHECK(x) do { esp_err_t __; if ((__ = x) != ESP_OK) return __; } while (0)
 #define CHECK_ARG(VAL) do { if (!(VAL)) return ESP_ERR_INVALID_ARG; } while (0)
 
+#define BLOB_VERSION 1
+
 static const char *TAG = "calibration";
 
-static float calc_linear_value(calibration_point_t *p1, calibration_point_t *p2, float code)
+// NVS blob: header, points, segments
+typedef struct
+{
+    uint16_t version;
+    uint16_t type;
+    uint32_t filled;
+} blob_header_t;
+
+static void freeze_linear(calibration_handle_t *handler)
+{
+    for (size_t i = 0; i < handler->filled - 1; i++)
+    {
+        const calibration_point_t *p1 = handler->points + i;
+        const calibration_point_t *p2 = p1 + 1;
+        calibration_segment_t *seg = handler->segments + i;
+        seg->k = (p2->value - p1->value) / (p2->code - p1->code);
+        seg->s = seg->k * p1->code - p1->value;
+        seg->c2 = 0;
+        seg->c3 = 0;
+    }
+    // last segment goes on past the last point
+    handler->segments[handler->filled - 1] = handler->segments[handler->filled - 2];
+}
+
+static void freeze_cubic(calibration_handle_t *handler)
+{
+    const calibration_point_t *p = handler->points;
+    calibration_segment_t *seg = handler->segments;
+    size_t n = handler->filled;
+
+    // secants in c2, tangents in k
+    for (size_t i = 0; i < n - 1; i++)
+        seg[i].c2 = (p[i + 1].value - p[i].value) / (p[i + 1].code - p[i].code);
+    seg[0].k = seg[0].c2;
+    seg[n - 1].k = seg[n - 2].c2;
+    for (size_t i = 1; i < n - 1; i++)
+        seg[i].k = seg[i - 1].c2 * seg[i].c2 <= 0 ? 0 : (seg[i - 1].c2 + seg[i].c2) / 2;
+
+    // Fritsch-Carlson: limit the tangents so that the spline is monotone on each segment
+    for (size_t i = 0; i < n - 1; i++)
+    {
+        float d = seg[i].c2;
+        if (d == 0)
+        {
+            seg[i].k = 0;
+            seg[i + 1].k = 0;
+            continue;
+        }
+        float a = seg[i].k / d;
+        float b = seg[i + 1].k / d;
+        float r = a * a + b * b;
+        if (r > 9)
+        {
+            float tau = 3 / sqrtf(r);
+            seg[i].k = tau * a * d;
+            seg[i + 1].k = tau * b * d;
+        }
+    }
+
+    // Hermite coefficients, the last segment is the tangent line at the last point
+    for (size_t i = 0; i < n; i++)
+    {
+        seg[i].s = seg[i].k * p[i].code - p[i].value;
+        if (i == n - 1)
+        {
+            seg[i].c2 = 0;
+            seg[i].c3 = 0;
+            break;
+        }
+        float h = p[i + 1].code - p[i].code;
+        float d = seg[i].c2;
+        seg[i].c2 = (3 * d - 2 * seg[i].k - seg[i + 1].k) / h;
+        seg[i].c3 = (seg[i].k + seg[i + 1].k - 2 * d) / (h * h);
+    }
+}
+
+// Segment of code: the last point not above it, the first one below them all
+static size_t find_segment(const calibration_handle_t *handler, float code)
+{
+    size_t lo = 0, hi = handler->filled;
+
+    while (hi - lo > 1)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (handler->points[mid].code <= code)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static inline bool in_segment(const calibration_handle_t *handler, size_t i, float code)
 {
-    float kx = (p2->value - p1->value) / (p2->code - p1->code);
-    float sx = kx * p1->code - p1->value;
-    return code * kx - sx;
+    return (i == 0 || handler->points[i].code <= code)
+        && (i == handler->filled - 1 || code < handler->points[i + 1].code);
+}
+
+static inline float convert(const calibration_handle_t *handler, size_t i, float code)
+{
+    const calibration_point_t *p = handler->points + i;
+    if (code == p->code)
+        return p->value;
+
+    const calibration_segment_t *seg = handler->segments + i;
+    float value = code * seg->k - seg->s;
+    if (handler->type == CALIBRATION_MONOTONE_CUBIC && code > p->code)
+    {
+        float t = code - p->code;
+        value += t * t * (seg->c2 + t * seg->c3);
+    }
+    return value;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -57,9 +167,9 @@ esp_err_t calibration_init(calibration_handle_t *handler, size_t count, calibrat
 {
     CHECK_ARG(handler && count > 1);
 
-    if (type != CALIBRATION_LINEAR)
+    if (type != CALIBRATION_LINEAR && type != CALIBRATION_MONOTONE_CUBIC)
     {
-        ESP_LOGE(TAG, "Only type CALIBRATION_LINEAR is supported");
+        ESP_LOGE(TAG, "Unsupported approximation type %d", type);
         return ESP_ERR_NOT_SUPPORTED;
     }
 
@@ -72,10 +182,13 @@ esp_err_t calibration_init(calibration_handle_t *handler, size_t count, calibrat
     handler->type = type;
     handler->count = count;
     handler->filled = 0;
+    handler->frozen = false;
     handler->points = calloc(sizeof(calibration_point_t), handler->count);
-    if (!handler->points)
+    handler->segments = calloc(sizeof(calibration_segment_t), handler->count);
+    if (!handler->points || !handler->segments)
     {
         ESP_LOGE(TAG, "Could not allocate memory for calibration points");
+        calibration_free(handler);
         return ESP_ERR_NO_MEM;
     }
 
@@ -86,13 +199,23 @@ esp_err_t calibration_add_point(calibration_handle_t *handler, float code, float
 {
     CHECK_ARG(handler && handler->points);
 
-    // FIXME: inefficient
-    for (size_t i = 0; i < handler->filled; i++)
-        if (handler->points[i].code == code)
-        {
-            handler->points[i].value = value;
-            return ESP_OK;
-        }
+    // first point with a code not below the new one
+    size_t pos = 0, end = handler->filled;
+    while (pos < end)
+    {
+        size_t mid = (pos + end) / 2;
+        if (handler->points[mid].code < code)
+            pos = mid + 1;
+        else
+            end = mid;
+    }
+
+    if (pos < handler->filled && handler->points[pos].code == code)
+    {
+        handler->points[pos].value = value;
+        handler->frozen = false;
+        return ESP_OK;
+    }
 
     if (handler->filled == handler->count)
     {
@@ -100,11 +223,6 @@ esp_err_t calibration_add_point(calibration_handle_t *handler, float code, float
         return ESP_ERR_NO_MEM;
     }
 
-    size_t pos;
-    for (pos = 0; pos < handler->filled; pos++)
-        if (handler->points[pos].code > code)
-            break;
-
     if (pos < handler->filled)
         memmove(handler->points + pos + 1, handler->points + pos, sizeof(calibration_point_t) * (handler->filled - pos));
 
@@ -112,6 +230,7 @@ esp_err_t calibration_add_point(calibration_handle_t *handler, float code, float
     handler->points[pos].value = value;
 
     handler->filled++;
+    handler->frozen = false;
 
     return ESP_OK;
 }
@@ -126,9 +245,9 @@ esp_err_t calibration_add_points(calibration_handle_t *handler, const calibratio
     return ESP_OK;
 }
 
-esp_err_t calibration_get_value(calibration_handle_t *handler, float code, float *value)
+esp_err_t calibration_freeze(calibration_handle_t *handler)
 {
-    CHECK_ARG(handler && handler->points && value);
+    CHECK_ARG(handler && handler->points && handler->segments);
 
     if (handler->filled < 2)
     {
@@ -136,24 +255,112 @@ esp_err_t calibration_get_value(calibration_handle_t *handler, float code, float
         return ESP_FAIL;
     }
 
-    // looking for a segment
-    size_t pos;
-    for (pos = 0; pos < handler->filled; pos++)
+    if (handler->type == CALIBRATION_MONOTONE_CUBIC)
+        freeze_cubic(handler);
+    else
+        freeze_linear(handler);
+    handler->frozen = true;
+
+    return ESP_OK;
+}
+
+esp_err_t calibration_get_value(calibration_handle_t *handler, float code, float *value)
+{
+    CHECK_ARG(handler && handler->points && value);
+
+    if (!handler->frozen)
+        CHECK(calibration_freeze(handler));
+
+    *value = convert(handler, find_segment(handler, code), code);
+
+    return ESP_OK;
+}
+
+esp_err_t calibration_get_values(calibration_handle_t *handler, const float *codes, float *values, size_t count)
+{
+    CHECK_ARG(handler && handler->points && codes && values);
+
+    if (!handler->frozen)
+        CHECK(calibration_freeze(handler));
+
+    size_t seg = 0;
+    for (size_t i = 0; i < count; i++)
     {
-        if (handler->points[pos].code == code)
-        {
-            *value = handler->points[pos].value;
-            return ESP_OK;
-        }
-        if (handler->points[pos].code > code)
-            break;
+        float code = codes[i];
+        if (!in_segment(handler, seg, code))
+            seg = find_segment(handler, code);
+        values[i] = convert(handler, seg, code);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t calibration_save(calibration_handle_t *handler, nvs_handle_t nvs, const char *key)
+{
+    CHECK_ARG(handler && handler->points && key);
+
+    if (!handler->frozen)
+        CHECK(calibration_freeze(handler));
+
+    size_t points_size = handler->filled * sizeof(calibration_point_t);
+    size_t segments_size = handler->filled * sizeof(calibration_segment_t);
+    size_t size = sizeof(blob_header_t) + points_size + segments_size;
+    uint8_t *blob = malloc(size);
+    if (!blob)
+        return ESP_ERR_NO_MEM;
+
+    blob_header_t header = {
+        .version = BLOB_VERSION,
+        .type = handler->type,
+        .filled = handler->filled,
+    };
+    memcpy(blob, &header, sizeof(header));
+    memcpy(blob + sizeof(header), handler->points, points_size);
+    memcpy(blob + sizeof(header) + points_size, handler->segments, segments_size);
+
+    esp_err_t res = nvs_set_blob(nvs, key, blob, size);
+    free(blob);
+    CHECK(res);
+
+    return nvs_commit(nvs);
+}
+
+esp_err_t calibration_load(calibration_handle_t *handler, nvs_handle_t nvs, const char *key)
+{
+    CHECK_ARG(handler && handler->points && handler->segments && key);
+
+    size_t size = 0;
+    CHECK(nvs_get_blob(nvs, key, NULL, &size));
+    if (size < sizeof(blob_header_t))
+        return ESP_ERR_INVALID_SIZE;
+
+    uint8_t *blob = malloc(size);
+    if (!blob)
+        return ESP_ERR_NO_MEM;
+    esp_err_t res = nvs_get_blob(nvs, key, blob, &size);
+    if (res != ESP_OK)
+    {
+        free(blob);
+        return res;
     }
-    if (pos > 0)
-        pos--;
-    if (pos == handler->filled - 1)
-        pos--;
 
-    *value = calc_linear_value(handler->points + pos, handler->points + pos + 1, code);
+    blob_header_t header;
+    memcpy(&header, blob, sizeof(header));
+    size_t points_size = header.filled * sizeof(calibration_point_t);
+    size_t segments_size = header.filled * sizeof(calibration_segment_t);
+    if (header.version != BLOB_VERSION || header.type != handler->type || header.filled < 2
+            || header.filled > handler->count || size != sizeof(header) + points_size + segments_size)
+    {
+        ESP_LOGE(TAG, "Stored calibration '%s' does not match the handle", key);
+        free(blob);
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    memcpy(handler->points, blob + sizeof(header), points_size);
+    memcpy(handler->segments, blob + sizeof(header) + points_size, segments_size);
+    handler->filled = header.filled;
+    handler->frozen = true;
+    free(blob);
 
     return ESP_OK;
 }
@@ -167,6 +374,12 @@ esp_err_t calibration_free(calibration_handle_t *handler)
         free(handler->points);
         handler->points = NULL;
     }
+    if (handler->segments)
+    {
+        free(handler->segments);
+        handler->segments = NULL;
+    }
+    handler->frozen = false;
 
     return ESP_OK;
 }
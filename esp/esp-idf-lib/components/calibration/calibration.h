@@ -39,7 +39,10 @@
 #ifndef __CALIBRATION_H__
 #define __CALIBRATION_H__
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <esp_err.h>
+#include <nvs.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -49,7 +52,8 @@ extern "C" {
  * Approximation methods
  */
 typedef enum {
-    CALIBRATION_LINEAR = 0, //!< Fast linear approximation. The more points, the more accurate approximation
+    CALIBRATION_LINEAR = 0,     //!< Fast linear approximation. The more points, the more accurate approximation
+    CALIBRATION_MONOTONE_CUBIC, //!< Monotone cubic spline (Fritsch-Carlson), smooth and without overshoot between points
 } calibration_method_t;
 
 /**
@@ -61,15 +65,31 @@ typedef struct
     float value;  //!< Calibrated value
 } calibration_point_t;
 
+/**
+ * Precomputed segment starting at a calibration point.
+ *
+ * value = code * k - s for linear segments, plus t * t * (c2 + t * c3)
+ * with t = code - point code for cubic ones
+ */
+typedef struct
+{
+    float k;  //!< Slope
+    float s;  //!< Offset
+    float c2; //!< Quadratic coefficient
+    float c3; //!< Cubic coefficient
+} calibration_segment_t;
+
 /**
  * Calibration handler
  */
 typedef struct
 {
-    calibration_method_t type;   //!< Approximation method
-    calibration_point_t *points; //!< Ordered list of calibration points
-    size_t count;                //!< Maximum number of calibration points
-    size_t filled;               //!< Current number of calibration points
+    calibration_method_t type;          //!< Approximation method
+    calibration_point_t *points;        //!< Ordered list of calibration points
+    size_t count;                       //!< Maximum number of calibration points
+    size_t filled;                      //!< Current number of calibration points
+    calibration_segment_t *segments;    //!< Segment table, one per point, see ::calibration_freeze()
+    bool frozen;                        //!< Segment table is up to date with the points
 } calibration_handle_t;
 
 /**
@@ -107,9 +127,25 @@ esp_err_t calibration_add_point(calibration_handle_t *handler, float code, float
  */
 esp_err_t calibration_add_points(calibration_handle_t *handler, const calibration_point_t *points, size_t count);
 
+/**
+ * @brief Build the segment table
+ *
+ * Precomputes the coefficients of every segment, conversions are then
+ * a binary search and a few multiplications. Adding points unfreezes the
+ * table; conversions freeze it again if needed, so calling this function
+ * is only needed to keep the computation out of the first conversion.
+ *
+ * @param handler Pointer to calibration handle structure
+ *
+ * @return `ESP_OK` on success
+ */
+esp_err_t calibration_freeze(calibration_handle_t *handler);
+
 /**
  * @brief Get calibrated value by raw value
  *
+ * Codes outside of the calibration points are extrapolated linearly.
+ *
  * @param handler    Pointer to calibration handle structure
  * @param code       Raw value
  * @param[out] value Calculated calibrated value
@@ -118,6 +154,52 @@ esp_err_t calibration_add_points(calibration_handle_t *handler, const calibratio
  */
 esp_err_t calibration_get_value(calibration_handle_t *handler, float code, float *value);
 
+/**
+ * @brief Get calibrated values of multiple raw values
+ *
+ * Faster than ::calibration_get_value() for consecutive samples of a signal,
+ * each code is first looked up in the segment of the previous one.
+ *
+ * @param handler     Pointer to calibration handle structure
+ * @param codes       Raw values
+ * @param[out] values Calculated calibrated values, may be the same array as `codes`
+ * @param count       Number of values
+ *
+ * @return `ESP_OK` on success
+ */
+esp_err_t calibration_get_values(calibration_handle_t *handler, const float *codes, float *values, size_t count);
+
+/**
+ * @brief Store frozen calibration to NVS
+ *
+ * The points and the segment table are written as a single blob,
+ * then committed.
+ *
+ * @param handler Pointer to calibration handle structure
+ * @param nvs     Handle of the open NVS namespace
+ * @param key     NVS key
+ *
+ * @return `ESP_OK` on success
+ */
+esp_err_t calibration_save(calibration_handle_t *handler, nvs_handle_t nvs, const char *key);
+
+/**
+ * @brief Load frozen calibration from NVS
+ *
+ * Replaces the points of an initialized handle with the ones stored by
+ * ::calibration_save(), the segment table is used as is.
+ *
+ * @param handler Pointer to calibration handle structure, initialized with
+ *                the same approximation method and enough points
+ * @param nvs     Handle of the open NVS namespace
+ * @param key     NVS key
+ *
+ * @return `ESP_OK` on success, `ESP_ERR_NVS_NOT_FOUND` if nothing is stored,
+ *         `ESP_ERR_INVALID_VERSION` if the stored calibration does not match
+ *         the handle
+ */
+esp_err_t calibration_load(calibration_handle_t *handler, nvs_handle_t nvs, const char *key);
+
 /**
  * @brief Free calibration handle
  *
@@ -0,0 +1,235 @@
+#define CATCH_CONFIG_MAIN // This tells the catch header to generate a main
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+#include "catch.hpp"
+#include "calibration.h"
+
+using namespace std::chrono;
+
+static constexpr size_t block_size = 1024;
+
+// calibration_get_value() as it was before the segment table
+static float get_value_reference(const calibration_handle_t *handler, float code)
+{
+    size_t pos;
+    for (pos = 0; pos < handler->filled; pos++)
+    {
+        if (handler->points[pos].code == code)
+            return handler->points[pos].value;
+        if (handler->points[pos].code > code)
+            break;
+    }
+    if (pos > 0)
+        pos--;
+    if (pos == handler->filled - 1)
+        pos--;
+
+    const calibration_point_t *p1 = handler->points + pos, *p2 = p1 + 1;
+    float kx = (p2->value - p1->value) / (p2->code - p1->code);
+    float sx = kx * p1->code - p1->value;
+    return code * kx - sx;
+}
+
+// Monotone increasing curve with flat parts and steps, points added in random order
+static void fill(calibration_handle_t *handler, size_t count, calibration_method_t type, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::vector<calibration_point_t> points(count);
+    float value = -50;
+    for (size_t i = 0; i < count; i++)
+    {
+        points[i].code = i * 100 + rng() % 50;
+        points[i].value = value;
+        if (rng() % 4)
+            value += (rng() % 1000) / 10.0f;
+    }
+    std::shuffle(points.begin(), points.end(), rng);
+
+    *handler = {};
+    REQUIRE(calibration_init(handler, count, type) == ESP_OK);
+    REQUIRE(calibration_add_points(handler, points.data(), count) == ESP_OK);
+}
+
+static std::vector<float> signal(const calibration_handle_t *handler, size_t num)
+{
+    float lo = handler->points[0].code - 200;
+    float hi = handler->points[handler->filled - 1].code + 200;
+    std::vector<float> codes(num);
+    for (size_t i = 0; i < num; i++)
+        codes[i] = lo + (hi - lo) * (0.5f + 0.5f * sinf(i * 0.01f));
+    return codes;
+}
+
+TEST_CASE("Points are kept ordered", "[calibration]")
+{
+    calibration_handle_t c;
+    fill(&c, 64, CALIBRATION_LINEAR, 1);
+    for (size_t i = 1; i < c.filled; i++)
+        CHECK(c.points[i - 1].code < c.points[i].code);
+
+    // same code replaces the value
+    REQUIRE(calibration_add_point(&c, c.points[10].code, 1234) == ESP_OK);
+    CHECK(c.filled == 64);
+    CHECK(c.points[10].value == 1234);
+    calibration_free(&c);
+}
+
+TEST_CASE("Linear segment table matches the linear scan", "[calibration]")
+{
+    for (size_t count : { 2, 3, 16, 64 })
+    {
+        calibration_handle_t c;
+        fill(&c, count, CALIBRATION_LINEAR, count);
+        REQUIRE(calibration_freeze(&c) == ESP_OK);
+
+        float lo = c.points[0].code - 500;
+        float hi = c.points[count - 1].code + 500;
+        for (float code = lo; code <= hi; code += 0.37f)
+        {
+            float value;
+            REQUIRE(calibration_get_value(&c, code, &value) == ESP_OK);
+            CHECK(value == get_value_reference(&c, code));
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            float value;
+            REQUIRE(calibration_get_value(&c, c.points[i].code, &value) == ESP_OK);
+            CHECK(value == c.points[i].value);
+        }
+        calibration_free(&c);
+    }
+}
+
+TEST_CASE("Monotone cubic spline goes through the points without overshoot", "[calibration]")
+{
+    calibration_handle_t c;
+    fill(&c, 32, CALIBRATION_MONOTONE_CUBIC, 7);
+
+    for (size_t i = 0; i < c.filled; i++)
+    {
+        float value;
+        REQUIRE(calibration_get_value(&c, c.points[i].code, &value) == ESP_OK);
+        CHECK(value == c.points[i].value);
+    }
+
+    for (size_t i = 0; i + 1 < c.filled; i++)
+    {
+        const calibration_point_t &p1 = c.points[i], &p2 = c.points[i + 1];
+        float prev = p1.value;
+        for (int step = 1; step <= 100; step++)
+        {
+            float value;
+            REQUIRE(calibration_get_value(&c, p1.code + (p2.code - p1.code) * step / 100, &value) == ESP_OK);
+            // monotone and within the values of the segment, give or take the rounding
+            CHECK(value >= prev - 1e-3f);
+            CHECK(value >= p1.value - 1e-3f);
+            CHECK(value <= p2.value + 1e-3f);
+            prev = value;
+        }
+    }
+
+    // continuous at the points
+    for (size_t i = 1; i + 1 < c.filled; i++)
+    {
+        float before, after;
+        REQUIRE(calibration_get_value(&c, c.points[i].code - 0.01f, &before) == ESP_OK);
+        REQUIRE(calibration_get_value(&c, c.points[i].code + 0.01f, &after) == ESP_OK);
+        CHECK(fabsf(before - c.points[i].value) < 0.1f);
+        CHECK(fabsf(after - c.points[i].value) < 0.1f);
+    }
+    calibration_free(&c);
+}
+
+TEST_CASE("calibration_get_values matches calibration_get_value", "[calibration]")
+{
+    for (auto type : { CALIBRATION_LINEAR, CALIBRATION_MONOTONE_CUBIC })
+    {
+        calibration_handle_t c;
+        fill(&c, 24, type, 3);
+
+        auto codes = signal(&c, block_size);
+        std::mt19937 rng(5);
+        for (size_t i = 0; i < 100; i++)
+            codes[rng() % block_size] = c.points[rng() % c.filled].code + (int)(rng() % 400) - 200;
+
+        std::vector<float> values(block_size);
+        REQUIRE(calibration_get_values(&c, codes.data(), values.data(), block_size) == ESP_OK);
+        for (size_t i = 0; i < block_size; i++)
+        {
+            float value;
+            REQUIRE(calibration_get_value(&c, codes[i], &value) == ESP_OK);
+            CHECK(values[i] == value);
+        }
+
+        // in place
+        auto in_place = codes;
+        REQUIRE(calibration_get_values(&c, in_place.data(), in_place.data(), block_size) == ESP_OK);
+        CHECK(in_place == values);
+        calibration_free(&c);
+    }
+}
+
+TEST_CASE("Adding a point unfreezes the table", "[calibration]")
+{
+    calibration_handle_t c = {};
+    REQUIRE(calibration_init(&c, 3, CALIBRATION_LINEAR) == ESP_OK);
+    REQUIRE(calibration_add_point(&c, 0, 0) == ESP_OK);
+    REQUIRE(calibration_add_point(&c, 10, 10) == ESP_OK);
+
+    float value;
+    REQUIRE(calibration_get_value(&c, 20, &value) == ESP_OK);
+    CHECK(value == 20);
+    REQUIRE(calibration_add_point(&c, 20, 40) == ESP_OK);
+    CHECK(!c.frozen);
+    REQUIRE(calibration_get_value(&c, 15, &value) == ESP_OK);
+    CHECK(value == 25);
+    calibration_free(&c);
+}
+
+// Runs the conversion on a block of codes for about 200 ms, returns the conversions per second
+static double conversions_per_second(const std::function<void()> &block)
+{
+    size_t blocks = 0;
+    auto start = steady_clock::now();
+    auto elapsed = steady_clock::duration::zero();
+    do
+    {
+        block();
+        blocks++;
+        elapsed = steady_clock::now() - start;
+    } while (elapsed < milliseconds(200));
+    return blocks * block_size / duration<double>(elapsed).count();
+}
+
+TEST_CASE("Conversion throughput", "[bench]")
+{
+    for (size_t count : { 8, 32, 128 })
+    {
+        calibration_handle_t c;
+        fill(&c, count, CALIBRATION_LINEAR, 11);
+        REQUIRE(calibration_freeze(&c) == ESP_OK);
+        const auto codes = signal(&c, block_size);
+        std::vector<float> values(block_size);
+
+        double scan = conversions_per_second([&] {
+            for (size_t i = 0; i < block_size; i++)
+                values[i] = get_value_reference(&c, codes[i]);
+        });
+        double single = conversions_per_second([&] {
+            for (size_t i = 0; i < block_size; i++)
+                calibration_get_value(&c, codes[i], &values[i]);
+        });
+        double batch = conversions_per_second([&] {
+            calibration_get_values(&c, codes.data(), values.data(), block_size);
+        });
+        printf("%3zu points: scan %7.2f M/s, table %7.2f M/s, batch %7.2f M/s\n", count, scan / 1e6, single / 1e6,
+               batch / 1e6);
+        calibration_free(&c);
+        CHECK(batch > 0);
+    }
+}
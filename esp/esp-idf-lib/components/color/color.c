@@ -349,6 +349,49 @@ rgb_t hsv2rgb_rainbow(hsv_t hsv)
     return rgb_from_values(r, g, b);
 }
 
+// Channels of the 8 hue sections of hsv2rgb_rainbow() with the Y1 yellow boost:
+// base + third * rainbow_third + twothirds * rainbow_twothirds
+static const uint8_t rainbow_base[8][3] = {
+    { K255, 0, 0 }, { K171, K85, 0 }, { K171, K170, 0 }, { 0, K255, 0 },
+    { 0, K171, K85 }, { 0, 0, K255 }, { K85, 0, K171 }, { K170, 0, K85 },
+};
+static const int8_t rainbow_third[8][3] = {
+    { -1, 1, 0 }, { 0, 1, 0 }, { 0, 1, 0 }, { 0, -1, 1 },
+    { 0, 0, 0 }, { 1, 0, -1 }, { 1, 0, -1 }, { 1, 0, -1 },
+};
+static const int8_t rainbow_twothirds[8][3] = {
+    { 0, 0, 0 }, { 0, 0, 0 }, { -1, 0, 0 }, { 0, 0, 0 },
+    { 0, -1, 1 }, { 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 },
+};
+
+void hsv2rgb_rainbow_n(const hsv_t *src, rgb_t *dst, size_t num)
+{
+    for (size_t i = 0; i < num; ++i)
+    {
+        uint8_t section = src[i].hue >> 5;
+        uint8_t offset8 = (src[i].hue & 0x1F) << 3;
+        int third = scale8(offset8, (256 / 3));
+        int twothirds = scale8(offset8, ((256 * 2) / 3));
+
+        // Full saturation gives desat = 0 and a satscale of 255, which scale8() leaves
+        // as is, no saturation gives desat = 255 and a satscale of 0: white, as in
+        // hsv2rgb_rainbow(). Likewise, scale8_video(255, 255) is 255 and 0 stays 0.
+        uint8_t desat = scale8_video(255 - src[i].sat, 255 - src[i].sat);
+        uint8_t satscale = 255 - desat;
+        uint8_t val = scale8_video(src[i].val, src[i].val);
+
+        uint8_t c[3];
+        for (int ch = 0; ch < 3; ++ch)
+        {
+            uint8_t x = rainbow_base[section][ch] + third * rainbow_third[section][ch]
+                    + twothirds * rainbow_twothirds[section][ch];
+            x = scale8(x, satscale) + desat;
+            c[ch] = scale8(x, val);
+        }
+        dst[i] = rgb_from_values(c[0], c[1], c[2]);
+    }
+}
+
 #define FIXFRAC8(N,D) (((N) * 256) / (D))
 
 // This function is only an approximation, and it is not
@@ -573,6 +616,8 @@ rgb_t rgb_heat_color(uint8_t temperature)
 
 typedef uint16_t saccum87;
 
+#define COLOR_GRADIENT_CHUNK 32
+
 void hsv_fill_solid_hsv(hsv_t *target, hsv_t color, size_t num)
 {
     for (size_t i = 0; i < num; ++i)
@@ -753,12 +798,22 @@ void rgb_fill_gradient_hsv(rgb_t *target, size_t startpos, hsv_t startcolor, siz
     accum88 hue88 = startcolor.hue << 8;
     accum88 sat88 = startcolor.sat << 8;
     accum88 val88 = startcolor.val << 8;
-    for (size_t i = startpos; i <= endpos; ++i)
+    // The gradient is converted in chunks with hsv2rgb_rainbow_n()
+    hsv_t chunk[COLOR_GRADIENT_CHUNK];
+    for (size_t i = startpos; i <= endpos;)
     {
-        target[i] = hsv2rgb_rainbow(hsv_from_values(hue88 >> 8, sat88 >> 8, val88 >> 8));
-        hue88 += huedelta87;
-        sat88 += satdelta87;
-        val88 += valdelta87;
+        size_t n = endpos - i + 1;
+        if (n > COLOR_GRADIENT_CHUNK)
+            n = COLOR_GRADIENT_CHUNK;
+        for (size_t j = 0; j < n; ++j)
+        {
+            chunk[j] = hsv_from_values(hue88 >> 8, sat88 >> 8, val88 >> 8);
+            hue88 += huedelta87;
+            sat88 += satdelta87;
+            val88 += valdelta87;
+        }
+        hsv2rgb_rainbow_n(chunk, target + i, n);
+        i += n;
     }
 }
 
@@ -947,6 +1002,34 @@ rgb_t color_from_palette_rgb(const rgb_t *palette, uint8_t pal_size, uint8_t ind
     return rgb_from_values(red1, green1, blue1);
 }
 
+void color_from_palette_rgb_n(const rgb_t *palette, uint8_t pal_size, const uint8_t *indexes, rgb_t *dst, size_t num,
+        uint8_t brightness, bool blend)
+{
+    uint8_t div = 256 / pal_size;
+    // Without blending, f2 is 0 and scale8() by f1 = 255 leaves the first entry as is
+    uint8_t blend_mask = blend ? 0xff : 0;
+    // (c * bscale) >> 8 is scale8(c, brightness + 1) for a brightness below 255, as in
+    // color_from_palette_rgb(), and c for 255
+    uint16_t bscale = brightness == 255 ? 256 : brightness ? brightness + 2 : 0;
+
+    for (size_t i = 0; i < num; ++i)
+    {
+        uint8_t hi = indexes[i] / div;
+        uint8_t lo = indexes[i] % div;
+        const rgb_t *e1 = palette + hi;
+        const rgb_t *e2 = palette + (hi == pal_size - 1 ? 0 : hi + 1);
+
+        uint8_t f2 = (uint8_t)(lo * pal_size) & blend_mask;
+        uint8_t f1 = 255 - f2;
+
+        uint8_t r = scale8(e1->red, f1) + scale8(e2->red, f2);
+        uint8_t g = scale8(e1->green, f1) + scale8(e2->green, f2);
+        uint8_t b = scale8(e1->blue, f1) + scale8(e2->blue, f2);
+
+        dst[i] = rgb_from_values((r * bscale) >> 8, (g * bscale) >> 8, (b * bscale) >> 8);
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 hsv_t blend(hsv_t existing, hsv_t overlay, fract8 amount, color_gradient_direction_t direction)
@@ -995,18 +1078,20 @@ hsv_t blend(hsv_t existing, hsv_t overlay, fract8 amount, color_gradient_directi
 
 void blur1d(rgb_t *leds, size_t num_leds, fract8 blur_amount)
 {
+    if (!num_leds)
+        return;
+
     uint8_t keep = 255 - blur_amount;
     uint8_t seep = blur_amount >> 1;
-    rgb_t carryover = rgb_from_code(0);
-    for (size_t i = 0; i < num_leds; ++i)
+    // The first LED has no left neighbor, it is done before the loop
+    rgb_t carryover = rgb_scale(leds[0], seep);
+    leds[0] = rgb_scale(leds[0], keep);
+    for (size_t i = 1; i < num_leds; ++i)
     {
         rgb_t cur = leds[i];
-        rgb_t part = cur;
-        part = rgb_scale(part, seep);
-        cur = rgb_add_rgb(rgb_scale(cur, keep), carryover);
-        if (i)
-            leds[i - 1] = rgb_add_rgb(leds[i - 1], part);
-        leds[i] = cur;
+        rgb_t part = rgb_scale(cur, seep);
+        leds[i - 1] = rgb_add_rgb(leds[i - 1], part);
+        leds[i] = rgb_add_rgb(rgb_scale(cur, keep), carryover);
         carryover = part;
     }
 }
@@ -1100,3 +1185,28 @@ rgb_t apply_gamma2rgb_channels(rgb_t c, float gamma_r, float gamma_g, float gamm
     };
     return res;
 }
+
+void color_gamma_lut_build(uint8_t *lut, float gamma)
+{
+    for (size_t i = 0; i < COLOR_GAMMA_LUT_SIZE; ++i)
+        lut[i] = apply_gamma2brightness(i, gamma);
+}
+
+void apply_gamma_lut_n(rgb_t *leds, size_t num, const uint8_t *lut)
+{
+    // rgb_t is 3 bytes, the frame is adjusted as a byte array
+    uint8_t *c = (uint8_t *)leds;
+    for (size_t i = 0; i < num * sizeof(rgb_t); ++i)
+        c[i] = lut[c[i]];
+}
+
+void apply_gamma_lut_channels_n(rgb_t *leds, size_t num, const uint8_t *lut_r, const uint8_t *lut_g,
+        const uint8_t *lut_b)
+{
+    for (size_t i = 0; i < num; ++i)
+    {
+        leds[i].r = lut_r[leds[i].r];
+        leds[i].g = lut_g[leds[i].g];
+        leds[i].b = lut_b[leds[i].b];
+    }
+}
@@ -36,6 +36,7 @@
 #define __COLOR_H__
 
 #include <stdint.h>
+#include <stddef.h>
 
 #include "rgb.h"
 #include "hsv.h"
@@ -65,6 +66,19 @@ extern "C" {
  */
 rgb_t hsv2rgb_rainbow(hsv_t hsv);
 
+/**
+ * @brief Convert an array of HSV colors to RGB using balanced rainbow
+ *
+ * Same results as hsv2rgb_rainbow() on each color. The hue sections are
+ * looked up in tables and the saturation and value are applied with the same
+ * multiplies for all colors, so that the loop has no branches.
+ *
+ * @param src HSV colors
+ * @param[out] dst RGB colors, can't overlap `src`
+ * @param num Number of colors
+ */
+void hsv2rgb_rainbow_n(const hsv_t *src, rgb_t *dst, size_t num);
+
 /**
  * @brief Convert HSV to RGB using mathematically straight spectrum
  *
@@ -281,6 +295,14 @@ hsv_t color_from_palette_hsv(const hsv_t *palette, uint8_t pal_size, uint8_t ind
  */
 rgb_t color_from_palette_rgb(const rgb_t *palette, uint8_t pal_size, uint8_t index, uint8_t brightness, bool blend);
 
+/**
+ * Same for an array of indexes, with the same results as
+ * color_from_palette_rgb() on each of them. `blend` and `brightness` are
+ * turned into scale factors once, so that the loop has no branches.
+ */
+void color_from_palette_rgb_n(const rgb_t *palette, uint8_t pal_size, const uint8_t *indexes, rgb_t *dst, size_t num,
+        uint8_t brightness, bool blend);
+
 ////////////////////////////////////////////////////////////////////////////////
 // Filter functions
 
@@ -357,6 +379,44 @@ rgb_t apply_gamma2rgb(rgb_t c, float gamma);
  */
 rgb_t apply_gamma2rgb_channels(rgb_t c, float gamma_r, float gamma_g, float gamma_b);
 
+/**
+ * Size of a gamma lookup table, one entry per channel value
+ */
+#define COLOR_GAMMA_LUT_SIZE 256
+
+/**
+ * @brief Build a gamma lookup table.
+ *
+ * Entry N is apply_gamma2brightness(N, gamma). Build it once for the gamma
+ * in use, the apply_gamma_lut_*() functions then correct a frame without
+ * calling powf().
+ *
+ * @param[out] lut Table of COLOR_GAMMA_LUT_SIZE entries
+ * @param gamma Gamma
+ */
+void color_gamma_lut_build(uint8_t *lut, float gamma);
+
+/**
+ * @brief Single gamma adjustment to each channel of an array of RGB colors.
+ *
+ * @param leds RGB colors, adjusted in place
+ * @param num Number of colors
+ * @param lut Table built by color_gamma_lut_build()
+ */
+void apply_gamma_lut_n(rgb_t *leds, size_t num, const uint8_t *lut);
+
+/**
+ * @brief Different gamma adjustments for each channel of an array of RGB colors.
+ *
+ * @param leds RGB colors, adjusted in place
+ * @param num Number of colors
+ * @param lut_r Table of the red channel, built by color_gamma_lut_build()
+ * @param lut_g Table of the green channel
+ * @param lut_b Table of the blue channel
+ */
+void apply_gamma_lut_channels_n(rgb_t *leds, size_t num, const uint8_t *lut_r, const uint8_t *lut_g,
+        const uint8_t *lut_b);
+
 #ifdef __cplusplus
 }
 #endif
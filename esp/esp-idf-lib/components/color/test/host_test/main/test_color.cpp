@@ -0,0 +1,203 @@
+#define CATCH_CONFIG_MAIN // This tells the catch header to generate a main
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <vector>
+#include "catch.hpp"
+#include "color.h"
+
+using namespace std::chrono;
+
+static constexpr size_t frame_size = 1024;
+
+static std::vector<hsv_t> random_hsv(size_t num)
+{
+    std::vector<hsv_t> colors(num);
+    for (auto &c : colors)
+        c = hsv_from_values(random8(), random8(), random8());
+    return colors;
+}
+
+static std::vector<rgb_t> random_rgb(size_t num)
+{
+    std::vector<rgb_t> colors(num);
+    for (auto &c : colors)
+        c = rgb_from_values(random8(), random8(), random8());
+    return colors;
+}
+
+static bool same(const rgb_t &a, const rgb_t &b)
+{
+    return a.r == b.r && a.g == b.g && a.b == b.b;
+}
+
+// blur1d() as it was before the first LED was moved out of the loop
+static void blur1d_reference(rgb_t *leds, size_t num_leds, fract8 blur_amount)
+{
+    uint8_t keep = 255 - blur_amount;
+    uint8_t seep = blur_amount >> 1;
+    rgb_t carryover = rgb_from_code(0);
+    for (size_t i = 0; i < num_leds; ++i)
+    {
+        rgb_t cur = leds[i];
+        rgb_t part = rgb_scale(cur, seep);
+        cur = rgb_add_rgb(rgb_scale(cur, keep), carryover);
+        if (i)
+            leds[i - 1] = rgb_add_rgb(leds[i - 1], part);
+        leds[i] = cur;
+        carryover = part;
+    }
+}
+
+TEST_CASE("hsv2rgb_rainbow_n matches hsv2rgb_rainbow for every color", "[color]")
+{
+    std::vector<hsv_t> src(256 * 256);
+    std::vector<rgb_t> dst(src.size());
+    size_t mismatches = 0;
+
+    for (unsigned hue = 0; hue < 256; hue++)
+    {
+        for (size_t i = 0; i < src.size(); i++)
+            src[i] = hsv_from_values(hue, i >> 8, i & 0xff);
+        hsv2rgb_rainbow_n(src.data(), dst.data(), src.size());
+        for (size_t i = 0; i < src.size(); i++)
+            mismatches += !same(dst[i], hsv2rgb_rainbow(src[i]));
+    }
+    CHECK(mismatches == 0);
+}
+
+TEST_CASE("rgb_fill_gradient_hsv matches the HSV gradient converted color by color", "[color]")
+{
+    const hsv_t from = hsv_from_values(HUE_RED, 255, 40);
+    const hsv_t to = hsv_from_values(HUE_BLUE, 128, 255);
+
+    for (size_t len : { 1, 2, 31, 32, 33, 100 })
+    {
+        for (auto direction : { COLOR_FORWARD_HUES, COLOR_BACKWARD_HUES, COLOR_SHORTEST_HUES, COLOR_LONGEST_HUES })
+        {
+            std::vector<hsv_t> hsv(len);
+            std::vector<rgb_t> rgb(len);
+            hsv_fill_gradient_hsv(hsv.data(), 0, from, len - 1, to, direction);
+            rgb_fill_gradient_hsv(rgb.data(), 0, from, len - 1, to, direction);
+            for (size_t i = 0; i < len; i++)
+                CHECK(same(rgb[i], hsv2rgb_rainbow(hsv[i])));
+        }
+    }
+}
+
+TEST_CASE("color_from_palette_rgb_n matches color_from_palette_rgb", "[color]")
+{
+    const auto palette = random_rgb(16);
+    uint8_t indexes[256];
+    rgb_t dst[256];
+
+    for (size_t i = 0; i < 256; i++)
+        indexes[i] = i;
+    for (uint8_t pal_size : { 2, 4, 8, 16 })
+    {
+        for (int brightness : { 0, 1, 127, 254, 255 })
+        {
+            for (bool blend : { false, true })
+            {
+                color_from_palette_rgb_n(palette.data(), pal_size, indexes, dst, 256, brightness, blend);
+                for (size_t i = 0; i < 256; i++)
+                    CHECK(same(dst[i], color_from_palette_rgb(palette.data(), pal_size, i, brightness, blend)));
+            }
+        }
+    }
+}
+
+TEST_CASE("Gamma lookup tables match apply_gamma2rgb", "[color]")
+{
+    uint8_t lut_r[COLOR_GAMMA_LUT_SIZE], lut_g[COLOR_GAMMA_LUT_SIZE], lut_b[COLOR_GAMMA_LUT_SIZE];
+    color_gamma_lut_build(lut_r, 2.2f);
+    color_gamma_lut_build(lut_g, 2.0f);
+    color_gamma_lut_build(lut_b, 2.8f);
+    for (unsigned i = 0; i < COLOR_GAMMA_LUT_SIZE; i++)
+        CHECK(lut_r[i] == apply_gamma2brightness(i, 2.2f));
+
+    const auto src = random_rgb(frame_size);
+    auto single = src;
+    auto channels = src;
+    apply_gamma_lut_n(single.data(), single.size(), lut_r);
+    apply_gamma_lut_channels_n(channels.data(), channels.size(), lut_r, lut_g, lut_b);
+    for (size_t i = 0; i < src.size(); i++)
+    {
+        CHECK(same(single[i], apply_gamma2rgb(src[i], 2.2f)));
+        CHECK(same(channels[i], apply_gamma2rgb_channels(src[i], 2.2f, 2.0f, 2.8f)));
+    }
+}
+
+TEST_CASE("blur1d is unchanged", "[color]")
+{
+    for (size_t len : { 0, 1, 2, 60 })
+    {
+        for (int amount : { 0, 64, 172, 255 })
+        {
+            auto leds = random_rgb(len);
+            auto expected = leds;
+            blur1d(leds.data(), len, amount);
+            blur1d_reference(expected.data(), len, amount);
+            for (size_t i = 0; i < len; i++)
+                CHECK(same(leds[i], expected[i]));
+        }
+    }
+}
+
+// Runs the kernel on a frame for about 200 ms, returns the colors per second
+static double pixels_per_second(const std::function<void()> &frame)
+{
+    size_t frames = 0;
+    auto start = steady_clock::now();
+    auto elapsed = steady_clock::duration::zero();
+    do
+    {
+        frame();
+        frames++;
+        elapsed = steady_clock::now() - start;
+    } while (elapsed < milliseconds(200));
+    return frames * frame_size / duration<double>(elapsed).count();
+}
+
+static void report(const char *name, double scalar, double batch)
+{
+    printf("%-24s scalar %8.2f Mpx/s, batch %8.2f Mpx/s, x%.1f\n", name, scalar / 1e6, batch / 1e6, batch / scalar);
+}
+
+TEST_CASE("Batch kernels throughput", "[bench]")
+{
+    const auto hsv = random_hsv(frame_size);
+    const auto palette = random_rgb(16);
+    std::vector<uint8_t> indexes(frame_size);
+    std::vector<rgb_t> rgb(frame_size);
+    for (auto &i : indexes)
+        i = random8();
+
+    double scalar = pixels_per_second([&] {
+        for (size_t i = 0; i < frame_size; i++)
+            rgb[i] = hsv2rgb_rainbow(hsv[i]);
+    });
+    double batch = pixels_per_second([&] { hsv2rgb_rainbow_n(hsv.data(), rgb.data(), frame_size); });
+    report("hsv2rgb_rainbow", scalar, batch);
+
+    scalar = pixels_per_second([&] {
+        for (size_t i = 0; i < frame_size; i++)
+            rgb[i] = color_from_palette_rgb(palette.data(), 16, indexes[i], 200, true);
+    });
+    batch = pixels_per_second([&] {
+        color_from_palette_rgb_n(palette.data(), 16, indexes.data(), rgb.data(), frame_size, 200, true);
+    });
+    report("color_from_palette_rgb", scalar, batch);
+
+    uint8_t lut[COLOR_GAMMA_LUT_SIZE];
+    color_gamma_lut_build(lut, 2.2f);
+    scalar = pixels_per_second([&] {
+        for (size_t i = 0; i < frame_size; i++)
+            rgb[i] = apply_gamma2rgb(rgb[i], 2.2f);
+    });
+    batch = pixels_per_second([&] { apply_gamma_lut_n(rgb.data(), frame_size, lut); });
+    report("apply_gamma2rgb", scalar, batch);
+
+    CHECK(batch > 0);
+}
@@ -45,6 +45,7 @@
 #include <esp_log.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <esp_timer.h>
 #include <esp_idf_lib_helpers.h>
 #include "ds18x20.h"
 
@@ -64,7 +65,13 @@
 #define CHECK(x) do { esp_err_t __; if ((__ = x) != ESP_OK) return __; } while (0)
 #define CHECK_ARG(VAL) do { if (!(VAL)) return ESP_ERR_INVALID_ARG; } while (0)
 
-#if HELPER_TARGET_IS_ESP32
+#ifdef CONFIG_ONEWIRE_RMT
+// The RMT backend sleeps during the transfers and has no strong pull-up to
+// switch on in time
+#define PORT_ENTER_CRITICAL
+#define PORT_EXIT_CRITICAL
+
+#elif HELPER_TARGET_IS_ESP32
 static portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
 #define PORT_ENTER_CRITICAL portENTER_CRITICAL(&mux)
 #define PORT_EXIT_CRITICAL portEXIT_CRITICAL(&mux)
@@ -95,7 +102,7 @@ esp_err_t ds18x20_measure(gpio_num_t pin, onewire_addr_t addr, bool wait)
 
     if (wait)
     {
-        SLEEP_MS(750);
+        SLEEP_MS(DS18X20_CONVERSION_MS);
         onewire_depower(pin);
     }
 
@@ -280,6 +287,86 @@ esp_err_t ds18x20_measure_and_read_multi(gpio_num_t pin, onewire_addr_t *addr_li
     return ds18x20_read_temp_multi(pin, addr_list, addr_count, result_list);
 }
 
+// The bus is read by ds18x20_measure_multi_wait(), not in the esp_timer task
+static void measure_multi_done(void *arg)
+{
+    ds18x20_multi_t *multi = (ds18x20_multi_t *)arg;
+
+    xSemaphoreGive(multi->done);
+}
+
+esp_err_t ds18x20_measure_multi_start(ds18x20_multi_t *multi)
+{
+    CHECK_ARG(multi && multi->addr_list && multi->addr_count && multi->result_list);
+
+    if (multi->busy)
+        return ESP_ERR_INVALID_STATE;
+
+    if (!multi->done)
+    {
+        multi->done = xSemaphoreCreateBinary();
+        if (!multi->done)
+            return ESP_ERR_NO_MEM;
+    }
+    if (!multi->timer)
+    {
+        const esp_timer_create_args_t args = {
+            .callback = measure_multi_done,
+            .arg = multi,
+            .name = "ds18x20",
+        };
+        CHECK(esp_timer_create(&args, &multi->timer));
+    }
+
+    // One broadcast CONVERT_T, all sensors convert at the same time
+    CHECK(ds18x20_measure(multi->pin, DS18X20_ANY, false));
+
+    multi->busy = true;
+    esp_err_t res = esp_timer_start_once(multi->timer,
+            (uint64_t)(multi->conversion_ms ? multi->conversion_ms : DS18X20_CONVERSION_MS) * 1000);
+    if (res != ESP_OK)
+    {
+        multi->busy = false;
+        onewire_depower(multi->pin);
+    }
+    return res;
+}
+
+esp_err_t ds18x20_measure_multi_wait(ds18x20_multi_t *multi, TickType_t timeout)
+{
+    CHECK_ARG(multi);
+
+    if (!multi->busy)
+        return ESP_ERR_INVALID_STATE;
+    if (xSemaphoreTake(multi->done, timeout) != pdTRUE)
+        return ESP_ERR_TIMEOUT;
+
+    onewire_depower(multi->pin);
+    esp_err_t res = ds18x20_read_temp_multi(multi->pin, multi->addr_list, multi->addr_count, multi->result_list);
+    multi->busy = false;
+    return res;
+}
+
+esp_err_t ds18x20_measure_multi_free(ds18x20_multi_t *multi)
+{
+    CHECK_ARG(multi);
+
+    if (multi->busy)
+        return ESP_ERR_INVALID_STATE;
+
+    if (multi->timer)
+    {
+        CHECK(esp_timer_delete(multi->timer));
+        multi->timer = NULL;
+    }
+    if (multi->done)
+    {
+        vSemaphoreDelete(multi->done);
+        multi->done = NULL;
+    }
+    return ESP_OK;
+}
+
 esp_err_t ds18x20_scan_devices(gpio_num_t pin, onewire_addr_t *addr_list, size_t addr_count, size_t *found)
 {
     CHECK_ARG(addr_list && addr_count);
@@ -46,6 +46,9 @@
 #define __DS18X20_H__
 
 #include <esp_err.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include <onewire.h>
 
 #ifdef __cplusplus
@@ -57,6 +60,9 @@ typedef onewire_addr_t ds18x20_addr_t;
 /** An address value which can be used to indicate "any device on the bus" */
 #define DS18X20_ANY ONEWIRE_NONE
 
+/** Maximal time of a 12-bit temperature conversion, ms */
+#define DS18X20_CONVERSION_MS 750
+
 /** Family ID (lower address byte) of sensors */
 typedef enum {
     DS18X20_FAMILY_DS18S20  = 0x10, //!< DS1820/DS18S20  9-bit  +/-0.5°C
@@ -90,7 +96,7 @@ esp_err_t ds18x20_scan_devices(gpio_num_t pin, onewire_addr_t *addr_list, size_t
  * @brief Tell one or more sensors to perform a temperature measurement and
  * conversion (CONVERT_T) operation.
  *
- * This operation can take up to 750ms to complete.
+ * This operation can take up to ::DS18X20_CONVERSION_MS to complete.
  *
  * If `wait=true`, this routine will automatically drive the pin high for the
  * necessary 750ms after issuing the command to ensure parasitically-powered
@@ -257,6 +263,76 @@ esp_err_t max31850_measure_and_read(gpio_num_t pin, onewire_addr_t addr, float *
  */
 esp_err_t ds18x20_measure_and_read_multi(gpio_num_t pin, onewire_addr_t *addr_list, size_t addr_count, float *result_list);
 
+/**
+ * Asynchronous measurement of all sensors on a bus, see
+ * ds18x20_measure_multi_start(). Zero-initialize it before the first use.
+ */
+typedef struct
+{
+    gpio_num_t pin;                 //!< The GPIO pin connected to the DS18x20 bus
+    onewire_addr_t *addr_list;      //!< Addresses of the devices to read
+    size_t addr_count;              //!< Number of entries in `addr_list`
+    float *result_list;             //!< Temperatures, at least `addr_count` entries
+    uint32_t conversion_ms;         //!< Conversion time, ms, 0 for ::DS18X20_CONVERSION_MS
+
+    esp_timer_handle_t timer;       //!< Internal, set to NULL before the first use
+    SemaphoreHandle_t done;         //!< Internal, set to NULL before the first use
+    volatile bool busy;             //!< A measurement is running
+} ds18x20_multi_t;
+
+/**
+ * @brief Start a measurement of all the sensors on the bus and return
+ *        immediately.
+ *
+ * A single CONVERT_T is broadcast with Skip ROM, so all the sensors convert
+ * at the same time. After `conversion_ms` a one-shot esp_timer signals the
+ * end of the conversion; the temperatures are then read by
+ * ds18x20_measure_multi_wait(), in the context of the calling task. The
+ * caller is free to do something else in the meantime.
+ *
+ * `conversion_ms` can be lowered for DS18B20 sensors configured for a lower
+ * resolution (94 ms at 9 bits).
+ *
+ * The bus must not be used by anyone else until ds18x20_measure_multi_wait()
+ * returns the temperatures. Parasite powered devices are powered for (at
+ * least) the conversion time as with ds18x20_measure().
+ *
+ * @param multi  Measurement, must stay valid until it is finished
+ *
+ * @returns `ESP_OK` if the measurement was started,
+ *          `ESP_ERR_INVALID_STATE` if the previous one is not finished yet
+ */
+esp_err_t ds18x20_measure_multi_start(ds18x20_multi_t *multi);
+
+/**
+ * @brief Wait for the end of a measurement started with
+ *        ds18x20_measure_multi_start() and read the temperatures.
+ *
+ * The scratchpads (CRC checked) of the devices in `addr_list` are read into
+ * `result_list`, which takes about 10 ms per device. With
+ * `CONFIG_ONEWIRE_RMT` the task sleeps during the transfers.
+ *
+ * @param multi    Measurement
+ * @param timeout  Maximum time to wait for the end of the conversion, ticks.
+ *                 0 to check whether it is over.
+ *
+ * @returns Result of ds18x20_read_temp_multi(),
+ *          `ESP_ERR_TIMEOUT` if the conversion is not over yet (the
+ *          measurement keeps running, wait again),
+ *          `ESP_ERR_INVALID_STATE` if no measurement was started
+ */
+esp_err_t ds18x20_measure_multi_wait(ds18x20_multi_t *multi, TickType_t timeout);
+
+/**
+ * @brief Free the timer of a measurement started with
+ *        ds18x20_measure_multi_start().
+ *
+ * @param multi  Measurement, must not be running
+ *
+ * @returns `ESP_OK` on success
+ */
+esp_err_t ds18x20_measure_multi_free(ds18x20_multi_t *multi);
+
 /**
  * @brief Read the scratchpad data for a particular ds18x20 device.
  *
@@ -39,6 +39,10 @@
 #include <string.h>
 #include <freertos/semphr.h>
 #include <esp_timer.h>
+#if CONFIG_RE_INTERRUPT
+#include <esp_attr.h>
+#include <freertos/task.h>
+#endif
 
 #define MUTEX_TIMEOUT 10
 
@@ -48,7 +52,7 @@
 #define BTN_PRESSED_LEVEL 1
 #endif
 
-#if defined(CONFIG_IDF_TARGET_ESP8266) && CONFIG_RE_INTERVAL_US < 10000
+#if defined(CONFIG_IDF_TARGET_ESP8266) && !CONFIG_RE_INTERRUPT && CONFIG_RE_INTERVAL_US < 10000
 #error Too small CONFIG_RE_INTERVAL_US! For ESP8266 it should be >= 10000
 #endif
 
@@ -62,10 +66,235 @@ static QueueHandle_t _queue;
 #define CHECK(x) do { esp_err_t __; if ((__ = x) != ESP_OK) return __; } while (0)
 #define CHECK_ARG(VAL) do { if (!(VAL)) return ESP_ERR_INVALID_ARG; } while (0)
 
+// Quadrature decoding of a new sample of the A (bit 0) and B (bit 1) levels
+static void decode(rotary_encoder_t *re, uint8_t levels, int64_t time_us)
+{
+    rotary_encoder_event_t ev = {
+        .sender = re,
+        .time_us = time_us
+    };
+
+    re->code <<= 2;
+    re->code |= levels & 3;
+    re->code &= 0xf;
+
+    if (!valid_states[re->code])
+        return;
+
+    int8_t inc = 0;
+
+    re->store = (re->store << 4) | re->code;
+
+    if ((re->store == 0xe817)||(re->store == 0x17e8)) inc = 1;
+    if ((re->store == 0xd42b)||(re->store == 0x2bd4)) inc = -1;
+
+    if (inc)
+    {
+        ev.diff = inc;
+        if (re->acceleration.coeff > 1)
+        {        
+            // at 200 ms, we want to have minimum acceleration
+            uint32_t accelerationMinCutoffMillis = CONFIG_RE_ACCELERATION_MIN_CUTOFF;
+            // at 4 ms, we want to have maximum acceleration
+            uint32_t accelerationMaxCutoffMillis = CONFIG_RE_ACCELERATION_MAX_CUTOFF;
+            uint32_t millisAfterLastMotion = (time_us - re->acceleration.last_time) / 1000u;
+            re->acceleration.last_time = time_us;
+
+            if (millisAfterLastMotion < accelerationMinCutoffMillis)
+            {
+                if (millisAfterLastMotion < accelerationMaxCutoffMillis)
+                {
+                    millisAfterLastMotion = accelerationMaxCutoffMillis; // limit to maximum acceleration
+                }
+                ev.diff = inc * ((int32_t)(re->acceleration.coeff / millisAfterLastMotion) == 0 ? 1 : (int32_t)(re->acceleration.coeff / millisAfterLastMotion));
+            }
+        }
+
+        ev.type = RE_ET_CHANGED;
+        xQueueSendToBack(_queue, &ev, 0);
+    }
+}
+
+#if CONFIG_RE_INTERRUPT
+
+#define EDGE_QUEUE_LEN (CONFIG_RE_MAX * 16)
+#define NO_DEADLINE INT64_MAX
+#define EDGE_BTN BIT(2)
+
+typedef struct
+{
+    rotary_encoder_t *re;
+    uint8_t levels;   // A, B and pressed button bits
+    int64_t time_us;
+} edge_t;
+
+static QueueHandle_t edges;
+static TaskHandle_t task;
+
+static void IRAM_ATTR isr_handler(void *arg)
+{
+    rotary_encoder_t *re = (rotary_encoder_t *)arg;
+    edge_t edge = {
+        .re = re,
+        .levels = gpio_get_level(re->pin_a) | (gpio_get_level(re->pin_b) << 1),
+        .time_us = esp_timer_get_time(),
+    };
+    if (re->pin_btn < GPIO_NUM_MAX && gpio_get_level(re->pin_btn) == BTN_PRESSED_LEVEL)
+        edge.levels |= EDGE_BTN;
+    BaseType_t woken = pdFALSE;
+
+    xQueueSendFromISR(edges, &edge, &woken);
+    if (woken)
+        portYIELD_FROM_ISR();
+}
+
+static void set_btn_pressed(rotary_encoder_t *re, bool pressed, int64_t time_us)
+{
+    rotary_encoder_event_t ev = {
+        .sender = re,
+        .time_us = time_us
+    };
+
+    if (pressed && re->btn_state == RE_BTN_RELEASED)
+    {
+        re->btn_state = RE_BTN_PRESSED;
+        re->btn_pressed_at_us = time_us;
+        ev.type = RE_ET_BTN_PRESSED;
+        xQueueSendToBack(_queue, &ev, 0);
+    }
+    else if (!pressed && re->btn_state != RE_BTN_RELEASED)
+    {
+        bool clicked = re->btn_state == RE_BTN_PRESSED;
+        re->btn_state = RE_BTN_RELEASED;
+        ev.type = RE_ET_BTN_RELEASED;
+        xQueueSendToBack(_queue, &ev, 0);
+        if (clicked)
+        {
+            ev.type = RE_ET_BTN_CLICKED;
+            xQueueSendToBack(_queue, &ev, 0);
+        }
+    }
+    else
+        return;
+
+    // edges until then are contact bounce
+    re->btn_settle_us = time_us + CONFIG_RE_BTN_DEAD_TIME_US;
+}
+
+static void handle_btn_timeouts(rotary_encoder_t *re, int64_t now)
+{
+    if (re->btn_settle_us && now >= re->btn_settle_us)
+    {
+        // the level may have changed during the dead time
+        re->btn_settle_us = 0;
+        set_btn_pressed(re, gpio_get_level(re->pin_btn) == BTN_PRESSED_LEVEL, now);
+    }
+    if (re->btn_state == RE_BTN_PRESSED && now >= re->btn_pressed_at_us + CONFIG_RE_BTN_LONG_PRESS_TIME_US)
+    {
+        re->btn_state = RE_BTN_LONG_PRESSED;
+        rotary_encoder_event_t ev = {
+            .type = RE_ET_BTN_LONG_PRESSED,
+            .sender = re,
+            .time_us = now
+        };
+        xQueueSendToBack(_queue, &ev, 0);
+    }
+}
+
+static int64_t next_btn_deadline(const rotary_encoder_t *re)
+{
+    int64_t deadline = re->btn_settle_us ? re->btn_settle_us : NO_DEADLINE;
+
+    if (re->btn_state == RE_BTN_PRESSED && re->btn_pressed_at_us + CONFIG_RE_BTN_LONG_PRESS_TIME_US < deadline)
+        deadline = re->btn_pressed_at_us + CONFIG_RE_BTN_LONG_PRESS_TIME_US;
+    return deadline;
+}
+
+static void handle_edge(const edge_t *edge)
+{
+    rotary_encoder_t *re = edge->re;
+
+    decode(re, edge->levels, edge->time_us);
+    if (re->pin_btn < GPIO_NUM_MAX && edge->time_us >= re->btn_settle_us)
+        set_btn_pressed(re, edge->levels & EDGE_BTN, edge->time_us);
+}
+
+static void encoder_task(void *arg)
+{
+    edge_t edge;
+
+    while (1)
+    {
+        int64_t now = esp_timer_get_time();
+        int64_t deadline = NO_DEADLINE;
+
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        for (size_t i = 0; i < CONFIG_RE_MAX; i++)
+        {
+            if (!encs[i] || encs[i]->pin_btn >= GPIO_NUM_MAX)
+                continue;
+            handle_btn_timeouts(encs[i], now);
+            int64_t next = next_btn_deadline(encs[i]);
+            if (next < deadline)
+                deadline = next;
+        }
+        xSemaphoreGive(mutex);
+
+        // sleep until the next edge unless a button is held
+        TickType_t ticks = portMAX_DELAY;
+        if (deadline != NO_DEADLINE)
+        {
+            const int64_t tick_us = portTICK_PERIOD_MS * 1000;
+            ticks = deadline > now ? (deadline - now + tick_us - 1) / tick_us : 0;
+        }
+        if (xQueueReceive(edges, &edge, ticks) != pdTRUE || !edge.re)
+            continue;
+
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        if (encs[edge.re->index] == edge.re)
+            handle_edge(&edge);
+        xSemaphoreGive(mutex);
+    }
+}
+
+static esp_err_t add_isr_handlers(rotary_encoder_t *re)
+{
+    esp_err_t res = gpio_install_isr_service(0);
+    // already installed by the application
+    if (res != ESP_OK && res != ESP_ERR_INVALID_STATE)
+        return res;
+
+    CHECK(gpio_isr_handler_add(re->pin_a, isr_handler, re));
+    CHECK(gpio_isr_handler_add(re->pin_b, isr_handler, re));
+    if (re->pin_btn < GPIO_NUM_MAX)
+        CHECK(gpio_isr_handler_add(re->pin_btn, isr_handler, re));
+
+    // the first edge is decoded from the resting levels
+    re->code = gpio_get_level(re->pin_a) | (gpio_get_level(re->pin_b) << 1);
+    // an empty edge wakes the task up to check the initial button level
+    re->btn_settle_us = esp_timer_get_time();
+    edge_t wakeup = { .re = NULL };
+    xQueueSendToBack(edges, &wakeup, 0);
+
+    return ESP_OK;
+}
+
+static void remove_isr_handlers(rotary_encoder_t *re)
+{
+    gpio_isr_handler_remove(re->pin_a);
+    gpio_isr_handler_remove(re->pin_b);
+    if (re->pin_btn < GPIO_NUM_MAX)
+        gpio_isr_handler_remove(re->pin_btn);
+}
+
+#else
+
 inline static void read_encoder(rotary_encoder_t *re)
 {
+    int64_t now = esp_timer_get_time();
     rotary_encoder_event_t ev = {
-        .sender = re
+        .sender = re,
+        .time_us = now
     };
 
     if (re->pin_btn < GPIO_NUM_MAX)
@@ -116,47 +345,7 @@ inline static void read_encoder(rotary_encoder_t *re)
         }
     } while(0);
 
-    re->code <<= 2;
-    re->code |= gpio_get_level(re->pin_a);
-    re->code |= gpio_get_level(re->pin_b) << 1;
-    re->code &= 0xf;
-
-    if (!valid_states[re->code])
-        return;
-
-    int8_t inc = 0;
-
-    re->store = (re->store << 4) | re->code;
-
-    if ((re->store == 0xe817)||(re->store == 0x17e8)) inc = 1;
-    if ((re->store == 0xd42b)||(re->store == 0x2bd4)) inc = -1;
-
-    if (inc)
-    {
-        ev.diff = inc;
-        if (re->acceleration.coeff > 1)
-        {        
-            int64_t nowMicros = esp_timer_get_time();
-            // at 200 ms, we want to have minimum acceleration
-            uint32_t accelerationMinCutoffMillis = CONFIG_RE_ACCELERATION_MIN_CUTOFF;
-            // at 4 ms, we want to have maximum acceleration
-            uint32_t accelerationMaxCutoffMillis = CONFIG_RE_ACCELERATION_MAX_CUTOFF;
-            uint32_t millisAfterLastMotion = (nowMicros - re->acceleration.last_time) / 1000u;
-            re->acceleration.last_time = nowMicros;
-
-            if (millisAfterLastMotion < accelerationMinCutoffMillis)
-            {
-                if (millisAfterLastMotion < accelerationMaxCutoffMillis)
-                {
-                    millisAfterLastMotion = accelerationMaxCutoffMillis; // limit to maximum acceleration
-                }
-                ev.diff = inc * ((int32_t)(re->acceleration.coeff / millisAfterLastMotion) == 0 ? 1 : (int32_t)(re->acceleration.coeff / millisAfterLastMotion));
-            }
-        }
-
-        ev.type = RE_ET_CHANGED;
-        xQueueSendToBack(_queue, &ev, 0);
-    }
+    decode(re, gpio_get_level(re->pin_a) | (gpio_get_level(re->pin_b) << 1), now);
 }
 
 static void timer_handler(void *arg)
@@ -180,6 +369,8 @@ static const esp_timer_create_args_t timer_args = {
 
 static esp_timer_handle_t timer;
 
+#endif
+
 esp_err_t rotary_encoder_init(QueueHandle_t queue)
 {
     CHECK_ARG(queue);
@@ -192,10 +383,26 @@ esp_err_t rotary_encoder_init(QueueHandle_t queue)
         return ESP_ERR_NO_MEM;
     }
 
+#if CONFIG_RE_INTERRUPT
+    edges = xQueueCreate(EDGE_QUEUE_LEN, sizeof(edge_t));
+    if (!edges)
+    {
+        ESP_LOGE(TAG, "Failed to create edge queue");
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreate(encoder_task, "encoder", CONFIG_RE_TASK_STACK_SIZE, NULL, CONFIG_RE_TASK_PRIORITY, &task) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed to create task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Initialization complete, interrupt driven");
+#else
     CHECK(esp_timer_create(&timer_args, &timer));
     CHECK(esp_timer_start_periodic(timer, CONFIG_RE_INTERVAL_US));
 
     ESP_LOGI(TAG, "Initialization complete, timer interval: %dms", CONFIG_RE_INTERVAL_US / 1000);
+#endif
     return ESP_OK;
 }
 
@@ -235,7 +442,11 @@ esp_err_t rotary_encoder_add(rotary_encoder_t *re)
         io_conf.pull_up_en = GPIO_PULLUP_DISABLE;
         io_conf.pull_down_en = GPIO_PULLDOWN_ENABLE;
     }
+#if CONFIG_RE_INTERRUPT
+    io_conf.intr_type = GPIO_INTR_ANYEDGE;
+#else
     io_conf.intr_type = GPIO_INTR_DISABLE;
+#endif
     io_conf.pin_bit_mask = GPIO_BIT(re->pin_a) | GPIO_BIT(re->pin_b);
     if (re->pin_btn < GPIO_NUM_MAX)
         io_conf.pin_bit_mask |= GPIO_BIT(re->pin_btn);
@@ -243,10 +454,23 @@ esp_err_t rotary_encoder_add(rotary_encoder_t *re)
 
     re->btn_state = RE_BTN_RELEASED;
     re->btn_pressed_time_us = 0;
+    re->btn_settle_us = 0;
+
+#if CONFIG_RE_INTERRUPT
+    esp_err_t res = add_isr_handlers(re);
+    if (res != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to add interrupt handlers: %d", res);
+        remove_isr_handlers(re);
+        encs[re->index] = NULL;
+        xSemaphoreGive(mutex);
+        return res;
+    }
+#endif
 
     xSemaphoreGive(mutex);
 
-    ESP_LOGI(TAG, "Added rotary encoder %d, A: %d, B: %d, BTN: %d", re->index, re->pin_a, re->pin_b, re->pin_btn);
+    ESP_LOGI(TAG, "Added rotary encoder %u, A: %d, B: %d, BTN: %d", (unsigned)re->index, re->pin_a, re->pin_b, re->pin_btn);
     return ESP_OK;
 }
 
@@ -262,8 +486,11 @@ esp_err_t rotary_encoder_remove(rotary_encoder_t *re)
     for (size_t i = 0; i < CONFIG_RE_MAX; i++)
         if (encs[i] == re)
         {
+#if CONFIG_RE_INTERRUPT
+            remove_isr_handlers(re);
+#endif
             encs[i] = NULL;
-            ESP_LOGI(TAG, "Removed rotary encoder %d", i);
+            ESP_LOGI(TAG, "Removed rotary encoder %u", (unsigned)i);
             xSemaphoreGive(mutex);
             return ESP_OK;
         }
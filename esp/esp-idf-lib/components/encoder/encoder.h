@@ -32,6 +32,9 @@
  *
  * ESP-IDF HW timer-based driver for rotary encoders
  *
+ * With CONFIG_RE_INTERRUPT, the encoders are read on GPIO interrupts instead,
+ * and nothing runs while they are idle.
+ *
  * Copyright (c) 2019 Ruslan V. Uss <unclerus@gmail.com>
  *
  * BSD Licensed as described in the file LICENSE
@@ -72,6 +75,8 @@ typedef struct
     uint16_t store;
     size_t index;
     uint64_t btn_pressed_time_us;
+    int64_t btn_pressed_at_us;
+    int64_t btn_settle_us;
     rotary_encoder_btn_state_t btn_state;
     rotary_encoder_acceleration_t acceleration;
 } rotary_encoder_t;
@@ -95,6 +100,7 @@ typedef struct
     rotary_encoder_event_type_t type;  //!< Event type
     rotary_encoder_t *sender;          //!< Pointer to descriptor
     int32_t diff;                      //!< Difference between new and old positions (only if type == RE_ET_CHANGED)
+    int64_t time_us;                   //!< Time of the event since boot, us
 } rotary_encoder_event_t;
 
 /**
@@ -0,0 +1,26 @@
+/*
+ * encoder.c is built here, so that the test can run the steps of the
+ * encoder task on synthetic edges without the task and the GPIO interrupts.
+ */
+#include "encoder.c"
+#include "encoder_hooks.h"
+
+void encoder_hook_edge(rotary_encoder_t *re, int a, int b, bool btn_pressed, int64_t time_us)
+{
+    edge_t edge = {
+        .re = re,
+        .levels = (a ? BIT(0) : 0) | (b ? BIT(1) : 0) | (btn_pressed ? EDGE_BTN : 0),
+        .time_us = time_us,
+    };
+    handle_edge(&edge);
+}
+
+void encoder_hook_btn_timeouts(rotary_encoder_t *re, int64_t now)
+{
+    handle_btn_timeouts(re, now);
+}
+
+int64_t encoder_hook_btn_deadline(const rotary_encoder_t *re)
+{
+    return next_btn_deadline(re);
+}
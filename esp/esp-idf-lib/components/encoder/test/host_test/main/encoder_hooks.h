@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "encoder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// An edge timestamped by the GPIO interrupt with the levels of A, B and the button, as received by the task
+void encoder_hook_edge(rotary_encoder_t *re, int a, int b, bool btn_pressed, int64_t time_us);
+
+// The button dead time and long press timeouts due at `now`
+void encoder_hook_btn_timeouts(rotary_encoder_t *re, int64_t now);
+
+// When the task wakes up next without an edge, INT64_MAX if it sleeps until one
+int64_t encoder_hook_btn_deadline(const rotary_encoder_t *re);
+
+#ifdef __cplusplus
+}
+#endif
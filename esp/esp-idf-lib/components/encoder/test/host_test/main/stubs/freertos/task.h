@@ -0,0 +1,17 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct task *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *arg);
+
+BaseType_t xTaskCreate(TaskFunction_t func, const char *name, uint32_t stack_size, void *arg, UBaseType_t priority,
+                       TaskHandle_t *task);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,275 @@
+#define CATCH_CONFIG_MAIN // This tells the catch header to generate a main
+#include <map>
+#include <vector>
+#include "catch.hpp"
+#include "encoder_hooks.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+static constexpr int64_t ms = 1000;
+static constexpr int64_t dead_time = 10 * ms;
+
+/**
+ * Simulated hardware and task: the pin levels, the time of the edges and
+ * the events sent to the application queue.
+ */
+static std::map<int, int> levels;
+static int64_t now;
+static std::vector<rotary_encoder_event_t> events;
+static int queue, edge_queue, mutex;
+
+extern "C" {
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    return levels[gpio_num];
+}
+
+esp_err_t gpio_config(const gpio_config_t *) { return ESP_OK; }
+esp_err_t gpio_install_isr_service(int) { return ESP_OK; }
+esp_err_t gpio_isr_handler_add(gpio_num_t, gpio_isr_t, void *) { return ESP_OK; }
+esp_err_t gpio_isr_handler_remove(gpio_num_t) { return ESP_OK; }
+
+int64_t esp_timer_get_time(void)
+{
+    return now;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t, UBaseType_t) { return (QueueHandle_t)&edge_queue; }
+void vQueueDelete(QueueHandle_t) {}
+BaseType_t xQueueSendFromISR(QueueHandle_t, const void *, BaseType_t *) { return pdTRUE; }
+BaseType_t xQueueReceive(QueueHandle_t, void *, TickType_t) { return pdFALSE; }
+
+BaseType_t xQueueSendToBack(QueueHandle_t q, const void *item, TickType_t)
+{
+    // the wakeup edges to the task are dropped, it is not started
+    if (q == (QueueHandle_t)&queue)
+        events.push_back(*(const rotary_encoder_event_t *)item);
+    return pdTRUE;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) { return (SemaphoreHandle_t)&mutex; }
+BaseType_t xSemaphoreTake(SemaphoreHandle_t, TickType_t) { return pdTRUE; }
+BaseType_t xSemaphoreGive(SemaphoreHandle_t) { return pdTRUE; }
+
+BaseType_t xTaskCreate(TaskFunction_t, const char *, uint32_t, void *, UBaseType_t, TaskHandle_t *task)
+{
+    *task = (TaskHandle_t)&levels;
+    return pdPASS;
+}
+
+}
+
+struct Encoder {
+    rotary_encoder_t re = {};
+    int a = 1, b = 1;
+    bool pressed = false;
+};
+
+// Runs the button timeouts the task wakes up for until `time_us`
+static void run_until(Encoder &enc, int64_t time_us)
+{
+    for (int64_t deadline = encoder_hook_btn_deadline(&enc.re); deadline <= time_us;
+         deadline = encoder_hook_btn_deadline(&enc.re)) {
+        now = deadline;
+        encoder_hook_btn_timeouts(&enc.re, now);
+    }
+    now = time_us;
+}
+
+// Sets the pin levels at `time_us` and passes the edge to the task
+static void edge(Encoder &enc, int a, int b, bool pressed, int64_t time_us)
+{
+    run_until(enc, time_us);
+    enc.a = a;
+    enc.b = b;
+    enc.pressed = pressed;
+    levels[enc.re.pin_a] = a;
+    levels[enc.re.pin_b] = b;
+    if (enc.re.pin_btn < GPIO_NUM_MAX)
+        levels[enc.re.pin_btn] = !pressed;
+    encoder_hook_edge(&enc.re, a, b, pressed, time_us);
+}
+
+static void ab(Encoder &enc, int a, int b, int64_t time_us)
+{
+    edge(enc, a, b, enc.pressed, time_us);
+}
+
+static void btn(Encoder &enc, bool pressed, int64_t time_us)
+{
+    edge(enc, enc.a, enc.b, pressed, time_us);
+}
+
+// One detent (half a quadrature cycle) from rest at A = B, 1 ms between the edges
+static void turn(Encoder &enc, bool cw, int64_t time_us)
+{
+    // CW is 11 -> 01 -> 00 -> 10 -> 11 (B, A)
+    int level = enc.a;
+    if (cw == (level == 1))
+        ab(enc, 0, 1, time_us);
+    else
+        ab(enc, 1, 0, time_us);
+    ab(enc, !level, !level, time_us + ms);
+}
+
+// Adds the encoder at rest with the button released at time 0
+static void start(Encoder &enc, bool with_button)
+{
+    enc = {};
+    enc.re.pin_a = (gpio_num_t)1;
+    enc.re.pin_b = (gpio_num_t)2;
+    enc.re.pin_btn = with_button ? (gpio_num_t)3 : GPIO_NUM_MAX;
+    levels[1] = levels[2] = levels[3] = 1;
+    events.clear();
+    now = 0;
+    REQUIRE(rotary_encoder_init((QueueHandle_t)&queue) == ESP_OK);
+    REQUIRE(rotary_encoder_add(&enc.re) == ESP_OK);
+    run_until(enc, 0);
+    REQUIRE(events.empty());
+    REQUIRE(encoder_hook_btn_deadline(&enc.re) == INT64_MAX);
+}
+
+static bool happened(const std::vector<rotary_encoder_event_t> &expected)
+{
+    if (events.size() != expected.size())
+        return false;
+    for (size_t i = 0; i < expected.size(); i++)
+        if (events[i].type != expected[i].type || events[i].time_us != expected[i].time_us
+            || (events[i].type == RE_ET_CHANGED && events[i].diff != expected[i].diff))
+            return false;
+    return true;
+}
+
+static rotary_encoder_event_t changed(int32_t diff, int64_t time_us)
+{
+    return { RE_ET_CHANGED, nullptr, diff, time_us };
+}
+
+static rotary_encoder_event_t button(rotary_encoder_event_type_t type, int64_t time_us)
+{
+    return { type, nullptr, 0, time_us };
+}
+
+TEST_CASE("Quadrature decoding", "[encoder]")
+{
+    Encoder enc;
+    start(enc, false);
+
+    // a detent is counted when the last four transitions go one way: from the second one on
+    turn(enc, true, 100 * ms);
+    CHECK(events.empty());
+    turn(enc, true, 200 * ms);
+    turn(enc, true, 300 * ms);
+    CHECK(happened({ changed(1, 201 * ms), changed(1, 301 * ms) }));
+
+    // the same after a reversal
+    events.clear();
+    turn(enc, false, 400 * ms);
+    turn(enc, false, 500 * ms);
+    turn(enc, false, 600 * ms);
+    CHECK(happened({ changed(-1, 501 * ms), changed(-1, 601 * ms) }));
+
+    // contact bounce loses the detent, it is never counted the wrong way
+    events.clear();
+    ab(enc, 1, 0, 700 * ms);
+    ab(enc, 1, 1, 700 * ms + 50);
+    ab(enc, 1, 0, 700 * ms + 100);
+    ab(enc, 0, 0, 701 * ms);
+    CHECK(events.empty());
+    turn(enc, false, 800 * ms);
+    CHECK(happened({ changed(-1, 801 * ms) }));
+
+    // a lost edge (both levels changed) is skipped
+    events.clear();
+    ab(enc, 1, 1, 900 * ms);
+    turn(enc, false, 1000 * ms);
+    CHECK(happened({ changed(-1, 1001 * ms) }));
+
+    // half a detent and back is not counted, nor the next detent
+    events.clear();
+    ab(enc, 1, 0, 1100 * ms);
+    ab(enc, 0, 0, 1101 * ms);
+    turn(enc, true, 1200 * ms);
+    CHECK(events.empty());
+    turn(enc, true, 1300 * ms);
+    CHECK(happened({ changed(1, 1301 * ms) }));
+
+    // button edges are ignored without a button
+    events.clear();
+    btn(enc, true, 1400 * ms);
+    CHECK(events.empty());
+    CHECK(encoder_hook_btn_deadline(&enc.re) == INT64_MAX);
+
+    CHECK(rotary_encoder_remove(&enc.re) == ESP_OK);
+}
+
+TEST_CASE("Acceleration", "[encoder]")
+{
+    Encoder enc;
+    start(enc, false);
+    CHECK(rotary_encoder_enable_acceleration(&enc.re, 100) == ESP_OK);
+
+    // slower than the minimum cutoff: one step, then coeff / ms since the last detent, limited at the maximum cutoff
+    turn(enc, true, 1000 * ms);
+    turn(enc, true, 1010 * ms);
+    turn(enc, true, 1020 * ms);
+    turn(enc, true, 1022 * ms);
+    CHECK(happened({ changed(1, 1011 * ms), changed(10, 1021 * ms), changed(25, 1023 * ms) }));
+
+    CHECK(rotary_encoder_disable_acceleration(&enc.re) == ESP_OK);
+    events.clear();
+    turn(enc, true, 1024 * ms);
+    CHECK(happened({ changed(1, 1025 * ms) }));
+
+    CHECK(rotary_encoder_remove(&enc.re) == ESP_OK);
+}
+
+TEST_CASE("Button", "[encoder]")
+{
+    Encoder enc;
+    start(enc, true);
+
+    // contact bounce inside the dead time is ignored
+    btn(enc, true, 100 * ms);
+    btn(enc, false, 102 * ms);
+    btn(enc, true, 105 * ms);
+    CHECK(encoder_hook_btn_deadline(&enc.re) == 100 * ms + dead_time);
+    run_until(enc, 200 * ms);
+    CHECK(happened({ button(RE_ET_BTN_PRESSED, 100 * ms) }));
+
+    // released during the dead time: caught when it ends
+    events.clear();
+    btn(enc, false, 300 * ms);
+    btn(enc, true, 301 * ms);
+    btn(enc, false, 305 * ms);
+    run_until(enc, 400 * ms);
+    CHECK(happened({ button(RE_ET_BTN_RELEASED, 300 * ms), button(RE_ET_BTN_CLICKED, 300 * ms) }));
+
+    events.clear();
+    btn(enc, true, 500 * ms);
+    btn(enc, false, 508 * ms);
+    run_until(enc, 600 * ms);
+    CHECK(happened({ button(RE_ET_BTN_PRESSED, 500 * ms), button(RE_ET_BTN_RELEASED, 510 * ms),
+                     button(RE_ET_BTN_CLICKED, 510 * ms) }));
+
+    // turning while pressed is not a click, holding it is a long press
+    events.clear();
+    btn(enc, true, 1000 * ms);
+    turn(enc, true, 1100 * ms);
+    turn(enc, true, 1200 * ms);
+    CHECK(encoder_hook_btn_deadline(&enc.re) == 1500 * ms);
+    run_until(enc, 1500 * ms);
+    CHECK(happened({ button(RE_ET_BTN_PRESSED, 1000 * ms), changed(1, 1201 * ms),
+                     button(RE_ET_BTN_LONG_PRESSED, 1500 * ms) }));
+    CHECK(encoder_hook_btn_deadline(&enc.re) == INT64_MAX);
+
+    // the release after a long press is not a click
+    btn(enc, false, 2000 * ms);
+    run_until(enc, 3000 * ms);
+    CHECK(happened({ button(RE_ET_BTN_PRESSED, 1000 * ms), changed(1, 1201 * ms),
+                     button(RE_ET_BTN_LONG_PRESSED, 1500 * ms), button(RE_ET_BTN_RELEASED, 2000 * ms) }));
+
+    CHECK(rotary_encoder_remove(&enc.re) == ESP_OK);
+}
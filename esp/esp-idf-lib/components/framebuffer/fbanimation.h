@@ -70,6 +70,9 @@ esp_err_t fb_animation_init(fb_animation_t *animation, framebuffer_t *fb);
 /**
  * @brief Play animation
  *
+ * The frame is drawn on each tick. Unless the framebuffer is in
+ * ::FB_REFRESH_FULL mode, it is only rendered when it changed.
+ *
  * @param animation     Animation descriptor
  * @param fps           Target FPS
  * @param draw          Function for drawing on a framebuffer
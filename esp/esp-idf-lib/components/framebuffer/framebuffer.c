@@ -31,6 +31,7 @@
  * MIT Licensed as described in the file LICENSE
  */
 #include <stdlib.h>
+#include <string.h>
 #include "framebuffer.h"
 
 #define CHECK_ARG(VAL) do { if (!(VAL)) return ESP_ERR_INVALID_ARG; } while (0)
@@ -42,6 +43,64 @@ static size_t xy(void *ctx, size_t x, size_t y)
     return y * fb->width + x;
 }
 
+static inline bool same_color(rgb_t a, rgb_t b)
+{
+    return a.r == b.r && a.g == b.g && a.b == b.b;
+}
+
+static void clear_dirty(framebuffer_t *fb)
+{
+    for (size_t y = 0; y < fb->height; y++)
+    {
+        fb->dirty[y].x0 = fb->width;
+        fb->dirty[y].x1 = 0;
+    }
+    fb->dirty_rows = 0;
+}
+
+static void mark_all(framebuffer_t *fb)
+{
+    for (size_t y = 0; y < fb->height; y++)
+    {
+        fb->dirty[y].x0 = 0;
+        fb->dirty[y].x1 = fb->width;
+    }
+    fb->dirty_rows = fb->height;
+}
+
+// Adds the non-empty columns [x0, x1) of row y to the rendered ones
+static void mark_span(framebuffer_t *fb, size_t y, size_t x0, size_t x1)
+{
+    fb_span_t *span = &fb->dirty[y];
+
+    if (span->x0 >= span->x1)
+        fb->dirty_rows++;
+    if (x0 < span->x0)
+        span->x0 = x0;
+    if (x1 > span->x1)
+        span->x1 = x1;
+}
+
+// Spans of the pixels that differ from the last rendered frame
+static void diff_frame(framebuffer_t *fb)
+{
+    clear_dirty(fb);
+    for (size_t y = 0; y < fb->height; y++)
+    {
+        const rgb_t *row = fb->data + y * fb->width;
+        const rgb_t *shown = fb->shown + y * fb->width;
+        if (!memcmp(row, shown, fb->width * sizeof(rgb_t)))
+            continue;
+
+        size_t x0 = 0, x1 = fb->width;
+        while (same_color(row[x0], shown[x0]))
+            x0++;
+        while (same_color(row[x1 - 1], shown[x1 - 1]))
+            x1--;
+        mark_span(fb, y, x0, x1);
+    }
+}
+
 esp_err_t fb_init(framebuffer_t *fb, size_t width, size_t height, fb_render_cb_t render_cb)
 {
     CHECK_ARG(fb && width && height && render_cb);
@@ -52,12 +111,19 @@ esp_err_t fb_init(framebuffer_t *fb, size_t width, size_t height, fb_render_cb_t
     fb->last_frame_us = 0;
     fb->render = render_cb;
     fb->internal = NULL;
+    fb->refresh = FB_REFRESH_FULL;
+    fb->invalid = true;
+    fb->shown = NULL;
     fb->mutex = xSemaphoreCreateMutex();
     if (!fb->mutex)
         return ESP_ERR_NO_MEM;
     fb->data = calloc(1, FB_SIZE(fb));
     if (!fb->data)
         return ESP_ERR_NO_MEM;
+    fb->dirty = malloc(height * sizeof(fb_span_t));
+    if (!fb->dirty)
+        return ESP_ERR_NO_MEM;
+    clear_dirty(fb);
 
     return ESP_OK;
 }
@@ -68,6 +134,10 @@ esp_err_t fb_free(framebuffer_t *fb)
 
     if (fb->data)
         free(fb->data);
+    if (fb->dirty)
+        free(fb->dirty);
+    if (fb->shown)
+        free(fb->shown);
     if (fb->mutex)
         vSemaphoreDelete(fb->mutex);
 
@@ -80,30 +150,102 @@ esp_err_t fb_render(framebuffer_t *fb, void *render_ctx)
 
     if (xSemaphoreTake(fb->mutex, 0) != pdTRUE)
         return ESP_ERR_INVALID_STATE;
-    CHECK(fb->render(fb, render_ctx));
+
+    if (fb->refresh == FB_REFRESH_FULL || fb->invalid)
+        mark_all(fb);
+    else if (fb->refresh == FB_REFRESH_DIFF)
+        diff_frame(fb);
+
+    // static frame, nothing to send
+    esp_err_t res = ESP_OK;
+    if (fb->dirty_rows)
+        res = fb->render(fb, render_ctx);
+    if (res == ESP_OK)
+    {
+        if (fb->refresh == FB_REFRESH_DIFF)
+            for (size_t y = 0; y < fb->height; y++)
+                if (fb->dirty[y].x0 < fb->dirty[y].x1)
+                    memcpy(fb->shown + FB_OFFSET(fb, fb->dirty[y].x0, y), fb->data + FB_OFFSET(fb, fb->dirty[y].x0, y),
+                           (fb->dirty[y].x1 - fb->dirty[y].x0) * sizeof(rgb_t));
+        fb->invalid = false;
+        clear_dirty(fb);
+    }
+    xSemaphoreGive(fb->mutex);
+
+    return res;
+}
+
+esp_err_t fb_set_refresh_mode(framebuffer_t *fb, fb_refresh_mode_t mode)
+{
+    CHECK_ARG(fb && fb->data && mode <= FB_REFRESH_DIFF);
+
+    if (xSemaphoreTake(fb->mutex, 0) != pdTRUE)
+        return ESP_ERR_INVALID_STATE;
+
+    if (mode == FB_REFRESH_DIFF && !fb->shown)
+    {
+        fb->shown = malloc(FB_SIZE(fb));
+        if (!fb->shown)
+        {
+            xSemaphoreGive(fb->mutex);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    else if (mode != FB_REFRESH_DIFF && fb->shown)
+    {
+        free(fb->shown);
+        fb->shown = NULL;
+    }
+    fb->refresh = mode;
+    fb->invalid = true;
+    clear_dirty(fb);
     xSemaphoreGive(fb->mutex);
 
     return ESP_OK;
 }
 
-esp_err_t fb_set_pixel_rgb(framebuffer_t *fb, size_t x, size_t y, rgb_t color)
+esp_err_t fb_mark_dirty(framebuffer_t *fb, size_t x, size_t y, size_t width, size_t height)
 {
-    CHECK_ARG(fb && fb->data && x < fb->width && y < fb->height);
+    CHECK_ARG(fb && fb->dirty);
+
+    // the other modes find the spans by themselves
+    if (fb->refresh != FB_REFRESH_DIRTY || x >= fb->width || y >= fb->height || !width)
+        return ESP_OK;
 
-    fb->data[FB_OFFSET(fb, x, y)] = color;
+    size_t x1 = width < fb->width - x ? x + width : fb->width;
+    size_t y1 = height < fb->height - y ? y + height : fb->height;
+    for (; y < y1; y++)
+        mark_span(fb, y, x, x1);
 
     return ESP_OK;
 }
 
-esp_err_t fb_set_pixel_hsv(framebuffer_t *fb, size_t x, size_t y, hsv_t color)
+esp_err_t fb_invalidate(framebuffer_t *fb)
+{
+    CHECK_ARG(fb);
+
+    fb->invalid = true;
+
+    return ESP_OK;
+}
+
+esp_err_t fb_set_pixel_rgb(framebuffer_t *fb, size_t x, size_t y, rgb_t color)
 {
     CHECK_ARG(fb && fb->data && x < fb->width && y < fb->height);
 
-    fb->data[FB_OFFSET(fb, x, y)] = hsv2rgb_rainbow(color);
+    rgb_t *pixel = &fb->data[FB_OFFSET(fb, x, y)];
+    if (fb->refresh == FB_REFRESH_DIRTY && !same_color(*pixel, color))
+        mark_span(fb, y, x, x + 1);
+    *pixel = color;
 
     return ESP_OK;
 }
 
+esp_err_t fb_set_pixel_hsv(framebuffer_t *fb, size_t x, size_t y, hsv_t color)
+{
+    return fb_set_pixel_rgb(fb, x, y, hsv2rgb_rainbow(color));
+}
+
 esp_err_t fb_get_pixel_rgb(framebuffer_t *fb, size_t x, size_t y, rgb_t *color)
 {
     CHECK_ARG(color && fb && fb->data && x < fb->width && y < fb->height);
@@ -167,6 +309,8 @@ esp_err_t fb_clear(framebuffer_t *fb)
     CHECK_ARG(fb && fb->data);
 
     memset(fb->data, 0, FB_SIZE(fb));
+    if (fb->refresh == FB_REFRESH_DIRTY)
+        mark_all(fb);
 
     return ESP_OK;
 }
@@ -204,6 +348,8 @@ esp_err_t fb_shift(framebuffer_t *fb, size_t offs, fb_shift_direction_t dir)
                     FB_SIZE(fb) - offs * fb->width * sizeof(rgb_t));
             break;
     }
+    if (fb->refresh == FB_REFRESH_DIRTY)
+        mark_all(fb);
 
     return ESP_OK;
 }
@@ -212,8 +358,31 @@ esp_err_t fb_fade(framebuffer_t *fb, uint8_t scale)
 {
     CHECK_ARG(fb && fb->data);
 
-    for (size_t i = 0; i < fb->width * fb->height; i++)
-        fb->data[i] = rgb_fade(fb->data[i], scale);
+    if (fb->refresh != FB_REFRESH_DIRTY)
+    {
+        for (size_t i = 0; i < fb->width * fb->height; i++)
+            fb->data[i] = rgb_fade(fb->data[i], scale);
+        return ESP_OK;
+    }
+
+    // black pixels stay black, a faded out frame is not rendered again
+    for (size_t y = 0; y < fb->height; y++)
+    {
+        rgb_t *row = fb->data + y * fb->width;
+        size_t x0 = fb->width, x1 = 0;
+        for (size_t x = 0; x < fb->width; x++)
+        {
+            rgb_t faded = rgb_fade(row[x], scale);
+            if (same_color(faded, row[x]))
+                continue;
+            if (x0 == fb->width)
+                x0 = x;
+            x1 = x + 1;
+            row[x] = faded;
+        }
+        if (x0 < x1)
+            mark_span(fb, y, x0, x1);
+    }
 
     return ESP_OK;
 }
@@ -223,6 +392,8 @@ esp_err_t fb_blur2d(framebuffer_t *fb, fract8 amount)
     CHECK_ARG(fb && fb->data);
 
     blur2d(fb->data, fb->width, fb->height, amount, xy, fb);
+    if (amount && fb->refresh == FB_REFRESH_DIRTY)
+        mark_all(fb);
 
     return ESP_OK;
 }
@@ -35,6 +35,7 @@
 #ifndef __FRAMEBUFFER_H__
 #define __FRAMEBUFFER_H__
 
+#include <stdbool.h>
 #include <esp_err.h>
 #include <color.h>
 #include <freertos/FreeRTOS.h>
@@ -55,6 +56,24 @@ typedef enum {
     FB_SHIFT_DOWN
 } fb_shift_direction_t;
 
+/**
+ * Which parts of the frame are passed to the renderer, see ::fb_set_refresh_mode()
+ */
+typedef enum {
+    FB_REFRESH_FULL = 0, ///< Every frame is rendered whole
+    FB_REFRESH_DIRTY,    ///< Only the pixels changed by the fb_*() functions or marked with ::fb_mark_dirty()
+    FB_REFRESH_DIFF      ///< Only the pixels that differ from the last rendered frame
+} fb_refresh_mode_t;
+
+/**
+ * Columns [x0, x1) of a frame row, empty when x0 >= x1
+ */
+typedef struct
+{
+    size_t x0;
+    size_t x1;
+} fb_span_t;
+
 typedef struct framebuffer_s framebuffer_t;
 
 /**
@@ -74,6 +93,11 @@ struct framebuffer_s
     uint64_t last_frame_us;        ///< Time of last rendered frame since boot in microseconds
     fb_render_cb_t render;         ///< See ::fb_render()
     uint8_t *internal;             ///< Buffer for effect settings, internal vars, palettes and so on
+    fb_refresh_mode_t refresh;     ///< See ::fb_set_refresh_mode()
+    fb_span_t *dirty;              ///< Span of each row to be rendered, see ::fb_render()
+    size_t dirty_rows;             ///< Number of rows with a non-empty span
+    bool invalid;                  ///< Whole frame is rendered next time, see ::fb_invalidate()
+    rgb_t *shown;                  ///< Last rendered frame in ::FB_REFRESH_DIFF mode
     SemaphoreHandle_t mutex;
 };
 
@@ -103,12 +127,57 @@ esp_err_t fb_free(framebuffer_t *fb);
  * Rendering is performed by calling the callback function with passing
  * it as arguments \p fb and \p ctx
  *
+ * Only the spans in `fb->dirty` have to be sent to the display: they cover
+ * the whole frame in ::FB_REFRESH_FULL mode and the changed pixels in the
+ * other modes. When nothing changed, the callback is not called at all.
+ * If the callback fails, the same pixels are rendered next time.
+ *
  * @param fb   Framebuffer descriptor
  * @param ctx  Argument to pass to callback
  * @return     ESP_OK on success
  */
 esp_err_t fb_render(framebuffer_t *fb, void *ctx);
 
+/**
+ * @brief Set what is rendered on each frame
+ *
+ * ::FB_REFRESH_DIRTY relies on all changes made through the fb_*() functions,
+ * direct writes to `fb->data` must be followed by ::fb_mark_dirty().
+ * ::FB_REFRESH_DIFF needs no cooperation from the drawing code, but keeps
+ * a copy of the last rendered frame and compares the frame with it.
+ * The first frame rendered in a new mode is rendered whole.
+ *
+ * @param fb        Framebuffer descriptor
+ * @param mode      Refresh mode, ::FB_REFRESH_FULL after ::fb_init()
+ * @return          ESP_OK on success
+ */
+esp_err_t fb_set_refresh_mode(framebuffer_t *fb, fb_refresh_mode_t mode);
+
+/**
+ * @brief Mark a rectangle as changed
+ *
+ * Needed in ::FB_REFRESH_DIRTY mode after writing to `fb->data` directly.
+ * The rectangle is clipped to the frame.
+ *
+ * @param fb        Framebuffer descriptor
+ * @param x         X coordinate of the top left corner
+ * @param y         Y coordinate of the top left corner
+ * @param width     Rectangle width
+ * @param height    Rectangle height
+ * @return          ESP_OK on success
+ */
+esp_err_t fb_mark_dirty(framebuffer_t *fb, size_t x, size_t y, size_t width, size_t height);
+
+/**
+ * @brief Render the whole frame next time
+ *
+ * For instance after the display was reset and lost its contents.
+ *
+ * @param fb        Framebuffer descriptor
+ * @return          ESP_OK on success
+ */
+esp_err_t fb_invalidate(framebuffer_t *fb);
+
 /**
  * @brief Set RGB color of framebuffer pixel
  *
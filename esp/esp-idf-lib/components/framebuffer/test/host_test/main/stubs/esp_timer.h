@@ -0,0 +1,12 @@
+#pragma once
+
+// fb_end() stamps the frames with it, lib8tion only needs it for its beat generators
+#include <stdint.h>
+#include <time.h>
+
+static inline int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+// The framebuffer only uses a mutex, taken without waiting, from a single thread in the test
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE 0
+#define pdTRUE  1
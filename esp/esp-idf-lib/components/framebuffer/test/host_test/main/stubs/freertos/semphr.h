@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include "FreeRTOS.h"
+
+typedef bool *SemaphoreHandle_t;
+
+static inline SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return (SemaphoreHandle_t)calloc(1, sizeof(bool));
+}
+
+static inline void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    free(sem);
+}
+
+static inline BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    (void)ticks;
+    if (*sem)
+        return pdFALSE;
+    *sem = true;
+    return pdTRUE;
+}
+
+static inline BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    if (!*sem)
+        return pdFALSE;
+    *sem = false;
+    return pdTRUE;
+}
@@ -0,0 +1,200 @@
+#define CATCH_CONFIG_MAIN // This tells the catch header to generate a main
+#include <vector>
+#include "catch.hpp"
+#include "framebuffer.h"
+
+static constexpr size_t width = 8;
+static constexpr size_t height = 4;
+
+/**
+ * Simulated display: copies only the dirty spans of each rendered frame, the way
+ * a partial refresh driver does, and records them.
+ */
+struct Display {
+    std::vector<rgb_t> pixels = std::vector<rgb_t>(width * height, rgb_from_code(0));
+    std::vector<std::vector<fb_span_t>> frames;
+    bool fail = false;
+};
+
+static esp_err_t render(framebuffer_t *fb, void *arg)
+{
+    Display *display = (Display *)arg;
+    if (display->fail)
+        return ESP_FAIL;
+
+    std::vector<fb_span_t> spans(fb->dirty, fb->dirty + fb->height);
+    for (size_t y = 0; y < fb->height; y++)
+        for (size_t x = spans[y].x0; x < spans[y].x1; x++)
+            display->pixels[y * fb->width + x] = fb->data[y * fb->width + x];
+    display->frames.push_back(spans);
+    return ESP_OK;
+}
+
+static bool same(const rgb_t &a, const rgb_t &b)
+{
+    return a.r == b.r && a.g == b.g && a.b == b.b;
+}
+
+static bool shows_frame(const Display &display, const framebuffer_t &fb)
+{
+    for (size_t i = 0; i < fb.width * fb.height; i++)
+        if (!same(display.pixels[i], fb.data[i]))
+            return false;
+    return true;
+}
+
+static bool whole(const std::vector<fb_span_t> &spans)
+{
+    for (auto &s : spans)
+        if (s.x0 != 0 || s.x1 != width)
+            return false;
+    return true;
+}
+
+static bool empty(const fb_span_t &span)
+{
+    return span.x0 >= span.x1;
+}
+
+// Initializes the framebuffer in the given mode and renders the first (whole) frame
+static void start(framebuffer_t &fb, Display &display, fb_refresh_mode_t mode)
+{
+    REQUIRE(fb_init(&fb, width, height, render) == ESP_OK);
+    REQUIRE(fb_set_refresh_mode(&fb, mode) == ESP_OK);
+    REQUIRE(fb_render(&fb, &display) == ESP_OK);
+    REQUIRE(display.frames.size() == 1);
+    REQUIRE(whole(display.frames[0]));
+    display.frames.clear();
+}
+
+TEST_CASE("Dirty spans are merged per row", "[framebuffer]")
+{
+    framebuffer_t fb;
+    Display display;
+    start(fb, display, FB_REFRESH_DIRTY);
+
+    const rgb_t red = rgb_from_values(255, 0, 0);
+    CHECK(fb_set_pixel_rgb(&fb, 1, 2, red) == ESP_OK);
+    CHECK(fb_set_pixel_rgb(&fb, 5, 2, red) == ESP_OK);
+    CHECK(fb.dirty[2].x0 == 1);
+    CHECK(fb.dirty[2].x1 == 6);
+    CHECK(fb.dirty_rows == 1);
+
+    // a rectangle widens the spans of the rows it covers and is clipped to the frame
+    CHECK(fb_mark_dirty(&fb, 6, 1, 10, 2) == ESP_OK);
+    CHECK(fb.dirty[1].x0 == 6);
+    CHECK(fb.dirty[1].x1 == width);
+    CHECK(fb.dirty[2].x0 == 1);
+    CHECK(fb.dirty[2].x1 == width);
+    CHECK(fb.dirty_rows == 2);
+    CHECK(fb_mark_dirty(&fb, width, 0, 1, 1) == ESP_OK);
+    CHECK(fb_mark_dirty(&fb, 0, 0, 0, 1) == ESP_OK);
+    CHECK(empty(fb.dirty[0]));
+
+    // pixels set to the color they already have are not rendered again
+    CHECK(fb_set_pixel_rgb(&fb, 3, 3, rgb_from_code(0)) == ESP_OK);
+    CHECK(empty(fb.dirty[3]));
+    CHECK(fb.dirty_rows == 2);
+
+    CHECK(fb_render(&fb, &display) == ESP_OK);
+    REQUIRE(display.frames.size() == 1);
+    CHECK(empty(display.frames[0][0]));
+    CHECK(display.frames[0][1].x0 == 6);
+    CHECK(display.frames[0][2].x0 == 1);
+    CHECK(empty(display.frames[0][3]));
+    CHECK(shows_frame(display, fb));
+    CHECK(fb.dirty_rows == 0);
+
+    // fading marks the lit pixels only
+    CHECK(fb_fade(&fb, 128) == ESP_OK);
+    CHECK(fb.dirty_rows == 1);
+    CHECK(fb.dirty[2].x0 == 1);
+    CHECK(fb.dirty[2].x1 == 6);
+
+    fb_free(&fb);
+}
+
+TEST_CASE("Invalidated frame is rendered whole", "[framebuffer]")
+{
+    for (auto mode : { FB_REFRESH_FULL, FB_REFRESH_DIRTY, FB_REFRESH_DIFF }) {
+        framebuffer_t fb;
+        Display display;
+        start(fb, display, mode);
+
+        CHECK(fb_invalidate(&fb) == ESP_OK);
+        CHECK(fb_render(&fb, &display) == ESP_OK);
+        REQUIRE(display.frames.size() == 1);
+        CHECK(whole(display.frames[0]));
+
+        // back to the changed pixels only, except in full mode
+        CHECK(fb_set_pixel_rgb(&fb, 2, 1, rgb_from_values(0, 255, 0)) == ESP_OK);
+        CHECK(fb_render(&fb, &display) == ESP_OK);
+        REQUIRE(display.frames.size() == 2);
+        CHECK(whole(display.frames[1]) == (mode == FB_REFRESH_FULL));
+        CHECK(shows_frame(display, fb));
+
+        // the first frame in a new mode is rendered whole
+        CHECK(fb_set_refresh_mode(&fb, mode == FB_REFRESH_DIFF ? FB_REFRESH_DIRTY : FB_REFRESH_DIFF) == ESP_OK);
+        CHECK(fb_render(&fb, &display) == ESP_OK);
+        REQUIRE(display.frames.size() == 3);
+        CHECK(whole(display.frames[2]));
+
+        fb_free(&fb);
+    }
+}
+
+TEST_CASE("Partial refresh output", "[framebuffer]")
+{
+    for (auto mode : { FB_REFRESH_DIRTY, FB_REFRESH_DIFF }) {
+        framebuffer_t fb;
+        Display display;
+        start(fb, display, mode);
+
+        // a static frame is not sent at all
+        CHECK(fb_render(&fb, &display) == ESP_OK);
+        CHECK(display.frames.empty());
+
+        CHECK(fb_set_pixel_rgb(&fb, 0, 0, rgb_from_values(1, 2, 3)) == ESP_OK);
+        CHECK(fb_set_pixel_rgb(&fb, 4, 3, rgb_from_values(4, 5, 6)) == ESP_OK);
+        CHECK(fb_set_pixel_rgb(&fb, 7, 3, rgb_from_values(7, 8, 9)) == ESP_OK);
+
+        // a failed render sends the same pixels next time
+        display.fail = true;
+        CHECK(fb_render(&fb, &display) == ESP_FAIL);
+        display.fail = false;
+        CHECK(fb_set_pixel_rgb(&fb, 2, 1, rgb_from_values(10, 11, 12)) == ESP_OK);
+        CHECK(fb_render(&fb, &display) == ESP_OK);
+        REQUIRE(display.frames.size() == 1);
+        auto &spans = display.frames[0];
+        CHECK(spans[0].x0 == 0);
+        CHECK(spans[0].x1 == 1);
+        CHECK(spans[1].x0 == 2);
+        CHECK(spans[1].x1 == 3);
+        CHECK(empty(spans[2]));
+        CHECK(spans[3].x0 == 4);
+        CHECK(spans[3].x1 == 8);
+        CHECK(shows_frame(display, fb));
+
+        // writes to the buffer which don't go through fb_*() are found by comparing the frames
+        fb.data[FB_OFFSET(&fb, 5, 2)] = rgb_from_values(13, 14, 15);
+        if (mode == FB_REFRESH_DIRTY)
+            CHECK(fb_mark_dirty(&fb, 5, 2, 1, 1) == ESP_OK);
+        CHECK(fb_render(&fb, &display) == ESP_OK);
+        REQUIRE(display.frames.size() == 2);
+        CHECK(display.frames[1][2].x0 == 5);
+        CHECK(display.frames[1][2].x1 == 6);
+        CHECK(shows_frame(display, fb));
+
+        // a pixel set back to the shown color is dropped from the span in diff mode
+        CHECK(fb_set_pixel_rgb(&fb, 5, 2, rgb_from_values(16, 17, 18)) == ESP_OK);
+        CHECK(fb_set_pixel_rgb(&fb, 6, 2, rgb_from_values(19, 20, 21)) == ESP_OK);
+        CHECK(fb_set_pixel_rgb(&fb, 5, 2, rgb_from_values(13, 14, 15)) == ESP_OK);
+        CHECK(fb_render(&fb, &display) == ESP_OK);
+        REQUIRE(display.frames.size() == 3);
+        CHECK(display.frames[2][2].x0 == (mode == FB_REFRESH_DIFF ? 6u : 5u));
+        CHECK(display.frames[2][2].x1 == 7);
+        CHECK(shows_frame(display, fb));
+
+        fb_free(&fb);
+    }
+}
@@ -30,19 +30,42 @@
  *
  * MIT Licensed as described in the file LICENSE
  */
+#include <stdio.h>
 #include <string.h>
 #include <inttypes.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <freertos/queue.h>
 #include <esp_log.h>
+#include <esp_timer.h>
 #include "i2cdev.h"
 
 static const char *TAG = "i2cdev";
 
+/* Command links in a buffer of the port, used with the port mutex held. They are
+ * allocated from the heap when transfers may run concurrently (CONFIG_I2CDEV_NOLOCK) */
+#if HELPER_TARGET_IS_ESP32 && ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(4, 4, 0) && !CONFIG_I2CDEV_NOLOCK
+#define I2CDEV_STATIC_LINK 1
+// Register write, then a repeated start and the read
+#define I2CDEV_LINK_SIZE I2C_LINK_RECOMMENDED_SIZE(2)
+#else
+#define I2CDEV_STATIC_LINK 0
+#endif
+
 typedef struct {
     SemaphoreHandle_t lock;
     i2c_config_t config;
     bool installed;
+    uint32_t timeout_ticks; // Stretch time set on the port, 0 until set
+#if I2CDEV_STATIC_LINK
+    uint8_t link[I2CDEV_LINK_SIZE];
+#endif
+#if !CONFIG_I2CDEV_NOLOCK
+    QueueHandle_t queue;
+    TaskHandle_t task;
+    TaskHandle_t stopping;
+    i2c_dev_sched_stats_t stats;
+#endif
 } i2c_port_state_t;
 
 static i2c_port_state_t states[I2C_NUM_MAX];
@@ -96,11 +119,16 @@ esp_err_t i2cdev_done()
     {
         if (!states[i].lock) continue;
 
+#if !CONFIG_I2CDEV_NOLOCK
+        if (states[i].task)
+            i2c_dev_sched_stop(i);
+#endif
         if (states[i].installed)
         {
             SEMAPHORE_TAKE(i);
             i2c_driver_delete(i);
             states[i].installed = false;
+            states[i].timeout_ticks = 0;
             SEMAPHORE_GIVE(i);
         }
 #if !CONFIG_I2CDEV_NOLOCK
@@ -205,6 +233,7 @@ static esp_err_t i2c_setup_port(const i2c_dev_t *dev)
         {
             i2c_driver_delete(dev->port);
             states[dev->port].installed = false;
+            states[dev->port].timeout_ticks = 0;
         }
 #if HELPER_TARGET_IS_ESP32
 #if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0)
@@ -234,19 +263,70 @@ static esp_err_t i2c_setup_port(const i2c_dev_t *dev)
         ESP_LOGD(TAG, "I2C driver successfully reconfigured on port %d", dev->port);
     }
 #if HELPER_TARGET_IS_ESP32
-    int t;
-    if ((res = i2c_get_timeout(dev->port, &t)) != ESP_OK)
-        return res;
-    // Timeout cannot be 0
+    // Timeout cannot be 0. The value set is kept, so that the register isn't read on every transfer
     uint32_t ticks = dev->timeout_ticks ? dev->timeout_ticks : I2CDEV_MAX_STRETCH_TIME;
-    if ((ticks != t) && (res = i2c_set_timeout(dev->port, ticks)) != ESP_OK)
-        return res;
-    ESP_LOGD(TAG, "Timeout: ticks = %" PRIu32 " (%" PRIu32 " usec) on port %d", dev->timeout_ticks, dev->timeout_ticks / 80, dev->port);
+    if (ticks != states[dev->port].timeout_ticks)
+    {
+        if ((res = i2c_set_timeout(dev->port, ticks)) != ESP_OK)
+            return res;
+        states[dev->port].timeout_ticks = ticks;
+        ESP_LOGD(TAG, "Timeout: ticks = %" PRIu32 " (%" PRIu32 " usec) on port %d", dev->timeout_ticks, dev->timeout_ticks / 80, dev->port);
+    }
 #endif
 
     return ESP_OK;
 }
 
+static i2c_cmd_handle_t i2c_link_create(i2c_port_t port)
+{
+#if I2CDEV_STATIC_LINK
+    return i2c_cmd_link_create_static(states[port].link, sizeof(states[port].link));
+#else
+    return i2c_cmd_link_create();
+#endif
+}
+
+static void i2c_link_delete(i2c_cmd_handle_t cmd)
+{
+#if I2CDEV_STATIC_LINK
+    i2c_cmd_link_delete_static(cmd);
+#else
+    i2c_cmd_link_delete(cmd);
+#endif
+}
+
+/* Writes the register and the data if any, then reads if in_size isn't 0. The device is
+ * always addressed, for writing unless there is only something to read. Called with the
+ * port set up and held */
+static esp_err_t i2c_dev_transfer(const i2c_dev_t *dev, const void *out_reg, size_t out_reg_size,
+        const void *out_data, size_t out_size, void *in_data, size_t in_size)
+{
+    i2c_cmd_handle_t cmd = i2c_link_create(dev->port);
+    if (!cmd) return ESP_ERR_NO_MEM;
+
+    if ((out_reg && out_reg_size) || (out_data && out_size) || !(in_data && in_size))
+    {
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, dev->addr << 1, true);
+        if (out_reg && out_reg_size)
+            i2c_master_write(cmd, (void *)out_reg, out_reg_size, true);
+        if (out_data && out_size)
+            i2c_master_write(cmd, (void *)out_data, out_size, true);
+    }
+    if (in_data && in_size)
+    {
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, (dev->addr << 1) | 1, true);
+        i2c_master_read(cmd, in_data, in_size, I2C_MASTER_LAST_NACK);
+    }
+    i2c_master_stop(cmd);
+
+    esp_err_t res = i2c_master_cmd_begin(dev->port, cmd, pdMS_TO_TICKS(CONFIG_I2CDEV_TIMEOUT));
+
+    i2c_link_delete(cmd);
+    return res;
+}
+
 esp_err_t i2c_dev_probe(const i2c_dev_t *dev, i2c_dev_type_t operation_type)
 {
     if (!dev) return ESP_ERR_INVALID_ARG;
@@ -256,14 +336,19 @@ esp_err_t i2c_dev_probe(const i2c_dev_t *dev, i2c_dev_type_t operation_type)
     esp_err_t res = i2c_setup_port(dev);
     if (res == ESP_OK)
     {
-        i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-        i2c_master_start(cmd);
-        i2c_master_write_byte(cmd, dev->addr << 1 | (operation_type == I2C_DEV_READ ? 1 : 0), true);
-        i2c_master_stop(cmd);
+        i2c_cmd_handle_t cmd = i2c_link_create(dev->port);
+        if (cmd)
+        {
+            i2c_master_start(cmd);
+            i2c_master_write_byte(cmd, dev->addr << 1 | (operation_type == I2C_DEV_READ ? 1 : 0), true);
+            i2c_master_stop(cmd);
 
-        res = i2c_master_cmd_begin(dev->port, cmd, pdMS_TO_TICKS(CONFIG_I2CDEV_TIMEOUT));
+            res = i2c_master_cmd_begin(dev->port, cmd, pdMS_TO_TICKS(CONFIG_I2CDEV_TIMEOUT));
 
-        i2c_cmd_link_delete(cmd);
+            i2c_link_delete(cmd);
+        }
+        else
+            res = ESP_ERR_NO_MEM;
     }
 
     SEMAPHORE_GIVE(dev->port);
@@ -280,23 +365,9 @@ esp_err_t i2c_dev_read(const i2c_dev_t *dev, const void *out_data, size_t out_si
     esp_err_t res = i2c_setup_port(dev);
     if (res == ESP_OK)
     {
-        i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-        if (out_data && out_size)
-        {
-            i2c_master_start(cmd);
-            i2c_master_write_byte(cmd, dev->addr << 1, true);
-            i2c_master_write(cmd, (void *)out_data, out_size, true);
-        }
-        i2c_master_start(cmd);
-        i2c_master_write_byte(cmd, (dev->addr << 1) | 1, true);
-        i2c_master_read(cmd, in_data, in_size, I2C_MASTER_LAST_NACK);
-        i2c_master_stop(cmd);
-
-        res = i2c_master_cmd_begin(dev->port, cmd, pdMS_TO_TICKS(CONFIG_I2CDEV_TIMEOUT));
+        res = i2c_dev_transfer(dev, out_data, out_size, NULL, 0, in_data, in_size);
         if (res != ESP_OK)
             ESP_LOGE(TAG, "Could not read from device [0x%02x at %d]: %d (%s)", dev->addr, dev->port, res, esp_err_to_name(res));
-
-        i2c_cmd_link_delete(cmd);
     }
 
     SEMAPHORE_GIVE(dev->port);
@@ -312,17 +383,9 @@ esp_err_t i2c_dev_write(const i2c_dev_t *dev, const void *out_reg, size_t out_re
     esp_err_t res = i2c_setup_port(dev);
     if (res == ESP_OK)
     {
-        i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-        i2c_master_start(cmd);
-        i2c_master_write_byte(cmd, dev->addr << 1, true);
-        if (out_reg && out_reg_size)
-            i2c_master_write(cmd, (void *)out_reg, out_reg_size, true);
-        i2c_master_write(cmd, (void *)out_data, out_size, true);
-        i2c_master_stop(cmd);
-        res = i2c_master_cmd_begin(dev->port, cmd, pdMS_TO_TICKS(CONFIG_I2CDEV_TIMEOUT));
+        res = i2c_dev_transfer(dev, out_reg, out_reg_size, out_data, out_size, NULL, 0);
         if (res != ESP_OK)
             ESP_LOGE(TAG, "Could not write to device [0x%02x at %d]: %d (%s)", dev->addr, dev->port, res, esp_err_to_name(res));
-        i2c_cmd_link_delete(cmd);
     }
 
     SEMAPHORE_GIVE(dev->port);
@@ -338,3 +401,172 @@ esp_err_t i2c_dev_write_reg(const i2c_dev_t *dev, uint8_t reg, const void *out_d
 {
     return i2c_dev_write(dev, &reg, 1, out_data, out_size);
 }
+
+#if !CONFIG_I2CDEV_NOLOCK
+
+static void i2c_sched_task(void *arg)
+{
+    i2c_port_t port = (i2c_port_t)(intptr_t)arg;
+    i2c_port_state_t *state = &states[port];
+    i2c_dev_xfer_t *batch[CONFIG_I2CDEV_SCHED_BATCH_MAX];
+    bool running = true;
+
+    while (running)
+    {
+        size_t count = 0;
+        i2c_dev_xfer_t *xfer;
+
+        // Everything queued when the port is taken runs back to back, up to CONFIG_I2CDEV_SCHED_BATCH_MAX
+        xQueueReceive(state->queue, &xfer, portMAX_DELAY);
+        do
+        {
+            if (!xfer)
+            {
+                running = false;
+                break;
+            }
+            batch[count++] = xfer;
+        } while (count < CONFIG_I2CDEV_SCHED_BATCH_MAX && xQueueReceive(state->queue, &xfer, 0) == pdTRUE);
+
+        if (!count) continue;
+
+        if (!xSemaphoreTake(state->lock, pdMS_TO_TICKS(CONFIG_I2CDEV_TIMEOUT)))
+        {
+            ESP_LOGE(TAG, "Could not take port mutex %d", port);
+            for (size_t i = 0; i < count; i++)
+                batch[i]->result = ESP_ERR_TIMEOUT;
+        }
+        else
+        {
+            int64_t locked = esp_timer_get_time();
+            uint64_t bus_us = 0;
+            const i2c_dev_t *configured = NULL;
+
+            for (size_t i = 0; i < count; i++)
+            {
+                xfer = batch[i];
+                // The port is set up again only when the device changes
+                esp_err_t res = xfer->dev == configured ? ESP_OK : i2c_setup_port(xfer->dev);
+                if (res == ESP_OK)
+                {
+                    configured = xfer->dev;
+                    int64_t begin = esp_timer_get_time();
+                    res = i2c_dev_transfer(xfer->dev, xfer->out_reg, xfer->out_reg_size,
+                            xfer->out_data, xfer->out_size, xfer->in_data, xfer->in_size);
+                    bus_us += esp_timer_get_time() - begin;
+                }
+                else
+                    configured = NULL;
+                if (res != ESP_OK)
+                {
+                    ESP_LOGE(TAG, "Transaction with device [0x%02x at %d] failed: %d (%s)",
+                            xfer->dev->addr, port, res, esp_err_to_name(res));
+                    state->stats.errors++;
+                }
+                xfer->result = res;
+            }
+
+            state->stats.transactions += count;
+            state->stats.batches++;
+            state->stats.bus_us += bus_us;
+            state->stats.locked_us += esp_timer_get_time() - locked;
+            xSemaphoreGive(state->lock);
+        }
+
+        // Out of the mutex, so that the callbacks can submit or use the blocking functions
+        for (size_t i = 0; i < count; i++)
+        {
+            if (batch[i]->callback)
+                batch[i]->callback(batch[i]);
+        }
+    }
+
+    xTaskNotifyGive(state->stopping);
+    vTaskDelete(NULL);
+}
+
+esp_err_t i2c_dev_sched_start(i2c_port_t port)
+{
+    if (port >= I2C_NUM_MAX || !states[port].lock) return ESP_ERR_INVALID_ARG;
+    if (states[port].task) return ESP_ERR_INVALID_STATE;
+
+    i2c_port_state_t *state = &states[port];
+    state->queue = xQueueCreate(CONFIG_I2CDEV_SCHED_QUEUE_SIZE, sizeof(i2c_dev_xfer_t *));
+    if (!state->queue)
+    {
+        ESP_LOGE(TAG, "Could not create transaction queue of port %d", port);
+        return ESP_ERR_NO_MEM;
+    }
+    memset(&state->stats, 0, sizeof(state->stats));
+    state->stats.since_us = esp_timer_get_time();
+
+    char name[configMAX_TASK_NAME_LEN];
+    snprintf(name, sizeof(name), "i2c%d", port);
+    if (xTaskCreate(i2c_sched_task, name, CONFIG_I2CDEV_SCHED_TASK_STACK_SIZE, (void *)(intptr_t)port,
+            CONFIG_I2CDEV_SCHED_TASK_PRIORITY, &state->task) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Could not create scheduler task of port %d", port);
+        vQueueDelete(state->queue);
+        state->queue = NULL;
+        state->task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t i2c_dev_sched_stop(i2c_port_t port)
+{
+    if (port >= I2C_NUM_MAX) return ESP_ERR_INVALID_ARG;
+    if (!states[port].task) return ESP_ERR_INVALID_STATE;
+
+    i2c_port_state_t *state = &states[port];
+    i2c_dev_xfer_t *stop = NULL;
+
+    // Queued after the transactions already submitted, which complete first
+    state->stopping = xTaskGetCurrentTaskHandle();
+    xQueueSend(state->queue, &stop, portMAX_DELAY);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    vQueueDelete(state->queue);
+    state->queue = NULL;
+    state->task = NULL;
+    return ESP_OK;
+}
+
+esp_err_t i2c_dev_submit(i2c_dev_xfer_t *xfer)
+{
+    if (!xfer || !xfer->dev || xfer->dev->port >= I2C_NUM_MAX) return ESP_ERR_INVALID_ARG;
+    if (!(xfer->out_reg && xfer->out_reg_size) && !(xfer->out_data && xfer->out_size)
+            && !(xfer->in_data && xfer->in_size))
+        return ESP_ERR_INVALID_ARG;
+
+    i2c_port_state_t *state = &states[xfer->dev->port];
+    if (!state->queue) return ESP_ERR_INVALID_STATE;
+
+    if (xQueueSend(state->queue, &xfer, pdMS_TO_TICKS(CONFIG_I2CDEV_TIMEOUT)) != pdTRUE)
+    {
+        ESP_LOGE(TAG, "[0x%02x at %d] Transaction queue full", xfer->dev->addr, xfer->dev->port);
+        return ESP_ERR_TIMEOUT;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t i2c_dev_sched_get_stats(i2c_port_t port, i2c_dev_sched_stats_t *stats, bool reset)
+{
+    if (port >= I2C_NUM_MAX || !stats || !states[port].lock) return ESP_ERR_INVALID_ARG;
+
+    SEMAPHORE_TAKE(port);
+    *stats = states[port].stats;
+    if (reset)
+    {
+        memset(&states[port].stats, 0, sizeof(states[port].stats));
+        states[port].stats.since_us = esp_timer_get_time();
+    }
+    SEMAPHORE_GIVE(port);
+
+    return ESP_OK;
+}
+
+#endif /* !CONFIG_I2CDEV_NOLOCK */
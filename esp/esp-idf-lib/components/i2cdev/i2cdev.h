@@ -215,6 +215,102 @@ esp_err_t i2c_dev_read_reg(const i2c_dev_t *dev, uint8_t reg,
 esp_err_t i2c_dev_write_reg(const i2c_dev_t *dev, uint8_t reg,
         const void *out_data, size_t out_size);
 
+/**
+ * Queued transaction, see ::i2c_dev_submit()
+ *
+ * The device is addressed for writing \p out_reg then \p out_data, if any,
+ * then with a repeated start for reading \p in_size bytes into \p in_data,
+ * if any, and the bus is released.
+ */
+typedef struct i2c_dev_xfer i2c_dev_xfer_t;
+
+/**
+ * Completion callback of a queued transaction. Called from the scheduler task
+ * of the port, with the port released: it may submit another transaction or
+ * call the blocking functions, but shouldn't wait for long.
+ */
+typedef void (*i2c_dev_xfer_cb_t)(i2c_dev_xfer_t *xfer);
+
+struct i2c_dev_xfer
+{
+    const i2c_dev_t *dev;       //!< Device descriptor
+    const void *out_reg;        //!< Register address to send if non-null
+    size_t out_reg_size;        //!< Size of register address
+    const void *out_data;       //!< Data to send if non-null
+    size_t out_size;            //!< Size of data to send
+    void *in_data;              //!< Input data buffer if non-null
+    size_t in_size;             //!< Number of bytes to read
+    i2c_dev_xfer_cb_t callback; //!< Completion callback, may be NULL
+    void *arg;                  //!< User argument of the callback
+    esp_err_t result;           //!< Result of the transaction, set before the callback
+};
+
+/**
+ * Statistics of the scheduler of a port
+ */
+typedef struct
+{
+    uint32_t transactions; //!< Transactions executed
+    uint32_t batches;      //!< Times the port was taken to execute queued transactions
+    uint32_t errors;       //!< Transactions failed
+    uint64_t bus_us;       //!< Time spent in the I2C driver executing the transactions, microseconds
+    uint64_t locked_us;    //!< Time the port was held by the scheduler, bus_us included, microseconds
+    int64_t since_us;      //!< esp_timer time of the start of the statistics, microseconds
+} i2c_dev_sched_stats_t;
+
+/**
+ * @brief Start the transaction scheduler of a port
+ *
+ * Creates the transaction queue of the port and the task executing it. The task
+ * takes the port once for all the transactions queued, up to
+ * CONFIG_I2CDEV_SCHED_BATCH_MAX, and executes them back to back. Blocking
+ * functions of this library can still be used on the port.
+ *
+ * Not available if option CONFIG_I2CDEV_NOLOCK is enabled.
+ *
+ * @param port I2C port number
+ * @return ESP_OK on success
+ */
+esp_err_t i2c_dev_sched_start(i2c_port_t port);
+
+/**
+ * @brief Stop the transaction scheduler of a port
+ *
+ * The transactions already submitted are completed first. No transaction must
+ * be submitted to the port during the call or after it.
+ *
+ * @param port I2C port number
+ * @return ESP_OK on success
+ */
+esp_err_t i2c_dev_sched_stop(i2c_port_t port);
+
+/**
+ * @brief Queue a transaction
+ *
+ * Returns without waiting for the transaction. The descriptor and the buffers
+ * must stay valid until its callback is called. A transaction with only
+ * \p out_reg is a command write.
+ *
+ * @param xfer Transaction
+ * @return ESP_OK when queued, ESP_ERR_TIMEOUT if the queue stayed full for
+ *         CONFIG_I2CDEV_TIMEOUT, ESP_ERR_INVALID_STATE if the scheduler of the
+ *         port isn't started
+ */
+esp_err_t i2c_dev_submit(i2c_dev_xfer_t *xfer);
+
+/**
+ * @brief Get the statistics of the scheduler of a port
+ *
+ * Bus utilisation is `bus_us` over the time since `since_us`, the overhead per
+ * transaction is `(locked_us - bus_us) / transactions`.
+ *
+ * @param port I2C port number
+ * @param[out] stats Statistics
+ * @param reset Start the statistics again
+ * @return ESP_OK on success
+ */
+esp_err_t i2c_dev_sched_get_stats(i2c_port_t port, i2c_dev_sched_stats_t *stats, bool reset);
+
 #define I2C_DEV_TAKE_MUTEX(dev) do { \
         esp_err_t __ = i2c_dev_take_mutex(dev); \
         if (__ != ESP_OK) return __;\
@@ -57,6 +57,10 @@
 #define CHECK(x) do { esp_err_t __; if ((__ = x) != ESP_OK) return __; } while (0)
 #define CHECK_ARG(VAL) do { if (!(VAL)) return ESP_ERR_INVALID_ARG; } while (0)
 
+#define MPU6050_FIFO_SIZE (1024)
+#define MPU6050_FIFO_STREAM_RATE_MIN (4)
+#define MPU6050_FIFO_STREAM_RATE_MAX (1000)
+
 static const char *TAG = "mpu6050";
 
 static const float accel_res[] = {
@@ -210,6 +214,7 @@ esp_err_t mpu6050_init_desc(mpu6050_dev_t *dev, uint8_t addr, i2c_port_t port, g
 #if HELPER_TARGET_IS_ESP32
     dev->i2c_dev.cfg.master.clk_speed = I2C_FREQ_HZ;
 #endif
+    dev->fifo_frame_size = 0;
 
     return i2c_dev_create_mutex(&dev->i2c_dev);
 }
@@ -798,7 +803,7 @@ esp_err_t mpu6050_set_int_enabled(mpu6050_dev_t *dev, uint8_t ints)
 
 esp_err_t mpu6050_get_int_status(mpu6050_dev_t *dev, uint8_t *ints)
 {
-    return read_reg(dev, MPU6050_REGISTER_INT_ENABLE, ints);
+    return read_reg(dev, MPU6050_REGISTER_INT_STATUS, ints);
 }
 
 static const uint8_t accel_offs_regs[] = {
@@ -1201,7 +1206,7 @@ esp_err_t mpu6050_get_fifo_bytes(mpu6050_dev_t *dev, uint8_t *data, size_t lengt
     CHECK_ARG(dev && data && length);
 
     I2C_DEV_TAKE_MUTEX(&dev->i2c_dev);
-    I2C_DEV_CHECK(&dev->i2c_dev, i2c_dev_read_reg(&dev->i2c_dev, MPU6050_REGISTER_FIFO_COUNTH, data, length));
+    I2C_DEV_CHECK(&dev->i2c_dev, i2c_dev_read_reg(&dev->i2c_dev, MPU6050_REGISTER_FIFO_R_W, data, length));
     I2C_DEV_GIVE_MUTEX(&dev->i2c_dev);
 
     return ESP_OK;
@@ -1217,6 +1222,92 @@ esp_err_t mpu6050_set_fifo_byte(mpu6050_dev_t *dev, uint8_t data)
     return write_reg(dev, MPU6050_REGISTER_FIFO_R_W, data);
 }
 
+esp_err_t mpu6050_start_fifo_stream(mpu6050_dev_t *dev, uint16_t rate_hz, bool gyro)
+{
+    CHECK_ARG(dev && rate_hz >= MPU6050_FIFO_STREAM_RATE_MIN && rate_hz <= MPU6050_FIFO_STREAM_RATE_MAX);
+
+    uint8_t fifo_en = BIT(MPU6050_ACCEL_FIFO_EN_BIT);
+    if (gyro)
+        fifo_en |= BIT(MPU6050_XG_FIFO_EN_BIT) | BIT(MPU6050_YG_FIFO_EN_BIT) | BIT(MPU6050_ZG_FIFO_EN_BIT);
+
+    CHECK(mpu6050_set_int_enabled(dev, 0));
+    CHECK(mpu6050_set_fifo_enabled(dev, false));
+    // The gyroscope output rate is 1 kHz with the DLPF on, as the accelerometer's
+    CHECK(mpu6050_set_dlpf_mode(dev, MPU6050_DLPF_1));
+    CHECK(mpu6050_set_rate(dev, MPU6050_FIFO_STREAM_RATE_MAX / rate_hz - 1));
+    CHECK(write_reg(dev, MPU6050_REGISTER_FIFO_EN, fifo_en));
+    CHECK(mpu6050_set_interrupt_mode(dev, MPU6050_INT_LEVEL_HIGH));
+    CHECK(mpu6050_set_interrupt_drive(dev, MPU6050_INT_PUSH_PULL));
+    CHECK(mpu6050_set_interrupt_latch(dev, MPU6050_INT_LATCH_PULSE));
+    CHECK(mpu6050_reset_fifo(dev));
+    CHECK(mpu6050_set_fifo_enabled(dev, true));
+    CHECK(mpu6050_set_int_enabled(dev, MPU6050_INT_DATA_READY));
+
+    dev->fifo_frame_size = gyro ? 12 : 6;
+
+    return ESP_OK;
+}
+
+esp_err_t mpu6050_stop_fifo_stream(mpu6050_dev_t *dev)
+{
+    CHECK_ARG(dev);
+
+    CHECK(mpu6050_set_int_enabled(dev, 0));
+    CHECK(mpu6050_set_fifo_enabled(dev, false));
+    CHECK(write_reg(dev, MPU6050_REGISTER_FIFO_EN, 0));
+    dev->fifo_frame_size = 0;
+
+    return ESP_OK;
+}
+
+esp_err_t mpu6050_read_fifo_stream(mpu6050_dev_t *dev, mpu6050_raw_motion_t *frames, size_t max, size_t *count)
+{
+    CHECK_ARG(dev && frames && max && count && dev->fifo_frame_size);
+
+    const size_t frame_size = dev->fifo_frame_size;
+    uint16_t available;
+
+    *count = 0;
+    CHECK(mpu6050_get_fifo_count(dev, &available));
+    if (available + frame_size > MPU6050_FIFO_SIZE || available % frame_size)
+    {
+        CHECK(mpu6050_set_fifo_enabled(dev, false));
+        CHECK(mpu6050_reset_fifo(dev));
+        CHECK(mpu6050_set_fifo_enabled(dev, true));
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    size_t n = available / frame_size;
+    if (n > max)
+        n = max;
+    if (!n)
+        return ESP_OK;
+
+    // A frame is at most as large as mpu6050_raw_motion_t, so the bytes are decoded in
+    // place from the last frame: frame i is read before its slot or a later one is written.
+    uint8_t *raw = (uint8_t *)frames;
+    CHECK(mpu6050_get_fifo_bytes(dev, raw, n * frame_size));
+    for (size_t i = n; i-- > 0;)
+    {
+        const uint8_t *b = raw + i * frame_size;
+        mpu6050_raw_motion_t m = { 0 };
+
+        m.accel.x = (int16_t)((b[0] << 8) | b[1]);
+        m.accel.y = (int16_t)((b[2] << 8) | b[3]);
+        m.accel.z = (int16_t)((b[4] << 8) | b[5]);
+        if (frame_size == 12)
+        {
+            m.gyro.x = (int16_t)((b[6] << 8) | b[7]);
+            m.gyro.y = (int16_t)((b[8] << 8) | b[9]);
+            m.gyro.z = (int16_t)((b[10] << 8) | b[11]);
+        }
+        frames[i] = m;
+    }
+    *count = n;
+
+    return ESP_OK;
+}
+
 esp_err_t mpu6050_get_device_id(mpu6050_dev_t *dev, uint8_t *id)
 {
     return read_reg_bits(dev, MPU6050_REGISTER_WHO_AM_I, MPU6050_WHO_AM_I_BIT, MPU6050_WHO_AM_I_MASK, id);
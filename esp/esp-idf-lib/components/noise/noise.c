@@ -454,14 +454,186 @@ uint8_t inoise8_1d(uint16_t x)
     return qadd8(n, n);            //  0..255
 }
 
+// Row kernels of the fill functions, pData[i] is the scaled noise at (x + i * step, y, z)
+// as computed by the per point functions. The hashes of the lattice cell are only computed
+// again when x crosses into another cell, the y and z fades once per row.
+
+static void noise8_3d_row(uint8_t *pData, size_t num, uint16_t x, uint16_t step, uint16_t y, uint16_t z)
+{
+    uint8_t Y = y >> 8;
+    uint8_t Z = z >> 8;
+    int8_t yy = ((uint8_t)y >> 1) & 0x7F;
+    int8_t zz = ((uint8_t)z >> 1) & 0x7F;
+    uint8_t v = ease8InOutQuad(y);
+    uint8_t w = ease8InOutQuad(z);
+    uint8_t N = 0x80;
+
+    uint8_t h[8] = { 0 };
+    int cell = -1;
+    for (size_t i = 0; i < num; ++i, x += step)
+    {
+        uint8_t X = x >> 8;
+        if (X != cell)
+        {
+            uint8_t A  = P(X) + Y;
+            uint8_t AA = P(A) + Z;
+            uint8_t AB = P(A + 1) + Z;
+            uint8_t B  = P(X + 1) + Y;
+            uint8_t BA = P(B) + Z;
+            uint8_t BB = P(B + 1) + Z;
+            h[0] = P(AA);
+            h[1] = P(BA);
+            h[2] = P(AB);
+            h[3] = P(BB);
+            h[4] = P(AA + 1);
+            h[5] = P(BA + 1);
+            h[6] = P(AB + 1);
+            h[7] = P(BB + 1);
+            cell = X;
+        }
+
+        uint8_t u = ease8InOutQuad(x);
+        int8_t xx = ((uint8_t)x >> 1) & 0x7F;
+
+        int8_t X1 = lerp7by8(grad8_3d(h[0], xx, yy, zz), grad8_3d(h[1], xx - N, yy, zz), u);
+        int8_t X2 = lerp7by8(grad8_3d(h[2], xx, yy - N, zz), grad8_3d(h[3], xx - N, yy - N, zz), u);
+        int8_t X3 = lerp7by8(grad8_3d(h[4], xx, yy, zz - N), grad8_3d(h[5], xx - N, yy, zz - N), u);
+        int8_t X4 = lerp7by8(grad8_3d(h[6], xx, yy - N, zz - N), grad8_3d(h[7], xx - N, yy - N, zz - N), u);
+
+        int8_t n = lerp7by8(lerp7by8(X1, X2, v), lerp7by8(X3, X4, v), w);
+        n += 64;
+        pData[i] = qadd8(n, n);
+    }
+}
+
+static void noise8_2d_row(uint8_t *pData, size_t num, uint16_t x, uint16_t step, uint16_t y)
+{
+    uint8_t Y = y >> 8;
+    int8_t yy = ((uint8_t)y >> 1) & 0x7F;
+    uint8_t v = ease8InOutQuad(y);
+    uint8_t N = 0x80;
+
+    uint8_t h[4] = { 0 };
+    int cell = -1;
+    for (size_t i = 0; i < num; ++i, x += step)
+    {
+        uint8_t X = x >> 8;
+        if (X != cell)
+        {
+            uint8_t A = P(X) + Y;
+            uint8_t B = P(X + 1) + Y;
+            h[0] = P(P(A));
+            h[1] = P(P(B));
+            h[2] = P(P(A + 1));
+            h[3] = P(P(B + 1));
+            cell = X;
+        }
+
+        uint8_t u = ease8InOutQuad(x);
+        int8_t xx = ((uint8_t)x >> 1) & 0x7F;
+
+        int8_t X1 = lerp7by8(grad8_2d(h[0], xx, yy), grad8_2d(h[1], xx - N, yy), u);
+        int8_t X2 = lerp7by8(grad8_2d(h[2], xx, yy - N), grad8_2d(h[3], xx - N, yy - N), u);
+
+        int8_t n = lerp7by8(X1, X2, v);
+        n += 64;
+        pData[i] = qadd8(n, n);
+    }
+}
+
+static void noise16_3d_row(uint16_t *pData, size_t num, uint32_t x, uint32_t step, uint32_t y, uint32_t z)
+{
+    uint8_t Y = (y >> 16) & 0xFF;
+    uint8_t Z = (z >> 16) & 0xFF;
+    int16_t yy = ((y & 0xFFFF) >> 1) & 0x7FFF;
+    int16_t zz = ((z & 0xFFFF) >> 1) & 0x7FFF;
+    uint16_t v = ease16InOutQuad(y & 0xFFFF);
+    uint16_t w = ease16InOutQuad(z & 0xFFFF);
+    uint16_t N = 0x8000L;
+
+    uint8_t h[8] = { 0 };
+    int cell = -1;
+    for (size_t i = 0; i < num; ++i, x += step)
+    {
+        uint8_t X = (x >> 16) & 0xFF;
+        if (X != cell)
+        {
+            uint8_t A  = P(X) + Y;
+            uint8_t AA = P(A) + Z;
+            uint8_t AB = P(A + 1) + Z;
+            uint8_t B  = P(X + 1) + Y;
+            uint8_t BA = P(B) + Z;
+            uint8_t BB = P(B + 1) + Z;
+            h[0] = P(AA);
+            h[1] = P(BA);
+            h[2] = P(AB);
+            h[3] = P(BB);
+            h[4] = P(AA + 1);
+            h[5] = P(BA + 1);
+            h[6] = P(AB + 1);
+            h[7] = P(BB + 1);
+            cell = X;
+        }
+
+        uint16_t u = ease16InOutQuad(x & 0xFFFF);
+        int16_t xx = ((x & 0xFFFF) >> 1) & 0x7FFF;
+
+        int16_t X1 = lerp15by16(grad16_3d(h[0], xx, yy, zz), grad16_3d(h[1], xx - N, yy, zz), u);
+        int16_t X2 = lerp15by16(grad16_3d(h[2], xx, yy - N, zz), grad16_3d(h[3], xx - N, yy - N, zz), u);
+        int16_t X3 = lerp15by16(grad16_3d(h[4], xx, yy, zz - N), grad16_3d(h[5], xx - N, yy, zz - N), u);
+        int16_t X4 = lerp15by16(grad16_3d(h[6], xx, yy - N, zz - N), grad16_3d(h[7], xx - N, yy - N, zz - N), u);
+
+        int32_t ans = lerp15by16(lerp15by16(X1, X2, v), lerp15by16(X3, X4, v), w);
+        uint32_t pan = ans + 19052L;
+        pData[i] = (pan * 440L) >> 8;
+    }
+}
+
+static void noise16_2d_row(uint16_t *pData, size_t num, uint32_t x, uint32_t step, uint32_t y)
+{
+    uint8_t Y = y >> 16;
+    int16_t yy = ((y & 0xFFFF) >> 1) & 0x7FFF;
+    uint16_t v = ease16InOutQuad(y & 0xFFFF);
+    uint16_t N = 0x8000L;
+
+    uint8_t h[4] = { 0 };
+    int cell = -1;
+    for (size_t i = 0; i < num; ++i, x += step)
+    {
+        uint8_t X = x >> 16;
+        if (X != cell)
+        {
+            uint8_t A = P(X) + Y;
+            uint8_t B = P(X + 1) + Y;
+            h[0] = P(P(A));
+            h[1] = P(P(B));
+            h[2] = P(P(A + 1));
+            h[3] = P(P(B + 1));
+            cell = X;
+        }
+
+        uint16_t u = ease16InOutQuad(x & 0xFFFF);
+        int16_t xx = ((x & 0xFFFF) >> 1) & 0x7FFF;
+
+        int16_t X1 = lerp15by16(grad16_2d(h[0], xx, yy), grad16_2d(h[1], xx - N, yy), u);
+        int16_t X2 = lerp15by16(grad16_2d(h[2], xx, yy - N), grad16_2d(h[3], xx - N, yy - N), u);
+
+        int32_t ans = lerp15by16(X1, X2, v);
+        uint32_t pan = ans + 17308L;
+        pData[i] = (pan * 484L) >> 8;
+    }
+}
+
 void fill_raw_noise8(uint8_t *pData, uint8_t num_points, uint8_t octaves, uint16_t x, int scale, uint16_t time)
 {
+    uint8_t row[UINT8_MAX];
     uint32_t _xx = x;
     uint32_t scx = scale;
     for (int o = 0; o < octaves; ++o)
     {
-        for (int i = 0, xx = _xx; i < num_points; ++i, xx += scx)
-            pData[i] = qadd8(pData[i], inoise8_2d(xx, time) >> o);
+        noise8_2d_row(row, num_points, _xx, scx, time);
+        for (int i = 0; i < num_points; ++i)
+            pData[i] = qadd8(pData[i], row[i] >> o);
 
         _xx <<= 1;
         scx <<= 1;
@@ -470,13 +642,15 @@ void fill_raw_noise8(uint8_t *pData, uint8_t num_points, uint8_t octaves, uint16
 
 void fill_raw_noise16into8(uint8_t *pData, uint8_t num_points, uint8_t octaves, uint32_t x, int scale, uint32_t time)
 {
+    uint16_t row[UINT8_MAX];
     uint32_t _xx = x;
     uint32_t scx = scale;
     for (int o = 0; o < octaves; ++o)
     {
-        for (int i = 0, xx = _xx; i < num_points; ++i, xx += scx)
+        noise16_2d_row(row, num_points, _xx, scx, time);
+        for (int i = 0; i < num_points; ++i)
         {
-            uint32_t accum = (inoise16_2d(xx, time)) >> o;
+            uint32_t accum = row[i] >> o;
             accum += (pData[i] << 8);
             if (accum > 65535)
             {
@@ -489,3 +663,52 @@ void fill_raw_noise16into8(uint8_t *pData, uint8_t num_points, uint8_t octaves,
         scx <<= 1;
     }
 }
+
+void fill_noise8_2d(uint8_t *pData, size_t width, size_t height, uint16_t x, int scalex, uint16_t y, int scaley)
+{
+    for (size_t row = 0; row < height; ++row, y += scaley)
+        noise8_2d_row(pData + row * width, width, x, scalex, y);
+}
+
+void fill_noise8_3d(uint8_t *pData, size_t width, size_t height, uint16_t x, int scalex, uint16_t y, int scaley,
+        uint16_t z)
+{
+    for (size_t row = 0; row < height; ++row, y += scaley)
+        noise8_3d_row(pData + row * width, width, x, scalex, y, z);
+}
+
+// The 16 bit rows are computed in chunks, then shifted down to 8 bits
+#define NOISE16_CHUNK 64
+
+void fill_noise16into8_2d(uint8_t *pData, size_t width, size_t height, uint32_t x, int scalex, uint32_t y, int scaley)
+{
+    uint16_t chunk[NOISE16_CHUNK];
+    for (size_t row = 0; row < height; ++row, y += scaley)
+    {
+        uint8_t *out = pData + row * width;
+        for (size_t i = 0; i < width; i += NOISE16_CHUNK)
+        {
+            size_t n = width - i < NOISE16_CHUNK ? width - i : NOISE16_CHUNK;
+            noise16_2d_row(chunk, n, x + i * (uint32_t)scalex, scalex, y);
+            for (size_t j = 0; j < n; ++j)
+                out[i + j] = chunk[j] >> 8;
+        }
+    }
+}
+
+void fill_noise16into8_3d(uint8_t *pData, size_t width, size_t height, uint32_t x, int scalex, uint32_t y, int scaley,
+        uint32_t z)
+{
+    uint16_t chunk[NOISE16_CHUNK];
+    for (size_t row = 0; row < height; ++row, y += scaley)
+    {
+        uint8_t *out = pData + row * width;
+        for (size_t i = 0; i < width; i += NOISE16_CHUNK)
+        {
+            size_t n = width - i < NOISE16_CHUNK ? width - i : NOISE16_CHUNK;
+            noise16_3d_row(chunk, n, x + i * (uint32_t)scalex, scalex, y, z);
+            for (size_t j = 0; j < n; ++j)
+                out[i + j] = chunk[j] >> 8;
+        }
+    }
+}
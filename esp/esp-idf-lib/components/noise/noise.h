@@ -24,6 +24,7 @@
 #ifndef __NOISE_H__
 #define __NOISE_H__
 
+#include <stddef.h>
 #include <lib8tion.h>
 
 ///@file noise.h
@@ -91,6 +92,29 @@ int8_t inoise8_1d_raw(uint16_t x);
 void fill_raw_noise8(uint8_t *pData, uint8_t num_points, uint8_t octaves, uint16_t x, int scale, uint16_t time);
 void fill_raw_noise16into8(uint8_t *pData, uint8_t num_points, uint8_t octaves, uint32_t x, int scale, uint32_t time);
 ///@}
+
+///@name noise field functions
+///@{
+/// Fill a width x height array of 8-bit values, row after row, with the scaled noise:
+/// pData[row * width + col] is inoise8_2d(x + col * scalex, y + row * scaley) for fill_noise8_2d(),
+/// inoise16_2d(...) >> 8 for fill_noise16into8_2d(), and likewise in 3d at the z position.
+/// The results are the same as those of the per point functions, but the hashes of a lattice
+/// cell are computed once for all the points of a row in it, and the y and z fades once per row.
+///@param pData the array of data to write into, width * height values
+///@param width the number of points per row
+///@param height the number of rows
+///@param x the x position of the first point of each row
+///@param scalex the scale (distance) between x points
+///@param y the y position of the first row
+///@param scaley the scale (distance) between rows
+///@param z the z position of the field for 3d functions
+void fill_noise8_2d(uint8_t *pData, size_t width, size_t height, uint16_t x, int scalex, uint16_t y, int scaley);
+void fill_noise8_3d(uint8_t *pData, size_t width, size_t height, uint16_t x, int scalex, uint16_t y, int scaley,
+        uint16_t z);
+void fill_noise16into8_2d(uint8_t *pData, size_t width, size_t height, uint32_t x, int scalex, uint32_t y, int scaley);
+void fill_noise16into8_3d(uint8_t *pData, size_t width, size_t height, uint32_t x, int scalex, uint32_t y, int scaley,
+        uint32_t z);
+///@}
 ///@}
 
 #ifdef __cplusplus
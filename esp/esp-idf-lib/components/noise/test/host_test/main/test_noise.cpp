@@ -0,0 +1,199 @@
+#define CATCH_CONFIG_MAIN // This tells the catch header to generate a main
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <vector>
+#include "catch.hpp"
+#include "noise.h"
+
+using namespace std::chrono;
+
+static constexpr size_t width = 32;
+static constexpr size_t height = 32;
+
+// Steps smaller than a lattice cell, a whole one and larger ones, negative ones and ones wrapping around
+static const int steps8[] = { 1, 7, 37, 255, 256, 300, 4099, -23, -300 };
+static const int steps16[] = { 1, 311, 5000, 65535, 65536, 80000, 1 << 20, -4000, -70000 };
+
+// fill_raw_noise8() and fill_raw_noise16into8() as they were before the row kernels
+static void fill_raw_noise8_reference(uint8_t *pData, uint8_t num_points, uint8_t octaves, uint16_t x, int scale,
+                                      uint16_t time)
+{
+    uint32_t _xx = x;
+    uint32_t scx = scale;
+    for (int o = 0; o < octaves; ++o)
+    {
+        for (int i = 0, xx = _xx; i < num_points; ++i, xx += scx)
+            pData[i] = qadd8(pData[i], inoise8_2d(xx, time) >> o);
+
+        _xx <<= 1;
+        scx <<= 1;
+    }
+}
+
+static void fill_raw_noise16into8_reference(uint8_t *pData, uint8_t num_points, uint8_t octaves, uint32_t x, int scale,
+                                            uint32_t time)
+{
+    uint32_t _xx = x;
+    uint32_t scx = scale;
+    for (int o = 0; o < octaves; ++o)
+    {
+        for (int i = 0, xx = _xx; i < num_points; ++i, xx += scx)
+        {
+            uint32_t accum = (inoise16_2d(xx, time)) >> o;
+            accum += (pData[i] << 8);
+            if (accum > 65535)
+                accum = 65535;
+            pData[i] = accum >> 8;
+        }
+
+        _xx <<= 1;
+        scx <<= 1;
+    }
+}
+
+TEST_CASE("fill_noise8_2d and fill_noise8_3d match the per point functions", "[noise]")
+{
+    std::vector<uint8_t> field(width * height);
+    size_t mismatches = 0;
+
+    for (uint16_t x : { 0, 200, 65500 })
+    {
+        for (int scalex : steps8)
+        {
+            for (int scaley : { 3, 256, -1000 })
+            {
+                const uint16_t y = x * 7 + 13;
+                const uint16_t z = x * 3 + 129;
+                fill_noise8_2d(field.data(), width, height, x, scalex, y, scaley);
+                for (size_t row = 0; row < height; row++)
+                    for (size_t col = 0; col < width; col++)
+                        mismatches += field[row * width + col]
+                            != inoise8_2d(x + col * scalex, y + row * scaley);
+
+                fill_noise8_3d(field.data(), width, height, x, scalex, y, scaley, z);
+                for (size_t row = 0; row < height; row++)
+                    for (size_t col = 0; col < width; col++)
+                        mismatches += field[row * width + col]
+                            != inoise8_3d(x + col * scalex, y + row * scaley, z);
+            }
+        }
+    }
+    CHECK(mismatches == 0);
+}
+
+TEST_CASE("fill_noise16into8_2d and fill_noise16into8_3d match the per point functions", "[noise]")
+{
+    // Wider than a chunk of the 16 bit rows
+    const size_t wide = 150;
+    std::vector<uint8_t> field(wide * 8);
+    size_t mismatches = 0;
+
+    for (uint32_t x : { 0u, 40000u, 0xFFFFF000u })
+    {
+        for (int scalex : steps16)
+        {
+            const uint32_t y = x * 5 + 77;
+            const uint32_t z = x * 3 + 0x18000;
+            const int scaley = 9000;
+            fill_noise16into8_2d(field.data(), wide, 8, x, scalex, y, scaley);
+            for (size_t row = 0; row < 8; row++)
+                for (size_t col = 0; col < wide; col++)
+                    mismatches += field[row * wide + col]
+                        != inoise16_2d(x + col * scalex, y + row * scaley) >> 8;
+
+            fill_noise16into8_3d(field.data(), wide, 8, x, scalex, y, scaley, z);
+            for (size_t row = 0; row < 8; row++)
+                for (size_t col = 0; col < wide; col++)
+                    mismatches += field[row * wide + col]
+                        != inoise16_3d(x + col * scalex, y + row * scaley, z) >> 8;
+        }
+    }
+    CHECK(mismatches == 0);
+}
+
+TEST_CASE("fill_raw_noise8 and fill_raw_noise16into8 are unchanged", "[noise]")
+{
+    for (uint8_t num : { 1, 17, 255 })
+    {
+        for (uint8_t octaves : { 1, 3, 8 })
+        {
+            for (int scale : { 1, 57, 300, -20 })
+            {
+                uint8_t data[255], expected[255];
+                for (size_t i = 0; i < num; i++)
+                    data[i] = expected[i] = i * 3;
+                fill_raw_noise8(data, num, octaves, 1234, scale, 4321);
+                fill_raw_noise8_reference(expected, num, octaves, 1234, scale, 4321);
+                for (size_t i = 0; i < num; i++)
+                    CHECK(data[i] == expected[i]);
+
+                for (size_t i = 0; i < num; i++)
+                    data[i] = expected[i] = i * 5;
+                fill_raw_noise16into8(data, num, octaves, 0x12345, scale * 200, 0x54321);
+                fill_raw_noise16into8_reference(expected, num, octaves, 0x12345, scale * 200, 0x54321);
+                for (size_t i = 0; i < num; i++)
+                    CHECK(data[i] == expected[i]);
+            }
+        }
+    }
+}
+
+// Runs the fill on a field for about 200 ms, returns the points per second
+static double points_per_second(const std::function<void()> &fill)
+{
+    size_t fields = 0;
+    auto start = steady_clock::now();
+    auto elapsed = steady_clock::duration::zero();
+    do
+    {
+        fill();
+        fields++;
+        elapsed = steady_clock::now() - start;
+    } while (elapsed < milliseconds(200));
+    return fields * width * height / duration<double>(elapsed).count();
+}
+
+static void report(const char *name, double point, double field)
+{
+    printf("%-20s per point %8.2f Mpt/s, field %8.2f Mpt/s, x%.1f\n", name, point / 1e6, field / 1e6, field / point);
+}
+
+TEST_CASE("Noise field throughput", "[bench]")
+{
+    std::vector<uint8_t> field(width * height);
+    // A typical effect: a few points per lattice cell
+    const int scale = 30;
+    uint16_t t = 0;
+
+    double point = points_per_second([&] {
+        t++;
+        for (size_t row = 0; row < height; row++)
+            for (size_t col = 0; col < width; col++)
+                field[row * width + col] = inoise8_2d(col * scale, row * scale + t);
+    });
+    double batch = points_per_second([&] { fill_noise8_2d(field.data(), width, height, 0, scale, ++t, scale); });
+    report("inoise8_2d", point, batch);
+
+    point = points_per_second([&] {
+        t++;
+        for (size_t row = 0; row < height; row++)
+            for (size_t col = 0; col < width; col++)
+                field[row * width + col] = inoise8_3d(col * scale, row * scale, t);
+    });
+    batch = points_per_second([&] { fill_noise8_3d(field.data(), width, height, 0, scale, 0, scale, ++t); });
+    report("inoise8_3d", point, batch);
+
+    point = points_per_second([&] {
+        t++;
+        for (size_t row = 0; row < height; row++)
+            for (size_t col = 0; col < width; col++)
+                field[row * width + col] = inoise16_3d(col * scale * 256, row * scale * 256, t * 256) >> 8;
+    });
+    batch = points_per_second([&] {
+        fill_noise16into8_3d(field.data(), width, height, 0, scale * 256, 0, scale * 256, ++t * 256);
+    });
+    report("inoise16_3d", point, batch);
+
+    CHECK(batch > 0);
+}
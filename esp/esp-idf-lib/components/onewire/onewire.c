@@ -60,6 +60,18 @@
 #define ONEWIRE_SKIP_ROM   0xcc
 #define ONEWIRE_SEARCH     0xf0
 
+#ifdef CONFIG_ONEWIRE_RMT
+
+// Bit level access of the RMT backend, see onewire_rmt.c. The byte level
+// functions, reset and power are implemented there as well.
+int onewire_rmt_read_bit(gpio_num_t pin);
+bool onewire_rmt_write_bit(gpio_num_t pin, bool v);
+
+#define _onewire_read_bit onewire_rmt_read_bit
+#define _onewire_write_bit onewire_rmt_write_bit
+
+#else
+
 #if HELPER_TARGET_IS_ESP8266
 #define PORT_ENTER_CRITICAL portENTER_CRITICAL()
 #define PORT_EXIT_CRITICAL portEXIT_CRITICAL()
@@ -226,28 +238,6 @@ bool onewire_read_bytes(gpio_num_t pin, uint8_t *buf, size_t count)
     return true;
 }
 
-bool onewire_select(gpio_num_t pin, onewire_addr_t addr)
-{
-    uint8_t i;
-
-    if (!onewire_write(pin, ONEWIRE_SELECT_ROM))
-        return false;
-
-    for (i = 0; i < 8; i++)
-    {
-        if (!onewire_write(pin, addr & 0xff))
-            return false;
-        addr >>= 8;
-    }
-
-    return true;
-}
-
-bool onewire_skip_rom(gpio_num_t pin)
-{
-    return onewire_write(pin, ONEWIRE_SKIP_ROM);
-}
-
 bool onewire_power(gpio_num_t pin)
 {
     // Make sure the bus is not being held low before driving it high, or we
@@ -266,6 +256,28 @@ void onewire_depower(gpio_num_t pin)
     setup_pin(pin, true);
 }
 
+#endif // CONFIG_ONEWIRE_RMT
+
+bool onewire_select(gpio_num_t pin, onewire_addr_t addr)
+{
+    uint8_t buf[9];
+
+    // Sent as one transfer, the RMT backend does it without a gap
+    buf[0] = ONEWIRE_SELECT_ROM;
+    for (int i = 1; i < 9; i++)
+    {
+        buf[i] = addr & 0xff;
+        addr >>= 8;
+    }
+
+    return onewire_write_bytes(pin, buf, sizeof(buf));
+}
+
+bool onewire_skip_rom(gpio_num_t pin)
+{
+    return onewire_write(pin, ONEWIRE_SKIP_ROM);
+}
+
 void onewire_search_start(onewire_search_t *search)
 {
     // reset the search state
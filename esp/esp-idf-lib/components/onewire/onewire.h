@@ -44,6 +44,9 @@
  * (https://www.pjrc.com/teensy/td_libs_OneWire.html), by Jim Studt, Paul
  * Stoffregen, and a host of others.
  *
+ * With `CONFIG_ONEWIRE_RMT` the bus timing is done by the RMT peripheral
+ * instead, the calling task sleeps during the transfers.
+ *
  * The original code is licensed under the MIT license.  The CRC code was taken
  * (at least partially) from Dallas Semiconductor sample code, which was licensed
  * under an MIT license with an additional clause (prohibiting inappropriate use
@@ -191,6 +194,9 @@ bool onewire_read_bytes(gpio_num_t pin, uint8_t *buf, size_t count);
  *       while something else is pulling it low (which could cause a reset or
  *       damage the ESP32/ESP8266).
  *
+ * @note Not available with the RMT backend (`CONFIG_ONEWIRE_RMT`), which
+ *       always returns `false`.
+ *
  * @param pin    The GPIO pin connected to the 1-Wire bus.
  *
  * @return `true` on success, `false` on error.
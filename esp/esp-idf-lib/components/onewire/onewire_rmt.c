@@ -0,0 +1,376 @@
+/*
+ * Copyright (c) 2014 zeroday nodemcu.com
+ * Copyright (c) 2016 Grzegorz Hetman <ghetman@gmail.com>
+ * Copyright (c) 2016 Alex Stewart <foogod@gmail.com>
+ * Copyright (c) 2018 Ruslan V. Uss <unclerus@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file onewire_rmt.c
+ *
+ * RMT backend of the 1-Wire bus. The slots are generated by the RMT TX channel
+ * and sampled by an RX channel on the same open-drain pin, so the CPU neither
+ * busy-waits nor disables interrupts during a transfer: the calling task
+ * sleeps until the peripheral is done.
+ *
+ * The channels of a bus are created on its first use and kept.
+ */
+
+#include <sdkconfig.h>
+
+#ifdef CONFIG_ONEWIRE_RMT
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include <driver/rmt_tx.h>
+#include <driver/rmt_rx.h>
+#include <soc/soc_caps.h>
+#include <esp_attr.h>
+#include <esp_log.h>
+#include "onewire.h"
+
+// All durations in microseconds, 1 tick = 1 us
+#define RMT_RESOLUTION_HZ 1000000
+
+#define RESET_LOW_US        480
+#define RESET_RELEASE_US    70
+#define PRESENCE_MIN_US     60
+#define RESET_IDLE_NS       1000000
+
+#define SLOT_START_US       2
+#define SLOT_US             60
+#define RECOVERY_US         5
+#define SAMPLE_US           15
+#define SLOT_IDLE_NS        ((SLOT_US + RECOVERY_US) * 2 * 1000)
+
+#define RX_MIN_NS           1000
+#define RX_SYMBOLS          16
+#define TIMEOUT_MS          20
+
+typedef struct
+{
+    gpio_num_t pin;
+    bool used;
+    bool ready;
+    rmt_channel_handle_t tx;
+    rmt_channel_handle_t rx;
+    rmt_encoder_handle_t copy_encoder;
+    rmt_encoder_handle_t bytes_encoder;
+    QueueHandle_t rx_done;
+    rmt_symbol_word_t rx_symbols[RX_SYMBOLS];
+} bus_t;
+
+static const char *TAG = "onewire_rmt";
+
+static bus_t buses[CONFIG_ONEWIRE_RMT_MAX_BUSES];
+static portMUX_TYPE buses_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static const rmt_symbol_word_t reset_symbol = {
+    .level0 = 0, .duration0 = RESET_LOW_US,
+    .level1 = 1, .duration1 = RESET_RELEASE_US
+};
+
+static const rmt_symbol_word_t bit_symbols[2] = {
+    { .level0 = 0, .duration0 = SLOT_US, .level1 = 1, .duration1 = RECOVERY_US },
+    { .level0 = 0, .duration0 = SLOT_START_US, .level1 = 1, .duration1 = SLOT_US + RECOVERY_US - SLOT_START_US },
+};
+
+// Read slots are write-1 slots, a device sending 0 keeps the bus low longer
+static const rmt_symbol_word_t read_symbols[8] = {
+    [0 ... 7] = { .level0 = 0, .duration0 = SLOT_START_US, .level1 = 1, .duration1 = SLOT_US + RECOVERY_US - SLOT_START_US },
+};
+
+static const rmt_transmit_config_t tx_config = {
+    .loop_count = 0,
+    .flags.eot_level = 1,
+};
+
+static bool IRAM_ATTR rx_done_cb(rmt_channel_handle_t channel, const rmt_rx_done_event_data_t *edata, void *user_data)
+{
+    BaseType_t woken = pdFALSE;
+    size_t num = edata->num_symbols;
+    xQueueSendFromISR(((bus_t *)user_data)->rx_done, &num, &woken);
+    return woken == pdTRUE;
+}
+
+static void free_bus(bus_t *bus)
+{
+    if (bus->tx)
+    {
+        rmt_disable(bus->tx);
+        rmt_del_channel(bus->tx);
+    }
+    if (bus->rx)
+    {
+        rmt_disable(bus->rx);
+        rmt_del_channel(bus->rx);
+    }
+    if (bus->copy_encoder)
+        rmt_del_encoder(bus->copy_encoder);
+    if (bus->bytes_encoder)
+        rmt_del_encoder(bus->bytes_encoder);
+    if (bus->rx_done)
+        vQueueDelete(bus->rx_done);
+    bus->tx = bus->rx = NULL;
+    bus->copy_encoder = bus->bytes_encoder = NULL;
+    bus->rx_done = NULL;
+}
+
+static esp_err_t init_bus(bus_t *bus)
+{
+    esp_err_t res;
+
+    bus->rx_done = xQueueCreate(1, sizeof(size_t));
+    if (!bus->rx_done)
+        return ESP_ERR_NO_MEM;
+
+    // RX first, TX loops its output back to it on the same pin
+    rmt_rx_channel_config_t rx_cfg = {
+        .gpio_num = bus->pin,
+        .clk_src = RMT_CLK_SRC_DEFAULT,
+        .resolution_hz = RMT_RESOLUTION_HZ,
+        .mem_block_symbols = SOC_RMT_MEM_WORDS_PER_CHANNEL,
+    };
+    if ((res = rmt_new_rx_channel(&rx_cfg, &bus->rx)) != ESP_OK)
+        return res;
+
+    rmt_tx_channel_config_t tx_cfg = {
+        .gpio_num = bus->pin,
+        .clk_src = RMT_CLK_SRC_DEFAULT,
+        .resolution_hz = RMT_RESOLUTION_HZ,
+        .mem_block_symbols = SOC_RMT_MEM_WORDS_PER_CHANNEL,
+        .trans_queue_depth = 4,
+        .flags.io_loop_back = 1,
+        .flags.io_od_mode = 1,
+    };
+    if ((res = rmt_new_tx_channel(&tx_cfg, &bus->tx)) != ESP_OK)
+        return res;
+
+    rmt_copy_encoder_config_t copy_cfg = { 0 };
+    if ((res = rmt_new_copy_encoder(&copy_cfg, &bus->copy_encoder)) != ESP_OK)
+        return res;
+
+    rmt_bytes_encoder_config_t bytes_cfg = {
+        .bit0 = bit_symbols[0],
+        .bit1 = bit_symbols[1],
+        .flags.msb_first = 0,
+    };
+    if ((res = rmt_new_bytes_encoder(&bytes_cfg, &bus->bytes_encoder)) != ESP_OK)
+        return res;
+
+    rmt_rx_event_callbacks_t cbs = { .on_recv_done = rx_done_cb };
+    if ((res = rmt_rx_register_event_callbacks(bus->rx, &cbs, bus)) != ESP_OK)
+        return res;
+
+    gpio_set_pull_mode(bus->pin, GPIO_PULLUP_ONLY);
+
+    if ((res = rmt_enable(bus->rx)) != ESP_OK)
+        return res;
+    return rmt_enable(bus->tx);
+}
+
+// Returns the bus of the pin, its channels are created on the first call
+static bus_t *get_bus(gpio_num_t pin)
+{
+    bus_t *bus;
+    bool found;
+
+    while (true)
+    {
+        bus = NULL;
+        found = false;
+
+        portENTER_CRITICAL(&buses_mux);
+        for (size_t i = 0; i < CONFIG_ONEWIRE_RMT_MAX_BUSES; i++)
+        {
+            if (buses[i].used && buses[i].pin == pin)
+            {
+                bus = buses + i;
+                found = true;
+                break;
+            }
+            if (!bus && !buses[i].used)
+                bus = buses + i;
+        }
+        if (found && bus->ready)
+        {
+            portEXIT_CRITICAL(&buses_mux);
+            return bus;
+        }
+        if (!found && bus)
+        {
+            // Reserve the slot, the channels can't be created in a critical section
+            bus->pin = pin;
+            bus->used = true;
+        }
+        portEXIT_CRITICAL(&buses_mux);
+
+        if (!found)
+            break;
+        // Still being set up by another task, its channels are ready in a
+        // few ticks or the slot is released if the setup fails
+        vTaskDelay(1);
+    }
+
+    if (!bus)
+    {
+        ESP_LOGE(TAG, "No free bus for GPIO%d, raise ONEWIRE_RMT_MAX_BUSES", pin);
+        return NULL;
+    }
+
+    esp_err_t res = init_bus(bus);
+    if (res != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Could not set up RMT for GPIO%d: %s", pin, esp_err_to_name(res));
+        free_bus(bus);
+    }
+
+    // Published under the lock, tasks waiting for the bus see the channels or the free slot
+    portENTER_CRITICAL(&buses_mux);
+    if (res == ESP_OK)
+        bus->ready = true;
+    else
+        bus->used = false;
+    portEXIT_CRITICAL(&buses_mux);
+    return res == ESP_OK ? bus : NULL;
+}
+
+// Sends the symbols while the RX channel records the bus, returns the number of recorded symbols
+static int transfer(bus_t *bus, const rmt_symbol_word_t *symbols, size_t count, uint32_t idle_ns)
+{
+    const rmt_receive_config_t rx_config = {
+        .signal_range_min_ns = RX_MIN_NS,
+        .signal_range_max_ns = idle_ns,
+    };
+    size_t received;
+
+    xQueueReset(bus->rx_done);
+    if (rmt_receive(bus->rx, bus->rx_symbols, sizeof(bus->rx_symbols), &rx_config) != ESP_OK)
+        return -1;
+    if (rmt_transmit(bus->tx, bus->copy_encoder, symbols, count * sizeof(rmt_symbol_word_t), &tx_config) != ESP_OK)
+        return -1;
+    if (xQueueReceive(bus->rx_done, &received, pdMS_TO_TICKS(TIMEOUT_MS)) != pdTRUE)
+    {
+        rmt_disable(bus->rx);
+        rmt_enable(bus->rx);
+        return -1;
+    }
+    if (rmt_tx_wait_all_done(bus->tx, TIMEOUT_MS) != ESP_OK)
+        return -1;
+
+    return received;
+}
+
+// Reads up to 8 bits, LSB first
+static int read_bits(gpio_num_t pin, size_t count)
+{
+    bus_t *bus = get_bus(pin);
+    if (!bus)
+        return -1;
+
+    int received = transfer(bus, read_symbols, count, SLOT_IDLE_NS);
+    if (received < (int)count)
+        return -1;
+
+    int r = 0;
+    for (size_t i = 0; i < count; i++)
+        if (bus->rx_symbols[i].duration0 < SAMPLE_US)
+            r |= 1 << i;
+    return r;
+}
+
+bool onewire_reset(gpio_num_t pin)
+{
+    bus_t *bus = get_bus(pin);
+    if (!bus)
+        return false;
+
+    // Our own reset pulse first, then the presence pulse of the devices.
+    // The receive ends after the bus has been idle for longer than a
+    // reset, so the devices are ready for the next command.
+    int received = transfer(bus, &reset_symbol, 1, RESET_IDLE_NS);
+    return received >= 2 && bus->rx_symbols[1].level0 == 0
+        && bus->rx_symbols[1].duration0 >= PRESENCE_MIN_US;
+}
+
+bool onewire_write_bytes(gpio_num_t pin, const uint8_t *buf, size_t count)
+{
+    bus_t *bus = get_bus(pin);
+    if (!bus)
+        return false;
+
+    if (rmt_transmit(bus->tx, bus->bytes_encoder, buf, count, &tx_config) != ESP_OK)
+        return false;
+    // 8 slots of 65 us per byte
+    return rmt_tx_wait_all_done(bus->tx, TIMEOUT_MS + count) == ESP_OK;
+}
+
+bool onewire_write(gpio_num_t pin, uint8_t v)
+{
+    return onewire_write_bytes(pin, &v, 1);
+}
+
+int onewire_read(gpio_num_t pin)
+{
+    return read_bits(pin, 8);
+}
+
+bool onewire_read_bytes(gpio_num_t pin, uint8_t *buf, size_t count)
+{
+    // A byte per receive, so the symbols fit in the channel memory
+    for (size_t i = 0; i < count; i++)
+    {
+        int b = read_bits(pin, 8);
+        if (b < 0)
+            return false;
+        buf[i] = b;
+    }
+    return true;
+}
+
+int onewire_rmt_read_bit(gpio_num_t pin)
+{
+    return read_bits(pin, 1);
+}
+
+bool onewire_rmt_write_bit(gpio_num_t pin, bool v)
+{
+    bus_t *bus = get_bus(pin);
+    if (!bus)
+        return false;
+
+    if (rmt_transmit(bus->tx, bus->copy_encoder, &bit_symbols[v], sizeof(rmt_symbol_word_t), &tx_config) != ESP_OK)
+        return false;
+    return rmt_tx_wait_all_done(bus->tx, TIMEOUT_MS) == ESP_OK;
+}
+
+bool onewire_power(gpio_num_t pin)
+{
+    // The pin belongs to the open-drain RMT channels, strong pull-up is not available
+    return false;
+}
+
+void onewire_depower(gpio_num_t pin)
+{
+}
+
+#endif // CONFIG_ONEWIRE_RMT
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int gpio_num_t;
+
+typedef enum
+{
+    GPIO_PULLUP_ONLY,
+} gpio_pull_mode_t;
+
+esp_err_t gpio_set_pull_mode(gpio_num_t gpio_num, gpio_pull_mode_t pull);
+
+#ifdef __cplusplus
+}
+#endif
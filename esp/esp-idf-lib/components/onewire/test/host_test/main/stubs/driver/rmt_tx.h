@@ -0,0 +1,3 @@
+#pragma once
+
+#include "driver/rmt_types.h"
@@ -0,0 +1,5 @@
+#pragma once
+
+// The RMT backend is built as for an esp32 target
+#define HELPER_TARGET_IS_ESP32     (1)
+#define HELPER_TARGET_IS_ESP8266   (0)
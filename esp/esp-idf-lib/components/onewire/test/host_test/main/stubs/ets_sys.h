@@ -0,0 +1,3 @@
+#pragma once
+
+// Only used by the bit-banging backend, which is not built
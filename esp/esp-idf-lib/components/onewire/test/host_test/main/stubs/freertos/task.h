@@ -0,0 +1,13 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void vTaskDelay(TickType_t ticks);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,3 @@
+#pragma once
+
+#define SOC_RMT_MEM_WORDS_PER_CHANNEL 48
@@ -0,0 +1,570 @@
+#define CATCH_CONFIG_MAIN // This tells the catch header to generate a main
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "catch.hpp"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "driver/rmt_tx.h"
+#include "driver/rmt_rx.h"
+#include "esp_timer.h"
+#include "onewire.h"
+#include "ds18x20.h"
+
+using namespace std::chrono;
+
+static constexpr gpio_num_t sensor_pin = 4;
+
+/**
+ * Simulated bus on sensor_pin: DS18B20 devices answering the commands sent with the
+ * bytes encoder, and the symbols the RX channel records for the slots sent with the
+ * copy encoder. The other pins have no devices.
+ */
+struct Bus {
+    struct Device {
+        onewire_addr_t rom;
+        int16_t raw;
+    };
+    std::vector<Device> devices = {
+        { 0x1100000000000128ULL, 0x0191 },      // 25.0625
+        { 0x2200000000000228ULL, (int16_t)0xff5e }, // -10.125
+        { 0x3300000000000328ULL, 0x07d0 },      // 125
+    };
+    int corrupt = -1;                           // device sending a bad scratchpad crc
+
+    // Reset: how long the devices pull the bus low after our reset pulse, 0 for no device
+    uint16_t presence_us = 120;
+    // Read slots: how long the bus stays low for a 1 and a 0 sent by a device
+    uint16_t one_low_us = 3;
+    uint16_t zero_low_us = 35;
+    bool rx_lost = false;                       // the receive never completes
+    bool rx_short = false;                      // a slot is missing from the receive
+
+    int converts = 0;
+    int transfers = 0;
+
+    // Device side of the protocol
+    enum { ROM, MATCH, FUNCTION, READ } state = ROM;
+    int selected = -1;
+    std::vector<uint8_t> match;
+    std::vector<uint8_t> out;
+    size_t out_bits = 0;
+
+    void reset()
+    {
+        state = ROM;
+        selected = -1;
+    }
+
+    void write_byte(uint8_t b)
+    {
+        switch (state) {
+        case ROM:
+            if (b == 0xcc) {
+                selected = -1;
+                state = FUNCTION;
+            } else if (b == 0x55) {
+                match.clear();
+                state = MATCH;
+            }
+            break;
+        case MATCH:
+            match.push_back(b);
+            if (match.size() == 8) {
+                onewire_addr_t addr = 0;
+                for (int i = 7; i >= 0; i--)
+                    addr = addr << 8 | match[i];
+                selected = -1;
+                for (size_t i = 0; i < devices.size(); i++)
+                    if (devices[i].rom == addr)
+                        selected = i;
+                state = FUNCTION;
+            }
+            break;
+        case FUNCTION:
+            if (b == 0x44) {
+                converts++;
+            } else if (b == 0xbe && selected >= 0) {
+                int16_t raw = devices[selected].raw;
+                out = { (uint8_t)(raw & 0xff), (uint8_t)(raw >> 8), 0, 0, 0x7f, 0xff, 0x0c, 0x10 };
+                out.push_back(onewire_crc8(out.data(), 8));
+                if (selected == corrupt)
+                    out[3] ^= 1;
+                out_bits = 0;
+                state = READ;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    int read_bit()
+    {
+        if (state != READ || out_bits >= out.size() * 8)
+            return 1;                           // nobody pulls the bus low
+        int bit = out[out_bits / 8] >> (out_bits % 8) & 1;
+        out_bits++;
+        return bit;
+    }
+};
+
+static Bus bus;
+
+// Driver side of the simulation
+struct rmt_channel {
+    gpio_num_t pin;
+    bool rx;
+    rmt_rx_done_callback_t on_recv_done = nullptr;
+    void *user_data = nullptr;
+    rmt_symbol_word_t *buffer = nullptr;
+    size_t capacity = 0;
+    bool receiving = false;
+    int restarts = 0;
+};
+
+struct rmt_encoder {
+    bool bytes;
+};
+
+static std::mutex sim_mutex;                    // the channels of a bus are used by one task at a time
+static std::list<rmt_channel> channels;
+static rmt_encoder copy_encoder = { false }, bytes_encoder = { true };
+static std::atomic<int> setup_calls { 0 };
+static std::atomic<bool> hold_setup { false };  // blocks the setup of a bus, as a preempted task would
+static std::atomic<int> fail_setup { 0 };       // number of bus setups to fail
+static std::atomic<int> delays { 0 };
+
+static rmt_channel *rx_channel(gpio_num_t pin)
+{
+    for (auto &c : channels)
+        if (c.rx && c.pin == pin)
+            return &c;
+    return nullptr;
+}
+
+static rmt_symbol_word_t symbol(uint16_t low_us, uint16_t high_us)
+{
+    rmt_symbol_word_t s = {};
+    s.level0 = 0;
+    s.duration0 = low_us;
+    s.level1 = 1;
+    s.duration1 = high_us;
+    return s;
+}
+
+extern "C" {
+
+esp_err_t rmt_new_rx_channel(const rmt_rx_channel_config_t *config, rmt_channel_handle_t *channel)
+{
+    setup_calls++;
+    while (hold_setup)
+        std::this_thread::sleep_for(milliseconds(1));
+    if (fail_setup > 0) {
+        fail_setup--;
+        return ESP_ERR_NOT_FOUND;
+    }
+    std::lock_guard<std::mutex> lock(sim_mutex);
+    channels.push_back({ config->gpio_num, true });
+    *channel = &channels.back();
+    return ESP_OK;
+}
+
+esp_err_t rmt_new_tx_channel(const rmt_tx_channel_config_t *config, rmt_channel_handle_t *channel)
+{
+    if (!config->flags.io_loop_back || !config->flags.io_od_mode)
+        return ESP_ERR_INVALID_ARG;
+    std::lock_guard<std::mutex> lock(sim_mutex);
+    channels.push_back({ config->gpio_num, false });
+    *channel = &channels.back();
+    return ESP_OK;
+}
+
+esp_err_t rmt_del_channel(rmt_channel_handle_t channel)
+{
+    std::lock_guard<std::mutex> lock(sim_mutex);
+    channels.remove_if([channel](const rmt_channel &c) { return &c == channel; });
+    return ESP_OK;
+}
+
+esp_err_t rmt_enable(rmt_channel_handle_t channel)
+{
+    return ESP_OK;
+}
+
+esp_err_t rmt_disable(rmt_channel_handle_t channel)
+{
+    if (channel->rx && channel->receiving) {
+        channel->receiving = false;
+        channel->restarts++;
+    }
+    return ESP_OK;
+}
+
+esp_err_t rmt_new_copy_encoder(const rmt_copy_encoder_config_t *config, rmt_encoder_handle_t *encoder)
+{
+    *encoder = &copy_encoder;
+    return ESP_OK;
+}
+
+esp_err_t rmt_new_bytes_encoder(const rmt_bytes_encoder_config_t *config, rmt_encoder_handle_t *encoder)
+{
+    if (config->flags.msb_first)
+        return ESP_ERR_INVALID_ARG;
+    *encoder = &bytes_encoder;
+    return ESP_OK;
+}
+
+esp_err_t rmt_del_encoder(rmt_encoder_handle_t encoder)
+{
+    return ESP_OK;
+}
+
+esp_err_t rmt_rx_register_event_callbacks(rmt_channel_handle_t channel, const rmt_rx_event_callbacks_t *cbs, void *user_data)
+{
+    channel->on_recv_done = cbs->on_recv_done;
+    channel->user_data = user_data;
+    return ESP_OK;
+}
+
+esp_err_t rmt_receive(rmt_channel_handle_t channel, void *buffer, size_t buffer_size, const rmt_receive_config_t *config)
+{
+    if (channel->receiving)
+        return ESP_ERR_INVALID_STATE;
+    channel->buffer = (rmt_symbol_word_t *)buffer;
+    channel->capacity = buffer_size / sizeof(rmt_symbol_word_t);
+    channel->receiving = true;
+    return ESP_OK;
+}
+
+// Loops the slots sent back to the RX channel, with the devices holding the bus low
+esp_err_t rmt_transmit(rmt_channel_handle_t channel, rmt_encoder_handle_t encoder, const void *payload, size_t payload_bytes,
+                       const rmt_transmit_config_t *config)
+{
+    std::lock_guard<std::mutex> lock(sim_mutex);
+    bus.transfers++;
+    if (config->flags.eot_level != 1)
+        return ESP_ERR_INVALID_ARG;
+    bool devices = channel->pin == sensor_pin;
+
+    if (encoder->bytes) {
+        if (devices)
+            for (size_t i = 0; i < payload_bytes; i++)
+                bus.write_byte(((const uint8_t *)payload)[i]);
+        return ESP_OK;
+    }
+
+    rmt_channel *rx = rx_channel(channel->pin);
+    const rmt_symbol_word_t *symbols = (const rmt_symbol_word_t *)payload;
+    size_t count = payload_bytes / sizeof(rmt_symbol_word_t);
+    if (!rx->receiving)
+        return ESP_OK;                          // a write slot, nothing is recorded
+    if (bus.rx_lost)
+        return ESP_OK;
+
+    size_t received = 0;
+    if (count == 1 && symbols[0].duration0 >= 480) {
+        // Our reset pulse, followed by the presence pulse of the devices
+        bus.reset();
+        uint16_t presence_us = devices ? bus.presence_us : 0;
+        rx->buffer[received++] = symbol(symbols[0].duration0, presence_us ? 30 : 0);
+        if (presence_us)
+            rx->buffer[received++] = symbol(presence_us, 0);
+    } else {
+        if (count > rx->capacity)
+            return ESP_ERR_INVALID_ARG;
+        for (size_t i = 0; i < count; i++) {
+            int bit = devices ? bus.read_bit() : 1;
+            uint16_t low_us = bit ? std::max<uint16_t>(symbols[i].duration0, bus.one_low_us) : bus.zero_low_us;
+            rx->buffer[received++] = symbol(low_us, i + 1 < count ? 65 - low_us : 0);
+        }
+        if (bus.rx_short)
+            received--;
+    }
+
+    rx->receiving = false;
+    rmt_rx_done_event_data_t edata = { rx->buffer, received };
+    rx->on_recv_done(rx, &edata, rx->user_data);
+    return ESP_OK;
+}
+
+esp_err_t rmt_tx_wait_all_done(rmt_channel_handle_t channel, int timeout_ms)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_pull_mode(gpio_num_t gpio_num, gpio_pull_mode_t pull)
+{
+    return ESP_OK;
+}
+
+// Queues and semaphores hold a single item, which is all the drivers use
+struct queue {
+    bool full;
+    size_t item_size;
+    uint8_t item[sizeof(size_t)];
+    TickType_t last_wait;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    QueueHandle_t queue = (QueueHandle_t)calloc(1, sizeof(struct queue));
+    queue->item_size = item_size;
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    free(queue);
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+    queue->full = false;
+    return pdTRUE;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *woken)
+{
+    if (queue->full)
+        return pdFALSE;
+    if (queue->item_size)
+        memcpy(queue->item, item, queue->item_size);
+    queue->full = true;
+    return pdTRUE;
+}
+
+// The simulated transfers complete before the task waits, so nothing is received later
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    queue->last_wait = ticks;
+    if (!queue->full)
+        return pdFALSE;
+    if (queue->item_size)
+        memcpy(item, queue->item, queue->item_size);
+    queue->full = false;
+    return pdTRUE;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xQueueCreate(1, 0);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    vQueueDelete(sem);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    return xQueueSendFromISR(sem, nullptr, nullptr);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    return xQueueReceive(sem, nullptr, ticks);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    delays++;
+    std::this_thread::sleep_for(milliseconds(1));
+}
+
+// A single timer, fired by the test
+static void (*timer_callback)(void *);
+static void *timer_arg;
+static uint64_t timer_timeout_us;
+static int timers;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *timer)
+{
+    timer_callback = args->callback;
+    timer_arg = args->arg;
+    timers++;
+    *timer = (esp_timer_handle_t)&timer_callback;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    timer_timeout_us = timeout_us;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    timers--;
+    return ESP_OK;
+}
+
+}
+
+TEST_CASE("Presence pulse is decoded from the reset", "[onewire]")
+{
+    bus = Bus();
+    CHECK(onewire_reset(sensor_pin));
+
+    // PRESENCE_MIN_US: anything shorter is a glitch, not a device
+    bus.presence_us = 60;
+    CHECK(onewire_reset(sensor_pin));
+    bus.presence_us = 59;
+    CHECK_FALSE(onewire_reset(sensor_pin));
+    bus.presence_us = 0;
+    CHECK_FALSE(onewire_reset(sensor_pin));
+
+    // The channels are created once per bus
+    CHECK(channels.size() == 2);
+}
+
+TEST_CASE("Read slots are sampled at SAMPLE_US", "[onewire]")
+{
+    bus = Bus();
+    REQUIRE(onewire_reset(sensor_pin));
+    REQUIRE(onewire_select(sensor_pin, bus.devices[0].rom));
+    REQUIRE(onewire_write(sensor_pin, 0xbe));
+
+    // A device sending 0 holds the bus low past the sample point
+    bus.zero_low_us = 15;
+    bus.one_low_us = 14;
+    CHECK(onewire_read(sensor_pin) == 0x91);
+    CHECK(onewire_read(sensor_pin) == 0x01);
+
+    // A slot missing from the receive is an error, not a 0 or a 1
+    bus.rx_short = true;
+    CHECK(onewire_read(sensor_pin) == -1);
+    bus.rx_short = false;
+}
+
+TEST_CASE("Lost receive times out and restarts the channel", "[onewire]")
+{
+    bus = Bus();
+    rmt_channel *rx = rx_channel(sensor_pin);
+    REQUIRE(rx);
+    int restarts = rx->restarts;
+
+    bus.rx_lost = true;
+    CHECK(onewire_read(sensor_pin) == -1);
+    CHECK_FALSE(onewire_reset(sensor_pin));
+    CHECK(rx->restarts == restarts + 2);
+
+    // The channel receives again
+    bus.rx_lost = false;
+    CHECK(onewire_reset(sensor_pin));
+}
+
+TEST_CASE("DS18B20 temperatures are read over RMT", "[ds18x20]")
+{
+    bus = Bus();
+    float t;
+    CHECK(ds18b20_measure_and_read(sensor_pin, bus.devices[0].rom, &t) == ESP_OK);
+    CHECK(t == 25.0625f);
+    CHECK(bus.converts == 1);
+    CHECK(ds18b20_read_temperature(sensor_pin, bus.devices[1].rom, &t) == ESP_OK);
+    CHECK(t == -10.125f);
+
+    bus.corrupt = 2;
+    CHECK(ds18b20_read_temperature(sensor_pin, bus.devices[2].rom, &t) == ESP_ERR_INVALID_CRC);
+    bus.presence_us = 0;
+    CHECK(ds18b20_read_temperature(sensor_pin, bus.devices[0].rom, &t) == ESP_ERR_INVALID_RESPONSE);
+}
+
+TEST_CASE("Multi sensor measurement is read by the waiting task", "[ds18x20]")
+{
+    bus = Bus();
+    onewire_addr_t addrs[3];
+    for (size_t i = 0; i < 3; i++)
+        addrs[i] = bus.devices[i].rom;
+    float results[3] = {};
+    ds18x20_multi_t multi = {};
+    multi.pin = sensor_pin;
+    multi.addr_list = addrs;
+    multi.addr_count = 3;
+    multi.result_list = results;
+
+    CHECK(ds18x20_measure_multi_wait(&multi, 0) == ESP_ERR_INVALID_STATE);
+    REQUIRE(ds18x20_measure_multi_start(&multi) == ESP_OK);
+    CHECK(bus.converts == 1);
+    CHECK(timer_timeout_us == DS18X20_CONVERSION_MS * 1000);
+    CHECK(multi.busy);
+    CHECK(ds18x20_measure_multi_start(&multi) == ESP_ERR_INVALID_STATE);
+
+    // Polling and waiting both time out while the conversion runs, the measurement goes on
+    CHECK(ds18x20_measure_multi_wait(&multi, 0) == ESP_ERR_TIMEOUT);
+    CHECK(multi.busy);
+    CHECK(ds18x20_measure_multi_wait(&multi, pdMS_TO_TICKS(10)) == ESP_ERR_TIMEOUT);
+    CHECK(multi.done->last_wait == pdMS_TO_TICKS(10));
+    CHECK(multi.busy);
+
+    // The timer only wakes the task, the bus is read by the waiting task
+    int transfers = bus.transfers;
+    timer_callback(timer_arg);
+    CHECK(bus.transfers == transfers);
+    CHECK(ds18x20_measure_multi_wait(&multi, 0) == ESP_OK);
+    CHECK(bus.transfers > transfers);
+    CHECK_FALSE(multi.busy);
+    CHECK(results[0] == 25.0625f);
+    CHECK(results[1] == -10.125f);
+    CHECK(results[2] == 125.0f);
+    CHECK(ds18x20_measure_multi_wait(&multi, 0) == ESP_ERR_INVALID_STATE);
+
+    // The timer and semaphore are reused, the conversion time can be shortened
+    bus.corrupt = 2;
+    multi.conversion_ms = 94;
+    REQUIRE(ds18x20_measure_multi_start(&multi) == ESP_OK);
+    CHECK(timer_timeout_us == 94000);
+    CHECK(timers == 1);
+    timer_callback(timer_arg);
+    CHECK(ds18x20_measure_multi_wait(&multi, portMAX_DELAY) == ESP_ERR_INVALID_CRC);
+    CHECK_FALSE(multi.busy);
+
+    CHECK(ds18x20_measure_multi_free(&multi) == ESP_OK);
+    CHECK(timers == 0);
+    CHECK(multi.timer == nullptr);
+    CHECK(multi.done == nullptr);
+}
+
+TEST_CASE("Bus set up by another task is waited for", "[onewire]")
+{
+    const gpio_num_t pin = 5;
+    int setups = setup_calls;
+    hold_setup = true;
+
+    std::atomic<bool> first_ok { false }, second_ok { false }, second_done { false };
+    std::thread first([&] { first_ok = onewire_write(pin, 0xcc); });
+    while (setup_calls == setups)
+        std::this_thread::sleep_for(milliseconds(1));
+
+    // The second task finds the bus reserved but not ready, and waits for it
+    int waits = delays;
+    std::thread second([&] { second_ok = onewire_write(pin, 0x44); second_done = true; });
+    auto deadline = steady_clock::now() + seconds(1);
+    while (delays < waits + 3 && !second_done && steady_clock::now() < deadline)
+        std::this_thread::sleep_for(milliseconds(1));
+    CHECK_FALSE(second_done);
+
+    hold_setup = false;
+    first.join();
+    second.join();
+    CHECK(first_ok);
+    CHECK(second_ok);
+    CHECK(setup_calls == setups + 1);
+}
+
+TEST_CASE("Failed bus setup releases the bus", "[onewire]")
+{
+    const gpio_num_t pin = 7;
+    fail_setup = 1;
+    CHECK_FALSE(onewire_write(pin, 0xcc));
+    CHECK(rx_channel(pin) == nullptr);
+    CHECK(onewire_write(pin, 0xcc));
+    CHECK(rx_channel(pin) != nullptr);
+
+    // All buses taken
+    CHECK_FALSE(onewire_write(8, 0xcc));
+}
@@ -0,0 +1,172 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <esp_timer.h>
+#include <i2cdev.h>
+
+#define I2C_PORT 0
+#define READ_SIZE_MAX 14
+
+typedef struct
+{
+    const char *name;
+    uint8_t addr;
+    uint8_t reg;
+    size_t size;
+    bool present;
+    i2c_dev_t dev;
+    uint32_t count;
+    uint32_t errors;
+    i2c_dev_xfer_t xfer[CONFIG_EXAMPLE_IN_FLIGHT];
+    uint8_t data[CONFIG_EXAMPLE_IN_FLIGHT][READ_SIZE_MAX];
+} device_t;
+
+static device_t devices[] = {
+    // Bus voltage of channel 1
+    { .name = "INA3221", .addr = CONFIG_EXAMPLE_INA3221_ADDR, .reg = 0x02, .size = 2 },
+    // Temperature
+    { .name = "LM75", .addr = CONFIG_EXAMPLE_LM75_ADDR, .reg = 0x00, .size = 2 },
+    // Accelerometer, temperature and gyroscope
+    { .name = "MPU6050", .addr = CONFIG_EXAMPLE_MPU6050_ADDR, .reg = 0x3b, .size = 14 },
+};
+
+#define DEVICE_COUNT (sizeof(devices) / sizeof(devices[0]))
+
+static volatile bool running;
+static SemaphoreHandle_t done;
+
+static void blocking_task(void *arg)
+{
+    device_t *d = arg;
+    uint8_t data[READ_SIZE_MAX];
+
+    while (running)
+    {
+        if (i2c_dev_read_reg(&d->dev, d->reg, data, d->size) == ESP_OK)
+            d->count++;
+        else
+            d->errors++;
+    }
+    xSemaphoreGive(done);
+    vTaskDelete(NULL);
+}
+
+static void on_complete(i2c_dev_xfer_t *xfer)
+{
+    device_t *d = xfer->arg;
+
+    if (xfer->result == ESP_OK)
+        d->count++;
+    else
+        d->errors++;
+    if (running && i2c_dev_submit(xfer) == ESP_OK)
+        return;
+    xSemaphoreGive(done);
+}
+
+static void run(const char *name, bool queued)
+{
+    i2c_dev_sched_stats_t stats;
+    unsigned pending = 0;
+
+    i2c_dev_sched_get_stats(I2C_PORT, &stats, true);
+    running = true;
+    int64_t start = esp_timer_get_time();
+
+    for (size_t i = 0; i < DEVICE_COUNT; i++)
+    {
+        device_t *d = &devices[i];
+        if (!d->present)
+            continue;
+        d->count = 0;
+        d->errors = 0;
+        if (!queued)
+        {
+            if (xTaskCreate(blocking_task, d->name, configMINIMAL_STACK_SIZE * 3, d, 5, NULL) == pdPASS)
+                pending++;
+            continue;
+        }
+        for (size_t j = 0; j < CONFIG_EXAMPLE_IN_FLIGHT; j++)
+        {
+            d->xfer[j] = (i2c_dev_xfer_t) {
+                .dev = &d->dev,
+                .out_reg = &d->reg,
+                .out_reg_size = 1,
+                .in_data = d->data[j],
+                .in_size = d->size,
+                .callback = on_complete,
+                .arg = d,
+            };
+            if (i2c_dev_submit(&d->xfer[j]) == ESP_OK)
+                pending++;
+        }
+    }
+
+    vTaskDelay(pdMS_TO_TICKS(CONFIG_EXAMPLE_DURATION_S * 1000));
+    running = false;
+    while (pending--)
+        xSemaphoreTake(done, portMAX_DELAY);
+
+    double elapsed_us = esp_timer_get_time() - start;
+    uint32_t count = 0, errors = 0;
+    uint64_t bits = 0;
+    for (size_t i = 0; i < DEVICE_COUNT; i++)
+    {
+        device_t *d = &devices[i];
+        if (!d->present)
+            continue;
+        count += d->count;
+        errors += d->errors;
+        // Start, address, register, repeated start, address, data and stop
+        bits += (uint64_t)d->count * (3 + 9 * (3 + d->size));
+        printf("  %-8s %8" PRIu32 " transactions, %" PRIu32 " errors\n", d->name, d->count, d->errors);
+    }
+    if (!count)
+        return;
+
+    double wire_us = bits * 1000000.0 / CONFIG_EXAMPLE_I2C_CLOCK_HZ;
+    printf("%s: %" PRIu32 " transactions, %" PRIu32 " errors, %.0f per second\n",
+           name, count, errors, count * 1000000.0 / elapsed_us);
+    printf("  on the wire %.1f us, overhead %.1f us per transaction, bus utilisation %.1f %%\n",
+           wire_us / count, (elapsed_us - wire_us) / count, wire_us * 100 / elapsed_us);
+
+    if (queued && i2c_dev_sched_get_stats(I2C_PORT, &stats, false) == ESP_OK && stats.batches)
+        printf("  %.2f transactions per batch, %.1f us in the driver and %.1f us in the scheduler per transaction\n",
+               (double)stats.transactions / stats.batches, (double)stats.bus_us / stats.transactions,
+               (double)(stats.locked_us - stats.bus_us) / stats.transactions);
+}
+
+void app_main()
+{
+    ESP_ERROR_CHECK(i2cdev_init());
+    ESP_ERROR_CHECK(i2c_dev_sched_start(I2C_PORT));
+    done = xSemaphoreCreateCounting(DEVICE_COUNT * CONFIG_EXAMPLE_IN_FLIGHT, 0);
+
+    size_t present = 0;
+    for (size_t i = 0; i < DEVICE_COUNT; i++)
+    {
+        device_t *d = &devices[i];
+        d->dev.port = I2C_PORT;
+        d->dev.addr = d->addr;
+        d->dev.cfg.sda_io_num = CONFIG_EXAMPLE_I2C_MASTER_SDA;
+        d->dev.cfg.scl_io_num = CONFIG_EXAMPLE_I2C_MASTER_SCL;
+#if HELPER_TARGET_IS_ESP32
+        d->dev.cfg.master.clk_speed = CONFIG_EXAMPLE_I2C_CLOCK_HZ;
+#endif
+        d->present = i2c_dev_probe(&d->dev, I2C_DEV_WRITE) == ESP_OK;
+        printf("%s at 0x%02x: %s\n", d->name, d->addr, d->present ? "found" : "not found, skipped");
+        present += d->present;
+    }
+    if (!present)
+        return;
+
+    while (1)
+    {
+        run("Blocking", false);
+        run("Queued", true);
+        printf("\n");
+    }
+}
@@ -63,8 +63,9 @@ static esp_err_t render_frame(framebuffer_t *fb, void *arg)
 
     led_strip_t *led_strip = (led_strip_t *)arg;
 
+    // only the pixels changed since the last frame
     for (size_t y = 0; y < fb->height; y++)
-        for (size_t x = 0; x < fb->width; x++)
+        for (size_t x = fb->dirty[y].x0; x < fb->dirty[y].x1; x++)
         {
             // calculate strip index of pixel
             size_t strip_idx = y * fb->width + (y % 2 ? fb->width - x - 1 : x);
@@ -190,6 +191,8 @@ void test(void *pvParameters)
     // Setup framebuffer
     framebuffer_t fb;
     fb_init(&fb, LED_MATRIX_WIDTH, LED_MATRIX_HEIGHT, render_frame);
+    // effects draw with fb_*() functions only, which keep track of the changes
+    fb_set_refresh_mode(&fb, FB_REFRESH_DIRTY);
 
     // setup animation
     fb_animation_t animation;
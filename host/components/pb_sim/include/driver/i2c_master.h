@@ -0,0 +1,6 @@
+/*
+ * The application only uses the legacy I2C API, which the simulated buses implement
+ */
+#pragma once
+
+#include "driver/i2c.h"
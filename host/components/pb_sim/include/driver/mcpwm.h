@@ -0,0 +1,83 @@
+/*
+ * Legacy MCPWM driver API of ESP-IDF, backed by the simulated generators of sim_pwm.c
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    MCPWM_UNIT_0,
+    MCPWM_UNIT_1,
+    MCPWM_UNIT_MAX,
+} mcpwm_unit_t;
+
+typedef enum {
+    MCPWM_TIMER_0,
+    MCPWM_TIMER_1,
+    MCPWM_TIMER_2,
+    MCPWM_TIMER_MAX,
+} mcpwm_timer_t;
+
+typedef enum {
+    MCPWM_GEN_A,
+    MCPWM_GEN_B,
+    MCPWM_GEN_MAX,
+} mcpwm_generator_t;
+
+#define MCPWM_OPR_A     MCPWM_GEN_A
+#define MCPWM_OPR_B     MCPWM_GEN_B
+#define MCPWM_OPR_MAX   MCPWM_GEN_MAX
+typedef mcpwm_generator_t mcpwm_operator_t;
+
+typedef enum {
+    MCPWM0A = 0,
+    MCPWM0B,
+    MCPWM1A,
+    MCPWM1B,
+    MCPWM2A,
+    MCPWM2B,
+} mcpwm_io_signals_t;
+
+typedef enum {
+    MCPWM_FREQ_HOLD,
+    MCPWM_UP_COUNTER,
+    MCPWM_DOWN_COUNTER,
+    MCPWM_UP_DOWN_COUNTER,
+    MCPWM_COUNTER_MAX,
+} mcpwm_counter_type_t;
+
+typedef enum {
+    MCPWM_DUTY_MODE_0 = 0,
+    MCPWM_DUTY_MODE_1,
+    MCPWM_DUTY_MODE_FORCE_LOW,
+    MCPWM_DUTY_MODE_FORCE_HIGH,
+    MCPWM_DUTY_MODE_MAX,
+} mcpwm_duty_type_t;
+
+typedef struct {
+    uint32_t frequency;
+    float cmpr_a;
+    float cmpr_b;
+    mcpwm_duty_type_t duty_mode;
+    mcpwm_counter_type_t counter_mode;
+} mcpwm_config_t;
+
+esp_err_t mcpwm_gpio_init(mcpwm_unit_t mcpwm_num, mcpwm_io_signals_t io_signal, int gpio_num);
+esp_err_t mcpwm_init(mcpwm_unit_t mcpwm_num, mcpwm_timer_t timer_num, const mcpwm_config_t *mcpwm_conf);
+esp_err_t mcpwm_set_frequency(mcpwm_unit_t mcpwm_num, mcpwm_timer_t timer_num, uint32_t frequency);
+esp_err_t mcpwm_set_duty(mcpwm_unit_t mcpwm_num, mcpwm_timer_t timer_num, mcpwm_generator_t gen, float duty);
+esp_err_t mcpwm_set_duty_type(mcpwm_unit_t mcpwm_num, mcpwm_timer_t timer_num, mcpwm_generator_t gen, mcpwm_duty_type_t duty_type);
+float mcpwm_get_duty(mcpwm_unit_t mcpwm_num, mcpwm_timer_t timer_num, mcpwm_generator_t gen);
+esp_err_t mcpwm_set_signal_high(mcpwm_unit_t mcpwm_num, mcpwm_timer_t timer_num, mcpwm_generator_t gen);
+esp_err_t mcpwm_set_signal_low(mcpwm_unit_t mcpwm_num, mcpwm_timer_t timer_num, mcpwm_generator_t gen);
+esp_err_t mcpwm_start(mcpwm_unit_t mcpwm_num, mcpwm_timer_t timer_num);
+esp_err_t mcpwm_stop(mcpwm_unit_t mcpwm_num, mcpwm_timer_t timer_num);
+
+#ifdef __cplusplus
+}
+#endif
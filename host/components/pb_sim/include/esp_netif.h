@@ -0,0 +1,7 @@
+/*
+ * The host build has no network interfaces of its own, only their IP events
+ */
+#pragma once
+
+#include "esp_err.h"
+#include "esp_netif_types.h"
@@ -0,0 +1,21 @@
+/*
+ * The host build talks plain TCP to the broker, the connection is kept in an esp_tls_t
+ * so that the MQTT agent manager finds its socket the same way as on the target
+ */
+#pragma once
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct esp_tls {
+    int sockfd;
+} esp_tls_t;
+
+esp_err_t esp_tls_get_conn_sockfd(esp_tls_t *tls, int *sockfd);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,23 @@
+/*
+ * Station API of ESP-IDF used by the application, answered by the simulated radio of sim_wifi.c
+ */
+#pragma once
+
+#include "esp_err.h"
+#include "esp_wifi_types.h"
+
+#ifndef ESP_ERR_WIFI_BASE
+#define ESP_ERR_WIFI_BASE           0x3000
+#endif
+#define ESP_ERR_WIFI_NOT_CONNECT    (ESP_ERR_WIFI_BASE + 15)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *ap_info);
+esp_err_t esp_wifi_sta_get_rssi(int *rssi);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,53 @@
+/*
+ * Transport interface of the esp-aws-iot port, implemented over a plain TCP socket by sim_transport.c.
+ * The network context has the fields of the target one, the credentials are ignored.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_tls.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum TlsTransportStatus {
+    TLS_TRANSPORT_SUCCESS = 0,
+    TLS_TRANSPORT_INVALID_PARAMETER,
+    TLS_TRANSPORT_INSUFFICIENT_MEMORY,
+    TLS_TRANSPORT_INVALID_CREDENTIALS,
+    TLS_TRANSPORT_HANDSHAKE_FAILED,
+    TLS_TRANSPORT_INTERNAL_ERROR,
+    TLS_TRANSPORT_CONNECT_FAILURE,
+    TLS_TRANSPORT_DISCONNECT_FAILURE,
+} TlsTransportStatus_t;
+
+typedef struct NetworkContext {
+    SemaphoreHandle_t xTlsContextSemaphore;
+    esp_tls_t *pxTls;
+    const char *pcHostname;
+    int xPort;
+    const char *pcServerRootCA;
+    uint32_t pcServerRootCASize;
+    const char *pcClientCert;
+    uint32_t pcClientCertSize;
+    const char *pcClientKey;
+    uint32_t pcClientKeySize;
+    bool use_secure_element;
+    void *ds_data;
+    const char **pAlpnProtos;
+    bool disableSni;
+} NetworkContext_t;
+
+TlsTransportStatus_t xTlsConnect(NetworkContext_t *pxNetworkContext);
+TlsTransportStatus_t xTlsDisconnect(NetworkContext_t *pxNetworkContext);
+int32_t espTlsTransportSend(NetworkContext_t *pxNetworkContext, const void *pvData, size_t uxDataLen);
+int32_t espTlsTransportRecv(NetworkContext_t *pxNetworkContext, void *pvData, size_t uxDataLen);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Message published to the broker by a client
+ */
+typedef struct {
+    const char *topic;          // Not terminated
+    size_t topic_len;
+    const uint8_t *payload;
+    size_t payload_len;
+    uint8_t qos;
+    bool retain;
+    int64_t received_us;        // esp_timer_get_time() when the packet was complete
+} sim_broker_message_t;
+
+/**
+ * @brief Called for every message published by a client, before it is forwarded to the subscribers
+ *
+ * Runs on the broker thread, which is not a FreeRTOS task: it must not call FreeRTOS APIs.
+ */
+typedef void (*sim_broker_observer_t)(const sim_broker_message_t *message, void *arg);
+
+typedef struct {
+    uint32_t connections;
+    uint32_t publishes_in;
+    uint32_t publishes_out;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+} sim_broker_stats_t;
+
+/**
+ * @brief Start an MQTT 3.1.1 broker on the loopback interface
+ *
+ * Supports QoS 0 to 2 on publish, subscriptions are granted at most QoS 1, wildcards and persistent sessions
+ * are supported. Retained messages are not stored, and messages for offline persistent sessions are dropped.
+ */
+esp_err_t sim_broker_start(uint16_t port, sim_broker_observer_t observer, void *arg);
+void sim_broker_stop(void);
+
+/**
+ * @brief Publish to the subscribed clients, as another client would
+ */
+esp_err_t sim_broker_publish(const char *topic, const void *payload, size_t len, uint8_t qos);
+
+/**
+ * @brief Close the connections of all clients, as on a network outage, the sessions are kept
+ */
+void sim_broker_drop_clients(void);
+
+void sim_broker_get_stats(sim_broker_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
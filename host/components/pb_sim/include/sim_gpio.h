@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+#include "driver/gpio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Level of an input computed when it is read, for signals which depend on time
+ */
+typedef int (*sim_gpio_input_fn_t)(gpio_num_t gpio_num, int64_t now_us, void *arg);
+
+/**
+ * @brief Called after every gpio_set_level() on the pin
+ */
+typedef void (*sim_gpio_output_fn_t)(gpio_num_t gpio_num, int level, int64_t now_us, void *arg);
+
+/**
+ * @brief Drive an input pin, as a switch or a sensor wired to it would
+ *
+ * The ISR handler of the pin runs in the context of the caller when the change matches its interrupt type.
+ */
+void sim_gpio_set_input(gpio_num_t gpio_num, int level);
+
+/**
+ * @brief Stop driving an input pin, it then reads its pull resistor
+ */
+void sim_gpio_release_input(gpio_num_t gpio_num);
+
+/**
+ * @brief Compute the level of an input pin on every read instead, NULL to remove
+ */
+esp_err_t sim_gpio_set_input_fn(gpio_num_t gpio_num, sim_gpio_input_fn_t fn, void *arg);
+
+/**
+ * @brief Get notified of the writes to an output pin, NULL to remove
+ */
+esp_err_t sim_gpio_set_output_fn(gpio_num_t gpio_num, sim_gpio_output_fn_t fn, void *arg);
+
+/**
+ * @brief Level last written to an output pin
+ */
+int sim_gpio_get_output(gpio_num_t gpio_num);
+
+#ifdef __cplusplus
+}
+#endif
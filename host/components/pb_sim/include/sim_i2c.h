@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "driver/i2c.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Device model on a simulated bus
+ *
+ * The callbacks run within i2c_master_cmd_begin(), with the bus held.
+ */
+typedef struct sim_i2c_device {
+    uint8_t address;
+    bool (*start)(struct sim_i2c_device *device, bool read);   // false to NACK the address
+    bool (*write)(struct sim_i2c_device *device, uint8_t data); // false to NACK the byte
+    uint8_t (*read)(struct sim_i2c_device *device);
+    void (*stop)(struct sim_i2c_device *device);
+    struct sim_i2c_device *next;
+} sim_i2c_device_t;
+
+typedef struct {
+    uint32_t transactions;      // i2c_master_cmd_begin() calls
+    uint32_t nacks;
+    uint64_t bytes;             // Address and data bytes
+    uint64_t bus_time_us;       // Time the transactions would take on the wire at the configured clock
+} sim_i2c_stats_t;
+
+esp_err_t sim_i2c_add_device(i2c_port_t port, sim_i2c_device_t *device);
+esp_err_t sim_i2c_remove_device(i2c_port_t port, sim_i2c_device_t *device);
+void sim_i2c_get_stats(i2c_port_t port, sim_i2c_stats_t *stats);
+void sim_i2c_reset_stats(i2c_port_t port);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+#include "driver/i2c.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Put an INA3221 at given address of a simulated bus
+ *
+ * The register model follows the datasheet: shunt voltages in 40 uV and bus voltages in 8 mV steps,
+ * left aligned by 3 bits, manufacturer ID 0x5449 and die ID 0x3220.
+ */
+esp_err_t sim_ina3221_attach(i2c_port_t port, uint8_t address);
+
+/**
+ * @brief Set the voltages measured on a channel, 1 to 3
+ */
+esp_err_t sim_ina3221_set_channel(int channel, float bus_voltage_v, float shunt_voltage_mv);
+
+/**
+ * @brief Read a register, as last written or measured
+ */
+uint16_t sim_ina3221_get_register(uint8_t reg);
+
+#ifdef __cplusplus
+}
+#endif
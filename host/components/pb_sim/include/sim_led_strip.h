@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+#include "led_strip.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Colour shown by a pixel of the strip on given GPIO, as latched by the last refresh
+ *
+ * @return ESP_ERR_NOT_FOUND when no strip was created on the GPIO
+ */
+esp_err_t sim_led_strip_get_pixel(int gpio_num, uint32_t index, uint8_t *red, uint8_t *green, uint8_t *blue);
+
+/**
+ * @brief Refreshes of the strip on given GPIO, clears included
+ */
+uint32_t sim_led_strip_get_refresh_count(int gpio_num);
+
+#ifdef __cplusplus
+}
+#endif
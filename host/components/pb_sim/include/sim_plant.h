@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include "driver/gpio.h"
+#include "driver/mcpwm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SIM_HCSR04_NO_ECHO  (-1)
+
+/**
+ * @brief Put an HC-SR04 on given pins
+ *
+ * The echo rises 150 us after the falling edge of the trigger and stays high 58 us per cm of distance,
+ * as on the sensor. Sensors may share a trigger pin, they then all answer the same pulse.
+ */
+esp_err_t sim_hcsr04_attach(gpio_num_t trigger_pin, gpio_num_t echo_pin, int distance_cm);
+
+/**
+ * @brief Distance measured by the sensor on given echo pin, SIM_HCSR04_NO_ECHO when nothing reflects
+ */
+esp_err_t sim_hcsr04_set_distance(gpio_num_t echo_pin, int distance_cm);
+
+typedef struct {
+    mcpwm_unit_t unit;          // Generator A opens, generator B closes, as wired to the L298N
+    mcpwm_timer_t timer;
+    gpio_num_t end_stop_gpio;   // FC-33, high at either end of the travel
+    gpio_num_t locked_gpio;     // Limit switches, active low, GPIO_NUM_NC when not fitted
+    gpio_num_t unlocked_gpio;
+    uint32_t travel_ms;         // Time from closed to open at full duty
+} sim_barrier_config_t;
+
+/**
+ * @brief Model the barrier moved by the motor, starting closed
+ *
+ * The position is integrated from the MCPWM outputs on every change of the generators and every read of the sensors.
+ */
+esp_err_t sim_barrier_attach(const sim_barrier_config_t *config);
+
+/**
+ * @brief Position of the barrier, 0.0 closed to 1.0 open
+ */
+float sim_barrier_get_position(void);
+
+/**
+ * @brief Block the barrier where it is, as an obstacle would
+ */
+void sim_barrier_set_jammed(bool jammed);
+
+#ifdef __cplusplus
+}
+#endif
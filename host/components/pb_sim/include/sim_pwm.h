@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include "driver/mcpwm.h"
+#include "driver/ledc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Called after every change of an MCPWM generator, from the task making it
+ */
+typedef void (*sim_mcpwm_listener_t)(mcpwm_unit_t unit, mcpwm_timer_t timer, void *arg);
+
+/**
+ * @brief Level the generator drives on average, 0.0 to 1.0, taking the forced levels into account
+ */
+float sim_mcpwm_get_output(mcpwm_unit_t unit, mcpwm_timer_t timer, mcpwm_generator_t gen);
+
+/**
+ * @brief GPIO given to mcpwm_gpio_init() for a signal, -1 if not routed
+ */
+int sim_mcpwm_get_gpio(mcpwm_unit_t unit, mcpwm_io_signals_t io_signal);
+
+void sim_mcpwm_set_listener(sim_mcpwm_listener_t listener, void *arg);
+
+/**
+ * @brief Output of a LEDC channel, as latched by the last ledc_update_duty()
+ *
+ * @param[out] freq_hz Frequency of the timer of the channel, may be NULL
+ * @param[out] duty Duty as a fraction of the full scale of the timer, may be NULL
+ * @return true when the channel is configured and running
+ */
+bool sim_ledc_get_output(ledc_mode_t mode, ledc_channel_t channel, uint32_t *freq_hz, float *duty);
+
+#ifdef __cplusplus
+}
+#endif
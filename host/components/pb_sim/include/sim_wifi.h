@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_wifi_types.h"
+#include "esp_netif_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Access point the simulated station joins
+ */
+typedef struct {
+    const char *ssid;
+    uint8_t bssid[6];
+    uint8_t channel;
+    int8_t rssi;
+    uint32_t connect_ms;        // From the association to the IP address, as DHCP would take
+} sim_wifi_ap_t;
+
+void sim_wifi_set_ap(const sim_wifi_ap_t *ap);
+void sim_wifi_set_rssi(int8_t rssi);
+
+/**
+ * @brief Associate with the access point
+ *
+ * Posts WIFI_EVENT_STA_CONNECTED right away and IP_EVENT_STA_GOT_IP connect_ms later, on the default event loop.
+ */
+esp_err_t sim_wifi_connect(void);
+
+/**
+ * @brief Lose the link, posts WIFI_EVENT_STA_DISCONNECTED with given reason
+ */
+esp_err_t sim_wifi_disconnect(uint8_t reason);
+
+/**
+ * @brief Whether the station has an IP address
+ */
+bool sim_wifi_is_connected(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,648 @@
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sim_broker.h"
+
+static const char *TAG = "sim_broker";
+
+// The log of ESP-IDF may take FreeRTOS locks, the broker thread prints directly
+#define SIM_BROKER_LOG(level, format, ...) fprintf(stderr, level " (%lld) %s: " format "\n", (long long)(esp_timer_get_time() / 1000), TAG, ##__VA_ARGS__)
+
+#define SIM_BROKER_MAX_CLIENTS      8
+#define SIM_BROKER_MAX_SESSIONS     8
+#define SIM_BROKER_MAX_SUBS         24
+#define SIM_BROKER_MAX_FILTER       128
+#define SIM_BROKER_MAX_CLIENT_ID    64
+#define SIM_BROKER_MAX_PACKET       (64 * 1024)
+
+#define MQTT_CONNECT        1
+#define MQTT_CONNACK        2
+#define MQTT_PUBLISH        3
+#define MQTT_PUBACK         4
+#define MQTT_PUBREC         5
+#define MQTT_PUBREL         6
+#define MQTT_PUBCOMP        7
+#define MQTT_SUBSCRIBE      8
+#define MQTT_SUBACK         9
+#define MQTT_UNSUBSCRIBE    10
+#define MQTT_UNSUBACK       11
+#define MQTT_PINGREQ        12
+#define MQTT_PINGRESP       13
+#define MQTT_DISCONNECT     14
+
+typedef struct {
+    char filter[SIM_BROKER_MAX_FILTER];
+    uint8_t qos;
+} sim_broker_sub_t;
+
+typedef struct {
+    bool used;
+    bool persistent;
+    char client_id[SIM_BROKER_MAX_CLIENT_ID];
+    sim_broker_sub_t subs[SIM_BROKER_MAX_SUBS];
+    size_t sub_count;
+    uint16_t next_packet_id;
+} sim_broker_session_t;
+
+typedef struct {
+    int fd;                     // -1 when the slot is free
+    sim_broker_session_t *session;
+    uint8_t *rx;
+    size_t rx_len;
+    size_t rx_size;
+} sim_broker_client_t;
+
+typedef struct {
+    int listen_fd;
+    int wake_pipe[2];
+    pthread_t thread;
+    bool running;
+    pthread_mutex_t lock;       // Sessions, client sockets and stats, publish comes from other threads
+    sim_broker_observer_t observer;
+    void *observer_arg;
+    sim_broker_client_t clients[SIM_BROKER_MAX_CLIENTS];
+    sim_broker_session_t sessions[SIM_BROKER_MAX_SESSIONS];
+    sim_broker_stats_t stats;
+} sim_broker_t;
+
+static sim_broker_t s_broker = {
+    .listen_fd = -1,
+    .wake_pipe = { -1, -1 },
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static bool sim_broker_topic_matches(const char *filter, const char *topic, size_t topic_len)
+{
+    const char *end = topic + topic_len;
+    // Topics starting with $ are not matched by a leading wildcard
+    if (topic_len && topic[0] == '$' && (filter[0] == '+' || filter[0] == '#')) {
+        return false;
+    }
+    while (*filter) {
+        if (filter[0] == '#') {
+            return true;
+        }
+        if (filter[0] == '+') {
+            while (topic < end && *topic != '/') {
+                topic++;
+            }
+            filter++;
+        } else {
+            if (topic == end || *filter != *topic) {
+                // "a/#" also matches "a"
+                return topic == end && filter[0] == '/' && filter[1] == '#' && filter[2] == '\0';
+            }
+            filter++;
+            topic++;
+        }
+    }
+    return topic == end;
+}
+
+static size_t sim_broker_encode_length(uint8_t *buf, size_t length)
+{
+    size_t n = 0;
+    do {
+        uint8_t byte = length % 128;
+        length /= 128;
+        buf[n++] = byte | (length ? 0x80 : 0);
+    } while (length);
+    return n;
+}
+
+static void sim_broker_send(sim_broker_client_t *client, const uint8_t *data, size_t len)
+{
+    size_t sent = 0;
+    while (sent < len) {
+        ssize_t ret = send(client->fd, data + sent, len - sent, MSG_NOSIGNAL);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            // Closed on the next poll
+            shutdown(client->fd, SHUT_RDWR);
+            return;
+        }
+        sent += ret;
+    }
+    s_broker.stats.bytes_out += len;
+}
+
+static void sim_broker_send_ack(sim_broker_client_t *client, uint8_t type, uint8_t flags, uint16_t packet_id)
+{
+    uint8_t packet[4] = { (type << 4) | flags, 2, packet_id >> 8, packet_id & 0xFF };
+    sim_broker_send(client, packet, sizeof(packet));
+}
+
+/* Forward a message to the subscribers, at the lowest of the publish and subscription QoS */
+static void sim_broker_forward(const char *topic, size_t topic_len, const uint8_t *payload, size_t payload_len, uint8_t qos)
+{
+    for (int i = 0; i < SIM_BROKER_MAX_CLIENTS; i++) {
+        sim_broker_client_t *client = &s_broker.clients[i];
+        if (client->fd < 0 || client->session == NULL) {
+            continue;
+        }
+        int granted = -1;
+        for (size_t j = 0; j < client->session->sub_count; j++) {
+            const sim_broker_sub_t *sub = &client->session->subs[j];
+            if (sim_broker_topic_matches(sub->filter, topic, topic_len) && (int)sub->qos > granted) {
+                granted = sub->qos;
+            }
+        }
+        if (granted < 0) {
+            continue;
+        }
+        uint8_t out_qos = qos < granted ? qos : granted;
+        size_t remaining = 2 + topic_len + (out_qos ? 2 : 0) + payload_len;
+        uint8_t *packet = malloc(5 + remaining);
+        if (packet == NULL) {
+            continue;
+        }
+        size_t n = 0;
+        packet[n++] = (MQTT_PUBLISH << 4) | (out_qos << 1);
+        n += sim_broker_encode_length(&packet[n], remaining);
+        packet[n++] = topic_len >> 8;
+        packet[n++] = topic_len & 0xFF;
+        memcpy(&packet[n], topic, topic_len);
+        n += topic_len;
+        if (out_qos) {
+            uint16_t packet_id = ++client->session->next_packet_id;
+            if (packet_id == 0) {
+                packet_id = ++client->session->next_packet_id;
+            }
+            packet[n++] = packet_id >> 8;
+            packet[n++] = packet_id & 0xFF;
+        }
+        memcpy(&packet[n], payload, payload_len);
+        n += payload_len;
+        sim_broker_send(client, packet, n);
+        s_broker.stats.publishes_out++;
+        free(packet);
+    }
+}
+
+static sim_broker_session_t *sim_broker_session(const char *client_id, bool clean)
+{
+    sim_broker_session_t *free_slot = NULL;
+    for (int i = 0; i < SIM_BROKER_MAX_SESSIONS; i++) {
+        sim_broker_session_t *session = &s_broker.sessions[i];
+        if (session->used && strcmp(session->client_id, client_id) == 0) {
+            // A second connection with the same client id takes the session over
+            for (int j = 0; j < SIM_BROKER_MAX_CLIENTS; j++) {
+                if (s_broker.clients[j].session == session && s_broker.clients[j].fd >= 0) {
+                    shutdown(s_broker.clients[j].fd, SHUT_RDWR);
+                    s_broker.clients[j].session = NULL;
+                }
+            }
+            if (clean) {
+                memset(session, 0, sizeof(*session));
+                session->used = true;
+                snprintf(session->client_id, sizeof(session->client_id), "%s", client_id);
+            }
+            session->persistent = !clean;
+            return session;
+        }
+        if (!session->used && free_slot == NULL) {
+            free_slot = session;
+        }
+    }
+    if (free_slot) {
+        memset(free_slot, 0, sizeof(*free_slot));
+        free_slot->used = true;
+        free_slot->persistent = !clean;
+        snprintf(free_slot->client_id, sizeof(free_slot->client_id), "%s", client_id);
+    }
+    return free_slot;
+}
+
+static bool sim_broker_read_string(const uint8_t **p, const uint8_t *end, const char **str, size_t *len)
+{
+    if (end - *p < 2) {
+        return false;
+    }
+    *len = ((*p)[0] << 8) | (*p)[1];
+    if ((size_t)(end - *p - 2) < *len) {
+        return false;
+    }
+    *str = (const char *)(*p + 2);
+    *p += 2 + *len;
+    return true;
+}
+
+static bool sim_broker_on_connect(sim_broker_client_t *client, const uint8_t *p, const uint8_t *end)
+{
+    const char *protocol;
+    size_t protocol_len;
+    if (!sim_broker_read_string(&p, end, &protocol, &protocol_len) || end - p < 4) {
+        return false;
+    }
+    uint8_t level = p[0];
+    uint8_t flags = p[1];
+    p += 4;     // Level, flags and keep alive, the keep alive is not enforced
+    const char *id;
+    size_t id_len;
+    if (!sim_broker_read_string(&p, end, &id, &id_len)) {
+        return false;
+    }
+    if (protocol_len != 4 || memcmp(protocol, "MQTT", 4) != 0 || level != 4) {
+        uint8_t connack[4] = { MQTT_CONNACK << 4, 2, 0, 1 };    // Unacceptable protocol version
+        sim_broker_send(client, connack, sizeof(connack));
+        return false;
+    }
+    char client_id[SIM_BROKER_MAX_CLIENT_ID];
+    snprintf(client_id, sizeof(client_id), "%.*s", (int)id_len, id);
+    bool clean = flags & 0x02;
+    bool present = false;
+    for (int i = 0; i < SIM_BROKER_MAX_SESSIONS && !clean; i++) {
+        present |= s_broker.sessions[i].used && s_broker.sessions[i].persistent && strcmp(s_broker.sessions[i].client_id, client_id) == 0;
+    }
+    client->session = sim_broker_session(client_id, clean);
+    uint8_t connack[4] = { MQTT_CONNACK << 4, 2, present ? 1 : 0, client->session ? 0 : 3 };
+    sim_broker_send(client, connack, sizeof(connack));
+    if (client->session) {
+        s_broker.stats.connections++;
+        SIM_BROKER_LOG("I", "%s connected, %s session", client_id, present ? "resumed" : (clean ? "clean" : "new"));
+    }
+    return client->session != NULL;
+}
+
+static bool sim_broker_on_publish(sim_broker_client_t *client, uint8_t flags, const uint8_t *p, const uint8_t *end)
+{
+    const char *topic;
+    size_t topic_len;
+    uint8_t qos = (flags >> 1) & 0x03;
+    if (qos == 3 || !sim_broker_read_string(&p, end, &topic, &topic_len)) {
+        return false;
+    }
+    uint16_t packet_id = 0;
+    if (qos) {
+        if (end - p < 2) {
+            return false;
+        }
+        packet_id = (p[0] << 8) | p[1];
+        p += 2;
+    }
+    s_broker.stats.publishes_in++;
+    if (s_broker.observer) {
+        sim_broker_message_t message = {
+            .topic = topic, .topic_len = topic_len, .payload = p, .payload_len = end - p,
+            .qos = qos, .retain = flags & 0x01, .received_us = esp_timer_get_time(),
+        };
+        s_broker.observer(&message, s_broker.observer_arg);
+    }
+    sim_broker_forward(topic, topic_len, p, end - p, qos);
+    if (qos == 1) {
+        sim_broker_send_ack(client, MQTT_PUBACK, 0, packet_id);
+    } else if (qos == 2) {
+        sim_broker_send_ack(client, MQTT_PUBREC, 0, packet_id);
+    }
+    return true;
+}
+
+static bool sim_broker_on_subscribe(sim_broker_client_t *client, bool subscribe, const uint8_t *p, const uint8_t *end)
+{
+    if (end - p < 2) {
+        return false;
+    }
+    uint16_t packet_id = (p[0] << 8) | p[1];
+    p += 2;
+    uint8_t codes[32];
+    size_t count = 0;
+    sim_broker_session_t *session = client->session;
+    while (p < end && count < sizeof(codes)) {
+        const char *filter;
+        size_t filter_len;
+        if (!sim_broker_read_string(&p, end, &filter, &filter_len) || (subscribe && p == end)) {
+            return false;
+        }
+        uint8_t qos = subscribe ? *p++ & 0x03 : 0;
+        if (qos > 1) {
+            qos = 1;
+        }
+        size_t index = 0;
+        while (index < session->sub_count &&
+                !(strlen(session->subs[index].filter) == filter_len && memcmp(session->subs[index].filter, filter, filter_len) == 0)) {
+            index++;
+        }
+        if (!subscribe) {
+            if (index < session->sub_count) {
+                session->subs[index] = session->subs[--session->sub_count];
+            }
+            continue;
+        }
+        if (filter_len >= SIM_BROKER_MAX_FILTER || (index == session->sub_count && index == SIM_BROKER_MAX_SUBS)) {
+            codes[count++] = 0x80;
+            continue;
+        }
+        snprintf(session->subs[index].filter, SIM_BROKER_MAX_FILTER, "%.*s", (int)filter_len, filter);
+        session->subs[index].qos = qos;
+        if (index == session->sub_count) {
+            session->sub_count++;
+        }
+        codes[count++] = qos;
+    }
+    if (!subscribe) {
+        sim_broker_send_ack(client, MQTT_UNSUBACK, 0, packet_id);
+        return true;
+    }
+    uint8_t suback[4 + sizeof(codes)] = { MQTT_SUBACK << 4, 2 + count, packet_id >> 8, packet_id & 0xFF };
+    memcpy(&suback[4], codes, count);
+    sim_broker_send(client, suback, 4 + count);
+    return true;
+}
+
+/* @return false when the connection must be closed */
+static bool sim_broker_on_packet(sim_broker_client_t *client, uint8_t header, const uint8_t *p, const uint8_t *end)
+{
+    uint8_t type = header >> 4;
+    if (type != MQTT_CONNECT && client->session == NULL) {
+        return false;
+    }
+    switch (type) {
+    case MQTT_CONNECT:
+        return client->session == NULL && sim_broker_on_connect(client, p, end);
+    case MQTT_PUBLISH:
+        return sim_broker_on_publish(client, header & 0x0F, p, end);
+    case MQTT_PUBREL:
+        if (end - p < 2) {
+            return false;
+        }
+        sim_broker_send_ack(client, MQTT_PUBCOMP, 0, (p[0] << 8) | p[1]);
+        return true;
+    case MQTT_PUBACK:
+    case MQTT_PUBREC:
+    case MQTT_PUBCOMP:
+        // Outgoing messages are not retried, acknowledgements have nothing to release
+        if (type == MQTT_PUBREC && end - p >= 2) {
+            sim_broker_send_ack(client, MQTT_PUBREL, 0x02, (p[0] << 8) | p[1]);
+        }
+        return true;
+    case MQTT_SUBSCRIBE:
+    case MQTT_UNSUBSCRIBE:
+        return sim_broker_on_subscribe(client, type == MQTT_SUBSCRIBE, p, end);
+    case MQTT_PINGREQ: {
+        uint8_t pingresp[2] = { MQTT_PINGRESP << 4, 0 };
+        sim_broker_send(client, pingresp, sizeof(pingresp));
+        return true;
+    }
+    case MQTT_DISCONNECT:
+    default:
+        return false;
+    }
+}
+
+static void sim_broker_close(sim_broker_client_t *client)
+{
+    if (client->session && !client->session->persistent) {
+        client->session->used = false;
+    }
+    close(client->fd);
+    free(client->rx);
+    *client = (sim_broker_client_t) { .fd = -1 };
+}
+
+/* Parse the complete packets received so far */
+static bool sim_broker_process(sim_broker_client_t *client)
+{
+    size_t offset = 0;
+    bool open = true;
+    while (open) {
+        const uint8_t *packet = client->rx + offset;
+        size_t available = client->rx_len - offset;
+        // Remaining length, 1 to 4 bytes after the fixed header byte
+        size_t length = 0;
+        size_t n = 1;
+        bool complete_length = false;
+        while (n < available && n <= 4 && !complete_length) {
+            uint8_t byte = packet[n];
+            length |= (size_t)(byte & 0x7F) << (7 * (n - 1));
+            complete_length = (byte & 0x80) == 0;
+            n++;
+        }
+        if (!complete_length) {
+            // Malformed once 4 length bytes all have the continuation bit
+            open = n <= 4;
+            break;
+        }
+        if (length > SIM_BROKER_MAX_PACKET) {
+            open = false;
+            break;
+        }
+        if (available < n + length) {
+            break;
+        }
+        open = sim_broker_on_packet(client, packet[0], packet + n, packet + n + length);
+        offset += n + length;
+    }
+    memmove(client->rx, client->rx + offset, client->rx_len - offset);
+    client->rx_len -= offset;
+    return open;
+}
+
+static void sim_broker_read(sim_broker_client_t *client)
+{
+    if (client->rx_size - client->rx_len < 1024) {
+        size_t size = client->rx_size ? client->rx_size * 2 : 4096;
+        uint8_t *rx = size <= 2 * SIM_BROKER_MAX_PACKET ? realloc(client->rx, size) : NULL;
+        if (rx == NULL) {
+            sim_broker_close(client);
+            return;
+        }
+        client->rx = rx;
+        client->rx_size = size;
+    }
+    ssize_t ret = recv(client->fd, client->rx + client->rx_len, client->rx_size - client->rx_len, 0);
+    if (ret < 0 && errno == EINTR) {
+        return;
+    }
+    if (ret <= 0) {
+        sim_broker_close(client);
+        return;
+    }
+    client->rx_len += ret;
+    s_broker.stats.bytes_in += ret;
+    if (!sim_broker_process(client)) {
+        sim_broker_close(client);
+    }
+}
+
+static void sim_broker_accept(void)
+{
+    int fd = accept(s_broker.listen_fd, NULL, NULL);
+    if (fd < 0) {
+        return;
+    }
+    for (int i = 0; i < SIM_BROKER_MAX_CLIENTS; i++) {
+        if (s_broker.clients[i].fd < 0) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            s_broker.clients[i] = (sim_broker_client_t) { .fd = fd };
+            return;
+        }
+    }
+    SIM_BROKER_LOG("W", "Too many clients");
+    close(fd);
+}
+
+static void *sim_broker_thread(void *arg)
+{
+    (void)arg;
+    struct pollfd fds[SIM_BROKER_MAX_CLIENTS + 2];
+    while (true) {
+        pthread_mutex_lock(&s_broker.lock);
+        bool running = s_broker.running;
+        nfds_t count = 0;
+        fds[count++] = (struct pollfd) { .fd = s_broker.wake_pipe[0], .events = POLLIN };
+        fds[count++] = (struct pollfd) { .fd = s_broker.listen_fd, .events = POLLIN };
+        for (int i = 0; i < SIM_BROKER_MAX_CLIENTS; i++) {
+            fds[count++] = (struct pollfd) { .fd = s_broker.clients[i].fd, .events = POLLIN };
+        }
+        pthread_mutex_unlock(&s_broker.lock);
+        if (!running) {
+            break;
+        }
+        if (poll(fds, count, -1) < 0 && errno != EINTR) {
+            SIM_BROKER_LOG("E", "poll: %s", strerror(errno));
+            break;
+        }
+
+        pthread_mutex_lock(&s_broker.lock);
+        if (fds[0].revents & POLLIN) {
+            uint8_t drain[16];
+            (void)read(s_broker.wake_pipe[0], drain, sizeof(drain));
+        }
+        if (fds[1].revents & POLLIN) {
+            sim_broker_accept();
+        }
+        for (int i = 0; i < SIM_BROKER_MAX_CLIENTS; i++) {
+            sim_broker_client_t *client = &s_broker.clients[i];
+            // The slot may have been closed or reused while the lock was released
+            if (client->fd >= 0 && client->fd == fds[i + 2].fd && fds[i + 2].revents) {
+                sim_broker_read(client);
+            }
+        }
+        pthread_mutex_unlock(&s_broker.lock);
+    }
+    return NULL;
+}
+
+static void sim_broker_wake(void)
+{
+    uint8_t byte = 0;
+    (void)write(s_broker.wake_pipe[1], &byte, 1);
+}
+
+esp_err_t sim_broker_start(uint16_t port, sim_broker_observer_t observer, void *arg)
+{
+    if (s_broker.running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return ESP_FAIL;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, SIM_BROKER_MAX_CLIENTS) != 0) {
+        ESP_LOGE(TAG, "Failed to listen on port %d: %s", port, strerror(errno));
+        close(fd);
+        return ESP_FAIL;
+    }
+    if (pipe(s_broker.wake_pipe) != 0) {
+        close(fd);
+        return ESP_FAIL;
+    }
+    s_broker.listen_fd = fd;
+    s_broker.observer = observer;
+    s_broker.observer_arg = arg;
+    for (int i = 0; i < SIM_BROKER_MAX_CLIENTS; i++) {
+        s_broker.clients[i] = (sim_broker_client_t) { .fd = -1 };
+    }
+    memset(s_broker.sessions, 0, sizeof(s_broker.sessions));
+    memset(&s_broker.stats, 0, sizeof(s_broker.stats));
+    s_broker.running = true;
+
+    // The FreeRTOS POSIX port drives its scheduler with signals, they must only reach its own threads
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+    int ret = pthread_create(&s_broker.thread, NULL, sim_broker_thread, NULL);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    if (ret != 0) {
+        s_broker.running = false;
+        close(fd);
+        close(s_broker.wake_pipe[0]);
+        close(s_broker.wake_pipe[1]);
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Listening on 127.0.0.1:%d", port);
+    return ESP_OK;
+}
+
+void sim_broker_stop(void)
+{
+    pthread_mutex_lock(&s_broker.lock);
+    bool running = s_broker.running;
+    s_broker.running = false;
+    pthread_mutex_unlock(&s_broker.lock);
+    if (!running) {
+        return;
+    }
+    sim_broker_wake();
+    pthread_join(s_broker.thread, NULL);
+    for (int i = 0; i < SIM_BROKER_MAX_CLIENTS; i++) {
+        if (s_broker.clients[i].fd >= 0) {
+            sim_broker_close(&s_broker.clients[i]);
+        }
+    }
+    close(s_broker.listen_fd);
+    close(s_broker.wake_pipe[0]);
+    close(s_broker.wake_pipe[1]);
+    s_broker.listen_fd = -1;
+}
+
+esp_err_t sim_broker_publish(const char *topic, const void *payload, size_t len, uint8_t qos)
+{
+    if (topic == NULL || (payload == NULL && len) || qos > 2) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_broker.lock);
+    if (s_broker.running) {
+        sim_broker_forward(topic, strlen(topic), payload, len, qos);
+    }
+    pthread_mutex_unlock(&s_broker.lock);
+    return ESP_OK;
+}
+
+void sim_broker_drop_clients(void)
+{
+    pthread_mutex_lock(&s_broker.lock);
+    for (int i = 0; i < SIM_BROKER_MAX_CLIENTS; i++) {
+        if (s_broker.clients[i].fd >= 0) {
+            // Closed by the broker thread once it sees the end of the stream
+            shutdown(s_broker.clients[i].fd, SHUT_RDWR);
+        }
+    }
+    pthread_mutex_unlock(&s_broker.lock);
+    sim_broker_wake();
+}
+
+void sim_broker_get_stats(sim_broker_stats_t *stats)
+{
+    pthread_mutex_lock(&s_broker.lock);
+    *stats = s_broker.stats;
+    pthread_mutex_unlock(&s_broker.lock);
+}
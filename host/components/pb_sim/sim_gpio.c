@@ -0,0 +1,254 @@
+#include <stdbool.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "driver/gpio.h"
+#include "sim_gpio.h"
+
+static const char *TAG = "sim_gpio";
+
+#define SIM_GPIO_FLOATING   (-1)
+
+typedef struct {
+    gpio_mode_t mode;
+    bool pull_up;
+    bool pull_down;
+    int out_level;
+    int in_level;                   // SIM_GPIO_FLOATING when not driven
+    gpio_int_type_t intr_type;
+    bool intr_enabled;
+    gpio_isr_t isr;
+    void *isr_arg;
+    sim_gpio_input_fn_t input_fn;
+    void *input_arg;
+    sim_gpio_output_fn_t output_fn;
+    void *output_arg;
+} sim_gpio_pin_t;
+
+static sim_gpio_pin_t s_pins[GPIO_NUM_MAX] = {
+    [0 ... GPIO_NUM_MAX - 1] = { .mode = GPIO_MODE_DISABLE, .in_level = SIM_GPIO_FLOATING },
+};
+static bool s_isr_service;
+
+static bool sim_gpio_valid(gpio_num_t gpio_num)
+{
+    return gpio_num >= 0 && gpio_num < GPIO_NUM_MAX;
+}
+
+static int sim_gpio_input_level(gpio_num_t gpio_num)
+{
+    const sim_gpio_pin_t *pin = &s_pins[gpio_num];
+    if (pin->input_fn) {
+        return pin->input_fn(gpio_num, esp_timer_get_time(), pin->input_arg) ? 1 : 0;
+    }
+    if (pin->in_level != SIM_GPIO_FLOATING) {
+        return pin->in_level;
+    }
+    if (pin->mode & GPIO_MODE_OUTPUT) {
+        return pin->out_level;
+    }
+    return pin->pull_up ? 1 : 0;
+}
+
+static bool sim_gpio_intr_matches(gpio_int_type_t type, int old_level, int new_level)
+{
+    switch (type) {
+    case GPIO_INTR_POSEDGE:
+        return old_level == 0 && new_level == 1;
+    case GPIO_INTR_NEGEDGE:
+        return old_level == 1 && new_level == 0;
+    case GPIO_INTR_ANYEDGE:
+        return old_level != new_level;
+    case GPIO_INTR_LOW_LEVEL:
+        return new_level == 0;
+    case GPIO_INTR_HIGH_LEVEL:
+        return new_level == 1;
+    default:
+        return false;
+    }
+}
+
+static void sim_gpio_input_changed(gpio_num_t gpio_num, int old_level)
+{
+    sim_gpio_pin_t *pin = &s_pins[gpio_num];
+    int new_level = sim_gpio_input_level(gpio_num);
+    if (s_isr_service && pin->isr && pin->intr_enabled && sim_gpio_intr_matches(pin->intr_type, old_level, new_level)) {
+        pin->isr(pin->isr_arg);
+    }
+}
+
+esp_err_t gpio_config(const gpio_config_t *pGPIOConfig)
+{
+    if (pGPIOConfig == NULL || (pGPIOConfig->pin_bit_mask >> GPIO_NUM_MAX) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < GPIO_NUM_MAX; i++) {
+        if (pGPIOConfig->pin_bit_mask & (1ULL << i)) {
+            sim_gpio_pin_t *pin = &s_pins[i];
+            pin->mode = pGPIOConfig->mode;
+            pin->pull_up = pGPIOConfig->pull_up_en;
+            pin->pull_down = pGPIOConfig->pull_down_en;
+            pin->intr_type = pGPIOConfig->intr_type;
+            pin->intr_enabled = pGPIOConfig->intr_type != GPIO_INTR_DISABLE;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio_num)
+{
+    if (!sim_gpio_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sim_gpio_pin_t *pin = &s_pins[gpio_num];
+    pin->mode = GPIO_MODE_INPUT;
+    pin->pull_up = true;
+    pin->pull_down = false;
+    pin->intr_type = GPIO_INTR_DISABLE;
+    pin->intr_enabled = false;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode)
+{
+    if (!sim_gpio_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_pins[gpio_num].mode = mode;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    if (!sim_gpio_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sim_gpio_pin_t *pin = &s_pins[gpio_num];
+    pin->out_level = level ? 1 : 0;
+    if (pin->output_fn) {
+        pin->output_fn(gpio_num, pin->out_level, esp_timer_get_time(), pin->output_arg);
+    }
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    if (!sim_gpio_valid(gpio_num)) {
+        return 0;
+    }
+    // As on the chip, a pin configured as output only reads low
+    if ((s_pins[gpio_num].mode & GPIO_MODE_INPUT) == 0) {
+        return 0;
+    }
+    return sim_gpio_input_level(gpio_num);
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type)
+{
+    if (!sim_gpio_valid(gpio_num) || intr_type >= GPIO_INTR_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_pins[gpio_num].intr_type = intr_type;
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_enable(gpio_num_t gpio_num)
+{
+    if (!sim_gpio_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_pins[gpio_num].intr_enabled = true;
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_disable(gpio_num_t gpio_num)
+{
+    if (!sim_gpio_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_pins[gpio_num].intr_enabled = false;
+    return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags)
+{
+    (void)intr_alloc_flags;
+    if (s_isr_service) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_isr_service = true;
+    return ESP_OK;
+}
+
+void gpio_uninstall_isr_service(void)
+{
+    s_isr_service = false;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args)
+{
+    if (!sim_gpio_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_isr_service) {
+        ESP_LOGE(TAG, "GPIO isr service is not installed");
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_pins[gpio_num].isr = isr_handler;
+    s_pins[gpio_num].isr_arg = args;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio_num)
+{
+    if (!sim_gpio_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_pins[gpio_num].isr = NULL;
+    s_pins[gpio_num].isr_arg = NULL;
+    return ESP_OK;
+}
+
+void sim_gpio_set_input(gpio_num_t gpio_num, int level)
+{
+    if (!sim_gpio_valid(gpio_num)) {
+        return;
+    }
+    int old_level = sim_gpio_input_level(gpio_num);
+    s_pins[gpio_num].in_level = level ? 1 : 0;
+    sim_gpio_input_changed(gpio_num, old_level);
+}
+
+void sim_gpio_release_input(gpio_num_t gpio_num)
+{
+    if (!sim_gpio_valid(gpio_num)) {
+        return;
+    }
+    int old_level = sim_gpio_input_level(gpio_num);
+    s_pins[gpio_num].in_level = SIM_GPIO_FLOATING;
+    sim_gpio_input_changed(gpio_num, old_level);
+}
+
+esp_err_t sim_gpio_set_input_fn(gpio_num_t gpio_num, sim_gpio_input_fn_t fn, void *arg)
+{
+    if (!sim_gpio_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_pins[gpio_num].input_fn = fn;
+    s_pins[gpio_num].input_arg = arg;
+    return ESP_OK;
+}
+
+esp_err_t sim_gpio_set_output_fn(gpio_num_t gpio_num, sim_gpio_output_fn_t fn, void *arg)
+{
+    if (!sim_gpio_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_pins[gpio_num].output_fn = fn;
+    s_pins[gpio_num].output_arg = arg;
+    return ESP_OK;
+}
+
+int sim_gpio_get_output(gpio_num_t gpio_num)
+{
+    return sim_gpio_valid(gpio_num) ? s_pins[gpio_num].out_level : 0;
+}
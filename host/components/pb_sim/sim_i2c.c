@@ -0,0 +1,340 @@
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "driver/i2c.h"
+#include "sim_i2c.h"
+
+static const char *TAG = "sim_i2c";
+
+#define SIM_I2C_MAX_OPS         32
+#define SIM_I2C_BITS_PER_BYTE   9       // 8 data bits and the acknowledge
+#define SIM_I2C_BITS_START_STOP 2
+
+typedef enum {
+    SIM_I2C_OP_START,
+    SIM_I2C_OP_WRITE,
+    SIM_I2C_OP_READ,
+    SIM_I2C_OP_STOP,
+} sim_i2c_op_type_t;
+
+typedef struct {
+    sim_i2c_op_type_t type;
+    bool ack_en;
+    uint8_t byte;               // Single byte writes are copied, like the driver does
+    const uint8_t *write_data;
+    uint8_t *read_data;
+    size_t len;
+    i2c_ack_type_t ack;
+} sim_i2c_op_t;
+
+typedef struct {
+    size_t count;
+    sim_i2c_op_t ops[SIM_I2C_MAX_OPS];
+} sim_i2c_cmd_t;
+
+typedef struct {
+    bool installed;
+    uint32_t clk_speed;
+    SemaphoreHandle_t lock;
+    sim_i2c_device_t *devices;
+    sim_i2c_stats_t stats;
+} sim_i2c_bus_t;
+
+static sim_i2c_bus_t s_buses[I2C_NUM_MAX];
+
+static bool sim_i2c_valid(i2c_port_t port)
+{
+    return port >= 0 && port < I2C_NUM_MAX;
+}
+
+static sim_i2c_op_t *sim_i2c_add_op(i2c_cmd_handle_t cmd_handle, sim_i2c_op_type_t type)
+{
+    sim_i2c_cmd_t *cmd = cmd_handle;
+    if (cmd == NULL || cmd->count == SIM_I2C_MAX_OPS) {
+        return NULL;
+    }
+    sim_i2c_op_t *op = &cmd->ops[cmd->count++];
+    memset(op, 0, sizeof(*op));
+    op->type = type;
+    return op;
+}
+
+esp_err_t i2c_param_config(i2c_port_t i2c_num, const i2c_config_t *i2c_conf)
+{
+    if (!sim_i2c_valid(i2c_num) || i2c_conf == NULL || i2c_conf->mode != I2C_MODE_MASTER) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_buses[i2c_num].clk_speed = i2c_conf->master.clk_speed;
+    return ESP_OK;
+}
+
+esp_err_t i2c_driver_install(i2c_port_t i2c_num, i2c_mode_t mode, size_t slv_rx_buf_len, size_t slv_tx_buf_len, int intr_alloc_flags)
+{
+    (void)slv_rx_buf_len;
+    (void)slv_tx_buf_len;
+    (void)intr_alloc_flags;
+    if (!sim_i2c_valid(i2c_num) || mode != I2C_MODE_MASTER) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sim_i2c_bus_t *bus = &s_buses[i2c_num];
+    if (bus->installed) {
+        ESP_LOGE(TAG, "i2c driver install error");
+        return ESP_FAIL;
+    }
+    if (bus->lock == NULL && (bus->lock = xSemaphoreCreateMutex()) == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    bus->installed = true;
+    return ESP_OK;
+}
+
+esp_err_t i2c_driver_delete(i2c_port_t i2c_num)
+{
+    if (!sim_i2c_valid(i2c_num) || !s_buses[i2c_num].installed) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_buses[i2c_num].installed = false;
+    return ESP_OK;
+}
+
+i2c_cmd_handle_t i2c_cmd_link_create(void)
+{
+    return calloc(1, sizeof(sim_i2c_cmd_t));
+}
+
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd_handle)
+{
+    free(cmd_handle);
+}
+
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd_handle)
+{
+    return sim_i2c_add_op(cmd_handle, SIM_I2C_OP_START) ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd_handle, uint8_t data, bool ack_en)
+{
+    sim_i2c_op_t *op = sim_i2c_add_op(cmd_handle, SIM_I2C_OP_WRITE);
+    if (op == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    op->byte = data;
+    op->write_data = NULL;
+    op->len = 1;
+    op->ack_en = ack_en;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd_handle, const uint8_t *data, size_t data_len, bool ack_en)
+{
+    if (data == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sim_i2c_op_t *op = sim_i2c_add_op(cmd_handle, SIM_I2C_OP_WRITE);
+    if (op == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    op->write_data = data;
+    op->len = data_len;
+    op->ack_en = ack_en;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_read_byte(i2c_cmd_handle_t cmd_handle, uint8_t *data, i2c_ack_type_t ack)
+{
+    return i2c_master_read(cmd_handle, data, 1, ack);
+}
+
+esp_err_t i2c_master_read(i2c_cmd_handle_t cmd_handle, uint8_t *data, size_t data_len, i2c_ack_type_t ack)
+{
+    if (data == NULL || data_len == 0 || ack >= I2C_MASTER_ACK_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sim_i2c_op_t *op = sim_i2c_add_op(cmd_handle, SIM_I2C_OP_READ);
+    if (op == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    op->read_data = data;
+    op->len = data_len;
+    op->ack = ack;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd_handle)
+{
+    return sim_i2c_add_op(cmd_handle, SIM_I2C_OP_STOP) ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+static sim_i2c_device_t *sim_i2c_find(sim_i2c_bus_t *bus, uint8_t address)
+{
+    for (sim_i2c_device_t *device = bus->devices; device; device = device->next) {
+        if (device->address == address) {
+            return device;
+        }
+    }
+    return NULL;
+}
+
+/* Runs the queued operations against the device models, a NACK ends the transaction like on the wire */
+static esp_err_t sim_i2c_run(sim_i2c_bus_t *bus, const sim_i2c_cmd_t *cmd)
+{
+    sim_i2c_device_t *device = NULL;
+    bool expect_address = false;
+    bool reading = false;
+    uint64_t bits = 0;
+    esp_err_t ret = ESP_OK;
+
+    for (size_t i = 0; i < cmd->count && ret == ESP_OK; i++) {
+        const sim_i2c_op_t *op = &cmd->ops[i];
+        switch (op->type) {
+        case SIM_I2C_OP_START:
+            expect_address = true;
+            bits += SIM_I2C_BITS_START_STOP / 2;
+            break;
+        case SIM_I2C_OP_WRITE:
+            for (size_t j = 0; j < op->len && ret == ESP_OK; j++) {
+                uint8_t byte = op->write_data ? op->write_data[j] : op->byte;
+                bits += SIM_I2C_BITS_PER_BYTE;
+                bus->stats.bytes++;
+                if (expect_address) {
+                    expect_address = false;
+                    reading = byte & I2C_MASTER_READ;
+                    sim_i2c_device_t *target = sim_i2c_find(bus, byte >> 1);
+                    if (device && device != target && device->stop) {
+                        device->stop(device);
+                    }
+                    device = target;
+                    if (device == NULL || (device->start && !device->start(device, reading))) {
+                        device = NULL;
+                        ret = op->ack_en ? ESP_FAIL : ESP_OK;
+                    }
+                } else if (device && !reading) {
+                    bool acked = device->write ? device->write(device, byte) : true;
+                    if (!acked && op->ack_en) {
+                        ret = ESP_FAIL;
+                    }
+                } else if (op->ack_en) {
+                    ret = ESP_FAIL;
+                }
+            }
+            break;
+        case SIM_I2C_OP_READ:
+            for (size_t j = 0; j < op->len; j++) {
+                // Nobody drives SDA without an addressed device, the pull-up reads all ones
+                op->read_data[j] = (device && reading && device->read) ? device->read(device) : 0xFF;
+                bits += SIM_I2C_BITS_PER_BYTE;
+                bus->stats.bytes++;
+            }
+            break;
+        case SIM_I2C_OP_STOP:
+            if (device && device->stop) {
+                device->stop(device);
+            }
+            device = NULL;
+            bits += SIM_I2C_BITS_START_STOP / 2;
+            break;
+        }
+    }
+    if (ret != ESP_OK) {
+        bus->stats.nacks++;
+        if (device && device->stop) {
+            device->stop(device);
+        }
+    }
+    if (bus->clk_speed) {
+        bus->stats.bus_time_us += bits * 1000000ULL / bus->clk_speed;
+    }
+    return ret;
+}
+
+esp_err_t i2c_master_cmd_begin(i2c_port_t i2c_num, i2c_cmd_handle_t cmd_handle, TickType_t ticks_to_wait)
+{
+    if (!sim_i2c_valid(i2c_num) || cmd_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sim_i2c_bus_t *bus = &s_buses[i2c_num];
+    if (!bus->installed) {
+        ESP_LOGE(TAG, "i2c driver not installed");
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (xSemaphoreTake(bus->lock, ticks_to_wait) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    bus->stats.transactions++;
+    esp_err_t ret = sim_i2c_run(bus, cmd_handle);
+    xSemaphoreGive(bus->lock);
+    return ret;
+}
+
+esp_err_t i2c_master_write_to_device(i2c_port_t i2c_num, uint8_t device_address, const uint8_t *write_buffer, size_t write_size, TickType_t ticks_to_wait)
+{
+    return i2c_master_write_read_device(i2c_num, device_address, write_buffer, write_size, NULL, 0, ticks_to_wait);
+}
+
+esp_err_t i2c_master_read_from_device(i2c_port_t i2c_num, uint8_t device_address, uint8_t *read_buffer, size_t read_size, TickType_t ticks_to_wait)
+{
+    return i2c_master_write_read_device(i2c_num, device_address, NULL, 0, read_buffer, read_size, ticks_to_wait);
+}
+
+esp_err_t i2c_master_write_read_device(i2c_port_t i2c_num, uint8_t device_address, const uint8_t *write_buffer, size_t write_size,
+                                       uint8_t *read_buffer, size_t read_size, TickType_t ticks_to_wait)
+{
+    sim_i2c_cmd_t cmd = { 0 };
+    if (write_size) {
+        i2c_master_start(&cmd);
+        i2c_master_write_byte(&cmd, (device_address << 1) | I2C_MASTER_WRITE, true);
+        i2c_master_write(&cmd, write_buffer, write_size, true);
+    }
+    if (read_size) {
+        i2c_master_start(&cmd);
+        i2c_master_write_byte(&cmd, (device_address << 1) | I2C_MASTER_READ, true);
+        i2c_master_read(&cmd, read_buffer, read_size, I2C_MASTER_LAST_NACK);
+    }
+    i2c_master_stop(&cmd);
+    return i2c_master_cmd_begin(i2c_num, &cmd, ticks_to_wait);
+}
+
+esp_err_t sim_i2c_add_device(i2c_port_t port, sim_i2c_device_t *device)
+{
+    if (!sim_i2c_valid(port) || device == NULL || device->address > 0x7F) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sim_i2c_bus_t *bus = &s_buses[port];
+    if (sim_i2c_find(bus, device->address)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    device->next = bus->devices;
+    bus->devices = device;
+    return ESP_OK;
+}
+
+esp_err_t sim_i2c_remove_device(i2c_port_t port, sim_i2c_device_t *device)
+{
+    if (!sim_i2c_valid(port) || device == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (sim_i2c_device_t **it = &s_buses[port].devices; *it; it = &(*it)->next) {
+        if (*it == device) {
+            *it = device->next;
+            device->next = NULL;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+void sim_i2c_get_stats(i2c_port_t port, sim_i2c_stats_t *stats)
+{
+    if (sim_i2c_valid(port) && stats) {
+        *stats = s_buses[port].stats;
+    }
+}
+
+void sim_i2c_reset_stats(i2c_port_t port)
+{
+    if (sim_i2c_valid(port)) {
+        memset(&s_buses[port].stats, 0, sizeof(s_buses[port].stats));
+    }
+}
@@ -0,0 +1,117 @@
+#include <math.h>
+#include "sim_i2c.h"
+#include "sim_ina3221.h"
+
+#define INA3221_REG_CONFIG          0x00
+#define INA3221_REG_MANUFACTURER_ID 0xFE
+#define INA3221_REG_DIE_ID          0xFF
+#define INA3221_CONFIG_RESET        0x8000
+#define INA3221_CONFIG_POR          0x7127
+#define INA3221_MANUFACTURER_ID     0x5449
+#define INA3221_DIE_ID              0x3220
+#define INA3221_SHUNT_LSB_MV        0.04f
+#define INA3221_BUS_LSB_V           0.008f
+
+typedef struct {
+    sim_i2c_device_t device;
+    uint16_t regs[256];
+    uint8_t pointer;
+    uint8_t write_count;        // Bytes written since the start, the first one sets the pointer
+    uint8_t msb;
+    bool read_lsb;
+} sim_ina3221_t;
+
+static sim_ina3221_t s_ina3221;
+
+static uint16_t sim_ina3221_encode(float value, float lsb)
+{
+    // 13 bit two's complement left aligned in the register
+    long raw = lroundf(value / lsb);
+    if (raw > 4095) {
+        raw = 4095;
+    } else if (raw < -4096) {
+        raw = -4096;
+    }
+    return (uint16_t)(raw << 3);
+}
+
+static void sim_ina3221_reset(sim_ina3221_t *ina)
+{
+    for (int reg = INA3221_REG_CONFIG + 1; reg <= 0x06; reg++) {
+        ina->regs[reg] = 0;
+    }
+    ina->regs[INA3221_REG_CONFIG] = INA3221_CONFIG_POR;
+    ina->regs[INA3221_REG_MANUFACTURER_ID] = INA3221_MANUFACTURER_ID;
+    ina->regs[INA3221_REG_DIE_ID] = INA3221_DIE_ID;
+}
+
+static bool sim_ina3221_start(sim_i2c_device_t *device, bool read)
+{
+    sim_ina3221_t *ina = (sim_ina3221_t *)device;
+    ina->write_count = 0;
+    ina->read_lsb = false;
+    (void)read;
+    return true;
+}
+
+static bool sim_ina3221_write(sim_i2c_device_t *device, uint8_t data)
+{
+    sim_ina3221_t *ina = (sim_ina3221_t *)device;
+    if (ina->write_count == 0) {
+        ina->pointer = data;
+    } else if (ina->write_count % 2 == 1) {
+        ina->msb = data;
+    } else {
+        uint16_t value = (ina->msb << 8) | data;
+        // Only the configuration and the alert limits are writable
+        if (ina->pointer == INA3221_REG_CONFIG) {
+            if (value & INA3221_CONFIG_RESET) {
+                sim_ina3221_reset(ina);
+            } else {
+                ina->regs[INA3221_REG_CONFIG] = value;
+            }
+        } else if (ina->pointer >= 0x07 && ina->pointer <= 0x10) {
+            ina->regs[ina->pointer] = value;
+        }
+    }
+    ina->write_count++;
+    return true;
+}
+
+static uint8_t sim_ina3221_read(sim_i2c_device_t *device)
+{
+    sim_ina3221_t *ina = (sim_ina3221_t *)device;
+    // The pointer does not auto-increment, longer reads repeat the register
+    uint16_t value = ina->regs[ina->pointer];
+    uint8_t byte = ina->read_lsb ? (value & 0xFF) : (value >> 8);
+    ina->read_lsb = !ina->read_lsb;
+    return byte;
+}
+
+esp_err_t sim_ina3221_attach(i2c_port_t port, uint8_t address)
+{
+    s_ina3221.device = (sim_i2c_device_t) {
+        .address = address,
+        .start = sim_ina3221_start,
+        .write = sim_ina3221_write,
+        .read = sim_ina3221_read,
+    };
+    sim_ina3221_reset(&s_ina3221);
+    return sim_i2c_add_device(port, &s_ina3221.device);
+}
+
+esp_err_t sim_ina3221_set_channel(int channel, float bus_voltage_v, float shunt_voltage_mv)
+{
+    if (channel < 1 || channel > 3) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint8_t shunt_reg = (channel - 1) * 2 + 1;
+    s_ina3221.regs[shunt_reg] = sim_ina3221_encode(shunt_voltage_mv, INA3221_SHUNT_LSB_MV);
+    s_ina3221.regs[shunt_reg + 1] = sim_ina3221_encode(bus_voltage_v, INA3221_BUS_LSB_V);
+    return ESP_OK;
+}
+
+uint16_t sim_ina3221_get_register(uint8_t reg)
+{
+    return s_ina3221.regs[reg];
+}
@@ -0,0 +1,127 @@
+#include <stdlib.h>
+#include <string.h>
+#include "led_strip.h"
+#include "sim_led_strip.h"
+
+#define SIM_LED_STRIP_MAX   4
+
+struct led_strip_t {
+    int gpio_num;
+    uint32_t max_leds;
+    uint8_t *pixels;            // Written by led_strip_set_pixel(), RGB
+    uint8_t *shown;             // Latched by led_strip_refresh()
+    uint32_t refreshes;
+};
+
+static struct led_strip_t *s_strips[SIM_LED_STRIP_MAX];
+
+static struct led_strip_t *sim_led_strip_find(int gpio_num)
+{
+    for (int i = 0; i < SIM_LED_STRIP_MAX; i++) {
+        if (s_strips[i] && s_strips[i]->gpio_num == gpio_num) {
+            return s_strips[i];
+        }
+    }
+    return NULL;
+}
+
+esp_err_t led_strip_new_rmt_device(const led_strip_config_t *led_config, const led_strip_rmt_config_t *rmt_config, led_strip_handle_t *ret_strip)
+{
+    (void)rmt_config;
+    if (led_config == NULL || ret_strip == NULL || led_config->max_leds == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (sim_led_strip_find(led_config->strip_gpio_num)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    int slot = 0;
+    while (slot < SIM_LED_STRIP_MAX && s_strips[slot]) {
+        slot++;
+    }
+    if (slot == SIM_LED_STRIP_MAX) {
+        return ESP_ERR_NO_MEM;
+    }
+    struct led_strip_t *strip = calloc(1, sizeof(*strip));
+    uint8_t *pixels = calloc(2, led_config->max_leds * 3);
+    if (strip == NULL || pixels == NULL) {
+        free(strip);
+        free(pixels);
+        return ESP_ERR_NO_MEM;
+    }
+    strip->gpio_num = led_config->strip_gpio_num;
+    strip->max_leds = led_config->max_leds;
+    strip->pixels = pixels;
+    strip->shown = pixels + led_config->max_leds * 3;
+    s_strips[slot] = strip;
+    *ret_strip = strip;
+    return ESP_OK;
+}
+
+esp_err_t led_strip_set_pixel(led_strip_handle_t strip, uint32_t index, uint32_t red, uint32_t green, uint32_t blue)
+{
+    if (strip == NULL || index >= strip->max_leds) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint8_t *pixel = &strip->pixels[index * 3];
+    pixel[0] = red;
+    pixel[1] = green;
+    pixel[2] = blue;
+    return ESP_OK;
+}
+
+esp_err_t led_strip_refresh(led_strip_handle_t strip)
+{
+    if (strip == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memcpy(strip->shown, strip->pixels, strip->max_leds * 3);
+    strip->refreshes++;
+    return ESP_OK;
+}
+
+esp_err_t led_strip_clear(led_strip_handle_t strip)
+{
+    if (strip == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Like the RMT backend, clearing writes the strip right away
+    memset(strip->pixels, 0, strip->max_leds * 3);
+    return led_strip_refresh(strip);
+}
+
+esp_err_t led_strip_del(led_strip_handle_t strip)
+{
+    if (strip == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < SIM_LED_STRIP_MAX; i++) {
+        if (s_strips[i] == strip) {
+            s_strips[i] = NULL;
+        }
+    }
+    free(strip->pixels);
+    free(strip);
+    return ESP_OK;
+}
+
+esp_err_t sim_led_strip_get_pixel(int gpio_num, uint32_t index, uint8_t *red, uint8_t *green, uint8_t *blue)
+{
+    const struct led_strip_t *strip = sim_led_strip_find(gpio_num);
+    if (strip == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (index >= strip->max_leds) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const uint8_t *pixel = &strip->shown[index * 3];
+    *red = pixel[0];
+    *green = pixel[1];
+    *blue = pixel[2];
+    return ESP_OK;
+}
+
+uint32_t sim_led_strip_get_refresh_count(int gpio_num)
+{
+    const struct led_strip_t *strip = sim_led_strip_find(gpio_num);
+    return strip ? strip->refreshes : 0;
+}
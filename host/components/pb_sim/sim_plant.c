@@ -0,0 +1,170 @@
+#include <inttypes.h>
+#include <stdbool.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sim_gpio.h"
+#include "sim_pwm.h"
+#include "sim_plant.h"
+
+static const char *TAG = "sim_plant";
+
+#define SIM_HCSR04_MAX          4
+#define SIM_HCSR04_ECHO_DELAY_US 150    // Burst of 8 cycles at 40 kHz before the echo rises
+#define SIM_HCSR04_US_PER_CM    58      // Round trip at the speed of sound
+
+typedef struct {
+    gpio_num_t trigger_pin;
+    gpio_num_t echo_pin;
+    int distance_cm;
+    int64_t trigger_us;         // Falling edge of the last trigger pulse, -1 before the first
+} sim_hcsr04_t;
+
+typedef struct {
+    bool attached;
+    sim_barrier_config_t config;
+    float position;
+    bool jammed;
+    float drive;                // Net motor drive since the last change, -1.0 closing to 1.0 opening
+    int64_t updated_us;
+} sim_barrier_t;
+
+// The POSIX port of FreeRTOS runs one task at a time, the models are not otherwise locked
+static sim_hcsr04_t s_hcsr04[SIM_HCSR04_MAX];
+static size_t s_hcsr04_count;
+static sim_barrier_t s_barrier;
+
+static sim_hcsr04_t *sim_hcsr04_find(gpio_num_t echo_pin)
+{
+    for (size_t i = 0; i < s_hcsr04_count; i++) {
+        if (s_hcsr04[i].echo_pin == echo_pin) {
+            return &s_hcsr04[i];
+        }
+    }
+    return NULL;
+}
+
+static void sim_hcsr04_trigger(gpio_num_t gpio_num, int level, int64_t now_us, void *arg)
+{
+    (void)arg;
+    if (level != 0) {
+        return;
+    }
+    for (size_t i = 0; i < s_hcsr04_count; i++) {
+        if (s_hcsr04[i].trigger_pin == gpio_num) {
+            s_hcsr04[i].trigger_us = now_us;
+        }
+    }
+}
+
+static int sim_hcsr04_echo(gpio_num_t gpio_num, int64_t now_us, void *arg)
+{
+    const sim_hcsr04_t *sensor = arg;
+    if (sensor->trigger_us < 0 || sensor->distance_cm == SIM_HCSR04_NO_ECHO) {
+        return 0;
+    }
+    int64_t rise_us = sensor->trigger_us + SIM_HCSR04_ECHO_DELAY_US;
+    int64_t fall_us = rise_us + (int64_t)sensor->distance_cm * SIM_HCSR04_US_PER_CM;
+    return now_us >= rise_us && now_us < fall_us;
+}
+
+esp_err_t sim_hcsr04_attach(gpio_num_t trigger_pin, gpio_num_t echo_pin, int distance_cm)
+{
+    if (s_hcsr04_count == SIM_HCSR04_MAX || sim_hcsr04_find(echo_pin)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    sim_hcsr04_t *sensor = &s_hcsr04[s_hcsr04_count];
+    *sensor = (sim_hcsr04_t) {
+        .trigger_pin = trigger_pin, .echo_pin = echo_pin, .distance_cm = distance_cm, .trigger_us = -1,
+    };
+    esp_err_t ret = sim_gpio_set_output_fn(trigger_pin, sim_hcsr04_trigger, NULL);
+    if (ret == ESP_OK) {
+        ret = sim_gpio_set_input_fn(echo_pin, sim_hcsr04_echo, sensor);
+    }
+    if (ret == ESP_OK) {
+        s_hcsr04_count++;
+    }
+    return ret;
+}
+
+esp_err_t sim_hcsr04_set_distance(gpio_num_t echo_pin, int distance_cm)
+{
+    sim_hcsr04_t *sensor = sim_hcsr04_find(echo_pin);
+    if (sensor == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    sensor->distance_cm = distance_cm;
+    return ESP_OK;
+}
+
+static void sim_barrier_update(int64_t now_us)
+{
+    sim_barrier_t *barrier = &s_barrier;
+    if (!barrier->jammed) {
+        barrier->position += barrier->drive * (now_us - barrier->updated_us) / (barrier->config.travel_ms * 1000.0f);
+        if (barrier->position < 0) {
+            barrier->position = 0;
+        } else if (barrier->position > 1) {
+            barrier->position = 1;
+        }
+    }
+    barrier->updated_us = now_us;
+}
+
+static void sim_barrier_motor_changed(mcpwm_unit_t unit, mcpwm_timer_t timer, void *arg)
+{
+    (void)arg;
+    if (unit == s_barrier.config.unit && timer == s_barrier.config.timer) {
+        // Integrated up to the change with the drive before it, the new one applies from now on
+        sim_barrier_update(esp_timer_get_time());
+        s_barrier.drive = sim_mcpwm_get_output(unit, timer, MCPWM_GEN_A) - sim_mcpwm_get_output(unit, timer, MCPWM_GEN_B);
+    }
+}
+
+static int sim_barrier_sensor(gpio_num_t gpio_num, int64_t now_us, void *arg)
+{
+    (void)arg;
+    sim_barrier_update(now_us);
+    float position = s_barrier.position;
+    if (gpio_num == s_barrier.config.end_stop_gpio) {
+        return position <= 0 || position >= 1;
+    }
+    if (gpio_num == s_barrier.config.locked_gpio) {
+        return position > 0;
+    }
+    return position < 1;
+}
+
+esp_err_t sim_barrier_attach(const sim_barrier_config_t *config)
+{
+    if (config == NULL || config->travel_ms == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_barrier = (sim_barrier_t) {
+        .attached = true, .config = *config, .position = 0, .updated_us = esp_timer_get_time(),
+    };
+    const gpio_num_t sensors[] = { config->end_stop_gpio, config->locked_gpio, config->unlocked_gpio };
+    for (size_t i = 0; i < sizeof(sensors) / sizeof(sensors[0]); i++) {
+        if (sensors[i] != GPIO_NUM_NC) {
+            ESP_ERROR_CHECK(sim_gpio_set_input_fn(sensors[i], sim_barrier_sensor, NULL));
+        }
+    }
+    sim_mcpwm_set_listener(sim_barrier_motor_changed, NULL);
+    ESP_LOGI(TAG, "Barrier on MCPWM%d timer %d, %" PRIu32 " ms travel", config->unit, config->timer, config->travel_ms);
+    return ESP_OK;
+}
+
+float sim_barrier_get_position(void)
+{
+    if (s_barrier.attached) {
+        sim_barrier_update(esp_timer_get_time());
+    }
+    return s_barrier.position;
+}
+
+void sim_barrier_set_jammed(bool jammed)
+{
+    if (s_barrier.attached) {
+        sim_barrier_update(esp_timer_get_time());
+    }
+    s_barrier.jammed = jammed;
+}
@@ -0,0 +1,299 @@
+#include <stdbool.h>
+#include "esp_log.h"
+#include "driver/mcpwm.h"
+#include "driver/ledc.h"
+#include "sim_pwm.h"
+
+static const char *TAG = "sim_pwm";
+
+typedef struct {
+    float duty;                 // Percent, as given to mcpwm_set_duty()
+    mcpwm_duty_type_t type;
+} sim_mcpwm_gen_t;
+
+typedef struct {
+    bool initialized;
+    bool running;
+    uint32_t frequency;
+    sim_mcpwm_gen_t gens[MCPWM_GEN_MAX];
+} sim_mcpwm_timer_t;
+
+typedef struct {
+    bool configured;
+    uint32_t freq_hz;
+    ledc_timer_bit_t resolution;
+} sim_ledc_timer_t;
+
+typedef struct {
+    bool configured;
+    bool stopped;
+    ledc_timer_t timer;
+    int gpio_num;
+    uint32_t duty;              // Staged by ledc_set_duty()
+    uint32_t active_duty;       // Latched by ledc_update_duty()
+} sim_ledc_channel_t;
+
+static sim_mcpwm_timer_t s_mcpwm[MCPWM_UNIT_MAX][MCPWM_TIMER_MAX];
+static int s_mcpwm_gpio[MCPWM_UNIT_MAX][MCPWM2B + 1] = {
+    [0 ... MCPWM_UNIT_MAX - 1] = { [0 ... MCPWM2B] = -1 },
+};
+static sim_mcpwm_listener_t s_mcpwm_listener;
+static void *s_mcpwm_listener_arg;
+
+static sim_ledc_timer_t s_ledc_timers[LEDC_SPEED_MODE_MAX][LEDC_TIMER_MAX];
+static sim_ledc_channel_t s_ledc_channels[LEDC_SPEED_MODE_MAX][LEDC_CHANNEL_MAX];
+
+static bool sim_mcpwm_valid(mcpwm_unit_t unit, mcpwm_timer_t timer)
+{
+    return unit >= 0 && unit < MCPWM_UNIT_MAX && timer >= 0 && timer < MCPWM_TIMER_MAX;
+}
+
+static void sim_mcpwm_changed(mcpwm_unit_t unit, mcpwm_timer_t timer)
+{
+    if (s_mcpwm_listener) {
+        s_mcpwm_listener(unit, timer, s_mcpwm_listener_arg);
+    }
+}
+
+esp_err_t mcpwm_gpio_init(mcpwm_unit_t mcpwm_num, mcpwm_io_signals_t io_signal, int gpio_num)
+{
+    if (mcpwm_num < 0 || mcpwm_num >= MCPWM_UNIT_MAX || io_signal < MCPWM0A || io_signal > MCPWM2B) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_mcpwm_gpio[mcpwm_num][io_signal] = gpio_num;
+    return ESP_OK;
+}
+
+esp_err_t mcpwm_init(mcpwm_unit_t mcpwm_num, mcpwm_timer_t timer_num, const mcpwm_config_t *mcpwm_conf)
+{
+    if (!sim_mcpwm_valid(mcpwm_num, timer_num) || mcpwm_conf == NULL || mcpwm_conf->frequency == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sim_mcpwm_timer_t *t = &s_mcpwm[mcpwm_num][timer_num];
+    t->initialized = true;
+    t->running = true;
+    t->frequency = mcpwm_conf->frequency;
+    t->gens[MCPWM_GEN_A] = (sim_mcpwm_gen_t) { .duty = mcpwm_conf->cmpr_a, .type = mcpwm_conf->duty_mode };
+    t->gens[MCPWM_GEN_B] = (sim_mcpwm_gen_t) { .duty = mcpwm_conf->cmpr_b, .type = mcpwm_conf->duty_mode };
+    sim_mcpwm_changed(mcpwm_num, timer_num);
+    return ESP_OK;
+}
+
+esp_err_t mcpwm_set_frequency(mcpwm_unit_t mcpwm_num, mcpwm_timer_t timer_num, uint32_t frequency)
+{
+    if (!sim_mcpwm_valid(mcpwm_num, timer_num) || frequency == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_mcpwm[mcpwm_num][timer_num].frequency = frequency;
+    return ESP_OK;
+}
+
+esp_err_t mcpwm_set_duty(mcpwm_unit_t mcpwm_num, mcpwm_timer_t timer_num, mcpwm_generator_t gen, float duty)
+{
+    if (!sim_mcpwm_valid(mcpwm_num, timer_num) || gen < 0 || gen >= MCPWM_GEN_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_mcpwm[mcpwm_num][timer_num].gens[gen].duty = duty < 0 ? 0 : (duty > 100 ? 100 : duty);
+    sim_mcpwm_changed(mcpwm_num, timer_num);
+    return ESP_OK;
+}
+
+esp_err_t mcpwm_set_duty_type(mcpwm_unit_t mcpwm_num, mcpwm_timer_t timer_num, mcpwm_generator_t gen, mcpwm_duty_type_t duty_type)
+{
+    if (!sim_mcpwm_valid(mcpwm_num, timer_num) || gen < 0 || gen >= MCPWM_GEN_MAX || duty_type >= MCPWM_DUTY_MODE_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_mcpwm[mcpwm_num][timer_num].gens[gen].type = duty_type;
+    sim_mcpwm_changed(mcpwm_num, timer_num);
+    return ESP_OK;
+}
+
+float mcpwm_get_duty(mcpwm_unit_t mcpwm_num, mcpwm_timer_t timer_num, mcpwm_generator_t gen)
+{
+    if (!sim_mcpwm_valid(mcpwm_num, timer_num) || gen < 0 || gen >= MCPWM_GEN_MAX) {
+        return 0;
+    }
+    return s_mcpwm[mcpwm_num][timer_num].gens[gen].duty;
+}
+
+esp_err_t mcpwm_set_signal_high(mcpwm_unit_t mcpwm_num, mcpwm_timer_t timer_num, mcpwm_generator_t gen)
+{
+    return mcpwm_set_duty_type(mcpwm_num, timer_num, gen, MCPWM_DUTY_MODE_FORCE_HIGH);
+}
+
+esp_err_t mcpwm_set_signal_low(mcpwm_unit_t mcpwm_num, mcpwm_timer_t timer_num, mcpwm_generator_t gen)
+{
+    return mcpwm_set_duty_type(mcpwm_num, timer_num, gen, MCPWM_DUTY_MODE_FORCE_LOW);
+}
+
+esp_err_t mcpwm_start(mcpwm_unit_t mcpwm_num, mcpwm_timer_t timer_num)
+{
+    if (!sim_mcpwm_valid(mcpwm_num, timer_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_mcpwm[mcpwm_num][timer_num].running = true;
+    sim_mcpwm_changed(mcpwm_num, timer_num);
+    return ESP_OK;
+}
+
+esp_err_t mcpwm_stop(mcpwm_unit_t mcpwm_num, mcpwm_timer_t timer_num)
+{
+    if (!sim_mcpwm_valid(mcpwm_num, timer_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_mcpwm[mcpwm_num][timer_num].running = false;
+    sim_mcpwm_changed(mcpwm_num, timer_num);
+    return ESP_OK;
+}
+
+float sim_mcpwm_get_output(mcpwm_unit_t unit, mcpwm_timer_t timer, mcpwm_generator_t gen)
+{
+    if (!sim_mcpwm_valid(unit, timer) || gen < 0 || gen >= MCPWM_GEN_MAX) {
+        return 0;
+    }
+    const sim_mcpwm_timer_t *t = &s_mcpwm[unit][timer];
+    const sim_mcpwm_gen_t *g = &t->gens[gen];
+    switch (g->type) {
+    case MCPWM_DUTY_MODE_FORCE_LOW:
+        return 0;
+    case MCPWM_DUTY_MODE_FORCE_HIGH:
+        return 1;
+    case MCPWM_DUTY_MODE_1:
+        // Active low, a stopped timer leaves the output at its idle level
+        return t->running ? 1 - g->duty / 100 : 1;
+    default:
+        return t->running ? g->duty / 100 : 0;
+    }
+}
+
+int sim_mcpwm_get_gpio(mcpwm_unit_t unit, mcpwm_io_signals_t io_signal)
+{
+    if (unit < 0 || unit >= MCPWM_UNIT_MAX || io_signal < MCPWM0A || io_signal > MCPWM2B) {
+        return -1;
+    }
+    return s_mcpwm_gpio[unit][io_signal];
+}
+
+void sim_mcpwm_set_listener(sim_mcpwm_listener_t listener, void *arg)
+{
+    s_mcpwm_listener_arg = arg;
+    s_mcpwm_listener = listener;
+}
+
+static bool sim_ledc_valid_channel(ledc_mode_t mode, ledc_channel_t channel)
+{
+    return mode >= 0 && mode < LEDC_SPEED_MODE_MAX && channel >= 0 && channel < LEDC_CHANNEL_MAX;
+}
+
+static bool sim_ledc_valid_timer(ledc_mode_t mode, ledc_timer_t timer)
+{
+    return mode >= 0 && mode < LEDC_SPEED_MODE_MAX && timer >= 0 && timer < LEDC_TIMER_MAX;
+}
+
+esp_err_t ledc_timer_config(const ledc_timer_config_t *timer_conf)
+{
+    if (timer_conf == NULL || !sim_ledc_valid_timer(timer_conf->speed_mode, timer_conf->timer_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sim_ledc_timer_t *timer = &s_ledc_timers[timer_conf->speed_mode][timer_conf->timer_num];
+    if (timer_conf->deconfigure) {
+        timer->configured = false;
+        return ESP_OK;
+    }
+    if (timer_conf->duty_resolution < LEDC_TIMER_1_BIT || timer_conf->duty_resolution >= LEDC_TIMER_BIT_MAX || timer_conf->freq_hz == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *timer = (sim_ledc_timer_t) {
+        .configured = true, .freq_hz = timer_conf->freq_hz, .resolution = timer_conf->duty_resolution,
+    };
+    return ESP_OK;
+}
+
+esp_err_t ledc_channel_config(const ledc_channel_config_t *ledc_conf)
+{
+    if (ledc_conf == NULL || !sim_ledc_valid_channel(ledc_conf->speed_mode, ledc_conf->channel) ||
+            !sim_ledc_valid_timer(ledc_conf->speed_mode, ledc_conf->timer_sel)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_ledc_channels[ledc_conf->speed_mode][ledc_conf->channel] = (sim_ledc_channel_t) {
+        .configured = true, .timer = ledc_conf->timer_sel, .gpio_num = ledc_conf->gpio_num,
+        .duty = ledc_conf->duty, .active_duty = ledc_conf->duty,
+    };
+    return ESP_OK;
+}
+
+esp_err_t ledc_set_freq(ledc_mode_t speed_mode, ledc_timer_t timer_num, uint32_t freq_hz)
+{
+    if (!sim_ledc_valid_timer(speed_mode, timer_num) || freq_hz == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sim_ledc_timer_t *timer = &s_ledc_timers[speed_mode][timer_num];
+    if (!timer->configured) {
+        ESP_LOGE(TAG, "timer %d is not configured", timer_num);
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->freq_hz = freq_hz;
+    return ESP_OK;
+}
+
+uint32_t ledc_get_freq(ledc_mode_t speed_mode, ledc_timer_t timer_num)
+{
+    return sim_ledc_valid_timer(speed_mode, timer_num) ? s_ledc_timers[speed_mode][timer_num].freq_hz : 0;
+}
+
+esp_err_t ledc_set_duty(ledc_mode_t speed_mode, ledc_channel_t channel, uint32_t duty)
+{
+    if (!sim_ledc_valid_channel(speed_mode, channel)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_ledc_channels[speed_mode][channel].duty = duty;
+    return ESP_OK;
+}
+
+uint32_t ledc_get_duty(ledc_mode_t speed_mode, ledc_channel_t channel)
+{
+    return sim_ledc_valid_channel(speed_mode, channel) ? s_ledc_channels[speed_mode][channel].active_duty : 0;
+}
+
+esp_err_t ledc_update_duty(ledc_mode_t speed_mode, ledc_channel_t channel)
+{
+    if (!sim_ledc_valid_channel(speed_mode, channel)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sim_ledc_channel_t *ch = &s_ledc_channels[speed_mode][channel];
+    if (!ch->configured) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    ch->active_duty = ch->duty;
+    ch->stopped = false;
+    return ESP_OK;
+}
+
+esp_err_t ledc_stop(ledc_mode_t speed_mode, ledc_channel_t channel, uint32_t idle_level)
+{
+    (void)idle_level;
+    if (!sim_ledc_valid_channel(speed_mode, channel)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_ledc_channels[speed_mode][channel].stopped = true;
+    return ESP_OK;
+}
+
+bool sim_ledc_get_output(ledc_mode_t mode, ledc_channel_t channel, uint32_t *freq_hz, float *duty)
+{
+    if (!sim_ledc_valid_channel(mode, channel)) {
+        return false;
+    }
+    const sim_ledc_channel_t *ch = &s_ledc_channels[mode][channel];
+    const sim_ledc_timer_t *timer = &s_ledc_timers[mode][ch->timer];
+    if (!ch->configured || !timer->configured || ch->stopped) {
+        return false;
+    }
+    if (freq_hz) {
+        *freq_hz = timer->freq_hz;
+    }
+    if (duty) {
+        *duty = (float)ch->active_duty / (1u << timer->resolution);
+    }
+    return true;
+}
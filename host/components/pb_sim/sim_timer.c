@@ -0,0 +1,224 @@
+#include <stdlib.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "sim_timer";
+
+#define SIM_TIMER_TASK_STACK    4096
+#define SIM_TIMER_TASK_PRIO     (configMAX_PRIORITIES - 2)  // Like the esp_timer task, above the application
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void *arg;
+    const char *name;
+    int64_t alarm_us;
+    uint64_t period_us;         // 0 for one shot timers
+    bool armed;
+    struct esp_timer *next;     // Armed timers, in alarm order
+};
+
+static SemaphoreHandle_t s_lock;
+static TaskHandle_t s_task;
+static struct esp_timer *s_armed;
+
+static int64_t s_boot_ns;
+
+static int64_t sim_timer_monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Time counts from the start of the process, as from the boot on the target
+__attribute__((constructor)) static void sim_timer_boot(void)
+{
+    s_boot_ns = sim_timer_monotonic_ns();
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return (sim_timer_monotonic_ns() - s_boot_ns) / 1000;
+}
+
+static void sim_timer_unlink(struct esp_timer *timer)
+{
+    for (struct esp_timer **it = &s_armed; *it; it = &(*it)->next) {
+        if (*it == timer) {
+            *it = timer->next;
+            break;
+        }
+    }
+    timer->next = NULL;
+    timer->armed = false;
+}
+
+static void sim_timer_insert(struct esp_timer *timer)
+{
+    struct esp_timer **it = &s_armed;
+    while (*it && (*it)->alarm_us <= timer->alarm_us) {
+        it = &(*it)->next;
+    }
+    timer->next = *it;
+    *it = timer;
+    timer->armed = true;
+}
+
+static void sim_timer_task(void *arg)
+{
+    (void)arg;
+    while (true) {
+        TickType_t wait = portMAX_DELAY;
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        struct esp_timer *timer = s_armed;
+        int64_t now_us = esp_timer_get_time();
+        if (timer && timer->alarm_us <= now_us) {
+            sim_timer_unlink(timer);
+            if (timer->period_us) {
+                timer->alarm_us += timer->period_us;
+                if (timer->alarm_us < now_us) {
+                    // Skip the periods missed while the host was busy rather than firing them in a burst
+                    timer->alarm_us = now_us + timer->period_us;
+                }
+                sim_timer_insert(timer);
+            }
+            esp_timer_cb_t callback = timer->callback;
+            void *callback_arg = timer->arg;
+            xSemaphoreGive(s_lock);
+            // The callback may start, stop or delete timers, including its own
+            callback(callback_arg);
+            continue;
+        }
+        if (timer) {
+            TickType_t ticks = pdMS_TO_TICKS((timer->alarm_us - now_us + 999) / 1000);
+            wait = ticks > 0 ? ticks : 1;
+        }
+        xSemaphoreGive(s_lock);
+        ulTaskNotifyTake(pdTRUE, wait);
+    }
+}
+
+static esp_err_t sim_timer_init(void)
+{
+    if (s_task) {
+        return ESP_OK;
+    }
+    s_lock = xSemaphoreCreateMutex();
+    if (s_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreate(sim_timer_task, "esp_timer", SIM_TIMER_TASK_STACK, NULL, SIM_TIMER_TASK_PRIO, &s_task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create the timer task");
+        vSemaphoreDelete(s_lock);
+        s_lock = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle)
+{
+    if (create_args == NULL || create_args->callback == NULL || out_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t ret = sim_timer_init();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    struct esp_timer *timer = calloc(1, sizeof(*timer));
+    if (timer == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    timer->callback = create_args->callback;
+    timer->arg = create_args->arg;
+    timer->name = create_args->name;
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+static esp_err_t sim_timer_arm(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period_us, bool restart)
+{
+    if (timer == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (timer->armed != restart) {
+        xSemaphoreGive(s_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (restart) {
+        sim_timer_unlink(timer);
+    }
+    timer->alarm_us = esp_timer_get_time() + timeout_us;
+    timer->period_us = period_us;
+    sim_timer_insert(timer);
+    xSemaphoreGive(s_lock);
+    xTaskNotifyGive(s_task);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    return sim_timer_arm(timer, timeout_us, 0, false);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
+{
+    if (period == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return sim_timer_arm(timer, period, period, false);
+}
+
+esp_err_t esp_timer_restart(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    if (timer == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Keeps a periodic timer periodic, with the new period
+    return sim_timer_arm(timer, timeout_us, timer->period_us ? timeout_us : 0, true);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (timer == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t ret = timer->armed ? ESP_OK : ESP_ERR_INVALID_STATE;
+    if (timer->armed) {
+        sim_timer_unlink(timer);
+    }
+    xSemaphoreGive(s_lock);
+    return ret;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    if (timer == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool armed = timer->armed;
+    xSemaphoreGive(s_lock);
+    if (armed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    free(timer);
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+    if (timer == NULL) {
+        return false;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool armed = timer->armed;
+    xSemaphoreGive(s_lock);
+    return armed;
+}
@@ -0,0 +1,129 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "esp_log.h"
+#include "esp_tls.h"
+#include "network_transport.h"
+
+static const char *TAG = "sim_transport";
+
+esp_err_t esp_tls_get_conn_sockfd(esp_tls_t *tls, int *sockfd)
+{
+    if (tls == NULL || sockfd == NULL || tls->sockfd < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *sockfd = tls->sockfd;
+    return ESP_OK;
+}
+
+static int sim_transport_connect(const char *hostname, int port)
+{
+    char service[8];
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *addrs = NULL;
+    snprintf(service, sizeof(service), "%d", port);
+    int ret = getaddrinfo(hostname, service, &hints, &addrs);
+    if (ret != 0) {
+        ESP_LOGE(TAG, "Failed to resolve %s: %s", hostname, gai_strerror(ret));
+        return -1;
+    }
+    int sockfd = -1;
+    for (struct addrinfo *addr = addrs; addr && sockfd < 0; addr = addr->ai_next) {
+        sockfd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+        if (sockfd >= 0 && connect(sockfd, addr->ai_addr, addr->ai_addrlen) != 0) {
+            close(sockfd);
+            sockfd = -1;
+        }
+    }
+    freeaddrinfo(addrs);
+    if (sockfd < 0) {
+        ESP_LOGE(TAG, "Failed to connect to %s:%d: %s", hostname, port, strerror(errno));
+        return -1;
+    }
+    // The agent polls the socket, receives must not block the task when no packet is pending
+    fcntl(sockfd, F_SETFL, fcntl(sockfd, F_GETFL) | O_NONBLOCK);
+    return sockfd;
+}
+
+TlsTransportStatus_t xTlsConnect(NetworkContext_t *pxNetworkContext)
+{
+    if (pxNetworkContext == NULL || pxNetworkContext->pcHostname == NULL) {
+        return TLS_TRANSPORT_INVALID_PARAMETER;
+    }
+    if (pxNetworkContext->pxTls == NULL) {
+        pxNetworkContext->pxTls = calloc(1, sizeof(esp_tls_t));
+        if (pxNetworkContext->pxTls == NULL) {
+            return TLS_TRANSPORT_INSUFFICIENT_MEMORY;
+        }
+    }
+    int sockfd = sim_transport_connect(pxNetworkContext->pcHostname, pxNetworkContext->xPort);
+    if (sockfd < 0) {
+        free(pxNetworkContext->pxTls);
+        pxNetworkContext->pxTls = NULL;
+        return TLS_TRANSPORT_CONNECT_FAILURE;
+    }
+    pxNetworkContext->pxTls->sockfd = sockfd;
+    ESP_LOGI(TAG, "Connected to %s:%d without TLS", pxNetworkContext->pcHostname, pxNetworkContext->xPort);
+    return TLS_TRANSPORT_SUCCESS;
+}
+
+TlsTransportStatus_t xTlsDisconnect(NetworkContext_t *pxNetworkContext)
+{
+    if (pxNetworkContext == NULL) {
+        return TLS_TRANSPORT_INVALID_PARAMETER;
+    }
+    if (pxNetworkContext->pxTls != NULL) {
+        if (pxNetworkContext->xTlsContextSemaphore) {
+            xSemaphoreTake(pxNetworkContext->xTlsContextSemaphore, portMAX_DELAY);
+        }
+        close(pxNetworkContext->pxTls->sockfd);
+        free(pxNetworkContext->pxTls);
+        pxNetworkContext->pxTls = NULL;
+        if (pxNetworkContext->xTlsContextSemaphore) {
+            xSemaphoreGive(pxNetworkContext->xTlsContextSemaphore);
+        }
+    }
+    return TLS_TRANSPORT_SUCCESS;
+}
+
+int32_t espTlsTransportSend(NetworkContext_t *pxNetworkContext, const void *pvData, size_t uxDataLen)
+{
+    if (pxNetworkContext == NULL || pxNetworkContext->pxTls == NULL || pvData == NULL) {
+        return -1;
+    }
+    int32_t sent = 0;
+    if (pxNetworkContext->xTlsContextSemaphore) {
+        xSemaphoreTake(pxNetworkContext->xTlsContextSemaphore, portMAX_DELAY);
+    }
+    ssize_t ret = send(pxNetworkContext->pxTls->sockfd, pvData, uxDataLen, MSG_NOSIGNAL);
+    if (ret >= 0) {
+        sent = ret;
+    } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        sent = -1;
+    }
+    if (pxNetworkContext->xTlsContextSemaphore) {
+        xSemaphoreGive(pxNetworkContext->xTlsContextSemaphore);
+    }
+    return sent;
+}
+
+int32_t espTlsTransportRecv(NetworkContext_t *pxNetworkContext, void *pvData, size_t uxDataLen)
+{
+    if (pxNetworkContext == NULL || pxNetworkContext->pxTls == NULL || pvData == NULL) {
+        return -1;
+    }
+    ssize_t ret = recv(pxNetworkContext->pxTls->sockfd, pvData, uxDataLen, MSG_DONTWAIT);
+    if (ret > 0) {
+        return ret;
+    }
+    if (ret == 0) {
+        // Orderly shutdown by the broker
+        return -1;
+    }
+    return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+}
@@ -0,0 +1,141 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "esp_netif.h"
+#include "sim_wifi.h"
+
+static const char *TAG = "sim_wifi";
+
+ESP_EVENT_DEFINE_BASE(WIFI_EVENT);
+ESP_EVENT_DEFINE_BASE(IP_EVENT);
+
+#define SIM_WIFI_IP         0x0200A8C0  // 192.168.0.2, in network order as lwIP keeps it
+#define SIM_WIFI_NETMASK    0x00FFFFFF
+#define SIM_WIFI_GW         0x0100A8C0
+
+static sim_wifi_ap_t s_ap = {
+    .ssid = "pb-sim",
+    .bssid = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 },
+    .channel = 6,
+    .rssi = -55,
+    .connect_ms = 300,
+};
+static char s_ssid[33] = "pb-sim";
+static bool s_associated;
+static bool s_got_ip;
+static esp_timer_handle_t s_dhcp_timer;
+
+static void sim_wifi_got_ip(void *arg)
+{
+    (void)arg;
+    if (!s_associated) {
+        return;
+    }
+    ip_event_got_ip_t event = {
+        .ip_info = {
+            .ip = { .addr = SIM_WIFI_IP },
+            .netmask = { .addr = SIM_WIFI_NETMASK },
+            .gw = { .addr = SIM_WIFI_GW },
+        },
+        .ip_changed = !s_got_ip,
+    };
+    s_got_ip = true;
+    esp_event_post(IP_EVENT, IP_EVENT_STA_GOT_IP, &event, sizeof(event), portMAX_DELAY);
+}
+
+void sim_wifi_set_ap(const sim_wifi_ap_t *ap)
+{
+    s_ap = *ap;
+    snprintf(s_ssid, sizeof(s_ssid), "%s", ap->ssid ? ap->ssid : "");
+    s_ap.ssid = s_ssid;
+}
+
+void sim_wifi_set_rssi(int8_t rssi)
+{
+    s_ap.rssi = rssi;
+}
+
+esp_err_t sim_wifi_connect(void)
+{
+    if (s_dhcp_timer == NULL) {
+        const esp_timer_create_args_t args = { .callback = sim_wifi_got_ip, .name = "sim_dhcp" };
+        esp_err_t ret = esp_timer_create(&args, &s_dhcp_timer);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    if (s_associated) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_associated = true;
+
+    wifi_event_sta_connected_t event = {
+        .ssid_len = strlen(s_ssid),
+        .channel = s_ap.channel,
+        .authmode = WIFI_AUTH_WPA2_PSK,
+        .aid = 1,
+    };
+    memcpy(event.ssid, s_ssid, event.ssid_len);
+    memcpy(event.bssid, s_ap.bssid, sizeof(event.bssid));
+    ESP_LOGI(TAG, "Associated with %s, IP in %" PRIu32 " ms", s_ssid, s_ap.connect_ms);
+    esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, &event, sizeof(event), portMAX_DELAY);
+    return esp_timer_start_once(s_dhcp_timer, (uint64_t)s_ap.connect_ms * 1000);
+}
+
+esp_err_t sim_wifi_disconnect(uint8_t reason)
+{
+    if (!s_associated) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_associated = false;
+    s_got_ip = false;
+    esp_timer_stop(s_dhcp_timer);
+
+    wifi_event_sta_disconnected_t event = {
+        .ssid_len = strlen(s_ssid),
+        .reason = reason,
+        .rssi = s_ap.rssi,
+    };
+    memcpy(event.ssid, s_ssid, event.ssid_len);
+    memcpy(event.bssid, s_ap.bssid, sizeof(event.bssid));
+    ESP_LOGI(TAG, "Disconnected from %s, reason %d", s_ssid, reason);
+    return esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &event, sizeof(event), portMAX_DELAY);
+}
+
+bool sim_wifi_is_connected(void)
+{
+    return s_got_ip;
+}
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *ap_info)
+{
+    if (ap_info == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_associated) {
+        return ESP_ERR_WIFI_NOT_CONNECT;
+    }
+    memset(ap_info, 0, sizeof(*ap_info));
+    memcpy(ap_info->bssid, s_ap.bssid, sizeof(ap_info->bssid));
+    memcpy(ap_info->ssid, s_ssid, strlen(s_ssid));
+    ap_info->primary = s_ap.channel;
+    ap_info->rssi = s_ap.rssi;
+    ap_info->authmode = WIFI_AUTH_WPA2_PSK;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_sta_get_rssi(int *rssi)
+{
+    if (rssi == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_associated) {
+        return ESP_ERR_WIFI_NOT_CONNECT;
+    }
+    *rssi = s_ap.rssi;
+    return ESP_OK;
+}
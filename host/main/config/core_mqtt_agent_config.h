@@ -0,0 +1,6 @@
+/*
+ * coreMQTT-Agent reads its options from the coreMQTT configuration
+ */
+#pragma once
+
+#include "core_mqtt_config.h"
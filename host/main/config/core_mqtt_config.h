@@ -0,0 +1,28 @@
+/*
+ * coreMQTT and coreMQTT-Agent configuration of the host build.
+ * The esp-aws-iot one reads the Kconfig of its component, which is not part of this project.
+ */
+#pragma once
+
+#include "esp_log.h"
+
+/* Logging, one message per macro as the libraries wrap the arguments in parentheses. */
+#define LogError( message )    MQTT_LOG_E message
+#define LogWarn( message )     MQTT_LOG_W message
+#define LogInfo( message )     MQTT_LOG_I message
+#define LogDebug( message )    MQTT_LOG_D message
+
+#define MQTT_LOG_E( ... )      ESP_LOGE( "coreMQTT", __VA_ARGS__ )
+#define MQTT_LOG_W( ... )      ESP_LOGW( "coreMQTT", __VA_ARGS__ )
+#define MQTT_LOG_I( ... )      ESP_LOGI( "coreMQTT", __VA_ARGS__ )
+#define MQTT_LOG_D( ... )      ESP_LOGD( "coreMQTT", __VA_ARGS__ )
+
+/* Same values as the defaults of the esp-aws-iot component on the target. */
+#define MQTT_STATE_ARRAY_MAX_COUNT              10U
+#define MQTT_PINGRESP_TIMEOUT_MS                5000U
+#define MQTT_RECV_POLLING_TIMEOUT_MS            10U
+#define MQTT_SEND_TIMEOUT_MS                    20000U
+
+#define MQTT_AGENT_MAX_OUTSTANDING_ACKS         20U
+#define MQTT_AGENT_MAX_EVENT_QUEUE_WAIT_TIME    1000U
+#define MQTT_COMMAND_CONTEXTS_POOL_SIZE         10U
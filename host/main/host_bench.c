@@ -0,0 +1,552 @@
+/*
+ * Telemetry benchmark of the host build.
+ *
+ * Producer tasks stamp a sample time into each message and enqueue it with
+ * MQTTAgent_Publish() without blocking, at a total rate that increases step by
+ * step. The broker observer computes the sample-to-broker latency, a sampler
+ * reads the depth of the agent command queue, and messages that never reach the
+ * broker are counted as lost. The backend then unlocks and locks the barrier to
+ * measure the command-to-actuation latency.
+ */
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <sdkconfig.h>
+
+#include "core_mqtt_agent.h"
+#include "freertos_agent_message.h"
+#include "core_mqtt_agent_manager_config.h"
+#include "boot_orchestrator.h"
+#include "sim_broker.h"
+#include "sim_plant.h"
+#include "sim_pwm.h"
+#include "host_bench.h"
+
+#define BENCH_TOPIC_PREFIX              "bench/"
+#define BENCH_MAX_STEPS                 16
+#define BENCH_SLOTS_PER_PRODUCER        8       /* Publishes of a producer in flight in the agent */
+#define BENCH_DRAIN_MS                  2000    /* Left to the agent to flush a step */
+#define BENCH_PRODUCER_PRIORITY         ( tskIDLE_PRIORITY + 2 )
+#define BENCH_SAMPLER_PRIORITY          ( tskIDLE_PRIORITY + 3 )
+#define BENCH_ACTUATION_START_TIMEOUT_MS    5000
+#define BENCH_ACTUATION_TRAVEL_TIMEOUT_MS   20000
+
+/* Log-linear histogram: exact below 64 us, then 32 buckets per power of two, about 3 % wide. */
+#define BENCH_HIST_LINEAR               64
+#define BENCH_HIST_SUB_BUCKETS          32
+#define BENCH_HIST_BUCKETS              ( BENCH_HIST_LINEAR + ( 32 - 6 ) * BENCH_HIST_SUB_BUCKETS )
+
+typedef struct
+{
+    uint32_t counts[ BENCH_HIST_BUCKETS ];
+    uint32_t total;
+    uint32_t max_us;
+} bench_histogram_t;
+
+typedef struct bench_producer bench_producer_t;
+
+struct MQTTAgentCommandContext
+{
+    bench_producer_t * producer;
+    bool busy;
+};
+
+typedef struct
+{
+    MQTTAgentCommandContext_t context;
+    MQTTPublishInfo_t publish_info;
+    char payload[ CONFIG_PB_HOST_BENCH_PAYLOAD_SIZE ];
+} bench_slot_t;
+
+struct bench_producer
+{
+    uint32_t id;
+    char topic[ 64 ];
+    TaskHandle_t task;
+    uint32_t seq;
+    uint32_t sent;
+    uint32_t backpressure;      /* All the slots were in flight */
+    uint32_t enqueue_failed;    /* MQTTAgent_Publish() refused the command */
+    uint32_t completion_failed; /* Written by the agent task */
+    bench_slot_t slots[ BENCH_SLOTS_PER_PRODUCER ];
+};
+
+typedef struct
+{
+    uint32_t rate_hz;
+    uint32_t sent;
+    uint32_t backpressure;
+    uint32_t enqueue_failed;
+    uint32_t completion_failed;
+    uint32_t received;
+    uint32_t p50_us;
+    uint32_t p99_us;
+    uint32_t p999_us;
+    uint32_t max_us;
+    uint32_t queue_depth_max;
+    float queue_depth_avg;
+} bench_step_result_t;
+
+static const char * TAG = "host_bench";
+extern MQTTAgentContext_t xGlobalMqttAgentContext;
+
+static bench_producer_t producers[ CONFIG_PB_HOST_BENCH_PRODUCERS ];
+static TaskHandle_t bench_task;
+
+/* Parameters of the running step, read by the producers */
+static uint32_t step_rate_hz;
+static int64_t step_start_us;
+static int64_t step_end_us;
+
+/* Written by the broker thread */
+static uint32_t current_step;
+static uint32_t step_received;
+static bench_histogram_t latency;
+
+static bench_histogram_t actuation;
+
+static uint32_t histogram_index( uint32_t value_us )
+{
+    if( value_us < BENCH_HIST_LINEAR )
+    {
+        return value_us;
+    }
+
+    uint32_t exponent = 31 - __builtin_clz( value_us );
+
+    return BENCH_HIST_LINEAR + ( exponent - 6 ) * BENCH_HIST_SUB_BUCKETS +
+           ( ( value_us >> ( exponent - 5 ) ) - BENCH_HIST_SUB_BUCKETS );
+}
+
+/* Largest value falling in the bucket */
+static uint32_t histogram_value( uint32_t index )
+{
+    if( index < BENCH_HIST_LINEAR )
+    {
+        return index;
+    }
+
+    uint32_t exponent = ( index - BENCH_HIST_LINEAR ) / BENCH_HIST_SUB_BUCKETS + 6;
+    uint64_t mantissa = ( index - BENCH_HIST_LINEAR ) % BENCH_HIST_SUB_BUCKETS + BENCH_HIST_SUB_BUCKETS;
+
+    return ( uint32_t ) ( ( ( mantissa + 1 ) << ( exponent - 5 ) ) - 1 );
+}
+
+static void histogram_add( bench_histogram_t * histogram,
+                           uint32_t value_us )
+{
+    uint32_t max_us = __atomic_load_n( &histogram->max_us, __ATOMIC_RELAXED );
+
+    __atomic_fetch_add( &histogram->counts[ histogram_index( value_us ) ], 1, __ATOMIC_RELAXED );
+    __atomic_fetch_add( &histogram->total, 1, __ATOMIC_RELAXED );
+
+    while( ( value_us > max_us ) &&
+           !__atomic_compare_exchange_n( &histogram->max_us, &max_us, value_us, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+    {
+    }
+}
+
+static uint32_t histogram_percentile( const bench_histogram_t * histogram,
+                                      double fraction )
+{
+    uint64_t rank = ( uint64_t ) ( fraction * histogram->total + 0.999999 );
+    uint64_t seen = 0;
+
+    if( histogram->total == 0 )
+    {
+        return 0;
+    }
+
+    for( uint32_t i = 0; i < BENCH_HIST_BUCKETS; i++ )
+    {
+        seen += histogram->counts[ i ];
+
+        if( seen >= rank )
+        {
+            uint32_t value_us = histogram_value( i );
+            return ( value_us < histogram->max_us ) ? value_us : histogram->max_us;
+        }
+    }
+
+    return histogram->max_us;
+}
+
+bool host_bench_observe( const sim_broker_message_t * message )
+{
+    char header[ 64 ];
+    unsigned step, producer, seq;
+    int64_t sample_us;
+
+    if( ( message->topic_len < strlen( BENCH_TOPIC_PREFIX ) ) ||
+        ( memcmp( message->topic, BENCH_TOPIC_PREFIX, strlen( BENCH_TOPIC_PREFIX ) ) != 0 ) )
+    {
+        return false;
+    }
+
+    size_t len = ( message->payload_len < sizeof( header ) - 1 ) ? message->payload_len : sizeof( header ) - 1;
+    memcpy( header, message->payload, len );
+    header[ len ] = '\0';
+
+    if( ( sscanf( header, "{\"s\":%u,\"p\":%u,\"seq\":%u,\"t\":%" SCNd64, &step, &producer, &seq, &sample_us ) == 4 ) &&
+        ( step == __atomic_load_n( &current_step, __ATOMIC_ACQUIRE ) ) &&
+        ( message->received_us >= sample_us ) )
+    {
+        histogram_add( &latency, ( uint32_t ) ( message->received_us - sample_us ) );
+        __atomic_fetch_add( &step_received, 1, __ATOMIC_RELAXED );
+    }
+
+    return true;
+}
+
+static void publish_complete_callback( MQTTAgentCommandContext_t * context,
+                                       MQTTAgentReturnInfo_t * return_info )
+{
+    if( return_info->returnCode != MQTTSuccess )
+    {
+        __atomic_fetch_add( &context->producer->completion_failed, 1, __ATOMIC_RELAXED );
+    }
+
+    __atomic_store_n( &context->busy, false, __ATOMIC_RELEASE );
+}
+
+static bench_slot_t * producer_get_slot( bench_producer_t * producer )
+{
+    for( int i = 0; i < BENCH_SLOTS_PER_PRODUCER; i++ )
+    {
+        if( !__atomic_load_n( &producer->slots[ i ].context.busy, __ATOMIC_ACQUIRE ) )
+        {
+            return &producer->slots[ i ];
+        }
+    }
+
+    return NULL;
+}
+
+static void producer_publish( bench_producer_t * producer,
+                              uint32_t step )
+{
+    bench_slot_t * slot = producer_get_slot( producer );
+
+    if( slot == NULL )
+    {
+        producer->backpressure++;
+        return;
+    }
+
+    /* The sample is taken now, formatting and queueing are part of the latency. */
+    int64_t sample_us = esp_timer_get_time();
+    int len = snprintf( slot->payload, sizeof( slot->payload ), "{\"s\":%" PRIu32 ",\"p\":%" PRIu32 ",\"seq\":%" PRIu32 ",\"t\":%" PRId64 ",\"pad\":\"",
+                        step, producer->id, producer->seq++, sample_us );
+
+    /* Padded to the configured size, as a telemetry document of that size */
+    if( len > ( int ) sizeof( slot->payload ) - 2 )
+    {
+        len = sizeof( slot->payload ) - 2;
+    }
+
+    memset( slot->payload + len, 'x', sizeof( slot->payload ) - 2 - len );
+    memcpy( slot->payload + sizeof( slot->payload ) - 2, "\"}", 2 );
+
+    slot->publish_info = ( MQTTPublishInfo_t ) {
+        .qos             = ( MQTTQoS_t ) CONFIG_PB_HOST_BENCH_QOS,
+        .pTopicName      = producer->topic,
+        .topicNameLength = ( uint16_t ) strlen( producer->topic ),
+        .pPayload        = slot->payload,
+        .payloadLength   = sizeof( slot->payload ),
+    };
+    slot->context.producer = producer;
+    __atomic_store_n( &slot->context.busy, true, __ATOMIC_RELAXED );
+
+    MQTTAgentCommandInfo_t command_info =
+    {
+        .cmdCompleteCallback         = publish_complete_callback,
+        .pCmdCompleteCallbackContext = &slot->context,
+        .blockTimeMs                 = 0, /* A full queue is a drop, not a stall */
+    };
+
+    if( MQTTAgent_Publish( &xGlobalMqttAgentContext, &slot->publish_info, &command_info ) != MQTTSuccess )
+    {
+        __atomic_store_n( &slot->context.busy, false, __ATOMIC_RELAXED );
+        producer->enqueue_failed++;
+        return;
+    }
+
+    producer->sent++;
+}
+
+static void producer_task( void * arg )
+{
+    bench_producer_t * producer = arg;
+
+    for( ; ; )
+    {
+        ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+
+        uint32_t step = __atomic_load_n( &current_step, __ATOMIC_ACQUIRE );
+        uint64_t published = 0;
+        TickType_t wake = xTaskGetTickCount();
+        int64_t now_us;
+
+        /* Catches up every tick, so the rate isn't bounded by the tick rate */
+        while( ( now_us = esp_timer_get_time() ) < step_end_us )
+        {
+            uint64_t due = ( uint64_t ) ( now_us - step_start_us ) * step_rate_hz /
+                           ( 1000000ULL * CONFIG_PB_HOST_BENCH_PRODUCERS );
+
+            for( ; published < due; published++ )
+            {
+                producer_publish( producer, step );
+            }
+
+            vTaskDelayUntil( &wake, 1 );
+        }
+
+        xTaskNotifyGive( bench_task );
+    }
+}
+
+static void bench_run_step( uint32_t step,
+                            uint32_t rate_hz,
+                            bench_step_result_t * result )
+{
+    QueueHandle_t queue = xGlobalMqttAgentContext.agentInterface.pMsgCtx->queue;
+    uint64_t depth_sum = 0;
+    uint32_t depth_samples = 0;
+
+    memset( &latency, 0, sizeof( latency ) );
+    __atomic_store_n( &step_received, 0, __ATOMIC_RELAXED );
+
+    for( int i = 0; i < CONFIG_PB_HOST_BENCH_PRODUCERS; i++ )
+    {
+        producers[ i ].sent = 0;
+        producers[ i ].backpressure = 0;
+        producers[ i ].enqueue_failed = 0;
+        __atomic_store_n( &producers[ i ].completion_failed, 0, __ATOMIC_RELAXED );
+    }
+
+    step_rate_hz = rate_hz;
+    step_start_us = esp_timer_get_time();
+    step_end_us = step_start_us + ( int64_t ) CONFIG_PB_HOST_BENCH_STEP_S * 1000000;
+    __atomic_store_n( &current_step, step, __ATOMIC_RELEASE );
+
+    for( int i = 0; i < CONFIG_PB_HOST_BENCH_PRODUCERS; i++ )
+    {
+        xTaskNotifyGive( producers[ i ].task );
+    }
+
+    result->queue_depth_max = 0;
+
+    while( esp_timer_get_time() < step_end_us )
+    {
+        uint32_t depth = uxQueueMessagesWaiting( queue );
+
+        depth_sum += depth;
+        depth_samples++;
+        result->queue_depth_max = ( depth > result->queue_depth_max ) ? depth : result->queue_depth_max;
+        vTaskDelay( 1 );
+    }
+
+    for( int i = 0; i < CONFIG_PB_HOST_BENCH_PRODUCERS; i++ )
+    {
+        ulTaskNotifyTake( pdFALSE, portMAX_DELAY );
+    }
+
+    vTaskDelay( pdMS_TO_TICKS( BENCH_DRAIN_MS ) );
+
+    result->rate_hz = rate_hz;
+    result->sent = 0;
+    result->backpressure = 0;
+    result->enqueue_failed = 0;
+    result->completion_failed = 0;
+
+    for( int i = 0; i < CONFIG_PB_HOST_BENCH_PRODUCERS; i++ )
+    {
+        result->sent += producers[ i ].sent;
+        result->backpressure += producers[ i ].backpressure;
+        result->enqueue_failed += producers[ i ].enqueue_failed;
+        result->completion_failed += __atomic_load_n( &producers[ i ].completion_failed, __ATOMIC_RELAXED );
+    }
+
+    result->received = __atomic_load_n( &step_received, __ATOMIC_ACQUIRE );
+    result->p50_us = histogram_percentile( &latency, 0.5 );
+    result->p99_us = histogram_percentile( &latency, 0.99 );
+    result->p999_us = histogram_percentile( &latency, 0.999 );
+    result->max_us = latency.max_us;
+    result->queue_depth_avg = depth_samples ? ( float ) depth_sum / depth_samples : 0.0f;
+
+    ESP_LOGI( TAG, "%5" PRIu32 " msg/s: sent %" PRIu32 ", received %" PRIu32 ", dropped %" PRIu32 ", p50 %" PRIu32 " us, p99 %" PRIu32 " us, queue max %" PRIu32,
+              rate_hz, result->sent, result->received, result->backpressure + result->enqueue_failed + result->completion_failed,
+              result->p50_us, result->p99_us, result->queue_depth_max );
+}
+
+/* Time from the backend command to the motor driven, polled every tick */
+static bool bench_actuate( const char * command,
+                           mcpwm_generator_t generator )
+{
+    char topic[ 160 ];
+    char payload[ 48 ];
+
+    snprintf( topic, sizeof( topic ), "cmd/pb/%s/%s/%s/%s/barrier/%s",
+              CONFIG_PB_CITY, CONFIG_PB_AREA, CONFIG_PB_ZONE, CONFIG_GRI_THING_NAME, command );
+    snprintf( payload, sizeof( payload ), "{\"command\":\"%s\"}", command );
+
+    int64_t start_us = esp_timer_get_time();
+
+    if( sim_broker_publish( topic, payload, strlen( payload ), 1 ) != ESP_OK )
+    {
+        return false;
+    }
+
+    while( sim_mcpwm_get_output( MCPWM_UNIT_0, MCPWM_TIMER_0, generator ) < 0.5f )
+    {
+        if( esp_timer_get_time() - start_us > BENCH_ACTUATION_START_TIMEOUT_MS * 1000LL )
+        {
+            ESP_LOGW( TAG, "Barrier didn't %s", command );
+            return false;
+        }
+
+        vTaskDelay( 1 );
+    }
+
+    histogram_add( &actuation, ( uint32_t ) ( esp_timer_get_time() - start_us ) );
+
+    /* The driver stops the motor at the end stop, the next command waits for it */
+    while( sim_mcpwm_get_output( MCPWM_UNIT_0, MCPWM_TIMER_0, generator ) >= 0.5f )
+    {
+        if( esp_timer_get_time() - start_us > BENCH_ACTUATION_TRAVEL_TIMEOUT_MS * 1000LL )
+        {
+            ESP_LOGW( TAG, "Barrier motor still running" );
+            return false;
+        }
+
+        vTaskDelay( pdMS_TO_TICKS( 10 ) );
+    }
+
+    return true;
+}
+
+static bool bench_write_results( const bench_step_result_t * results,
+                                 int steps,
+                                 uint32_t actuation_timeouts )
+{
+    FILE * file = fopen( CONFIG_PB_HOST_BENCH_RESULTS, "w" );
+
+    if( file == NULL )
+    {
+        ESP_LOGE( TAG, "Failed to create %s", CONFIG_PB_HOST_BENCH_RESULTS );
+        return false;
+    }
+
+    fprintf( file, "{\n  \"benchmark\": \"pb_host_telemetry\",\n  \"version\": 1,\n" );
+    fprintf( file, "  \"config\": {\"producers\": %d, \"payload_bytes\": %d, \"qos\": %d, \"step_s\": %d, "
+                   "\"agent_queue_length\": %d, \"command_pool_size\": %d, \"max_outstanding_acks\": %d, \"tick_hz\": %d},\n",
+             CONFIG_PB_HOST_BENCH_PRODUCERS, CONFIG_PB_HOST_BENCH_PAYLOAD_SIZE, CONFIG_PB_HOST_BENCH_QOS, CONFIG_PB_HOST_BENCH_STEP_S,
+             configMQTT_AGENT_COMMAND_QUEUE_LENGTH, ( int ) MQTT_COMMAND_CONTEXTS_POOL_SIZE, ( int ) MQTT_AGENT_MAX_OUTSTANDING_ACKS,
+             configTICK_RATE_HZ );
+    fprintf( file, "  \"steps\": [\n" );
+
+    for( int i = 0; i < steps; i++ )
+    {
+        const bench_step_result_t * r = &results[ i ];
+        uint32_t lost = ( r->sent > r->received + r->completion_failed ) ? r->sent - r->received - r->completion_failed : 0;
+
+        fprintf( file, "    {\"rate_hz\": %" PRIu32 ", \"sent\": %" PRIu32 ", \"received\": %" PRIu32 ", "
+                       "\"throughput_hz\": %.1f, \"backpressure\": %" PRIu32 ", \"enqueue_failed\": %" PRIu32 ", "
+                       "\"completion_failed\": %" PRIu32 ", \"lost\": %" PRIu32 ", "
+                       "\"p50_us\": %" PRIu32 ", \"p99_us\": %" PRIu32 ", \"p999_us\": %" PRIu32 ", \"max_us\": %" PRIu32 ", "
+                       "\"queue_depth_max\": %" PRIu32 ", \"queue_depth_avg\": %.2f}%s\n",
+                 r->rate_hz, r->sent, r->received, ( double ) r->received / CONFIG_PB_HOST_BENCH_STEP_S,
+                 r->backpressure, r->enqueue_failed, r->completion_failed, lost,
+                 r->p50_us, r->p99_us, r->p999_us, r->max_us,
+                 r->queue_depth_max, ( double ) r->queue_depth_avg, ( i + 1 < steps ) ? "," : "" );
+    }
+
+    fprintf( file, "  ],\n" );
+    fprintf( file, "  \"actuation\": {\"samples\": %" PRIu32 ", \"timeouts\": %" PRIu32 ", \"resolution_us\": %d, "
+                   "\"p50_us\": %" PRIu32 ", \"p99_us\": %" PRIu32 ", \"max_us\": %" PRIu32 "}\n}\n",
+             actuation.total, actuation_timeouts, 1000000 / configTICK_RATE_HZ,
+             histogram_percentile( &actuation, 0.5 ), histogram_percentile( &actuation, 0.99 ), actuation.max_us );
+
+    return fclose( file ) == 0;
+}
+
+static void bench_task_main( void * arg )
+{
+    static bench_step_result_t results[ BENCH_MAX_STEPS ];
+    uint32_t rates[ BENCH_MAX_STEPS ];
+    uint32_t actuation_timeouts = 0;
+    uint32_t received = 0;
+    int steps = 0;
+
+    ( void ) arg;
+
+    for( const char * p = CONFIG_PB_HOST_BENCH_RATES; *p != '\0' && steps < BENCH_MAX_STEPS; )
+    {
+        char * end;
+        unsigned long rate = strtoul( p, &end, 10 );
+
+        if( end == p )
+        {
+            p++;
+            continue;
+        }
+
+        if( rate > 0 )
+        {
+            rates[ steps++ ] = ( uint32_t ) rate;
+        }
+
+        p = end;
+    }
+
+    boot_wait( BOOT_READY( BOOT_STAGE_MQTT ) | BOOT_READY( BOOT_STAGE_TASKS ), portMAX_DELAY );
+
+    /* Lets the application tasks subscribe before the load starts */
+    vTaskDelay( pdMS_TO_TICKS( 2000 ) );
+
+    for( int i = 0; i < steps; i++ )
+    {
+        bench_run_step( i + 1, rates[ i ], &results[ i ] );
+        received += results[ i ].received;
+    }
+
+    for( int i = 0; i < CONFIG_PB_HOST_BENCH_ACTUATIONS; i++ )
+    {
+        actuation_timeouts += bench_actuate( "unlock", MCPWM_GEN_A ) ? 0 : 1;
+        actuation_timeouts += bench_actuate( "lock", MCPWM_GEN_B ) ? 0 : 1;
+    }
+
+    bool written = bench_write_results( results, steps, actuation_timeouts );
+
+    ESP_LOGI( TAG, "Actuation p50 %" PRIu32 " us, max %" PRIu32 " us, results in %s",
+              histogram_percentile( &actuation, 0.5 ), actuation.max_us, CONFIG_PB_HOST_BENCH_RESULTS );
+    fflush( stdout );
+    sim_broker_stop();
+    exit( ( written && ( received > 0 ) ) ? EXIT_SUCCESS : EXIT_FAILURE );
+}
+
+void host_bench_start( void )
+{
+    for( int i = 0; i < CONFIG_PB_HOST_BENCH_PRODUCERS; i++ )
+    {
+        char name[ configMAX_TASK_NAME_LEN ];
+
+        producers[ i ].id = i;
+        snprintf( producers[ i ].topic, sizeof( producers[ i ].topic ), BENCH_TOPIC_PREFIX "%s/%d", CONFIG_GRI_THING_NAME, i );
+        snprintf( name, sizeof( name ), "BenchProd%d", i );
+        BaseType_t ret = xTaskCreate( producer_task, name, 4096, &producers[ i ], BENCH_PRODUCER_PRIORITY, &producers[ i ].task );
+        configASSERT( ret == pdPASS );
+    }
+
+    BaseType_t ret = xTaskCreate( bench_task_main, "HostBench", 4096, NULL, BENCH_SAMPLER_PRIORITY, &bench_task );
+    configASSERT( ret == pdPASS );
+}
@@ -0,0 +1,33 @@
+/*
+ * Telemetry benchmark of the host build: producer tasks publish through the
+ * coreMQTT-Agent at increasing rates to the simulated broker, then the backend
+ * drives the barrier. The results are written as JSON.
+ */
+#pragma once
+
+#include <stdbool.h>
+
+#include "sim_broker.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Start the benchmark task. It waits for the MQTT connection, runs the
+ * steps and exits the process with the results.
+ */
+void host_bench_start( void );
+
+/**
+ * @brief Account a message received by the broker, from the broker observer
+ *
+ * Doesn't call FreeRTOS, as required on the broker thread.
+ *
+ * @return true if the message was published by the benchmark
+ */
+bool host_bench_observe( const sim_broker_message_t * message );
+
+#ifdef __cplusplus
+}
+#endif
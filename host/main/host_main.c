@@ -0,0 +1,292 @@
+/*
+ * Entry point of the host build: the boot sequence of main.c, with the peripherals,
+ * the access point and the broker simulated by pb_sim.
+ */
+
+/* Standard includes. */
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+
+/* ESP-IDF includes. */
+#include <esp_err.h>
+#include <esp_event.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <nvs_flash.h>
+#include <sdkconfig.h>
+
+/* Simulated peripherals and services. */
+#include "sim_broker.h"
+#include "sim_ina3221.h"
+#include "sim_plant.h"
+#include "sim_wifi.h"
+#include "host_bench.h"
+
+/* Network transport include. */
+#include "network_transport.h"
+
+/* coreMQTT-Agent network manager include. */
+#include "core_mqtt_agent_manager.h"
+
+/* WiFi connection handler include. */
+#include "app_wifi.h"
+
+/* Boot orchestration include. */
+#include "boot_orchestrator.h"
+
+/* Application includes. */
+#include "led_control.h"
+#include "barrier_control.h"
+#include "buzzer_control.h"
+#include "buzzer_driver.h"
+#include "ina3221_sensor.h"
+#include "power_perception.h"
+#include "obstacle_perception.h"
+#include "sensor_sampler.h"
+#include "wifi_perception.h"
+#include "app_driver.h"
+
+/* Wiring of the board, as in the drivers. */
+#define HOST_INA3221_PORT           I2C_NUM_1
+#define HOST_INA3221_ADDR           0x40
+#define HOST_HCSR04_TRIGGER_GPIO    GPIO_NUM_5
+#define HOST_HCSR04_DRIVER_ECHO     GPIO_NUM_18     /* app_driver.c */
+#define HOST_HCSR04_OBSTACLE_ECHO   GPIO_NUM_17     /* obstacle_perception.c */
+#define HOST_FC33_GPIO              GPIO_NUM_15
+#define HOST_BARRIER_TRAVEL_MS      3000
+
+#define HOST_SCENARIO_PERIOD_MS     1000
+
+static const char * TAG = "host_main";
+
+static NetworkContext_t xNetworkContext;
+
+/**
+ * @brief Prints every message the application publishes. Runs on the broker
+ * thread, so it doesn't use the log of ESP-IDF.
+ */
+static void prvBrokerObserver( const sim_broker_message_t * pxMessage,
+                               void * pvArg )
+{
+    ( void ) pvArg;
+
+    #if CONFIG_PB_HOST_BENCH
+        if( host_bench_observe( pxMessage ) )
+        {
+            return;
+        }
+    #endif /* CONFIG_PB_HOST_BENCH */
+
+    printf( "[broker] %.*s (QoS %d, %zu bytes): %.*s\n",
+            ( int ) pxMessage->topic_len, pxMessage->topic, pxMessage->qos, pxMessage->payload_len,
+            ( int ) ( pxMessage->payload_len < 200 ? pxMessage->payload_len : 200 ), ( const char * ) pxMessage->payload );
+}
+
+static void prvAttachPeripherals( void )
+{
+    ESP_ERROR_CHECK( sim_ina3221_attach( HOST_INA3221_PORT, HOST_INA3221_ADDR ) );
+    ESP_ERROR_CHECK( sim_ina3221_set_channel( 1, 12.1f, 4.0f ) );
+    ESP_ERROR_CHECK( sim_ina3221_set_channel( 2, 5.02f, 1.5f ) );
+    ESP_ERROR_CHECK( sim_ina3221_set_channel( 3, 3.31f, 0.8f ) );
+
+    ESP_ERROR_CHECK( sim_hcsr04_attach( HOST_HCSR04_TRIGGER_GPIO, HOST_HCSR04_DRIVER_ECHO, 250 ) );
+    ESP_ERROR_CHECK( sim_hcsr04_attach( HOST_HCSR04_TRIGGER_GPIO, HOST_HCSR04_OBSTACLE_ECHO, 250 ) );
+
+    const sim_barrier_config_t xBarrier =
+    {
+        .unit          = MCPWM_UNIT_0,
+        .timer         = MCPWM_TIMER_0,
+        .end_stop_gpio = HOST_FC33_GPIO,
+        .locked_gpio   = CONFIG_PB_LOCKED_LIMIT_SWITCH_GPIO,
+        .unlocked_gpio = CONFIG_PB_UNLOCKED_LIMIT_SWITCH_GPIO,
+        .travel_ms     = HOST_BARRIER_TRAVEL_MS,
+    };
+    ESP_ERROR_CHECK( sim_barrier_attach( &xBarrier ) );
+}
+
+static BaseType_t prvInitializeNetworkContext( void )
+{
+    /* No credentials, the transport of pb_sim talks plain TCP to the broker. */
+    xNetworkContext.pcHostname = CONFIG_GRI_MQTT_ENDPOINT;
+    xNetworkContext.xPort = CONFIG_GRI_MQTT_PORT;
+    xNetworkContext.pxTls = NULL;
+    xNetworkContext.xTlsContextSemaphore = xSemaphoreCreateMutex();
+
+    if( xNetworkContext.xTlsContextSemaphore == NULL )
+    {
+        ESP_LOGE( TAG, "Not enough memory to create TLS semaphore for global "
+                       "network context." );
+        return pdFAIL;
+    }
+
+    return pdPASS;
+}
+
+static void prvInitializeDrivers( void )
+{
+    /* Barrier (MCPWM), LED (RMT) and ultrasonic sensor. */
+    app_driver_init();
+    buzzer_driver_init();
+
+    if( ina3221_init() != ESP_OK )
+    {
+        ESP_LOGE( TAG, "Failed to initialize the INA3221." );
+    }
+}
+
+static void prvPublishBarrierCommand( const char * pcCommand )
+{
+    char cTopic[ 160 ];
+    char cPayload[ 48 ];
+
+    snprintf( cTopic, sizeof( cTopic ), "cmd/pb/%s/%s/%s/%s/barrier/%s",
+              CONFIG_PB_CITY, CONFIG_PB_AREA, CONFIG_PB_ZONE, CONFIG_GRI_THING_NAME, pcCommand );
+    snprintf( cPayload, sizeof( cPayload ), "{\"command\":\"%s\"}", pcCommand );
+    ESP_LOGI( TAG, "Backend: %s", cTopic );
+    sim_broker_publish( cTopic, cPayload, strlen( cPayload ), 1 );
+}
+
+#if CONFIG_PB_HOST_SCENARIO
+
+/**
+ * @brief Plays the part of the car park: a vehicle comes close to the sensors,
+ * the backend unlocks the barrier, the vehicle leaves and the barrier is locked again.
+ */
+    static void prvScenarioTask( void * pvParameters )
+    {
+        uint32_t ulStep = 0;
+
+        ( void ) pvParameters;
+
+        boot_wait( BOOT_READY( BOOT_STAGE_MQTT ) | BOOT_READY( BOOT_STAGE_TASKS ), portMAX_DELAY );
+
+        for( ; ; )
+        {
+            uint32_t ulPhase = ulStep % 30;
+            int lDistanceCm = ( ulPhase < 10 ) ? ( int ) ( 250 - ulPhase * 22 ) : ( ( ulPhase < 20 ) ? 30 : 250 );
+
+            sim_hcsr04_set_distance( HOST_HCSR04_DRIVER_ECHO, lDistanceCm );
+            sim_hcsr04_set_distance( HOST_HCSR04_OBSTACLE_ECHO, lDistanceCm );
+
+            /* The barrier motor loads the 12 V rail while it runs. */
+            sim_ina3221_set_channel( 1, 12.1f - ( float ) ( ulStep % 7 ) * 0.02f,
+                                     ( ulPhase == 10 || ulPhase == 20 ) ? 40.0f : 4.0f + ( float ) ( ulStep % 5 ) * 0.1f );
+
+            if( ulPhase == 10 )
+            {
+                prvPublishBarrierCommand( "unlock" );
+            }
+            else if( ulPhase == 20 )
+            {
+                prvPublishBarrierCommand( "lock" );
+            }
+
+            #if CONFIG_PB_HOST_WIFI_OUTAGE_S > 0
+                if( ( ulStep > 0 ) && ( ( ulStep % CONFIG_PB_HOST_WIFI_OUTAGE_S ) == 0 ) )
+                {
+                    ESP_LOGW( TAG, "Access point drops the station" );
+                    sim_broker_drop_clients();
+                    sim_wifi_disconnect( 8 ); /* WIFI_REASON_ASSOC_LEAVE */
+                }
+            #endif /* CONFIG_PB_HOST_WIFI_OUTAGE_S > 0 */
+
+            ulStep++;
+            vTaskDelay( pdMS_TO_TICKS( HOST_SCENARIO_PERIOD_MS ) );
+        }
+    }
+
+#endif /* CONFIG_PB_HOST_SCENARIO */
+
+#if CONFIG_PB_HOST_RUN_TIME_S > 0
+    static void prvStopTimerCallback( void * pvArg )
+    {
+        sim_broker_stats_t xStats;
+
+        ( void ) pvArg;
+
+        sim_broker_get_stats( &xStats );
+        printf( "[broker] %" PRIu32 " connections, %" PRIu32 " publishes in, %" PRIu32 " out, %" PRIu64 " bytes in, %" PRIu64 " out\n",
+                xStats.connections, xStats.publishes_in, xStats.publishes_out, xStats.bytes_in, xStats.bytes_out );
+        fflush( stdout );
+        sim_broker_stop();
+        exit( xStats.publishes_in > 0 ? EXIT_SUCCESS : EXIT_FAILURE );
+    }
+#endif /* CONFIG_PB_HOST_RUN_TIME_S > 0 */
+
+void app_main( void )
+{
+    BaseType_t xRet;
+    esp_err_t xEspErrRet;
+
+    ESP_ERROR_CHECK( esp_event_loop_create_default() );
+    ESP_ERROR_CHECK( boot_orchestrator_init() );
+
+    /* The broker and the plant exist before the board boots. */
+    ESP_ERROR_CHECK( sim_broker_start( CONFIG_PB_HOST_BROKER_PORT, prvBrokerObserver, NULL ) );
+    prvAttachPeripherals();
+
+    xEspErrRet = nvs_flash_init();
+
+    if( ( xEspErrRet == ESP_ERR_NVS_NO_FREE_PAGES ) ||
+        ( xEspErrRet == ESP_ERR_NVS_NEW_VERSION_FOUND ) )
+    {
+        ESP_ERROR_CHECK( nvs_flash_erase() );
+        ESP_ERROR_CHECK( nvs_flash_init() );
+    }
+
+    boot_stage_done( BOOT_STAGE_NVS );
+
+    xRet = xCoreMqttAgentManagerStart( &xNetworkContext );
+    configASSERT( xRet == pdPASS );
+
+    app_wifi_init();
+
+    if( app_wifi_start( POP_TYPE_MAC ) != ESP_OK )
+    {
+        ESP_LOGE( TAG, "Failed to start WiFi." );
+    }
+
+    boot_stage_done( BOOT_STAGE_RADIO );
+
+    ESP_ERROR_CHECK( boot_run_async( "BootDrivers", prvInitializeDrivers, 4096, BOOT_STAGE_DRIVERS ) );
+
+    xRet = prvInitializeNetworkContext();
+    configASSERT( xRet == pdPASS );
+    boot_stage_done( BOOT_STAGE_CREDENTIALS );
+
+    vStartLEDControl();
+    vStartBarrierControl();
+    vStartBuzzerControl();
+    ESP_ERROR_CHECK( sensor_sampler_start() );
+    vStartPowerPerception();
+    vStartObstaclePerception();
+    vStartWifiPerception();
+    boot_stage_done( BOOT_STAGE_TASKS );
+
+    #if CONFIG_PB_HOST_SCENARIO
+        xRet = xTaskCreate( prvScenarioTask, "HostScenario", 4096, NULL, tskIDLE_PRIORITY + 1, NULL );
+        configASSERT( xRet == pdPASS );
+    #endif /* CONFIG_PB_HOST_SCENARIO */
+
+    #if CONFIG_PB_HOST_BENCH
+        host_bench_start();
+    #endif /* CONFIG_PB_HOST_BENCH */
+
+    #if CONFIG_PB_HOST_RUN_TIME_S > 0
+        esp_timer_handle_t xStopTimer;
+        const esp_timer_create_args_t xStopTimerArgs =
+        {
+            .callback = prvStopTimerCallback,
+            .name     = "host_stop",
+        };
+        ESP_ERROR_CHECK( esp_timer_create( &xStopTimerArgs, &xStopTimer ) );
+        ESP_ERROR_CHECK( esp_timer_start_once( xStopTimer, ( uint64_t ) CONFIG_PB_HOST_RUN_TIME_S * 1000000 ) );
+    #endif /* CONFIG_PB_HOST_RUN_TIME_S > 0 */
+}
@@ -0,0 +1,127 @@
+/*
+ * Stand-in for app_wifi.c on the host: the station joins the simulated access point
+ * of pb_sim and reconnects after a loss of the link, without provisioning.
+ */
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+
+#include <esp_event.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_wifi.h>
+#include <esp_netif.h>
+
+#include "sim_wifi.h"
+#include "app_wifi.h"
+
+/* Delay before reconnecting, the target reconnects right away then backs off. */
+#define HOST_WIFI_RECONNECT_DELAY_MS    200
+
+static const char * TAG = "app_wifi";
+static const int WIFI_CONNECTED_EVENT = BIT0;
+static EventGroupHandle_t wifi_event_group;
+
+static esp_timer_handle_t reconnect_timer;
+static int64_t disconnected_us;
+static app_wifi_reconnect_stats_t reconnect_stats;
+static portMUX_TYPE reconnect_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void reconnect_timer_callback( void * arg )
+{
+    ( void ) arg;
+    sim_wifi_connect();
+}
+
+static void app_wifi_report_connected( void )
+{
+    uint32_t latency_ms = ( uint32_t ) ( ( esp_timer_get_time() - disconnected_us ) / 1000 );
+
+    taskENTER_CRITICAL( &reconnect_stats_lock );
+    reconnect_stats.avg_ms = ( reconnect_stats.connections == 0 ) ? latency_ms :
+                             reconnect_stats.avg_ms - ( reconnect_stats.avg_ms >> 2 ) + ( latency_ms >> 2 );
+    reconnect_stats.connections++;
+    reconnect_stats.directed++;
+    reconnect_stats.last_ms = latency_ms;
+    taskEXIT_CRITICAL( &reconnect_stats_lock );
+
+    ESP_LOGI( TAG, "Got IP %" PRIu32 " ms after losing the link (avg %" PRIu32 " ms)", latency_ms, reconnect_stats.avg_ms );
+}
+
+static void event_handler( void * arg,
+                           esp_event_base_t event_base,
+                           int32_t event_id,
+                           void * event_data )
+{
+    ( void ) arg;
+
+    if( ( event_base == IP_EVENT ) && ( event_id == IP_EVENT_STA_GOT_IP ) )
+    {
+        app_wifi_report_connected();
+        xEventGroupSetBits( wifi_event_group, WIFI_CONNECTED_EVENT );
+    }
+    else if( ( event_base == WIFI_EVENT ) && ( event_id == WIFI_EVENT_STA_DISCONNECTED ) )
+    {
+        if( xEventGroupClearBits( wifi_event_group, WIFI_CONNECTED_EVENT ) & WIFI_CONNECTED_EVENT )
+        {
+            disconnected_us = esp_timer_get_time();
+        }
+
+        ESP_LOGI( TAG, "Disconnected (reason %d). Connecting to the AP again...",
+                  ( ( wifi_event_sta_disconnected_t * ) event_data )->reason );
+        esp_timer_start_once( reconnect_timer, ( uint64_t ) HOST_WIFI_RECONNECT_DELAY_MS * 1000 );
+    }
+}
+
+void app_wifi_init( void )
+{
+    wifi_event_group = xEventGroupCreate();
+    configASSERT( wifi_event_group != NULL );
+
+    ESP_ERROR_CHECK( esp_event_handler_register( WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &event_handler, NULL ) );
+    ESP_ERROR_CHECK( esp_event_handler_register( IP_EVENT, IP_EVENT_STA_GOT_IP, &event_handler, NULL ) );
+
+    const esp_timer_create_args_t reconnect_timer_args =
+    {
+        .callback = reconnect_timer_callback,
+        .name     = "wifi_reconnect",
+    };
+    ESP_ERROR_CHECK( esp_timer_create( &reconnect_timer_args, &reconnect_timer ) );
+}
+
+esp_err_t app_wifi_start( app_wifi_pop_type_t pop_type )
+{
+    ( void ) pop_type;
+
+    ESP_LOGI( TAG, "Already provisioned, starting Wi-Fi STA" );
+    disconnected_us = esp_timer_get_time();
+
+    /* Association and DHCP go on in the background, use
+     * vWaitOnWifiConnected() to wait for them. */
+    return sim_wifi_connect();
+}
+
+esp_err_t app_wifi_connect( void )
+{
+    return sim_wifi_connect();
+}
+
+bool app_wifi_is_connected( void )
+{
+    return ( xEventGroupGetBits( wifi_event_group ) & WIFI_CONNECTED_EVENT ) != 0;
+}
+
+void app_wifi_get_reconnect_stats( app_wifi_reconnect_stats_t * stats )
+{
+    taskENTER_CRITICAL( &reconnect_stats_lock );
+    *stats = reconnect_stats;
+    taskEXIT_CRITICAL( &reconnect_stats_lock );
+}
+
+void vWaitOnWifiConnected( void )
+{
+    xEventGroupWaitBits( wifi_event_group, WIFI_CONNECTED_EVENT, false, true, portMAX_DELAY );
+}
@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+"""
+Compares two results of the host telemetry benchmark, steps are matched by rate.
+Exits with 1 when the current results regress beyond the tolerances.
+"""
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        results = json.load(f)
+    if results.get('benchmark') != 'pb_host_telemetry':
+        sys.exit(f'{path}: not a result of the host telemetry benchmark')
+    return results
+
+
+def dropped(step):
+    return step['backpressure'] + step['enqueue_failed'] + step['completion_failed'] + step['lost']
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('baseline')
+    parser.add_argument('current')
+    parser.add_argument('--latency-tolerance', type=float, default=0.2,
+                        help='relative increase of p50 and p99 allowed (default 0.2)')
+    parser.add_argument('--throughput-tolerance', type=float, default=0.05,
+                        help='relative decrease of throughput allowed (default 0.05)')
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    current = load(args.current)
+    if baseline['config'] != current['config']:
+        print('warning: the configurations differ, the comparison may not be meaningful')
+
+    base_steps = {step['rate_hz']: step for step in baseline['steps']}
+    regressions = []
+
+    print(f"{'rate':>6} {'p50 us':>15} {'p99 us':>15} {'msg/s':>15} {'dropped':>13}")
+    for step in current['steps']:
+        base = base_steps.get(step['rate_hz'])
+        if base is None:
+            continue
+        print(f"{step['rate_hz']:>6} {base['p50_us']:>7}/{step['p50_us']:<7} {base['p99_us']:>7}/{step['p99_us']:<7} "
+              f"{base['throughput_hz']:>7.0f}/{step['throughput_hz']:<7.0f} {dropped(base):>6}/{dropped(step):<6}")
+        for key in ('p50_us', 'p99_us'):
+            if step[key] > base[key] * (1 + args.latency_tolerance):
+                regressions.append(f"{step['rate_hz']} msg/s: {key} {base[key]} -> {step[key]}")
+        if step['throughput_hz'] < base['throughput_hz'] * (1 - args.throughput_tolerance):
+            regressions.append(f"{step['rate_hz']} msg/s: throughput {base['throughput_hz']} -> {step['throughput_hz']}")
+        if dropped(step) > dropped(base):
+            regressions.append(f"{step['rate_hz']} msg/s: dropped {dropped(base)} -> {dropped(step)}")
+
+    base_act, act = baseline['actuation'], current['actuation']
+    if act['samples'] and base_act['samples']:
+        print(f"actuation p50 {base_act['p50_us']}/{act['p50_us']} us, p99 {base_act['p99_us']}/{act['p99_us']} us")
+        # Polled at the tick, differences below the resolution are noise
+        if act['p50_us'] > base_act['p50_us'] * (1 + args.latency_tolerance) + act['resolution_us']:
+            regressions.append(f"actuation p50 {base_act['p50_us']} -> {act['p50_us']}")
+    if act['timeouts'] > base_act['timeouts']:
+        regressions.append(f"actuation timeouts {base_act['timeouts']} -> {act['timeouts']}")
+
+    for regression in regressions:
+        print(f'regression: {regression}')
+    return 1 if regressions else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,147 @@
+#include <stdlib.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "core_mqtt_agent_manager.h"
+#include "core_mqtt_agent_manager_events.h"
+#include "boot_orchestrator.h"
+
+#define BOOT_ALL_READY (BOOT_READY(BOOT_STAGE_COUNT) - 1)
+/* Failed stages are flagged in the same event group, above the ready bits */
+#define BOOT_FAILED(ready_mask) ((ready_mask) << BOOT_STAGE_COUNT)
+#define BOOT_JOB_PRIORITY (tskIDLE_PRIORITY + 5)
+
+typedef struct {
+    void (*job)(void);
+    boot_stage_t stage;
+} boot_job_t;
+
+static const char *TAG = "boot";
+
+static const char *const s_stage_names[BOOT_STAGE_COUNT] = {
+    [BOOT_STAGE_NVS] = "nvs",
+    [BOOT_STAGE_RADIO] = "radio",
+    [BOOT_STAGE_CREDENTIALS] = "credentials",
+    [BOOT_STAGE_DRIVERS] = "drivers",
+    [BOOT_STAGE_TASKS] = "tasks",
+    [BOOT_STAGE_NETWORK] = "network",
+    [BOOT_STAGE_MQTT] = "mqtt",
+};
+
+static EventGroupHandle_t s_ready = NULL;
+/* Written once per stage, before its bit is set */
+static int64_t s_done_us[BOOT_STAGE_COUNT];
+static int64_t s_start_us;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void boot_log_profile(void)
+{
+    ESP_LOGI(TAG, "Boot profile (ms since app_main, app_main started %" PRIu32 " ms after reset):",
+             (uint32_t)(s_start_us / 1000));
+    for (int stage = 0; stage < BOOT_STAGE_COUNT; stage++) {
+        ESP_LOGI(TAG, "  %-12s %6" PRIu32, s_stage_names[stage], (uint32_t)((s_done_us[stage] - s_start_us) / 1000));
+    }
+}
+
+void boot_stage_done(boot_stage_t stage)
+{
+    int64_t now_us = esp_timer_get_time();
+    bool first = false;
+
+    taskENTER_CRITICAL(&s_lock);
+    if (s_done_us[stage] == 0) {
+        s_done_us[stage] = now_us;
+        first = true;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+    if (!first) {
+        return;
+    }
+
+    ESP_LOGI(TAG, "%s ready at %" PRIu32 " ms", s_stage_names[stage], (uint32_t)((now_us - s_start_us) / 1000));
+    if ((xEventGroupSetBits(s_ready, BOOT_READY(stage)) & BOOT_ALL_READY) == BOOT_ALL_READY) {
+        boot_log_profile();
+    }
+}
+
+void boot_stage_failed(boot_stage_t stage)
+{
+    ESP_LOGE(TAG, "%s failed at %" PRIu32 " ms", s_stage_names[stage],
+             (uint32_t)((esp_timer_get_time() - s_start_us) / 1000));
+    xEventGroupSetBits(s_ready, BOOT_FAILED(BOOT_READY(stage)));
+}
+
+bool boot_wait(uint32_t ready_mask, TickType_t timeout)
+{
+    TimeOut_t time_out;
+    vTaskSetTimeOutState(&time_out);
+    while (1) {
+        /* Wakes up on any change, so that a failure isn't missed while waiting for all stages */
+        EventBits_t bits = xEventGroupWaitBits(s_ready, ready_mask | BOOT_FAILED(ready_mask), pdFALSE, pdFALSE, timeout);
+        if (bits & BOOT_FAILED(ready_mask)) {
+            return false;
+        }
+        if ((bits & ready_mask) == ready_mask) {
+            return true;
+        }
+        if (xTaskCheckForTimeOut(&time_out, &timeout) == pdTRUE) {
+            return false;
+        }
+    }
+}
+
+static void boot_job_task(void *arg)
+{
+    boot_job_t job = *(boot_job_t *)arg;
+    free(arg);
+    job.job();
+    boot_stage_done(job.stage);
+    vTaskDelete(NULL);
+}
+
+esp_err_t boot_run_async(const char *name, void (*job)(void), uint32_t stack_size, boot_stage_t stage)
+{
+    boot_job_t *arg = malloc(sizeof(*arg));
+    if (arg == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    arg->job = job;
+    arg->stage = stage;
+    if (xTaskCreate(boot_job_task, name, stack_size, arg, BOOT_JOB_PRIORITY, NULL) != pdPASS) {
+        free(arg);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+static void boot_ip_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    if (event_id == IP_EVENT_STA_GOT_IP || event_id == IP_EVENT_PPP_GOT_IP) {
+        boot_stage_done(BOOT_STAGE_NETWORK);
+    }
+}
+
+static void boot_mqtt_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    if (event_id == CORE_MQTT_AGENT_CONNECTED_EVENT) {
+        boot_stage_done(BOOT_STAGE_MQTT);
+    }
+}
+
+esp_err_t boot_orchestrator_init(void)
+{
+    s_start_us = esp_timer_get_time();
+    if ((s_ready = xEventGroupCreate()) == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = esp_event_handler_register(IP_EVENT, ESP_EVENT_ANY_ID, boot_ip_event_handler, NULL);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return xCoreMqttAgentManagerRegisterHandler(boot_mqtt_event_handler) == pdPASS ? ESP_OK : ESP_FAIL;
+}
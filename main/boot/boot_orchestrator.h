@@ -0,0 +1,45 @@
+// boot_orchestrator.h
+#ifndef BOOT_ORCHESTRATOR_H
+#define BOOT_ORCHESTRATOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+/* Boot milestones; the profile lists them in this order */
+typedef enum {
+    BOOT_STAGE_NVS,             /* Default NVS partition initialized */
+    BOOT_STAGE_RADIO,           /* Wi-Fi (and modem) started, association and DHCP under way */
+    BOOT_STAGE_CREDENTIALS,     /* Network context holds the device certificate and key */
+    BOOT_STAGE_DRIVERS,         /* Hardware drivers initialized */
+    BOOT_STAGE_TASKS,           /* Application tasks created */
+    BOOT_STAGE_NETWORK,         /* First IP address, on any uplink */
+    BOOT_STAGE_MQTT,            /* First broker connection */
+    BOOT_STAGE_COUNT,
+} boot_stage_t;
+
+#define BOOT_READY(stage) (1UL << (stage))
+
+/*
+ * Starts the boot profile and watches the network and MQTT milestones.
+ * Has to be called first thing in app_main, after creating the default event loop.
+ */
+esp_err_t boot_orchestrator_init(void);
+
+/* Marks a stage as done; later calls for the same stage are ignored */
+void boot_stage_done(boot_stage_t stage);
+
+/* Marks a stage as failed, it will never be done: waiters for it are released */
+void boot_stage_failed(boot_stage_t stage);
+
+/*
+ * Blocks until all stages in ready_mask (BOOT_READY() bits) are done.
+ * @return false on timeout, or if one of the stages failed
+ */
+bool boot_wait(uint32_t ready_mask, TickType_t timeout);
+
+/* Runs the job in a task of its own, and marks the stage as done when it returns */
+esp_err_t boot_run_async(const char *name, void (*job)(void), uint32_t stack_size, boot_stage_t stage);
+
+#endif // BOOT_ORCHESTRATOR_H
@@ -66,12 +66,25 @@
 /* Network transport include. */
 #include "network_transport.h"
 
+#if CONFIG_PB_TLS_SESSION_CACHE
+    #include "tls_session_cache.h"
+#endif /* CONFIG_PB_TLS_SESSION_CACHE */
+
 /* Public functions include. */
 #include "core_mqtt_agent_manager.h"
 
+/* Boot readiness include. */
+#include "boot_orchestrator.h"
+
 /* Configurations include. */
 #include "core_mqtt_agent_manager_config.h"
 
+/* Trace points include. */
+#include "pb_trace.h"
+
+/* Rate limited logging include. */
+#include "pb_log.h"
+
 /* OTA demo include. */
 #if CONFIG_GRI_ENABLE_OTA
     #include "ota_over_mqtt.h"
@@ -80,8 +93,8 @@
 /* Preprocessor definitions ***************************************************/
 
 /* Network event group bit definitions */
-#define WIFI_CONNECTED_BIT                  ( 1 << 0 )
-#define WIFI_DISCONNECTED_BIT               ( 1 << 1 )
+#define NETWORK_CONNECTED_BIT               ( 1 << 0 )
+#define NETWORK_DISCONNECTED_BIT            ( 1 << 1 )
 #define CORE_MQTT_AGENT_CONNECTED_BIT       ( 1 << 2 )
 #define CORE_MQTT_AGENT_DISCONNECTED_BIT    ( 1 << 3 )
 
@@ -171,6 +184,39 @@ static void prvIncomingPublishCallback( MQTTAgentContext_t * pMqttAgentContext,
                                         uint16_t packetId,
                                         MQTTPublishInfo_t * pxPublishInfo );
 
+#if CONFIG_PB_TRACE
+
+/**
+ * @brief Agent_MessageSend() between trace points. The command is the argument
+ * of the enqueue, so that it can be matched with its dequeue.
+ */
+    static bool prvTracedMessageSend( MQTTAgentMessageContext_t * pMsgCtx,
+                                      MQTTAgentCommand_t * const * pCommandToSend,
+                                      uint32_t blockTimeMs );
+
+/**
+ * @brief Agent_MessageReceive() with a trace point for each command received.
+ */
+    static bool prvTracedMessageReceive( MQTTAgentMessageContext_t * pMsgCtx,
+                                         MQTTAgentCommand_t ** pReceivedCommand,
+                                         uint32_t blockTimeMs );
+
+/**
+ * @brief espTlsTransportSend() between trace points.
+ */
+    static int32_t prvTracedTransportSend( NetworkContext_t * pNetworkContext,
+                                           const void * pBuffer,
+                                           size_t bytesToSend );
+
+/**
+ * @brief espTlsTransportRecv() with a trace point when data is received. The
+ * agent polls the transport, empty reads are not recorded.
+ */
+    static int32_t prvTracedTransportRecv( NetworkContext_t * pNetworkContext,
+                                           void * pBuffer,
+                                           size_t bytesToRecv );
+#endif /* CONFIG_PB_TRACE */
+
 /**
  * @brief Passed into MQTTAgent_Subscribe() as the callback to execute when the
  * broker ACKs the SUBSCRIBE message. This callback implementation is used for
@@ -260,6 +306,8 @@ static BaseType_t prvBackoffForRetry( BackoffAlgorithmContext_t * pxRetryParams
  */
 static void prvCoreMqttAgentConnectionTask( void * pvParameters );
 
+#if !CONFIG_PB_UPLINK_MANAGER
+
 /**
  * @brief ESP Event Loop library handler for WiFi and IP events.
  */
@@ -267,6 +315,7 @@ static void prvWifiEventHandler( void * pvHandlerArg,
                                  esp_event_base_t xEventBase,
                                  int32_t lEventId,
                                  void * pvEventData );
+#endif /* !CONFIG_PB_UPLINK_MANAGER */
 
 /**
  * @brief ESP Event Loop library handler for coreMQTT-Agent events.
@@ -359,6 +408,8 @@ static void prvIncomingPublishCallback( MQTTAgentContext_t * pMqttAgentContext,
 
     ( void ) packetId;
 
+    PB_TRACE_BEGIN( PB_TRACE_MQTT_INCOMING_PUBLISH, pxPublishInfo->payloadLength );
+
     /* Fan out the incoming publishes to the callbacks registered using
      * subscription manager. */
     xPublishHandled = handleIncomingPublishes( ( SubscriptionElement_t * ) pMqttAgentContext->pIncomingCallbackContext,
@@ -389,8 +440,68 @@ static void prvIncomingPublishCallback( MQTTAgentContext_t * pMqttAgentContext,
                   pxPublishInfo->pTopicName );
         *pcLocation = cOriginalChar;
     }
+
+    PB_TRACE_END( PB_TRACE_MQTT_INCOMING_PUBLISH, xPublishHandled );
 }
 
+#if CONFIG_PB_TRACE
+
+    static bool prvTracedMessageSend( MQTTAgentMessageContext_t * pMsgCtx,
+                                      MQTTAgentCommand_t * const * pCommandToSend,
+                                      uint32_t blockTimeMs )
+    {
+        bool xSent;
+
+        PB_TRACE_BEGIN( PB_TRACE_AGENT_ENQUEUE, ( uintptr_t ) *pCommandToSend );
+        xSent = Agent_MessageSend( pMsgCtx, pCommandToSend, blockTimeMs );
+        PB_TRACE_END( PB_TRACE_AGENT_ENQUEUE, xSent );
+
+        return xSent;
+    }
+
+    static bool prvTracedMessageReceive( MQTTAgentMessageContext_t * pMsgCtx,
+                                         MQTTAgentCommand_t ** pReceivedCommand,
+                                         uint32_t blockTimeMs )
+    {
+        bool xReceived = Agent_MessageReceive( pMsgCtx, pReceivedCommand, blockTimeMs );
+
+        if( xReceived == true )
+        {
+            PB_TRACE_INSTANT( PB_TRACE_AGENT_DEQUEUE, ( uintptr_t ) *pReceivedCommand );
+        }
+
+        return xReceived;
+    }
+
+    static int32_t prvTracedTransportSend( NetworkContext_t * pNetworkContext,
+                                           const void * pBuffer,
+                                           size_t bytesToSend )
+    {
+        int32_t lSent;
+
+        PB_TRACE_BEGIN( PB_TRACE_TLS_SEND, bytesToSend );
+        lSent = espTlsTransportSend( pNetworkContext, pBuffer, bytesToSend );
+        PB_TRACE_END( PB_TRACE_TLS_SEND, lSent );
+
+        return lSent;
+    }
+
+    static int32_t prvTracedTransportRecv( NetworkContext_t * pNetworkContext,
+                                           void * pBuffer,
+                                           size_t bytesToRecv )
+    {
+        int32_t lReceived = espTlsTransportRecv( pNetworkContext, pBuffer, bytesToRecv );
+
+        if( lReceived > 0 )
+        {
+            PB_TRACE_INSTANT( PB_TRACE_TLS_RECV, lReceived );
+        }
+
+        return lReceived;
+    }
+
+#endif /* CONFIG_PB_TRACE */
+
 static void prvSubscriptionCommandCallback( MQTTAgentCommandContext_t * pxCommandContext,
                                             MQTTAgentReturnInfo_t * pxReturnInfo )
 {
@@ -563,8 +674,13 @@ static MQTTStatus_t prvCoreMqttAgentInit( NetworkContext_t * pxNetworkContext )
     MQTTAgentMessageInterface_t xMessageInterface =
     {
         .pMsgCtx        = NULL,
-        .send           = Agent_MessageSend,
-        .recv           = Agent_MessageReceive,
+        #if CONFIG_PB_TRACE
+            .send       = prvTracedMessageSend,
+            .recv       = prvTracedMessageReceive,
+        #else
+            .send       = Agent_MessageSend,
+            .recv       = Agent_MessageReceive,
+        #endif /* CONFIG_PB_TRACE */
         .getCommand     = Agent_GetCommand,
         .releaseCommand = Agent_ReleaseCommand
     };
@@ -583,8 +699,13 @@ static MQTTStatus_t prvCoreMqttAgentInit( NetworkContext_t * pxNetworkContext )
 
     /* Fill in Transport Interface send and receive function pointers. */
     xTransport.pNetworkContext = pxNetworkContext;
-    xTransport.send = espTlsTransportSend;
-    xTransport.recv = espTlsTransportRecv;
+    #if CONFIG_PB_TRACE
+        xTransport.send = prvTracedTransportSend;
+        xTransport.recv = prvTracedTransportRecv;
+    #else
+        xTransport.send = espTlsTransportSend;
+        xTransport.recv = espTlsTransportRecv;
+    #endif /* CONFIG_PB_TRACE */
 
     /* Initialize MQTT library. */
     xReturn = MQTTAgent_Init( &xGlobalMqttAgentContext,
@@ -703,14 +824,25 @@ static void prvCoreMqttAgentConnectionTask( void * pvParameters )
     TlsTransportStatus_t xTlsRet;
     MQTTStatus_t eMqttRet;
 
+    /* The manager is started before the radio, so that it sees the first
+     * network events, while the credentials are still being read. */
+    if( boot_wait( BOOT_READY( BOOT_STAGE_CREDENTIALS ), portMAX_DELAY ) == false )
+    {
+        /* Missing endpoint, thing name or device certificate: a connection
+         * attempt cannot succeed, so don't keep the task around. */
+        ESP_LOGE( TAG, "No credentials for the MQTT broker, not connecting." );
+        vTaskDelete( NULL );
+    }
+
     while( 1 )
     {
         int lSockFd = -1;
 
-        /* Wait for the device to be connected to WiFi and be disconnected from
-         * MQTT broker. */
+        /* Wait for the device to be connected to the network (WiFi, or the
+         * uplink chosen by the uplink manager) and be disconnected from MQTT
+         * broker. */
         xEventGroupWaitBits( xNetworkEventGroup,
-                             WIFI_CONNECTED_BIT | CORE_MQTT_AGENT_DISCONNECTED_BIT,
+                             NETWORK_CONNECTED_BIT | CORE_MQTT_AGENT_DISCONNECTED_BIT,
                              pdFALSE,
                              pdTRUE,
                              portMAX_DELAY );
@@ -733,7 +865,12 @@ static void prvCoreMqttAgentConnectionTask( void * pvParameters )
 
         do
         {
-            xTlsRet = xTlsConnect( pxNetworkContext );
+            #if CONFIG_PB_TLS_SESSION_CACHE
+                /* Resumes the previous session when the broker still has it. */
+                xTlsRet = tls_session_connect( pxNetworkContext );
+            #else
+                xTlsRet = xTlsConnect( pxNetworkContext );
+            #endif /* CONFIG_PB_TLS_SESSION_CACHE */
 
             if( xTlsRet == TLS_TRANSPORT_SUCCESS )
             {
@@ -820,6 +957,7 @@ static void prvCoreMqttAgentConnectionTask( void * pvParameters )
 }
 
 
+#if !CONFIG_PB_UPLINK_MANAGER
 static void prvWifiEventHandler( void * pvHandlerArg,
                                  esp_event_base_t xEventBase,
                                  int32_t lEventId,
@@ -837,7 +975,7 @@ static void prvWifiEventHandler( void * pvHandlerArg,
 
                 /* Notify networking tasks that WiFi is disconnected. */
                 xEventGroupClearBits( xNetworkEventGroup,
-                                      WIFI_CONNECTED_BIT );
+                                      NETWORK_CONNECTED_BIT );
                 break;
 
             default:
@@ -852,7 +990,7 @@ static void prvWifiEventHandler( void * pvHandlerArg,
                 ESP_LOGI( TAG, "WiFi connected." );
                 /* Notify networking tasks that WiFi is connected. */
                 xEventGroupSetBits( xNetworkEventGroup,
-                                    WIFI_CONNECTED_BIT );
+                                    NETWORK_CONNECTED_BIT );
                 break;
 
             default:
@@ -864,6 +1002,7 @@ static void prvWifiEventHandler( void * pvHandlerArg,
         ESP_LOGE( TAG, "WiFi event handler received unexpected event base." );
     }
 }
+#endif /* !CONFIG_PB_UPLINK_MANAGER */
 
 static void prvCoreMqttAgentEventHandler( void * pvHandlerArg,
                                           esp_event_base_t xEventBase,
@@ -877,13 +1016,13 @@ static void prvCoreMqttAgentEventHandler( void * pvHandlerArg,
     switch( lEventId )
     {
         case CORE_MQTT_AGENT_CONNECTED_EVENT:
-            ESP_LOGI( TAG,
-                      "coreMQTT-Agent connected." );
+            PB_LOGI( TAG,
+                     "coreMQTT-Agent connected." );
             break;
 
         case CORE_MQTT_AGENT_DISCONNECTED_EVENT:
-            ESP_LOGI( TAG,
-                      "coreMQTT-Agent disconnected." );
+            PB_LOGI( TAG,
+                     "coreMQTT-Agent disconnected." );
             /* Notify networking tasks of TLS and MQTT disconnection. */
             xEventGroupClearBits( xNetworkEventGroup,
                                   CORE_MQTT_AGENT_CONNECTED_BIT );
@@ -946,9 +1085,46 @@ BaseType_t xCoreMqttAgentManagerRegisterHandler( esp_event_handler_t xEventHandl
     return xRet;
 }
 
+void vCoreMqttAgentManagerUplinkChanged( BaseType_t xUplinkAvailable )
+{
+    EventBits_t xBits;
+
+    /* The manager isn't started in every configuration (e.g. the
+     * qualification test), there is no session to move then. */
+    if( xNetworkEventGroup == NULL )
+    {
+        return;
+    }
+
+    if( xUplinkAvailable == pdTRUE )
+    {
+        xBits = xEventGroupSetBits( xNetworkEventGroup,
+                                    NETWORK_CONNECTED_BIT );
+    }
+    else
+    {
+        xBits = xEventGroupClearBits( xNetworkEventGroup,
+                                      NETWORK_CONNECTED_BIT );
+    }
+
+    /* The socket of the current session goes through the previous uplink, so
+     * drop the session. The connection task reconnects through the new one. */
+    if( ( xBits & CORE_MQTT_AGENT_CONNECTED_BIT ) != 0 )
+    {
+        ESP_LOGI( TAG, "Uplink changed, reconnecting to the MQTT broker." );
+        xEventGroupClearBits( xNetworkEventGroup,
+                              CORE_MQTT_AGENT_CONNECTED_BIT );
+        xEventGroupSetBits( xNetworkEventGroup,
+                            CORE_MQTT_AGENT_DISCONNECTED_BIT );
+        xCoreMqttAgentManagerPost( CORE_MQTT_AGENT_DISCONNECTED_EVENT );
+    }
+}
+
 BaseType_t xCoreMqttAgentManagerStart( NetworkContext_t * pxNetworkContextIn )
 {
-    esp_err_t xEspErrRet;
+    #if !CONFIG_PB_UPLINK_MANAGER
+        esp_err_t xEspErrRet;
+    #endif /* !CONFIG_PB_UPLINK_MANAGER */
     MQTTStatus_t eMqttRet;
     BaseType_t xRet = pdPASS;
 
@@ -990,6 +1166,7 @@ BaseType_t xCoreMqttAgentManagerStart( NetworkContext_t * pxNetworkContextIn )
         }
     }
 
+    #if !CONFIG_PB_UPLINK_MANAGER
     if( xRet != pdFAIL )
     {
         xEspErrRet = esp_event_handler_instance_register( IP_EVENT,
@@ -1023,6 +1200,20 @@ BaseType_t xCoreMqttAgentManagerStart( NetworkContext_t * pxNetworkContextIn )
             xRet = pdFAIL;
         }
     }
+    #endif /* !CONFIG_PB_UPLINK_MANAGER */
+
+    #if CONFIG_PB_TLS_SESSION_CACHE
+    if( xRet != pdFAIL )
+    {
+        if( tls_session_cache_init() != ESP_OK )
+        {
+            ESP_LOGE( TAG,
+                      "Failed to initialize the TLS session cache." );
+
+            xRet = pdFAIL;
+        }
+    }
+    #endif /* CONFIG_PB_TLS_SESSION_CACHE */
 
     if( xRet != pdFAIL )
     {
@@ -68,6 +68,17 @@ BaseType_t xCoreMqttAgentManagerStart( NetworkContext_t * pxNetworkContextIn );
  */
 BaseType_t xCoreMqttAgentManagerPost( int32_t lEventId );
 
+/**
+ * @brief Notify the manager that the uplink carrying the MQTT connection has
+ * changed. This is used instead of WiFi events when the uplink manager selects
+ * between several network interfaces.
+ * @param[in] xUplinkAvailable pdTRUE if the traffic is routed through a new
+ * uplink, pdFALSE if no uplink is usable. A connected session is dropped in
+ * both cases, so that it is re-established through the new route.
+ * Does nothing until xCoreMqttAgentManagerStart() has been called.
+ */
+void vCoreMqttAgentManagerUplinkChanged( BaseType_t xUplinkAvailable );
+
 /* *INDENT-OFF* */
     #ifdef __cplusplus
         } /* extern "C" */
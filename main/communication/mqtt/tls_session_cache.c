@@ -0,0 +1,425 @@
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <sys/select.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_tls.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/platform_util.h"
+#include "sdkconfig.h"
+#if CONFIG_PB_TLS_SESSION_CACHE_NVS
+#include "esp_partition.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#endif
+#include "tls_session_cache.h"
+
+/* Same connect timeout as xTlsConnect() */
+#define TLS_SESSION_CONNECT_TIMEOUT_MS 3000
+/* Longest wait for the next server flight before stepping the handshake again */
+#define TLS_SESSION_STEP_WAIT_MS 10
+/* Weight of a new handshake in the averages (1/4) */
+#define TLS_SESSION_EWMA_SHIFT 2
+
+#if CONFIG_PB_TLS_SESSION_CACHE_NVS
+#define TLS_SESSION_NVS_PARTITION "storage"
+#define TLS_SESSION_NVS_NAMESPACE "tls"
+#define TLS_SESSION_NVS_KEY "session"
+#endif
+
+/* BIO of the MQTT connection, counts the bytes passed to the socket by the TLS record layer */
+typedef struct {
+    mbedtls_net_context net;
+    uint32_t tx_bytes;
+    uint32_t rx_bytes;
+    bool io_failed;             /* The socket failed or was closed, as opposed to a TLS level failure */
+} tls_session_bio_t;
+
+typedef enum {
+    TLS_SESSION_CONNECTED,
+    TLS_SESSION_LINK_FAILED,        /* TCP connect, socket error or timeout, the session isn't the cause */
+    TLS_SESSION_HANDSHAKE_FAILED,   /* Alert or protocol error after the ClientHello was sent */
+} tls_session_result_t;
+
+static const char *TAG = "tls_session";
+
+/* Owned by the connection task, which is the only caller of tls_session_connect() */
+static esp_tls_client_session_t *s_session = NULL;
+static tls_session_bio_t s_bio;
+#if CONFIG_PB_TLS_SESSION_CACHE_NVS
+static bool s_nvs_ready = false;
+#endif
+
+/* Handshake statistics; guarded by s_stats_mutex */
+static tls_session_stats_t s_stats;
+static SemaphoreHandle_t s_stats_mutex = NULL;
+
+static void tls_session_bio_check(tls_session_bio_t *bio, int ret)
+{
+    /* 0 is the end of the stream on receive */
+    if (ret <= 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+        bio->io_failed = true;
+    }
+}
+
+static int tls_session_bio_send(void *ctx, const unsigned char *buf, size_t len)
+{
+    tls_session_bio_t *bio = ctx;
+    int ret = mbedtls_net_send(&bio->net, buf, len);
+    if (ret > 0) {
+        bio->tx_bytes += ret;
+    }
+    tls_session_bio_check(bio, ret);
+    return ret;
+}
+
+static int tls_session_bio_recv(void *ctx, unsigned char *buf, size_t len)
+{
+    tls_session_bio_t *bio = ctx;
+    int ret = mbedtls_net_recv(&bio->net, buf, len);
+    if (ret > 0) {
+        bio->rx_bytes += ret;
+    }
+    tls_session_bio_check(bio, ret);
+    return ret;
+}
+
+/*
+ * Swaps the socket BIO esp-tls installed for the counting one. esp-tls creates the TLS
+ * context and sends the ClientHello in the same step, so the ClientHello isn't counted.
+ */
+static esp_err_t tls_session_attach_bio(esp_tls_t *tls)
+{
+    mbedtls_ssl_context *ssl = esp_tls_get_ssl_context(tls);
+    int sockfd = -1;
+    if (ssl == NULL || esp_tls_get_conn_sockfd(tls, &sockfd) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    mbedtls_net_init(&s_bio.net);
+    s_bio.net.fd = sockfd;
+    s_bio.tx_bytes = 0;
+    s_bio.rx_bytes = 0;
+    s_bio.io_failed = false;
+    mbedtls_ssl_set_bio(ssl, &s_bio, tls_session_bio_send, tls_session_bio_recv, NULL);
+    return ESP_OK;
+}
+
+static void tls_session_wait_readable(esp_tls_t *tls)
+{
+    int sockfd = -1;
+    if (esp_tls_get_conn_sockfd(tls, &sockfd) != ESP_OK) {
+        return;
+    }
+    fd_set read_set;
+    FD_ZERO(&read_set);
+    FD_SET(sockfd, &read_set);
+    struct timeval timeout = { .tv_sec = 0, .tv_usec = TLS_SESSION_STEP_WAIT_MS * 1000 };
+    select(sockfd + 1, &read_set, NULL, NULL, &timeout);
+}
+
+/*
+ * Runs the TCP connect and the handshake step by step, like esp_tls_conn_new_sync() does,
+ * but attaches the byte counters as soon as the TLS context exists, that is once the
+ * ClientHello is sent.
+ */
+static tls_session_result_t tls_session_handshake(NetworkContext_t *network_context, const esp_tls_cfg_t *cfg,
+                                                  int64_t *handshake_start_us)
+{
+    const int64_t start_us = esp_timer_get_time();
+    bool attached = false;
+    int ret;
+
+    while (true) {
+        int64_t step_us = esp_timer_get_time();
+        ret = esp_tls_conn_new_async(network_context->pcHostname, strlen(network_context->pcHostname),
+                                     network_context->xPort, cfg, network_context->pxTls);
+        esp_tls_conn_state_t state;
+        if (!attached && ret >= 0 && esp_tls_get_conn_state(network_context->pxTls, &state) == ESP_OK
+                && (state == ESP_TLS_HANDSHAKE || state == ESP_TLS_DONE)) {
+            if (tls_session_attach_bio(network_context->pxTls) != ESP_OK) {
+                ESP_LOGE(TAG, "Cannot attach to the TLS context");
+                return TLS_SESSION_LINK_FAILED;
+            }
+            *handshake_start_us = step_us;
+            attached = true;
+        }
+        if (ret > 0) {
+            return TLS_SESSION_CONNECTED;
+        }
+        if (ret < 0) {
+            return attached && !s_bio.io_failed ? TLS_SESSION_HANDSHAKE_FAILED : TLS_SESSION_LINK_FAILED;
+        }
+        if (esp_timer_get_time() - start_us > cfg->timeout_ms * 1000LL) {
+            ESP_LOGE(TAG, "Failed to connect to %s within %d ms", network_context->pcHostname, cfg->timeout_ms);
+            return TLS_SESSION_LINK_FAILED;
+        }
+        if (attached) {
+            /* Don't spin while the server works on its flight */
+            tls_session_wait_readable(network_context->pxTls);
+        }
+    }
+}
+
+#if CONFIG_PB_TLS_SESSION_CACHE_NVS
+/* The session holds the master secret, so it's only ever written to the encrypted partition */
+static esp_err_t tls_session_nvs_init(void)
+{
+    const esp_partition_t *keys = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_NVS_KEYS, NULL);
+    if (keys == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    nvs_sec_cfg_t sec_cfg;
+    esp_err_t err = nvs_flash_read_security_cfg(keys, &sec_cfg);
+    if (err == ESP_ERR_NVS_KEYS_NOT_INITIALIZED) {
+        err = nvs_flash_generate_keys(keys, &sec_cfg);
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_flash_secure_init_partition(TLS_SESSION_NVS_PARTITION, &sec_cfg);
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        err = nvs_flash_erase_partition(TLS_SESSION_NVS_PARTITION);
+        if (err == ESP_OK) {
+            err = nvs_flash_secure_init_partition(TLS_SESSION_NVS_PARTITION, &sec_cfg);
+        }
+    }
+    return err;
+}
+
+static void tls_session_nvs_save(const esp_tls_client_session_t *session)
+{
+    size_t len = 0;
+    mbedtls_ssl_session_save(&session->saved_session, NULL, 0, &len);
+    unsigned char *buf = malloc(len);
+    if (buf == NULL) {
+        ESP_LOGW(TAG, "No memory to save the session");
+        return;
+    }
+    nvs_handle_t handle;
+    esp_err_t err = ESP_FAIL;
+    if (mbedtls_ssl_session_save(&session->saved_session, buf, len, &len) == 0
+            && (err = nvs_open_from_partition(TLS_SESSION_NVS_PARTITION, TLS_SESSION_NVS_NAMESPACE, NVS_READWRITE, &handle)) == ESP_OK) {
+        err = nvs_set_blob(handle, TLS_SESSION_NVS_KEY, buf, len);
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to save the session (%s)", esp_err_to_name(err));
+    }
+    mbedtls_platform_zeroize(buf, len);
+    free(buf);
+}
+
+static esp_tls_client_session_t *tls_session_nvs_load(void)
+{
+    nvs_handle_t handle;
+    if (nvs_open_from_partition(TLS_SESSION_NVS_PARTITION, TLS_SESSION_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return NULL;
+    }
+    size_t len = 0;
+    unsigned char *buf = NULL;
+    esp_tls_client_session_t *session = NULL;
+    if (nvs_get_blob(handle, TLS_SESSION_NVS_KEY, NULL, &len) == ESP_OK && (buf = malloc(len)) != NULL
+            && nvs_get_blob(handle, TLS_SESSION_NVS_KEY, buf, &len) == ESP_OK
+            && (session = calloc(1, sizeof(*session))) != NULL) {
+        mbedtls_ssl_session_init(&session->saved_session);
+        int ret = mbedtls_ssl_session_load(&session->saved_session, buf, len);
+        if (ret != 0) {
+            /* Saved by a firmware with another mbedTLS version or configuration */
+            ESP_LOGW(TAG, "Discarding the saved session (-0x%04x)", -ret);
+            esp_tls_free_client_session(session);
+            session = NULL;
+        }
+    }
+    nvs_close(handle);
+    if (buf != NULL) {
+        mbedtls_platform_zeroize(buf, len);
+        free(buf);
+    }
+    return session;
+}
+
+static void tls_session_nvs_erase(void)
+{
+    nvs_handle_t handle;
+    if (nvs_open_from_partition(TLS_SESSION_NVS_PARTITION, TLS_SESSION_NVS_NAMESPACE, NVS_READWRITE, &handle) == ESP_OK) {
+        nvs_erase_key(handle, TLS_SESSION_NVS_KEY);
+        nvs_commit(handle);
+        nvs_close(handle);
+    }
+}
+#endif // CONFIG_PB_TLS_SESSION_CACHE_NVS
+
+static void tls_session_set_cached(bool cached)
+{
+    xSemaphoreTake(s_stats_mutex, portMAX_DELAY);
+    s_stats.cached = cached;
+    xSemaphoreGive(s_stats_mutex);
+}
+
+/*
+ * A resumed session keeps the master secret of the offered one, a full handshake derives a
+ * new one. The session id can't tell: with session tickets mbedTLS offers a random id, and
+ * the server may send a new ticket on resumption as well.
+ */
+static bool tls_session_is_resumed(const esp_tls_client_session_t *offered, const esp_tls_client_session_t *session)
+{
+    return offered != NULL && session != NULL &&
+           memcmp(offered->saved_session.MBEDTLS_PRIVATE(master), session->saved_session.MBEDTLS_PRIVATE(master),
+                  sizeof(session->saved_session.MBEDTLS_PRIVATE(master))) == 0;
+}
+
+/* Caches the session of the new connection; only new sessions are persisted to spare the flash */
+static void tls_session_store(esp_tls_client_session_t *session, bool persist)
+{
+    if (session == NULL) {
+        ESP_LOGW(TAG, "No session to cache");
+        return;
+    }
+    if (s_session != NULL) {
+        esp_tls_free_client_session(s_session);
+    }
+    s_session = session;
+    tls_session_set_cached(true);
+#if CONFIG_PB_TLS_SESSION_CACHE_NVS
+    if (persist && s_nvs_ready) {
+        tls_session_nvs_save(session);
+    }
+#endif
+}
+
+static void tls_session_forget(void)
+{
+    if (s_session != NULL) {
+        esp_tls_free_client_session(s_session);
+        s_session = NULL;
+    }
+    tls_session_set_cached(false);
+#if CONFIG_PB_TLS_SESSION_CACHE_NVS
+    if (s_nvs_ready) {
+        tls_session_nvs_erase();
+    }
+#endif
+}
+
+static uint32_t tls_session_ewma(uint32_t average, uint32_t sample)
+{
+    return (average * ((1 << TLS_SESSION_EWMA_SHIFT) - 1) + sample) >> TLS_SESSION_EWMA_SHIFT;
+}
+
+static void tls_session_record(tls_handshake_stats_t *stats, uint32_t ms, uint32_t bytes)
+{
+    stats->last_ms = ms;
+    stats->last_bytes = bytes;
+    stats->avg_ms = stats->count == 0 ? ms : tls_session_ewma(stats->avg_ms, ms);
+    stats->avg_bytes = stats->count == 0 ? bytes : tls_session_ewma(stats->avg_bytes, bytes);
+    stats->count++;
+}
+
+esp_err_t tls_session_cache_init(void)
+{
+    if (s_stats_mutex != NULL) {
+        return ESP_OK;
+    }
+    if ((s_stats_mutex = xSemaphoreCreateMutex()) == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+#if CONFIG_PB_TLS_SESSION_CACHE_NVS
+    esp_err_t err = tls_session_nvs_init();
+    if (err != ESP_OK) {
+        /* Not fatal, sessions are still cached in RAM */
+        ESP_LOGW(TAG, "Encrypted storage unavailable (%s), the session won't survive a reset", esp_err_to_name(err));
+        return ESP_OK;
+    }
+    s_nvs_ready = true;
+    s_session = tls_session_nvs_load();
+    tls_session_set_cached(s_session != NULL);
+    ESP_LOGI(TAG, "%s saved session", s_session != NULL ? "Resuming the" : "No");
+#endif
+    return ESP_OK;
+}
+
+TlsTransportStatus_t tls_session_connect(NetworkContext_t *network_context)
+{
+    esp_tls_cfg_t cfg = {
+        .cacert_buf = (const unsigned char *)network_context->pcServerRootCA,
+        .cacert_bytes = network_context->pcServerRootCASize,
+        .clientcert_buf = (const unsigned char *)network_context->pcClientCert,
+        .clientcert_bytes = network_context->pcClientCertSize,
+        .skip_common_name = network_context->disableSni,
+        .alpn_protos = network_context->pAlpnProtos,
+#if CONFIG_ESP_SECURE_CERT_DS_PERIPHERAL
+        .ds_data = network_context->ds_data,
+#else
+        .clientkey_buf = (const unsigned char *)network_context->pcClientKey,
+        .clientkey_bytes = network_context->pcClientKeySize,
+#endif
+        .timeout_ms = TLS_SESSION_CONNECT_TIMEOUT_MS,
+        .non_block = true,
+        .client_session = s_session,
+    };
+    const bool offered = s_session != NULL;
+
+    esp_tls_t *tls = esp_tls_init();
+    if (tls == NULL) {
+        return TLS_TRANSPORT_INSUFFICIENT_MEMORY;
+    }
+
+    xSemaphoreTake(network_context->xTlsContextSemaphore, portMAX_DELAY);
+    network_context->pxTls = tls;
+
+    int64_t handshake_start_us = esp_timer_get_time();
+    tls_session_result_t result = tls_session_handshake(network_context, &cfg, &handshake_start_us);
+    if (result != TLS_SESSION_CONNECTED) {
+        esp_tls_conn_destroy(network_context->pxTls);
+        network_context->pxTls = NULL;
+        xSemaphoreGive(network_context->xTlsContextSemaphore);
+        /* A dead link is what the session is kept for, the next attempt offers it again */
+        if (offered && result == TLS_SESSION_HANDSHAKE_FAILED) {
+            /* The retry does a full handshake, in case the session itself was the problem */
+            ESP_LOGW(TAG, "Handshake failed while resuming, dropping the cached session");
+            tls_session_forget();
+        }
+        return TLS_TRANSPORT_CONNECT_FAILURE;
+    }
+
+    uint32_t handshake_ms = (uint32_t)((esp_timer_get_time() - handshake_start_us) / 1000);
+    uint32_t handshake_bytes = s_bio.tx_bytes + s_bio.rx_bytes;
+    esp_tls_client_session_t *session = esp_tls_get_client_session(network_context->pxTls);
+    bool resumed = tls_session_is_resumed(s_session, session);
+    tls_session_store(session, !resumed);
+    xSemaphoreGive(network_context->xTlsContextSemaphore);
+
+    xSemaphoreTake(s_stats_mutex, portMAX_DELAY);
+    tls_session_record(resumed ? &s_stats.resumed : &s_stats.full, handshake_ms, handshake_bytes);
+    if (offered && !resumed) {
+        s_stats.rejected++;
+    }
+    tls_session_stats_t stats = s_stats;
+    xSemaphoreGive(s_stats_mutex);
+
+    ESP_LOGI(TAG, "%s handshake: %" PRIu32 " ms, %" PRIu32 " bytes (full avg %" PRIu32 " ms/%" PRIu32 " bytes, resumed avg %" PRIu32 " ms/%" PRIu32 " bytes)",
+             resumed ? "Resumed" : offered ? "Rejected resumption, full" : "Full", handshake_ms, handshake_bytes,
+             stats.full.avg_ms, stats.full.avg_bytes, stats.resumed.avg_ms, stats.resumed.avg_bytes);
+    return TLS_TRANSPORT_SUCCESS;
+}
+
+esp_err_t tls_session_cache_get_stats(tls_session_stats_t *stats)
+{
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_stats_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(s_stats_mutex, portMAX_DELAY);
+    *stats = s_stats;
+    xSemaphoreGive(s_stats_mutex);
+    return ESP_OK;
+}
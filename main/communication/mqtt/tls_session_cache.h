@@ -0,0 +1,42 @@
+// tls_session_cache.h
+#ifndef TLS_SESSION_CACHE_H
+#define TLS_SESSION_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "network_transport.h"
+
+/* Cost of one kind of TLS session setup */
+typedef struct {
+    uint32_t count;
+    uint32_t last_ms;           /* From the end of the TCP connect to the end of the handshake */
+    uint32_t avg_ms;            /* Moving average over the recent handshakes */
+    uint32_t last_bytes;        /* Bytes sent and received during the handshake */
+    uint32_t avg_bytes;
+} tls_handshake_stats_t;
+
+typedef struct {
+    tls_handshake_stats_t full;
+    tls_handshake_stats_t resumed;
+    uint32_t rejected;          /* Session offered, but the server did a full handshake */
+    bool cached;                /* A session will be offered on the next connect */
+} tls_session_stats_t;
+
+/*
+ * Sets up the cache and, with CONFIG_PB_TLS_SESSION_CACHE_NVS, loads the session saved
+ * in the encrypted storage partition, so the first connection after boot or deep sleep
+ * is resumed as well. The default NVS partition has to be initialized before.
+ */
+esp_err_t tls_session_cache_init(void);
+
+/*
+ * Drop-in replacement of xTlsConnect() which offers the cached session to the broker,
+ * so reconnects skip the certificate exchange and the asymmetric crypto, and caches
+ * the session of the new connection.
+ */
+TlsTransportStatus_t tls_session_connect(NetworkContext_t *network_context);
+
+esp_err_t tls_session_cache_get_stats(tls_session_stats_t *stats);
+
+#endif // TLS_SESSION_CACHE_H
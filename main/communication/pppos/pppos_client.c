@@ -1,13 +1,26 @@
+#include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 #include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "freertos/event_groups.h"
+#include "freertos/semphr.h"
 #include "esp_netif.h"
 #include "esp_netif_ppp.h"
-#include "mqtt_client.h"
 #include "esp_modem_api.h"
+#include "esp_timer.h"
 #include "esp_log.h"
 #include "sdkconfig.h"
+#include "pb_trace.h"
+#if CONFIG_ESP_MODEM_TRACE_HOOKS && CONFIG_PB_TRACE
+#include "esp_modem_trace.h"
+#endif
 #include "driver/gpio.h"
+#include "backoff_algorithm.h"
+#include "pppos_client.h"
+#include "pppos_supervisor.h"
+#include "core_mqtt_agent_manager.h"
+#include "core_mqtt_agent_manager_events.h"
 
 
 #if defined(CONFIG_PB_FLOW_CONTROL_NONE)
@@ -18,21 +31,77 @@
 #define EXAMPLE_FLOW_CONTROL ESP_MODEM_FLOW_CONTROL_HW
 #endif
 
+#if defined(CONFIG_PB_MODEM_USE_CMUX)
+#define PPPOS_DATA_MODE ESP_MODEM_MODE_CMUX
+#else
+#define PPPOS_DATA_MODE ESP_MODEM_MODE_DATA
+#endif
+
+/* Number of AT sync attempts before the modem is considered unresponsive */
+#define PPPOS_SYNC_ATTEMPTS 5
+/* Interval between network registration checks */
+#define PPPOS_REGISTER_POLL_MS 1000
+/* AT+CSQ reports 99 when there is no signal */
+#define PPPOS_CSQ_UNKNOWN 99
+/* esp_modem_at() copies up to 128 bytes of the response */
+#define PPPOS_AT_RESPONSE_MAX 128
+/* <stat> of +CREG/+CGREG/+CEREG: registered on the home network or roaming */
+#define PPPOS_REG_HOME 1
+#define PPPOS_REG_ROAMING 5
+
 
 static const char *TAG = "pppos_client";
 static EventGroupHandle_t event_group = NULL;
 static const int CONNECT_BIT = BIT0;
-static const int GOT_DATA_BIT = BIT2;
+static const int LINK_LOST_BIT = BIT1;
+static const int RADIO_CHANGED_BIT = BIT2;  // A publish window was acquired, released or scheduled
 static const int USB_DISCONNECTED_BIT = BIT3; // Used only with USB DTE but we define it unconditionally, to avoid too many #ifdefs in the code
 
+/* DCE published for link-quality queries once the data session is up; guarded by s_dce_mutex */
+static esp_modem_dce_t *s_dce = NULL;
+static SemaphoreHandle_t s_dce_mutex = NULL;
+
+/* Supervisor statistics; guarded by s_stats_mutex (not the DCE one, which is held during AT queries) */
+static pppos_link_stats_t s_stats = { .state = PPPOS_STATE_POWER_ON };
+static SemaphoreHandle_t s_stats_mutex = NULL;
+
+/* Radio duty cycle bookkeeping; guarded by s_stats_mutex as well */
+static uint32_t s_radio_refs = 0;               /* Open publish windows */
+static uint32_t s_radio_holds = PPPOS_RADIO_HOLD_MQTT; /* pppos_radio_hold_t bits */
+static int64_t s_radio_next_window_us = 0;      /* Next announced publish window, 0 if none */
+static int64_t s_radio_last_release_us = 0;
+static int64_t s_radio_on_since_us = 0;         /* 0 while the radio sleeps */
+static bool s_radio_sleeping = false;           /* From the decision to sleep until the radio is resumed */
+static bool s_radio_sleep_drops_mqtt = false;   /* The MQTT session was routed through PPP when the radio went to sleep */
+static bool s_mqtt_connected = false;
+
+static void pppos_publish_dce(esp_modem_dce_t *dce)
+{
+    xSemaphoreTake(s_dce_mutex, portMAX_DELAY);
+    s_dce = dce;
+    xSemaphoreGive(s_dce_mutex);
+}
+
+#if CONFIG_ESP_MODEM_TRACE_HOOKS && CONFIG_PB_TRACE
+/* Forwards the esp_modem trace points (DTE commands and CMUX reads) to pb_trace */
+void esp_modem_trace_hook(esp_modem_trace_point_t point, esp_modem_trace_phase_t phase, uint32_t arg)
+{
+    pb_trace_id_t id = point == ESP_MODEM_TRACE_CMUX_DATA ? PB_TRACE_CMUX_DATA : PB_TRACE_DTE_COMMAND;
+    if (phase == ESP_MODEM_TRACE_BEGIN) {
+        PB_TRACE_BEGIN(id, arg);
+    } else {
+        PB_TRACE_END(id, arg);
+    }
+}
+#endif
+
 #ifdef CONFIG_PB_MODEM_DEVICE_CUSTOM
 esp_err_t esp_modem_get_time(esp_modem_dce_t *dce_wrap, char *p_time);
 #endif
 
-#if defined(CONFIG_PB_SERIAL_CONFIG_USB)
+#if defined(CONFIG_PB_SERIAL_CONFIG_USB) && !defined(CONFIG_PB_SERIAL_CONFIG_UART)
 #include "esp_modem_usb_c_api.h"
 #include "esp_modem_usb_config.h"
-#include "freertos/task.h"
 static void usb_terminal_error_handler(esp_modem_terminal_error_t err)
 {
     if (err == ESP_MODEM_TERMINAL_DEVICE_GONE) {
@@ -41,56 +110,8 @@ static void usb_terminal_error_handler(esp_modem_terminal_error_t err)
         xEventGroupSetBits(event_group, USB_DISCONNECTED_BIT);
     }
 }
-#define CHECK_USB_DISCONNECTION(event_group) \
-if ((xEventGroupGetBits(event_group) & USB_DISCONNECTED_BIT) == USB_DISCONNECTED_BIT) { \
-    esp_modem_destroy(dce); \
-    continue; \
-}
-#else
-#define CHECK_USB_DISCONNECTION(event_group)
 #endif
 
-static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
-{
-    ESP_LOGD(TAG, "Event dispatched from event loop base=%s, event_id=%" PRIu32, base, event_id);
-    esp_mqtt_event_handle_t event = event_data;
-    esp_mqtt_client_handle_t client = event->client;
-    int msg_id;
-    switch ((esp_mqtt_event_id_t)event_id) {
-    case MQTT_EVENT_CONNECTED:
-        ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED");
-        msg_id = esp_mqtt_client_subscribe(client, CONFIG_PB_MQTT_TEST_TOPIC, 0);
-        ESP_LOGI(TAG, "sent subscribe successful, msg_id=%d", msg_id);
-        break;
-    case MQTT_EVENT_DISCONNECTED:
-        ESP_LOGI(TAG, "MQTT_EVENT_DISCONNECTED");
-        break;
-    case MQTT_EVENT_SUBSCRIBED:
-        ESP_LOGI(TAG, "MQTT_EVENT_SUBSCRIBED, msg_id=%d", event->msg_id);
-        msg_id = esp_mqtt_client_publish(client, CONFIG_PB_MQTT_TEST_TOPIC, CONFIG_PB_MQTT_TEST_DATA, 0, 0, 0);
-        ESP_LOGI(TAG, "sent publish successful, msg_id=%d", msg_id);
-        break;
-    case MQTT_EVENT_UNSUBSCRIBED:
-        ESP_LOGI(TAG, "MQTT_EVENT_UNSUBSCRIBED, msg_id=%d", event->msg_id);
-        break;
-    case MQTT_EVENT_PUBLISHED:
-        ESP_LOGI(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
-        break;
-    case MQTT_EVENT_DATA:
-        ESP_LOGI(TAG, "MQTT_EVENT_DATA");
-        printf("TOPIC=%.*s\r\n", event->topic_len, event->topic);
-        printf("DATA=%.*s\r\n", event->data_len, event->data);
-        xEventGroupSetBits(event_group, GOT_DATA_BIT);
-        break;
-    case MQTT_EVENT_ERROR:
-        ESP_LOGI(TAG, "MQTT_EVENT_ERROR");
-        break;
-    default:
-        ESP_LOGI(TAG, "MQTT other event id: %d", event->event_id);
-        break;
-    }
-}
-
 static void on_ppp_changed(void *arg, esp_event_base_t event_base,
                            int32_t event_id, void *event_data)
 {
@@ -99,6 +120,10 @@ static void on_ppp_changed(void *arg, esp_event_base_t event_base,
         /* User interrupted event from esp-netif */
         esp_netif_t **p_netif = event_data;
         ESP_LOGI(TAG, "User interrupted event from netif:%p", *p_netif);
+    } else if (event_id > NETIF_PPP_ERRORNONE && event_id < NETIF_PP_PHASE_OFFSET) {
+        /* PPP protocol error reported by lwIP, the session is gone */
+        ESP_LOGW(TAG, "PPP error %" PRIu32, event_id);
+        xEventGroupSetBits(event_group, LINK_LOST_BIT);
     }
 }
 
@@ -123,11 +148,14 @@ static void on_ip_event(void *arg, esp_event_base_t event_base,
         esp_netif_get_dns_info(netif, 1, &dns_info);
         ESP_LOGI(TAG, "Name Server2: " IPSTR, IP2STR(&dns_info.ip.u_addr.ip4));
         ESP_LOGI(TAG, "~~~~~~~~~~~~~~");
+        xEventGroupClearBits(event_group, LINK_LOST_BIT);
         xEventGroupSetBits(event_group, CONNECT_BIT);
 
         ESP_LOGI(TAG, "GOT ip event!!!");
     } else if (event_id == IP_EVENT_PPP_LOST_IP) {
         ESP_LOGI(TAG, "Modem Disconnect from PPP Server");
+        xEventGroupClearBits(event_group, CONNECT_BIT);
+        xEventGroupSetBits(event_group, LINK_LOST_BIT);
     } else if (event_id == IP_EVENT_GOT_IP6) {
         ESP_LOGI(TAG, "GOT IPv6 event!");
 
@@ -136,33 +164,43 @@ static void on_ip_event(void *arg, esp_event_base_t event_base,
     }
 }
 
-#include "esp_netif_ppp.h"
+#if defined(CONFIG_PB_MODEM_POWER_SAVING)
+static void on_mqtt_agent_event(void *arg, esp_event_base_t event_base,
+                                int32_t event_id, void *event_data)
+{
+    if (event_id == CORE_MQTT_AGENT_CONNECTED_EVENT) {
+        xSemaphoreTake(s_stats_mutex, portMAX_DELAY);
+        s_mqtt_connected = true;
+        xSemaphoreGive(s_stats_mutex);
+        pppos_radio_hold(PPPOS_RADIO_HOLD_MQTT, false);
+    } else if (event_id == CORE_MQTT_AGENT_DISCONNECTED_EVENT) {
+        xSemaphoreTake(s_stats_mutex, portMAX_DELAY);
+        s_mqtt_connected = false;
+        bool caused_by_sleep = s_radio_sleeping && s_radio_sleep_drops_mqtt;
+        xSemaphoreGive(s_stats_mutex);
+        /* Waking up for it would undo the sleep, the hold is taken when the radio resumes instead */
+        if (!caused_by_sleep) {
+            pppos_radio_hold(PPPOS_RADIO_HOLD_MQTT, true);
+        }
+    }
+}
+#endif // CONFIG_PB_MODEM_POWER_SAVING
+
 #define UART_BAUD   115200
-#define MODEM_TX    27
-#define MODEM_RX    26
-#define MODEM_PWRKEY 4
-#define MODEM_DTR   32
-#define MODEM_RI    33
-#define MODEM_FLIGHT 25
-#define MODEM_STATUS 34
 
-void pppos_start(void)
+static void pppos_set_state(pppos_state_t state)
 {
-    /* Init and register system/core components */
-    ESP_ERROR_CHECK(esp_netif_init());
-    //ESP_ERROR_CHECK(esp_event_loop_create_default());
-    ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, ESP_EVENT_ANY_ID, &on_ip_event, NULL));
-    ESP_ERROR_CHECK(esp_event_handler_register(NETIF_PPP_STATUS, ESP_EVENT_ANY_ID, &on_ppp_changed, NULL));
+    ESP_LOGI(TAG, "%s -> %s", pppos_state_name(s_stats.state), pppos_state_name(state));
+    xSemaphoreTake(s_stats_mutex, portMAX_DELAY);
+    s_stats.state = state;
+    xSemaphoreGive(s_stats_mutex);
+}
 
-    /* Configure the PPP netif */
+/* Creates the DCE (waits for the device on USB) and powers the module on */
+static esp_modem_dce_t *pppos_power_on(esp_netif_t *esp_netif)
+{
     esp_modem_dce_config_t dce_config = ESP_MODEM_DCE_DEFAULT_CONFIG(CONFIG_PB_MODEM_PPP_APN);
-    esp_netif_config_t netif_ppp_config = ESP_NETIF_DEFAULT_PPP();
-    esp_netif_t *esp_netif = esp_netif_new(&netif_ppp_config);
-    assert(esp_netif);
-
-    event_group = xEventGroupCreate();
 
-    /* Configure the DTE */
 #if defined(CONFIG_PB_SERIAL_CONFIG_UART)
     esp_modem_dte_config_t dte_config = ESP_MODEM_DTE_DEFAULT_CONFIG();
     /* setup UART specific configuration based on kconfig options */
@@ -198,7 +236,7 @@ void pppos_start(void)
     gpio_set_level(MODEM_PWRKEY, 1);
     vTaskDelay(pdMS_TO_TICKS(1000)); // Wait for the modem to stabilize
     gpio_set_level(MODEM_PWRKEY, 0); // Send the power key signal
-    
+
 #elif CONFIG_PB_MODEM_DEVICE_CUSTOM == 1
     ESP_LOGI(TAG, "Initializing esp_modem with custom module...");
     esp_modem_dce_t *dce = esp_modem_new_dev(ESP_MODEM_DCE_CUSTOM, &dte_config, &dce_config, esp_netif);
@@ -206,109 +244,591 @@ void pppos_start(void)
     ESP_LOGI(TAG, "Initializing esp_modem for a generic module...");
     esp_modem_dce_t *dce = esp_modem_new(&dte_config, &dce_config, esp_netif);
 #endif
-    assert(dce);
+    if (dce == NULL) {
+        return NULL;
+    }
     if (dte_config.uart_config.flow_control == ESP_MODEM_FLOW_CONTROL_HW) {
         esp_err_t err = esp_modem_set_flow_control(dce, 2, 2);  //2/2 means HW Flow Control.
         if (err != ESP_OK) {
             ESP_LOGE(TAG, "Failed to set the set_flow_control mode");
-            return;
+            esp_modem_destroy(dce);
+            return NULL;
         }
         ESP_LOGI(TAG, "HW set_flow_control OK");
     }
 
 #elif defined(CONFIG_PB_SERIAL_CONFIG_USB)
-    while (1) {
 #if CONFIG_PB_MODEM_DEVICE_BG96 == 1
-        ESP_LOGI(TAG, "Initializing esp_modem for the BG96 module...");
-        struct esp_modem_usb_term_config usb_config = ESP_MODEM_BG96_USB_CONFIG();
-        esp_modem_dce_device_t usb_dev_type = ESP_MODEM_DCE_BG96;
+    ESP_LOGI(TAG, "Initializing esp_modem for the BG96 module...");
+    struct esp_modem_usb_term_config usb_config = ESP_MODEM_BG96_USB_CONFIG();
+    esp_modem_dce_device_t usb_dev_type = ESP_MODEM_DCE_BG96;
 #elif CONFIG_PB_MODEM_DEVICE_SIM7600 == 1
-        ESP_LOGI(TAG, "Initializing esp_modem for the SIM7600 module...");
-        struct esp_modem_usb_term_config usb_config = ESP_MODEM_SIM7600_USB_CONFIG();
-        esp_modem_dce_device_t usb_dev_type = ESP_MODEM_DCE_SIM7600;
+    ESP_LOGI(TAG, "Initializing esp_modem for the SIM7600 module...");
+    struct esp_modem_usb_term_config usb_config = ESP_MODEM_SIM7600_USB_CONFIG();
+    esp_modem_dce_device_t usb_dev_type = ESP_MODEM_DCE_SIM7600;
 #elif CONFIG_PB_MODEM_DEVICE_A7670 == 1
-        ESP_LOGI(TAG, "Initializing esp_modem for the A7670 module...");
-        struct esp_modem_usb_term_config usb_config = ESP_MODEM_A7670_USB_CONFIG();
-        esp_modem_dce_device_t usb_dev_type = ESP_MODEM_DCE_SIM7600;
+    ESP_LOGI(TAG, "Initializing esp_modem for the A7670 module...");
+    struct esp_modem_usb_term_config usb_config = ESP_MODEM_A7670_USB_CONFIG();
+    esp_modem_dce_device_t usb_dev_type = ESP_MODEM_DCE_SIM7600;
 #else
 #error USB modem not selected
 #endif
-        const esp_modem_dte_config_t dte_usb_config = ESP_MODEM_DTE_DEFAULT_USB_CONFIG(usb_config);
-        ESP_LOGI(TAG, "Waiting for USB device connection...");
-        esp_modem_dce_t *dce = esp_modem_new_dev_usb(usb_dev_type, &dte_usb_config, &dce_config, esp_netif);
-        assert(dce);
-        esp_modem_set_error_cb(dce, usb_terminal_error_handler);
-        ESP_LOGI(TAG, "Modem connected, waiting 10 seconds for boot...");
-        vTaskDelay(pdMS_TO_TICKS(10000)); // Give DTE some time to boot
+    const esp_modem_dte_config_t dte_usb_config = ESP_MODEM_DTE_DEFAULT_USB_CONFIG(usb_config);
+    ESP_LOGI(TAG, "Waiting for USB device connection...");
+    esp_modem_dce_t *dce = esp_modem_new_dev_usb(usb_dev_type, &dte_usb_config, &dce_config, esp_netif);
+    if (dce == NULL) {
+        return NULL;
+    }
+    esp_modem_set_error_cb(dce, usb_terminal_error_handler);
+    ESP_LOGI(TAG, "Modem connected, waiting 10 seconds for boot...");
+    vTaskDelay(pdMS_TO_TICKS(10000)); // Give DTE some time to boot
 
 #else
 #error Invalid serial connection to modem.
 #endif
+    return dce;
+}
 
-    xEventGroupClearBits(event_group, CONNECT_BIT | GOT_DATA_BIT | USB_DISCONNECTED_BIT);
+static bool pppos_sync(esp_modem_dce_t *dce)
+{
+    for (int i = 0; i < PPPOS_SYNC_ATTEMPTS; ++i) {
+        if (esp_modem_sync(dce) == ESP_OK) {
+            return true;
+        }
+        vTaskDelay(pdMS_TO_TICKS(500));
+    }
+    return false;
+}
 
-    /* Run the modem demo app */
+/* Reads <stat> from the "+CxREG: <n>,<stat>[,...]" response of "AT+CxREG?", -1 if the query failed */
+static int pppos_get_reg_stat(esp_modem_dce_t *dce, const char *reg)
+{
+    char cmd[16];
+    char out[PPPOS_AT_RESPONSE_MAX] = "";
+    int n, stat;
 
-    int rssi, ber;
-    esp_err_t err = esp_modem_get_signal_quality(dce, &rssi, &ber);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "esp_modem_get_signal_quality failed with %d %s", err, esp_err_to_name(err));
-        return;
+    snprintf(cmd, sizeof(cmd), "AT%s?", reg);
+    if (esp_modem_at(dce, cmd, out, 1000) != ESP_OK) {
+        return -1;
+    }
+    const char *p = strstr(out, reg);
+    if (p == NULL || sscanf(p + strlen(reg), ": %d,%d", &n, &stat) != 2) {
+        return -1;
     }
-    ESP_LOGI(TAG, "Signal quality: rssi=%d, ber=%d", rssi, ber);
+    return stat;
+}
 
+/* PPP needs the packet domain: EPS (+CEREG) on LTE-M/NB-IoT, GPRS (+CGREG) otherwise.
+ * +CREG only stands in for modules which answer neither. */
+static bool pppos_is_registered(esp_modem_dce_t *dce, int *eps, int *gprs, int *cs)
+{
+    *eps = pppos_get_reg_stat(dce, "+CEREG");
+    *gprs = pppos_get_reg_stat(dce, "+CGREG");
+    *cs = -1;
+    if (*eps == PPPOS_REG_HOME || *eps == PPPOS_REG_ROAMING || *gprs == PPPOS_REG_HOME || *gprs == PPPOS_REG_ROAMING) {
+        return true;
+    }
+    if (*eps < 0 && *gprs < 0) {
+        *cs = pppos_get_reg_stat(dce, "+CREG");
+        return *cs == PPPOS_REG_HOME || *cs == PPPOS_REG_ROAMING;
+    }
+    return false;
+}
 
+static bool pppos_wait_for_registration(esp_modem_dce_t *dce)
+{
+    int64_t deadline = esp_timer_get_time() + (int64_t)CONFIG_PB_MODEM_REGISTER_TIMEOUT_MS * 1000;
+    int eps = -1, gprs = -1, cs = -1;
 
-    err = esp_modem_set_mode(dce, ESP_MODEM_MODE_DATA);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "esp_modem_set_mode(ESP_MODEM_MODE_DATA) failed with %d", err);
-        return;
+    while (esp_timer_get_time() < deadline) {
+        if (pppos_is_registered(dce, &eps, &gprs, &cs)) {
+            int rssi = PPPOS_CSQ_UNKNOWN, ber = PPPOS_CSQ_UNKNOWN;
+            int act = -1;
+            char operator_name[PPPOS_OPERATOR_NAME_MAX] = "";
+            /* Only informative once registered */
+            esp_modem_get_signal_quality(dce, &rssi, &ber);
+            esp_modem_get_operator_name(dce, operator_name, &act);
+            ESP_LOGI(TAG, "Registered on \"%s\" (act=%d, CEREG=%d, CGREG=%d, CREG=%d), signal quality: rssi=%d, ber=%d",
+                     operator_name, act, eps, gprs, cs, rssi, ber);
+            return true;
+        }
+        vTaskDelay(pdMS_TO_TICKS(PPPOS_REGISTER_POLL_MS));
     }
-    /* Wait for IP address */
-    ESP_LOGI(TAG, "Waiting for IP address");
-    xEventGroupWaitBits(event_group, CONNECT_BIT | USB_DISCONNECTED_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
-    CHECK_USB_DISCONNECTION(event_group);
+    ESP_LOGW(TAG, "Network registration timed out (last CEREG=%d, CGREG=%d, CREG=%d)", eps, gprs, cs);
+    return false;
+}
 
-    /* Config MQTT */
-#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
-    esp_mqtt_client_config_t mqtt_config = {
-        .broker.address.uri = CONFIG_PB_MQTT_BROKER_URI,
-    };
+/* Returns to command mode from DATA or CMUX; forces the mode via UNDEF if the regular transition fails */
+static bool pppos_leave_data_mode(esp_modem_dce_t *dce)
+{
+    if (esp_modem_set_mode(dce, ESP_MODEM_MODE_COMMAND) == ESP_OK) {
+        return true;
+    }
+    ESP_LOGW(TAG, "Failed to leave data mode, forcing command mode");
+    esp_modem_set_mode(dce, ESP_MODEM_MODE_UNDEF);
+#if defined(CONFIG_PB_MODEM_USE_CMUX)
+    /* the CMUX terminal is still attached to the DTE, close it explicitly */
+    return esp_modem_set_mode(dce, ESP_MODEM_MODE_CMUX_MANUAL_EXIT) == ESP_OK;
 #else
-    esp_mqtt_client_config_t mqtt_config = {
-        .uri = CONFIG_PB_MQTT_BROKER_URI,
-    };
+    return esp_modem_set_mode(dce, ESP_MODEM_MODE_COMMAND) == ESP_OK;
 #endif
-    esp_mqtt_client_handle_t mqtt_client = esp_mqtt_client_init(&mqtt_config);
-    esp_mqtt_client_register_event(mqtt_client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
-    esp_mqtt_client_start(mqtt_client);
-    ESP_LOGI(TAG, "Waiting for MQTT data");
-    xEventGroupWaitBits(event_group, GOT_DATA_BIT | USB_DISCONNECTED_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
-    CHECK_USB_DISCONNECTION(event_group);
-
-    esp_mqtt_client_destroy(mqtt_client);
-    err = esp_modem_set_mode(dce, ESP_MODEM_MODE_COMMAND);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "esp_modem_set_mode(ESP_MODEM_MODE_COMMAND) failed with %d", err);
-        return;
+}
+
+static void pppos_backoff(BackoffAlgorithmContext_t *backoff)
+{
+    uint16_t next_backoff_ms = 0;
+    if (BackoffAlgorithm_GetNextBackoff(backoff, rand(), &next_backoff_ms) == BackoffAlgorithmSuccess) {
+        ESP_LOGI(TAG, "Recovery attempt %" PRIu32 ", backing off %u ms", backoff->attemptsDone, next_backoff_ms);
+        vTaskDelay(pdMS_TO_TICKS(next_backoff_ms));
     }
-    char imsi[32];
-    err = esp_modem_get_imsi(dce, imsi);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "esp_modem_get_imsi failed with %d", err);
-        return;
+}
+
+static void pppos_link_up(int64_t outage_start_us)
+{
+    xSemaphoreTake(s_stats_mutex, portMAX_DELAY);
+    if (outage_start_us > 0) {
+        uint32_t outage_ms = (uint32_t)((esp_timer_get_time() - outage_start_us) / 1000);
+        s_stats.reconnects++;
+        s_stats.last_reconnect_ms = outage_ms;
+        if (outage_ms > s_stats.max_reconnect_ms) {
+            s_stats.max_reconnect_ms = outage_ms;
+        }
+        s_stats.total_downtime_ms += outage_ms;
+        ESP_LOGI(TAG, "Link restored after %" PRIu32 " ms (reconnect #%" PRIu32 ")", outage_ms, s_stats.reconnects);
+    }
+    xSemaphoreGive(s_stats_mutex);
+}
+
+#if defined(CONFIG_PB_MODEM_POWER_SAVING)
+/* Requests PSM and/or eDRX timers from the network, the module applies them once idle */
+static void pppos_configure_power_saving(esp_modem_dce_t *dce)
+{
+#if defined(CONFIG_PB_MODEM_PSM) || defined(CONFIG_PB_MODEM_EDRX)
+    char cmd[64];
+    char out[PPPOS_AT_RESPONSE_MAX];
+#endif
+#if defined(CONFIG_PB_MODEM_PSM)
+    snprintf(cmd, sizeof(cmd), "AT+CPSMS=1,,,\"%s\",\"%s\"", CONFIG_PB_MODEM_PSM_PERIODIC_TAU, CONFIG_PB_MODEM_PSM_ACTIVE_TIME);
+    if (esp_modem_at(dce, cmd, out, 1000) != ESP_OK) {
+        ESP_LOGW(TAG, "Module refused PSM (%s)", cmd);
+    }
+#endif
+#if defined(CONFIG_PB_MODEM_EDRX)
+    snprintf(cmd, sizeof(cmd), "AT+CEDRXS=1,%d,\"%s\"", CONFIG_PB_MODEM_EDRX_ACT, CONFIG_PB_MODEM_EDRX_VALUE);
+    if (esp_modem_at(dce, cmd, out, 1000) != ESP_OK) {
+        ESP_LOGW(TAG, "Module refused eDRX (%s)", cmd);
+    }
+#endif
+}
+#endif // CONFIG_PB_MODEM_POWER_SAVING
+
+/* Called before the link is taken down for a sleep, notes whether MQTT goes down with it */
+static void pppos_radio_enter_sleep(esp_netif_t *esp_netif)
+{
+    xSemaphoreTake(s_stats_mutex, portMAX_DELAY);
+    s_radio_sleeping = true;
+    s_radio_sleep_drops_mqtt = esp_netif_get_default_netif() == esp_netif;
+    xSemaphoreGive(s_stats_mutex);
+}
+
+/* Starts or stops the radio-on clock */
+static void pppos_radio_set_on(bool on)
+{
+    int64_t now = esp_timer_get_time();
+    xSemaphoreTake(s_stats_mutex, portMAX_DELAY);
+    if (on && s_radio_sleeping) {
+        s_radio_sleeping = false;
+#if defined(CONFIG_PB_MODEM_POWER_SAVING)
+        /* A session dropped by the sleep is held for once the radio is back */
+        if (!s_mqtt_connected) {
+            s_radio_holds |= PPPOS_RADIO_HOLD_MQTT;
+        }
+#endif
+    }
+    if (on && s_radio_on_since_us == 0) {
+        s_radio_on_since_us = now;
+    } else if (!on && s_radio_on_since_us != 0) {
+        s_stats.radio_on_ms += (now - s_radio_on_since_us) / 1000;
+        s_stats.sleep_cycles++;
+        s_radio_on_since_us = 0;
+    }
+    xSemaphoreGive(s_stats_mutex);
+}
+
+/* While the link is up: 0 if the radio may sleep now, otherwise how long to wait before checking again */
+static TickType_t pppos_radio_idle_ticks(void)
+{
+#if defined(CONFIG_PB_MODEM_POWER_SAVING)
+    TickType_t ticks = portMAX_DELAY;
+    int64_t now = esp_timer_get_time();
+    xSemaphoreTake(s_stats_mutex, portMAX_DELAY);
+    int64_t linger_end = s_radio_last_release_us + (int64_t)CONFIG_PB_MODEM_RADIO_LINGER_MS * 1000;
+    int64_t window_end = s_radio_next_window_us + (int64_t)CONFIG_PB_MODEM_RADIO_LINGER_MS * 1000;
+    int64_t wake_at = s_radio_next_window_us - (int64_t)CONFIG_PB_MODEM_RADIO_WAKE_LEAD_MS * 1000;
+    if (s_radio_refs > 0 || s_radio_holds != 0) {
+        /* pppos_radio_release() and pppos_radio_hold() set RADIO_CHANGED_BIT */
+    } else if (now < linger_end) {
+        ticks = pdMS_TO_TICKS((linger_end - now) / 1000) + 1;
+    } else if (s_radio_next_window_us == 0 || window_end <= now ||
+               wake_at - now >= (int64_t)CONFIG_PB_MODEM_RADIO_MIN_SLEEP_MS * 1000) {
+        ticks = 0;
+    } else {
+        /* The next window is too close to be worth a sleep, stay on until it is over */
+        ticks = pdMS_TO_TICKS((window_end - now) / 1000) + 1;
     }
-    ESP_LOGI(TAG, "IMSI=%s", imsi);
+    xSemaphoreGive(s_stats_mutex);
+    return ticks;
+#else
+    return portMAX_DELAY;
+#endif
+}
 
-#if defined(CONFIG_PB_SERIAL_CONFIG_USB)
-    // USB example runs in a loop to demonstrate hot-plugging and sudden disconnection features.
-    ESP_LOGI(TAG, "USB demo finished. Disconnect and connect the modem to run it again");
-    xEventGroupWaitBits(event_group, USB_DISCONNECTED_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
-    CHECK_USB_DISCONNECTION(event_group); // dce will be destroyed here
-} // while (1)
+/* While the radio sleeps: 0 if it has to be resumed now, otherwise how long it may keep sleeping */
+static TickType_t pppos_radio_sleep_ticks(void)
+{
+    TickType_t ticks = portMAX_DELAY;
+    int64_t now = esp_timer_get_time();
+    xSemaphoreTake(s_stats_mutex, portMAX_DELAY);
+#if defined(CONFIG_PB_MODEM_POWER_SAVING)
+    int64_t wake_at = s_radio_next_window_us - (int64_t)CONFIG_PB_MODEM_RADIO_WAKE_LEAD_MS * 1000;
 #else
-    // UART DTE clean-up
-    esp_modem_destroy(dce);
-    esp_netif_destroy(esp_netif);
+    int64_t wake_at = s_radio_next_window_us;
+#endif
+    if (s_radio_refs > 0 || s_radio_holds != 0) {
+        ticks = 0;
+    } else if (s_radio_next_window_us > now) {
+        /* Missed windows (s_radio_next_window_us in the past) wait for an explicit acquire */
+        ticks = wake_at <= now ? 0 : pdMS_TO_TICKS((wake_at - now) / 1000) + 1;
+    }
+    xSemaphoreGive(s_stats_mutex);
+    return ticks;
+}
+
+/* Blocks while the link is up; returns PPPOS_EVENT_IDLE if the radio may sleep, otherwise why the link was lost */
+static pppos_event_t pppos_hold_link(void)
+{
+    while (1) {
+        xEventGroupClearBits(event_group, RADIO_CHANGED_BIT);
+        TickType_t ticks = pppos_radio_idle_ticks();
+        if (ticks == 0) {
+            return PPPOS_EVENT_IDLE;
+        }
+        EventBits_t bits = xEventGroupWaitBits(event_group, LINK_LOST_BIT | USB_DISCONNECTED_BIT | RADIO_CHANGED_BIT,
+                                               pdFALSE, pdFALSE, ticks);
+        if (bits & USB_DISCONNECTED_BIT) {
+            return PPPOS_EVENT_DEVICE_GONE;
+        }
+        if (bits & LINK_LOST_BIT) {
+            return PPPOS_EVENT_LINK_LOST;
+        }
+    }
+}
+
+/*
+ * Connection supervisor:
+ * POWER_ON -> SYNC -> REGISTER -> DATA, on link loss DATA -> DEGRADED, which waits for PPP to come back
+ * on its own and otherwise falls to RECOVER. RECOVER backs off exponentially and re-enters SYNC,
+ * or POWER_ON (destroying the DCE) if the modem is gone, unresponsive or the outage exceeds its deadline.
+ * With power saving, an idle link goes DATA -> SLEEP between publish windows and resumes through SYNC,
+ * which is quick as the module stays registered.
+ * Each state runs its action here, the transitions are made by pppos_supervisor_next().
+ */
+static void pppos_supervisor_task(void *arg)
+{
+    esp_netif_t *esp_netif = arg;
+    esp_modem_dce_t *dce = NULL;
+    pppos_state_t state = PPPOS_STATE_POWER_ON;
+    int64_t outage_start_us = 0;    /* 0 while the link is up (or has never been up) */
+    BackoffAlgorithmContext_t backoff;
+#if defined(CONFIG_PB_MODEM_POWER_SAVING)
+    bool power_saving_configured = false;
+#endif
+
+    BackoffAlgorithm_InitializeParams(&backoff, CONFIG_PB_MODEM_RECOVERY_BACKOFF_BASE_MS,
+                                      CONFIG_PB_MODEM_RECOVERY_BACKOFF_MAX_MS, BACKOFF_ALGORITHM_RETRY_FOREVER);
+
+    while (1) {
+        pppos_event_t event = PPPOS_EVENT_FAILED;
+
+        pppos_set_state(state);
+        switch (state) {
+        case PPPOS_STATE_POWER_ON:
+            xEventGroupClearBits(event_group, CONNECT_BIT | LINK_LOST_BIT | USB_DISCONNECTED_BIT);
+            dce = pppos_power_on(esp_netif);
+#if defined(CONFIG_PB_MODEM_POWER_SAVING)
+            power_saving_configured = false;
 #endif
-}
\ No newline at end of file
+            event = dce ? PPPOS_EVENT_OK : PPPOS_EVENT_FAILED;
+            break;
+
+        case PPPOS_STATE_SYNC:
+            event = pppos_sync(dce) ? PPPOS_EVENT_OK : PPPOS_EVENT_FAILED;
+            break;
+
+        case PPPOS_STATE_REGISTER:
+            if (!pppos_wait_for_registration(dce)) {
+                break;
+            }
+#if defined(CONFIG_PB_MODEM_POWER_SAVING)
+            if (!power_saving_configured) {
+                pppos_configure_power_saving(dce);
+                power_saving_configured = true;
+            }
+#endif
+            event = PPPOS_EVENT_OK;
+            break;
+
+        case PPPOS_STATE_DATA: {
+            xEventGroupClearBits(event_group, CONNECT_BIT | LINK_LOST_BIT);
+            /* In CMUX mode PPP runs on one virtual terminal and AT commands on the other,
+             * so the link can be monitored without leaving data mode */
+            esp_err_t err = esp_modem_set_mode(dce, PPPOS_DATA_MODE);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "esp_modem_set_mode(%s) failed with %d",
+                         PPPOS_DATA_MODE == ESP_MODEM_MODE_CMUX ? "ESP_MODEM_MODE_CMUX" : "ESP_MODEM_MODE_DATA", err);
+                break;
+            }
+            pppos_publish_dce(dce);
+            ESP_LOGI(TAG, "Waiting for IP address");
+            EventBits_t bits = xEventGroupWaitBits(event_group, CONNECT_BIT | LINK_LOST_BIT | USB_DISCONNECTED_BIT, pdFALSE, pdFALSE,
+                                                   pdMS_TO_TICKS(CONFIG_PB_MODEM_CONNECT_TIMEOUT_MS));
+            if (bits & USB_DISCONNECTED_BIT) {
+                event = PPPOS_EVENT_DEVICE_GONE;
+                break;
+            }
+            if ((bits & LINK_LOST_BIT) || !(bits & CONNECT_BIT)) {
+                break;
+            }
+            pppos_link_up(outage_start_us);
+            outage_start_us = 0;
+            BackoffAlgorithm_InitializeParams(&backoff, CONFIG_PB_MODEM_RECOVERY_BACKOFF_BASE_MS,
+                                              CONFIG_PB_MODEM_RECOVERY_BACKOFF_MAX_MS, BACKOFF_ALGORITHM_RETRY_FOREVER);
+            /* Connected: block until the link is lost (or it's time to sleep) */
+            event = pppos_hold_link();
+            if (event != PPPOS_EVENT_IDLE) {
+                outage_start_us = esp_timer_get_time();
+            }
+            break;
+        }
+
+        case PPPOS_STATE_DEGRADED: {
+            /* lwIP may renegotiate the PPP session by itself, give it a grace period */
+            EventBits_t bits = xEventGroupWaitBits(event_group, CONNECT_BIT | USB_DISCONNECTED_BIT, pdFALSE, pdFALSE,
+                                                   pdMS_TO_TICKS(CONFIG_PB_MODEM_DEGRADED_GRACE_MS));
+            if (bits & USB_DISCONNECTED_BIT) {
+                event = PPPOS_EVENT_DEVICE_GONE;
+                break;
+            }
+            if (!(bits & CONNECT_BIT)) {
+                break;
+            }
+            pppos_link_up(outage_start_us);
+            outage_start_us = 0;
+            xEventGroupClearBits(event_group, LINK_LOST_BIT);
+            event = pppos_hold_link();
+            if (event != PPPOS_EVENT_IDLE) {
+                outage_start_us = esp_timer_get_time();
+            }
+            break;
+        }
+
+        case PPPOS_STATE_RECOVER: {
+            pppos_publish_dce(NULL);
+            if (outage_start_us == 0) {
+                outage_start_us = esp_timer_get_time();
+            }
+            xSemaphoreTake(s_stats_mutex, portMAX_DELAY);
+            s_stats.recovery_attempts++;
+            xSemaphoreGive(s_stats_mutex);
+
+            uint32_t outage_ms = (uint32_t)((esp_timer_get_time() - outage_start_us) / 1000);
+            bool device_gone = xEventGroupGetBits(event_group) & USB_DISCONNECTED_BIT;
+            bool power_cycle = pppos_supervisor_needs_power_cycle(dce != NULL, device_gone, outage_ms,
+                                                                  CONFIG_PB_MODEM_RECONNECT_DEADLINE_MS);
+            if (outage_ms > CONFIG_PB_MODEM_RECONNECT_DEADLINE_MS) {
+                ESP_LOGW(TAG, "Reconnect deadline exceeded, power cycling the modem");
+            }
+            if (!power_cycle && !pppos_leave_data_mode(dce)) {
+                power_cycle = true;
+            }
+            if (power_cycle && dce) {
+                esp_modem_destroy(dce);
+                dce = NULL;
+                /* the deadline restarts with a freshly powered modem */
+                outage_start_us = esp_timer_get_time();
+            }
+            pppos_backoff(&backoff);
+            event = power_cycle ? PPPOS_EVENT_FAILED : PPPOS_EVENT_OK;
+            break;
+        }
+
+        case PPPOS_STATE_SLEEP: {
+            pppos_publish_dce(NULL);
+            pppos_radio_enter_sleep(esp_netif);
+            /* Ending the PPP session lets the module drop to idle and then to PSM/eDRX */
+            if (!pppos_leave_data_mode(dce)) {
+                pppos_radio_set_on(true);
+                break;
+            }
+            pppos_radio_set_on(false);
+            EventBits_t bits = 0;
+            TickType_t ticks;
+            while ((ticks = pppos_radio_sleep_ticks()) != 0) {
+                bits = xEventGroupWaitBits(event_group, RADIO_CHANGED_BIT | USB_DISCONNECTED_BIT, pdFALSE, pdFALSE, ticks);
+                if (bits & USB_DISCONNECTED_BIT) {
+                    break;
+                }
+                xEventGroupClearBits(event_group, RADIO_CHANGED_BIT);
+            }
+            pppos_radio_set_on(true);
+            /* set_mode(DATA) falls back to ATO (resume_data_mode) if the data call was only suspended */
+            event = (bits & USB_DISCONNECTED_BIT) ? PPPOS_EVENT_DEVICE_GONE : PPPOS_EVENT_OK;
+            break;
+        }
+        }
+        state = pppos_supervisor_next(state, event);
+    }
+}
+
+void pppos_start(void)
+{
+    /* Init and register system/core components */
+    ESP_ERROR_CHECK(esp_netif_init());
+    //ESP_ERROR_CHECK(esp_event_loop_create_default());
+    ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, ESP_EVENT_ANY_ID, &on_ip_event, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_register(NETIF_PPP_STATUS, ESP_EVENT_ANY_ID, &on_ppp_changed, NULL));
+
+    /* Configure the PPP netif */
+    esp_netif_config_t netif_ppp_config = ESP_NETIF_DEFAULT_PPP();
+    esp_netif_t *esp_netif = esp_netif_new(&netif_ppp_config);
+    assert(esp_netif);
+
+    event_group = xEventGroupCreate();
+    s_dce_mutex = xSemaphoreCreateMutex();
+    s_stats_mutex = xSemaphoreCreateMutex();
+    assert(event_group && s_dce_mutex && s_stats_mutex);
+    s_radio_on_since_us = esp_timer_get_time();
+    /* The first linger starts with the radio, not at boot time 0 */
+    s_radio_last_release_us = s_radio_on_since_us;
+#if defined(CONFIG_PB_MODEM_POWER_SAVING)
+    /* Publishers acquire the radio only once MQTT is up, so hold it until the session connects */
+    if (xCoreMqttAgentManagerRegisterHandler(on_mqtt_agent_event) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to register the MQTT event handler, the radio stays on");
+    }
+#endif
+
+    xTaskCreate(pppos_supervisor_task, "pppos_supervisor", CONFIG_PB_MODEM_SUPERVISOR_TASK_STACK_SIZE, esp_netif,
+                CONFIG_PB_MODEM_SUPERVISOR_TASK_PRIORITY, NULL);
+}
+
+esp_err_t pppos_get_link_stats(pppos_link_stats_t *stats)
+{
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_stats_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(s_stats_mutex, portMAX_DELAY);
+    *stats = s_stats;
+    if (s_radio_on_since_us != 0) {
+        stats->radio_on_ms += (esp_timer_get_time() - s_radio_on_since_us) / 1000;
+    }
+    xSemaphoreGive(s_stats_mutex);
+    return ESP_OK;
+}
+
+esp_err_t pppos_get_link_quality(pppos_link_quality_t *quality)
+{
+    if (quality == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_dce_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+#if !defined(CONFIG_PB_MODEM_USE_CMUX)
+    /* Without CMUX the only terminal is busy with PPP frames */
+    return ESP_ERR_NOT_SUPPORTED;
+#else
+    esp_err_t err = ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_dce_mutex, portMAX_DELAY);
+    if (s_dce != NULL) {
+        err = esp_modem_get_signal_quality(s_dce, &quality->rssi, &quality->ber);
+        if (err == ESP_OK) {
+            /* Operator and system mode are informative only, keep the sample if they fail */
+            quality->act = -1;
+            quality->system_mode = -1;
+            quality->operator_name[0] = '\0';
+            if (esp_modem_get_operator_name(s_dce, quality->operator_name, &quality->act) != ESP_OK) {
+                quality->operator_name[0] = '\0';
+            }
+            if (esp_modem_get_network_system_mode(s_dce, &quality->system_mode) != ESP_OK) {
+                quality->system_mode = -1;
+            }
+        }
+    }
+    xSemaphoreGive(s_dce_mutex);
+    return err;
+#endif
+}
+
+esp_err_t pppos_radio_acquire(uint32_t timeout_ms)
+{
+    if (event_group == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(s_stats_mutex, portMAX_DELAY);
+    s_radio_refs++;
+    xSemaphoreGive(s_stats_mutex);
+    xEventGroupSetBits(event_group, RADIO_CHANGED_BIT);
+
+    EventBits_t bits = xEventGroupWaitBits(event_group, CONNECT_BIT, pdFALSE, pdFALSE, pdMS_TO_TICKS(timeout_ms));
+    return (bits & CONNECT_BIT) ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+void pppos_radio_release(void)
+{
+    if (event_group == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_stats_mutex, portMAX_DELAY);
+    if (s_radio_refs > 0) {
+        s_radio_refs--;
+    }
+    s_radio_last_release_us = esp_timer_get_time();
+    xSemaphoreGive(s_stats_mutex);
+    xEventGroupSetBits(event_group, RADIO_CHANGED_BIT);
+}
+
+void pppos_radio_schedule(uint32_t delay_ms)
+{
+    if (event_group == NULL) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    int64_t window = now + (int64_t)delay_ms * 1000;
+    xSemaphoreTake(s_stats_mutex, portMAX_DELAY);
+    /* Keep the earliest pending window of all publishers */
+    if (s_radio_next_window_us <= now || window < s_radio_next_window_us) {
+        s_radio_next_window_us = window;
+    }
+    xSemaphoreGive(s_stats_mutex);
+    xEventGroupSetBits(event_group, RADIO_CHANGED_BIT);
+}
+
+void pppos_radio_hold(pppos_radio_hold_t reason, bool hold)
+{
+    if (event_group == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_stats_mutex, portMAX_DELAY);
+    if (hold) {
+        s_radio_holds |= reason;
+    } else {
+        s_radio_holds &= ~reason;
+        /* Linger after the hold like after a window, a publisher may follow right away */
+        s_radio_last_release_us = esp_timer_get_time();
+    }
+    xSemaphoreGive(s_stats_mutex);
+    xEventGroupSetBits(event_group, RADIO_CHANGED_BIT);
+}
@@ -2,15 +2,73 @@
 #ifndef PPPOS_CLIENT_H
 #define PPPOS_CLIENT_H
 
+#include <stdbool.h>
 #include "esp_err.h"
 #include "esp_event.h"
 #include "esp_netif.h"
+#include "pppos_supervisor.h"
 
+/* GPIO wired to the SIM module */
+#define MODEM_TX    27
+#define MODEM_RX    26
+#define MODEM_PWRKEY 4
+#define MODEM_DTR   32
+#define MODEM_RI    33
+#define MODEM_FLIGHT 25
+#define MODEM_STATUS 34
+#define PPPOS_IS_MODEM_GPIO(gpio) ((gpio) == MODEM_TX || (gpio) == MODEM_RX || (gpio) == MODEM_PWRKEY || \
+                                   (gpio) == MODEM_DTR || (gpio) == MODEM_RI || (gpio) == MODEM_FLIGHT || \
+                                   (gpio) == MODEM_STATUS)
 
+/* Size of the operator name buffer, matches the esp_modem C-API string limit */
+#define PPPOS_OPERATOR_NAME_MAX 128
+
+/* Snapshot of the cellular link as reported by the modem */
+typedef struct {
+    int rssi;           /* AT+CSQ rssi: 0..31, 99 if unknown */
+    int ber;            /* AT+CSQ ber: 0..7, 99 if unknown */
+    int act;            /* AT+COPS access technology, -1 if unknown */
+    int system_mode;    /* Module specific network system mode, -1 if unknown */
+    char operator_name[PPPOS_OPERATOR_NAME_MAX];
+} pppos_link_quality_t;
+
+/* Reconnection statistics of the connection supervisor */
+typedef struct {
+    pppos_state_t state;
+    uint32_t reconnects;            /* Number of times the link was restored after a loss */
+    uint32_t recovery_attempts;     /* Number of passes through the RECOVER state */
+    uint32_t last_reconnect_ms;     /* Duration of the last outage */
+    uint32_t max_reconnect_ms;      /* Longest outage */
+    uint64_t total_downtime_ms;     /* Sum of all outages */
+    uint64_t radio_on_ms;           /* Time spent outside of the SLEEP state */
+    uint32_t sleep_cycles;          /* Number of times the radio was put to sleep */
+} pppos_link_stats_t;
 
 /* Function prototypes */
 esp_err_t pppos_client_init(void);
 void pppos_client_start(void);
 void pppos_client_stop(void);
+/* Starts the connection supervisor task, which brings the PPP link up and keeps it up */
 void pppos_start(void);
+esp_err_t pppos_get_link_stats(pppos_link_stats_t *stats);
+/* Queries the modem over the CMUX command channel, ESP_ERR_INVALID_STATE until the data session is up */
+esp_err_t pppos_get_link_quality(pppos_link_quality_t *quality);
+/*
+ * Radio duty cycling (PB_MODEM_POWER_SAVING): publishers hold the radio on for their window
+ * and announce the next one, the supervisor sleeps the radio in between.
+ * pppos_radio_acquire() wakes the radio and waits up to timeout_ms for the PPP link,
+ * the window has to be released by pppos_radio_release() even if it timed out.
+ */
+esp_err_t pppos_radio_acquire(uint32_t timeout_ms);
+void pppos_radio_release(void);
+/* Announces a publish window in delay_ms, the radio is resumed ahead of it */
+void pppos_radio_schedule(uint32_t delay_ms);
+
+/* Reasons to keep the radio on regardless of publish windows */
+typedef enum {
+    PPPOS_RADIO_HOLD_MQTT = 1 << 0,     /* MQTT session not connected yet (or lost), held from pppos_start() */
+    PPPOS_RADIO_HOLD_UPLINK = 1 << 1,   /* Cellular carries the MQTT session */
+} pppos_radio_hold_t;
+/* Sets or clears a hold; the radio may sleep only while no hold is set and no window is open */
+void pppos_radio_hold(pppos_radio_hold_t reason, bool hold);
 #endif // PPPOS_CLIENT_H
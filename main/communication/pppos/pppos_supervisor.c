@@ -0,0 +1,69 @@
+#include "pppos_supervisor.h"
+
+pppos_state_t pppos_supervisor_next(pppos_state_t state, pppos_event_t event)
+{
+    if (event == PPPOS_EVENT_DEVICE_GONE) {
+        /* The DCE is unusable without its device, RECOVER power cycles the modem */
+        return state == PPPOS_STATE_RECOVER ? PPPOS_STATE_POWER_ON : PPPOS_STATE_RECOVER;
+    }
+    switch (state) {
+    case PPPOS_STATE_POWER_ON:
+        return event == PPPOS_EVENT_OK ? PPPOS_STATE_SYNC :
+               event == PPPOS_EVENT_FAILED ? PPPOS_STATE_RECOVER : state;
+    case PPPOS_STATE_SYNC:
+        return event == PPPOS_EVENT_OK ? PPPOS_STATE_REGISTER :
+               event == PPPOS_EVENT_FAILED ? PPPOS_STATE_RECOVER : state;
+    case PPPOS_STATE_REGISTER:
+        return event == PPPOS_EVENT_OK ? PPPOS_STATE_DATA :
+               event == PPPOS_EVENT_FAILED ? PPPOS_STATE_RECOVER : state;
+    case PPPOS_STATE_DATA:
+    case PPPOS_STATE_DEGRADED:
+        /* Both hold the link once it is up; DATA fails if the session cannot be started,
+         * DEGRADED if lwIP doesn't renegotiate it within the grace period */
+        switch (event) {
+        case PPPOS_EVENT_FAILED:
+            return PPPOS_STATE_RECOVER;
+        case PPPOS_EVENT_LINK_LOST:
+            return PPPOS_STATE_DEGRADED;
+        case PPPOS_EVENT_IDLE:
+            return PPPOS_STATE_SLEEP;
+        default:
+            return state;
+        }
+    case PPPOS_STATE_RECOVER:
+        /* FAILED: data mode could not be left (or there is nothing to resync), power cycle */
+        return event == PPPOS_EVENT_OK ? PPPOS_STATE_SYNC :
+               event == PPPOS_EVENT_FAILED ? PPPOS_STATE_POWER_ON : state;
+    case PPPOS_STATE_SLEEP:
+        /* Resumes through SYNC, which is quick as the module stays registered */
+        return event == PPPOS_EVENT_OK ? PPPOS_STATE_SYNC :
+               event == PPPOS_EVENT_FAILED ? PPPOS_STATE_RECOVER : state;
+    }
+    return PPPOS_STATE_RECOVER;
+}
+
+bool pppos_supervisor_needs_power_cycle(bool have_dce, bool device_gone, uint32_t outage_ms, uint32_t deadline_ms)
+{
+    return !have_dce || device_gone || outage_ms > deadline_ms;
+}
+
+const char *pppos_state_name(pppos_state_t state)
+{
+    switch (state) {
+    case PPPOS_STATE_POWER_ON:
+        return "POWER_ON";
+    case PPPOS_STATE_SYNC:
+        return "SYNC";
+    case PPPOS_STATE_REGISTER:
+        return "REGISTER";
+    case PPPOS_STATE_DATA:
+        return "DATA";
+    case PPPOS_STATE_DEGRADED:
+        return "DEGRADED";
+    case PPPOS_STATE_RECOVER:
+        return "RECOVER";
+    case PPPOS_STATE_SLEEP:
+        return "SLEEP";
+    }
+    return "UNKNOWN";
+}
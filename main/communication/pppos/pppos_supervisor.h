@@ -0,0 +1,52 @@
+// pppos_supervisor.h
+#ifndef PPPOS_SUPERVISOR_H
+#define PPPOS_SUPERVISOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Connection supervisor states */
+typedef enum {
+    PPPOS_STATE_POWER_ON,   /* Creating the DCE and powering the module on */
+    PPPOS_STATE_SYNC,       /* Waiting for the module to answer AT commands */
+    PPPOS_STATE_REGISTER,   /* Waiting for network registration */
+    PPPOS_STATE_DATA,       /* PPP session requested or up */
+    PPPOS_STATE_DEGRADED,   /* PPP session lost, waiting for lwIP to renegotiate it */
+    PPPOS_STATE_RECOVER,    /* Leaving data mode (or power cycling) after a backoff delay */
+    PPPOS_STATE_SLEEP,      /* Out of data mode between publish windows, the module may enter PSM/eDRX */
+} pppos_state_t;
+
+/* Outcome of the action of the current state */
+typedef enum {
+    PPPOS_EVENT_OK,             /* The action succeeded (DCE created, synced, registered, data mode left, radio resumed) */
+    PPPOS_EVENT_FAILED,         /* The action failed or timed out */
+    PPPOS_EVENT_LINK_LOST,      /* The PPP session of a connected link was lost */
+    PPPOS_EVENT_IDLE,           /* The link is up but no publish window needs it, the radio may sleep */
+    PPPOS_EVENT_DEVICE_GONE,    /* The modem disappeared (USB disconnected) */
+} pppos_event_t;
+
+/*
+ * Transition function of the connection supervisor. Has no platform dependencies,
+ * pppos_client.c runs the action of each state and feeds its outcome here.
+ * Events which don't apply to a state keep the supervisor in it, except for
+ * PPPOS_EVENT_DEVICE_GONE, which always leads to RECOVER (or to POWER_ON from RECOVER).
+ */
+pppos_state_t pppos_supervisor_next(pppos_state_t state, pppos_event_t event);
+
+/*
+ * Decides whether RECOVER has to destroy the DCE and power cycle the modem instead of
+ * resynchronizing it: there is no DCE, the device is gone or the outage exceeds the deadline.
+ */
+bool pppos_supervisor_needs_power_cycle(bool have_dce, bool device_gone, uint32_t outage_ms, uint32_t deadline_ms);
+
+const char *pppos_state_name(pppos_state_t state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PPPOS_SUPERVISOR_H
@@ -0,0 +1,193 @@
+#define CATCH_CONFIG_MAIN // This tells the catch header to generate a main
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "pppos_supervisor.h"
+
+static const pppos_state_t all_states[] = {
+    PPPOS_STATE_POWER_ON, PPPOS_STATE_SYNC, PPPOS_STATE_REGISTER, PPPOS_STATE_DATA,
+    PPPOS_STATE_DEGRADED, PPPOS_STATE_RECOVER, PPPOS_STATE_SLEEP,
+};
+static const uint32_t recover_deadline_ms = 120000;
+static const pppos_event_t all_events[] = {
+    PPPOS_EVENT_OK, PPPOS_EVENT_FAILED, PPPOS_EVENT_LINK_LOST, PPPOS_EVENT_IDLE, PPPOS_EVENT_DEVICE_GONE,
+};
+
+/**
+ * Simulated modem: answers the action of each supervisor state the way pppos_client.c
+ * reports it, after a scripted number of failed attempts.
+ */
+struct SimModem {
+    int unresponsive_syncs = 0;     // SYNC fails this many times
+    int stuck_in_data_mode = 0;     // RECOVER cannot leave data mode this many times
+    bool device_gone = false;       // until the next power cycle
+    int link_losses = 0;            // the connected link is lost this many times (lwIP doesn't renegotiate)
+    bool idle = false;              // no publish window holds the link
+
+    int power_ons = 0;
+
+    pppos_event_t run(pppos_state_t state)
+    {
+        if (device_gone && state != PPPOS_STATE_RECOVER && state != PPPOS_STATE_POWER_ON) {
+            return PPPOS_EVENT_DEVICE_GONE;
+        }
+        switch (state) {
+        case PPPOS_STATE_POWER_ON:
+            ++power_ons;
+            device_gone = false;    // the device is back once the DCE is recreated
+            return PPPOS_EVENT_OK;
+        case PPPOS_STATE_SYNC:
+            if (unresponsive_syncs > 0) {
+                --unresponsive_syncs;
+                return PPPOS_EVENT_FAILED;
+            }
+            return PPPOS_EVENT_OK;
+        case PPPOS_STATE_REGISTER:
+            return PPPOS_EVENT_OK;
+        case PPPOS_STATE_DATA:
+            if (link_losses > 0) {
+                --link_losses;
+                return PPPOS_EVENT_LINK_LOST;
+            }
+            return idle ? PPPOS_EVENT_IDLE : PPPOS_EVENT_OK;
+        case PPPOS_STATE_DEGRADED:
+            return PPPOS_EVENT_FAILED;  // grace period over
+        case PPPOS_STATE_RECOVER:
+            if (pppos_supervisor_needs_power_cycle(true, device_gone, 0, recover_deadline_ms)) {
+                return PPPOS_EVENT_FAILED;
+            }
+            if (stuck_in_data_mode > 0) {
+                --stuck_in_data_mode;
+                return PPPOS_EVENT_FAILED;
+            }
+            return PPPOS_EVENT_OK;
+        case PPPOS_STATE_SLEEP:
+            return PPPOS_EVENT_OK;
+        }
+        return PPPOS_EVENT_FAILED;
+    }
+};
+
+// Runs the supervisor until the link is up again, returns the visited states
+static std::vector<pppos_state_t> run_until_connected(pppos_state_t state, SimModem &modem, size_t max_steps = 100)
+{
+    std::vector<pppos_state_t> trace = { state };
+    while (trace.size() < max_steps) {
+        pppos_event_t event = modem.run(state);
+        if (state == PPPOS_STATE_DATA && event == PPPOS_EVENT_OK) {
+            break;
+        }
+        state = pppos_supervisor_next(state, event);
+        trace.push_back(state);
+    }
+    return trace;
+}
+
+TEST_CASE("Bring-up and duty cycle", "[pppos][supervisor]")
+{
+    CHECK(pppos_supervisor_next(PPPOS_STATE_POWER_ON, PPPOS_EVENT_OK) == PPPOS_STATE_SYNC);
+    CHECK(pppos_supervisor_next(PPPOS_STATE_SYNC, PPPOS_EVENT_OK) == PPPOS_STATE_REGISTER);
+    CHECK(pppos_supervisor_next(PPPOS_STATE_REGISTER, PPPOS_EVENT_OK) == PPPOS_STATE_DATA);
+    CHECK(pppos_supervisor_next(PPPOS_STATE_DATA, PPPOS_EVENT_IDLE) == PPPOS_STATE_SLEEP);
+    // the radio resumes through SYNC
+    CHECK(pppos_supervisor_next(PPPOS_STATE_SLEEP, PPPOS_EVENT_OK) == PPPOS_STATE_SYNC);
+    CHECK(pppos_supervisor_next(PPPOS_STATE_SLEEP, PPPOS_EVENT_FAILED) == PPPOS_STATE_RECOVER);
+
+    SimModem modem;
+    auto trace = run_until_connected(PPPOS_STATE_POWER_ON, modem);
+    CHECK(trace == std::vector<pppos_state_t> { PPPOS_STATE_POWER_ON, PPPOS_STATE_SYNC, PPPOS_STATE_REGISTER, PPPOS_STATE_DATA });
+}
+
+TEST_CASE("Link loss", "[pppos][supervisor]")
+{
+    CHECK(pppos_supervisor_next(PPPOS_STATE_DATA, PPPOS_EVENT_LINK_LOST) == PPPOS_STATE_DEGRADED);
+    CHECK(pppos_supervisor_next(PPPOS_STATE_DATA, PPPOS_EVENT_FAILED) == PPPOS_STATE_RECOVER);
+    // renegotiated by lwIP and lost again, or gone to sleep
+    CHECK(pppos_supervisor_next(PPPOS_STATE_DEGRADED, PPPOS_EVENT_LINK_LOST) == PPPOS_STATE_DEGRADED);
+    CHECK(pppos_supervisor_next(PPPOS_STATE_DEGRADED, PPPOS_EVENT_IDLE) == PPPOS_STATE_SLEEP);
+    // not renegotiated within the grace period
+    CHECK(pppos_supervisor_next(PPPOS_STATE_DEGRADED, PPPOS_EVENT_FAILED) == PPPOS_STATE_RECOVER);
+    CHECK(pppos_supervisor_next(PPPOS_STATE_RECOVER, PPPOS_EVENT_OK) == PPPOS_STATE_SYNC);
+
+    SimModem modem;
+    modem.link_losses = 1;
+    auto trace = run_until_connected(PPPOS_STATE_DATA, modem);
+    CHECK(trace == std::vector<pppos_state_t> { PPPOS_STATE_DATA, PPPOS_STATE_DEGRADED, PPPOS_STATE_RECOVER,
+                                                PPPOS_STATE_SYNC, PPPOS_STATE_REGISTER, PPPOS_STATE_DATA });
+}
+
+TEST_CASE("Device gone", "[pppos][supervisor]")
+{
+    for (auto state : all_states) {
+        auto next = pppos_supervisor_next(state, PPPOS_EVENT_DEVICE_GONE);
+        CHECK(next == (state == PPPOS_STATE_RECOVER ? PPPOS_STATE_POWER_ON : PPPOS_STATE_RECOVER));
+    }
+    // RECOVER power cycles the modem
+    CHECK(pppos_supervisor_needs_power_cycle(true, true, 0, 1000) == true);
+
+    SimModem modem;
+    modem.device_gone = true;
+    auto trace = run_until_connected(PPPOS_STATE_DATA, modem);
+    CHECK(trace == std::vector<pppos_state_t> { PPPOS_STATE_DATA, PPPOS_STATE_RECOVER, PPPOS_STATE_POWER_ON,
+                                                PPPOS_STATE_SYNC, PPPOS_STATE_REGISTER, PPPOS_STATE_DATA });
+    CHECK(modem.power_ons == 1);
+}
+
+TEST_CASE("Power cycle decision", "[pppos][supervisor]")
+{
+    const uint32_t deadline_ms = 120000;
+    CHECK(pppos_supervisor_needs_power_cycle(true, false, 0, deadline_ms) == false);
+    CHECK(pppos_supervisor_needs_power_cycle(true, false, deadline_ms, deadline_ms) == false);
+    CHECK(pppos_supervisor_needs_power_cycle(true, false, deadline_ms + 1, deadline_ms) == true);
+    CHECK(pppos_supervisor_needs_power_cycle(false, false, 0, deadline_ms) == true);
+    CHECK(pppos_supervisor_needs_power_cycle(true, true, 0, deadline_ms) == true);
+    // RECOVER reports FAILED when it power cycles (or data mode cannot be left)
+    CHECK(pppos_supervisor_next(PPPOS_STATE_RECOVER, PPPOS_EVENT_FAILED) == PPPOS_STATE_POWER_ON);
+}
+
+TEST_CASE("Every state leads back to DATA", "[pppos][supervisor]")
+{
+    // No state (or unexpected event) may trap the supervisor: from the successor of every
+    // state/event pair, a responsive modem is brought back to DATA within one bring-up
+    for (auto state : all_states) {
+        for (auto event : all_events) {
+            auto next = pppos_supervisor_next(state, event);
+            CHECK(std::find(std::begin(all_states), std::end(all_states), next) != std::end(all_states));
+            SimModem modem;
+            auto trace = run_until_connected(next, modem);
+            CHECK(trace.back() == PPPOS_STATE_DATA);
+            CHECK(trace.size() <= 6);
+        }
+    }
+}
+
+TEST_CASE("Scripted outages are recovered in bounded attempts", "[pppos][supervisor][recovery]")
+{
+    // Each entry is the number of sync attempts the modem stays unresponsive for after the link drops
+    for (int failing_attempts : { 0, 1, 3, 6 }) {
+        SimModem modem;
+        modem.link_losses = 1;
+        modem.unresponsive_syncs = failing_attempts;
+        auto trace = run_until_connected(PPPOS_STATE_DATA, modem);
+        CHECK(trace.back() == PPPOS_STATE_DATA);
+        // one RECOVER pass for the loss and one per failed sync, no power cycle
+        CHECK(std::count(trace.begin(), trace.end(), PPPOS_STATE_RECOVER) == failing_attempts + 1);
+        CHECK(modem.power_ons == 0);
+    }
+
+    // A modem which cannot leave data mode is power cycled
+    SimModem modem;
+    modem.link_losses = 1;
+    modem.stuck_in_data_mode = 1;
+    auto trace = run_until_connected(PPPOS_STATE_DATA, modem);
+    CHECK(trace.back() == PPPOS_STATE_DATA);
+    CHECK(modem.power_ons == 1);
+}
+
+TEST_CASE("State names", "[pppos][supervisor]")
+{
+    for (auto state : all_states) {
+        CHECK(std::string(pppos_state_name(state)) != "UNKNOWN");
+    }
+}
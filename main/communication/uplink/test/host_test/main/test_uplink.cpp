@@ -0,0 +1,437 @@
+#define CATCH_CONFIG_MAIN // This tells the catch header to generate a main
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "catch.hpp"
+#include "uplink_policy.h"
+
+using namespace std::chrono;
+
+// Probe interval and timeout of the failover tests, scaled down from
+// CONFIG_PB_UPLINK_PROBE_INTERVAL_MS and CONFIG_PB_UPLINK_PROBE_TIMEOUT_MS
+static constexpr uint32_t probe_interval_ms = 50;
+static constexpr uint32_t probe_timeout_ms = 20;
+static constexpr uint32_t max_probe_failures = 3;
+// Longest probe/evaluate cycle: the interval plus a timed out probe on each uplink
+static constexpr uint32_t cycle_ms = probe_interval_ms + UPLINK_COUNT * probe_timeout_ms;
+
+static uplink_policy_config_t default_config()
+{
+    uplink_policy_config_t config = {};
+    config.hysteresis = 15;
+    config.hold_ms = 10000;
+    config.max_probe_failures = max_probe_failures;
+    config.bias[UPLINK_WIFI] = 0;
+    config.bias[UPLINK_CELLULAR] = -10;
+    return config;
+}
+
+static int check(int ret, const char *what)
+{
+    if (ret == -1) {
+        throw std::runtime_error(std::string(what) + ": " + strerror(errno));
+    }
+    return ret;
+}
+
+// Each uplink is a loopback source address, 127.0.0.2 for Wi-Fi and 127.0.0.3 for cellular
+static sockaddr_in uplink_address(uplink_id_t id)
+{
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK + 2 + id);
+    return addr;
+}
+
+static int uplink_socket(uplink_id_t id, int type)
+{
+    int fd = check(socket(AF_INET, type, 0), "socket");
+    sockaddr_in addr = uplink_address(id);
+    if (bind(fd, (sockaddr *)&addr, sizeof(addr)) == -1) {
+        close(fd);
+        check(-1, "bind");
+    }
+    return fd;
+}
+
+/**
+ * Network between the uplinks and the broker: an MQTT broker on TCP and the probe target
+ * (UDP echo) on 127.0.0.1. Taking an uplink down blackholes its traffic, like a path which
+ * silently stops passing packets: nothing is answered and no reset is sent, so the client
+ * only learns about it from its probes.
+ */
+class Network {
+public:
+    Network()
+    {
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        listener = check(socket(AF_INET, SOCK_STREAM, 0), "socket");
+        check(bind(listener, (sockaddr *)&addr, sizeof(addr)), "bind");
+        check(listen(listener, 4), "listen");
+        socklen_t len = sizeof(broker_addr);
+        check(getsockname(listener, (sockaddr *)&broker_addr, &len), "getsockname");
+        echo = check(socket(AF_INET, SOCK_DGRAM, 0), "socket");
+        check(bind(echo, (sockaddr *)&broker_addr, sizeof(broker_addr)), "bind");
+        for (auto &up : uplink_up) {
+            up = true;
+        }
+        thread = std::thread(&Network::run, this);
+    }
+
+    ~Network()
+    {
+        stop = true;
+        thread.join();
+        for (int fd : sessions) {
+            close(fd);
+        }
+        close(echo);
+        close(listener);
+    }
+
+    void set_up(uplink_id_t id, bool up)
+    {
+        uplink_up[id] = up;
+    }
+
+    [[nodiscard]] const sockaddr_in &broker() const
+    {
+        return broker_addr;
+    }
+
+    std::atomic<uint32_t> connects{0};
+
+private:
+    bool passes(const sockaddr_in &peer)
+    {
+        for (int id = 0; id < UPLINK_COUNT; id++) {
+            if (peer.sin_addr.s_addr == uplink_address(static_cast<uplink_id_t>(id)).sin_addr.s_addr) {
+                return uplink_up[id];
+            }
+        }
+        return false;
+    }
+
+    bool passes(int fd)
+    {
+        sockaddr_in peer = {};
+        socklen_t len = sizeof(peer);
+        return getpeername(fd, (sockaddr *)&peer, &len) == 0 && passes(peer);
+    }
+
+    // Answers CONNECT with CONNACK and PINGREQ with PINGRESP, one packet per read is enough here
+    void serve(int fd)
+    {
+        uint8_t buf[64];
+        ssize_t len = recv(fd, buf, sizeof(buf), 0);
+        if (len <= 0) {
+            close(fd);
+            sessions.erase(std::find(sessions.begin(), sessions.end(), fd));
+            return;
+        }
+        if (!passes(fd)) {
+            return;
+        }
+        if (buf[0] == 0x10) {
+            const uint8_t connack[] = { 0x20, 0x02, 0x00, 0x00 };
+            send(fd, connack, sizeof(connack), MSG_NOSIGNAL);
+            connects++;
+        } else if (buf[0] == 0xc0) {
+            const uint8_t pingresp[] = { 0xd0, 0x00 };
+            send(fd, pingresp, sizeof(pingresp), MSG_NOSIGNAL);
+        }
+    }
+
+    void run()
+    {
+        while (!stop) {
+            std::vector<pollfd> fds = { { listener, POLLIN, 0 }, { echo, POLLIN, 0 } };
+            for (int fd : sessions) {
+                fds.push_back({ fd, POLLIN, 0 });
+            }
+            if (poll(fds.data(), fds.size(), 10) <= 0) {
+                continue;
+            }
+            if (fds[0].revents & POLLIN) {
+                sessions.push_back(accept(listener, nullptr, nullptr));
+            }
+            if (fds[1].revents & POLLIN) {
+                uint8_t buf[64];
+                sockaddr_in peer = {};
+                socklen_t len = sizeof(peer);
+                ssize_t n = recvfrom(echo, buf, sizeof(buf), 0, (sockaddr *)&peer, &len);
+                if (n > 0 && passes(peer)) {
+                    sendto(echo, buf, n, 0, (sockaddr *)&peer, len);
+                }
+            }
+            for (size_t i = 2; i < fds.size(); i++) {
+                if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                    serve(fds[i].fd);
+                }
+            }
+        }
+    }
+
+    int listener{-1};
+    int echo{-1};
+    sockaddr_in broker_addr{};
+    std::vector<int> sessions;
+    std::atomic<bool> uplink_up[UPLINK_COUNT];
+    std::atomic<bool> stop{false};
+    std::thread thread;
+};
+
+static bool wait_readable(int fd, milliseconds timeout)
+{
+    pollfd pfd = { fd, POLLIN, 0 };
+    return poll(&pfd, 1, static_cast<int>(timeout.count())) == 1 && (pfd.revents & POLLIN);
+}
+
+// Echo probe through the uplink, like the ICMP probe of the manager
+static bool probe(const Network &network, uplink_id_t id, uint32_t &rtt_ms)
+{
+    int fd = uplink_socket(id, SOCK_DGRAM);
+    auto start = steady_clock::now();
+    const char ping[] = "probe";
+    bool ok = sendto(fd, ping, sizeof(ping), 0, (const sockaddr *)&network.broker(), sizeof(network.broker())) > 0
+              && wait_readable(fd, milliseconds(probe_timeout_ms));
+    rtt_ms = static_cast<uint32_t>(std::max<int64_t>(1, duration_cast<milliseconds>(steady_clock::now() - start).count()));
+    close(fd);
+    return ok;
+}
+
+/**
+ * MQTT session of the agent manager: a TCP connection through one uplink, which is up once the
+ * broker has answered the CONNECT. A route change closes it and connects through the new uplink.
+ */
+class MqttSession {
+public:
+    ~MqttSession()
+    {
+        disconnect();
+    }
+
+    bool connect(const Network &network, uplink_id_t id)
+    {
+        disconnect();
+        fd = uplink_socket(id, SOCK_STREAM);
+        uplink = id;
+        // CONNECT, MQTT 3.1.1, clean session, keep alive 60 s, client ID "pbt0"
+        const uint8_t connect_packet[] = { 0x10, 16, 0x00, 0x04, 'M', 'Q', 'T', 'T', 0x04, 0x02, 0x00, 60,
+                                           0x00, 0x04, 'p', 'b', 't', '0'
+                                         };
+        uint8_t connack[4];
+        connected = ::connect(fd, (const sockaddr *)&network.broker(), sizeof(network.broker())) == 0
+                    && send(fd, connect_packet, sizeof(connect_packet), MSG_NOSIGNAL) == sizeof(connect_packet)
+                    && wait_readable(fd, milliseconds(probe_timeout_ms))
+                    && recv(fd, connack, sizeof(connack), 0) == sizeof(connack)
+                    && connack[0] == 0x20 && connack[3] == 0x00;
+        return connected;
+    }
+
+    void disconnect()
+    {
+        if (fd != -1) {
+            close(fd);
+            fd = -1;
+        }
+        uplink = UPLINK_NONE;
+        connected = false;
+    }
+
+    // PINGREQ, answered only while the path of the session passes traffic
+    bool ping()
+    {
+        const uint8_t pingreq[] = { 0xc0, 0x00 };
+        uint8_t pingresp[2];
+        return connected && send(fd, pingreq, sizeof(pingreq), MSG_NOSIGNAL) == sizeof(pingreq)
+               && wait_readable(fd, milliseconds(probe_timeout_ms))
+               && recv(fd, pingresp, sizeof(pingresp), 0) == sizeof(pingresp) && pingresp[0] == 0xd0;
+    }
+
+    uplink_id_t uplink{UPLINK_NONE};
+    bool connected{false};
+
+private:
+    int fd{-1};
+};
+
+// One probe/evaluate/reconnect cycle of the uplink manager task, without the wait for the next one
+static void run_cycle(uplink_policy_t &policy, const Network &network, MqttSession &session)
+{
+    for (int id = 0; id < UPLINK_COUNT; id++) {
+        uint32_t rtt_ms;
+        bool ok = probe(network, static_cast<uplink_id_t>(id), rtt_ms);
+        uplink_policy_report_probe(&policy, static_cast<uplink_id_t>(id), ok, rtt_ms);
+    }
+    auto now = duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+    uplink_id_t route = uplink_policy_evaluate(&policy, static_cast<uint32_t>(now));
+    // vCoreMqttAgentManagerUplinkChanged(): the socket is bound to the old route, reconnect
+    if (route != session.uplink || !session.connected) {
+        if (route == UPLINK_NONE) {
+            session.disconnect();
+        } else {
+            session.connect(network, route);
+        }
+    }
+}
+
+/**
+ * Runs the cycles until the MQTT session is connected through the expected uplink
+ * @return Wall time it took, or the timeout if the session didn't get there
+ */
+static milliseconds run_until_connected(uplink_policy_t &policy, const Network &network, MqttSession &session,
+                                        uplink_id_t expected, milliseconds timeout)
+{
+    auto start = steady_clock::now();
+    while (steady_clock::now() - start < timeout) {
+        auto cycle_start = steady_clock::now();
+        run_cycle(policy, network, session);
+        if (session.connected && session.uplink == expected) {
+            return duration_cast<milliseconds>(steady_clock::now() - start);
+        }
+        std::this_thread::sleep_until(cycle_start + milliseconds(probe_interval_ms));
+    }
+    return timeout;
+}
+
+TEST_CASE("Signal quality mapping", "[uplink]")
+{
+    CHECK(uplink_quality_from_wifi_rssi(-100) == 0);
+    CHECK(uplink_quality_from_wifi_rssi(-75) == 50);
+    CHECK(uplink_quality_from_wifi_rssi(-40) == 100);
+    CHECK(uplink_quality_from_csq(99) == 0);
+    CHECK(uplink_quality_from_csq(0) == 0);
+    CHECK(uplink_quality_from_csq(31) == 100);
+    CHECK(uplink_quality_from_csq(15) == 48);
+}
+
+TEST_CASE("Hysteresis keeps the session on similar uplinks", "[uplink]")
+{
+    uplink_policy_t policy;
+    auto config = default_config();
+    uplink_policy_init(&policy, &config);
+    uplink_policy_set_link(&policy, UPLINK_WIFI, true);
+    uplink_policy_set_link(&policy, UPLINK_CELLULAR, true);
+    uplink_policy_set_quality(&policy, UPLINK_WIFI, 60);
+    uplink_policy_set_quality(&policy, UPLINK_CELLULAR, 70);
+
+    CHECK(uplink_policy_evaluate(&policy, 0) == UPLINK_WIFI);
+    CHECK(policy.switches == 1);
+
+    // Wi-Fi signal fluctuates around the cellular score for ten minutes
+    for (uint32_t now = 1000; now < 600000; now += 1000) {
+        uplink_policy_set_quality(&policy, UPLINK_WIFI, (now / 1000) % 2 ? 40 : 75);
+        CHECK(uplink_policy_evaluate(&policy, now) == UPLINK_WIFI);
+    }
+    // ...and stays worse, but never for the whole hold time
+    for (uint32_t now = 600000; now < 1200000; now += 1000) {
+        uplink_policy_set_quality(&policy, UPLINK_WIFI, (now / 1000) % 10 ? 20 : 60);
+        CHECK(uplink_policy_evaluate(&policy, now) == UPLINK_WIFI);
+    }
+    CHECK(policy.switches == 1);
+}
+
+TEST_CASE("Sustained better uplink is taken after the hold time", "[uplink]")
+{
+    uplink_policy_t policy;
+    auto config = default_config();
+    uplink_policy_init(&policy, &config);
+    uplink_policy_set_link(&policy, UPLINK_CELLULAR, true);
+    uplink_policy_set_quality(&policy, UPLINK_CELLULAR, 50);
+    CHECK(uplink_policy_evaluate(&policy, 0) == UPLINK_CELLULAR);
+
+    uplink_policy_set_link(&policy, UPLINK_WIFI, true);
+    uplink_policy_set_quality(&policy, UPLINK_WIFI, 80);
+    // The hold time counts from the first evaluation which sees the better candidate
+    CHECK(uplink_policy_evaluate(&policy, 1000) == UPLINK_CELLULAR);
+    CHECK(uplink_policy_evaluate(&policy, 1000 + config.hold_ms - 1) == UPLINK_CELLULAR);
+    CHECK(uplink_policy_evaluate(&policy, 1000 + config.hold_ms) == UPLINK_WIFI);
+    CHECK(policy.switches == 2);
+
+    SECTION("High loss and RTT outweigh the signal") {
+        for (int i = 0; i < 2; i++) {
+            uplink_policy_report_probe(&policy, UPLINK_WIFI, false, 0);
+            uplink_policy_report_probe(&policy, UPLINK_WIFI, true, 900);
+        }
+        CHECK(uplink_policy_usable(&policy, UPLINK_WIFI));
+        CHECK(uplink_policy_score(&policy, UPLINK_WIFI) + config.hysteresis <= uplink_policy_score(&policy, UPLINK_CELLULAR));
+        uint32_t now = 100000;
+        CHECK(uplink_policy_evaluate(&policy, now) == UPLINK_WIFI);
+        CHECK(uplink_policy_evaluate(&policy, now + config.hold_ms) == UPLINK_CELLULAR);
+    }
+
+    SECTION("Lost uplink is left without the hold time") {
+        uplink_policy_set_link(&policy, UPLINK_WIFI, false);
+        CHECK(uplink_policy_evaluate(&policy, 100000) == UPLINK_CELLULAR);
+        uplink_policy_set_link(&policy, UPLINK_CELLULAR, false);
+        CHECK(uplink_policy_evaluate(&policy, 100001) == UPLINK_NONE);
+        CHECK(policy.switches == 3);
+    }
+}
+
+TEST_CASE("MQTT session fails over to the standby uplink in bounded time", "[uplink][failover]")
+{
+    Network network;
+    MqttSession session;
+
+    uplink_policy_t policy;
+    auto config = default_config();
+    config.hold_ms = 10 * probe_interval_ms;
+    uplink_policy_init(&policy, &config);
+    uplink_policy_set_link(&policy, UPLINK_WIFI, true);
+    uplink_policy_set_link(&policy, UPLINK_CELLULAR, true);
+    uplink_policy_set_quality(&policy, UPLINK_WIFI, 70);
+    uplink_policy_set_quality(&policy, UPLINK_CELLULAR, 50);
+    REQUIRE(run_until_connected(policy, network, session, UPLINK_WIFI, milliseconds(1000)) < milliseconds(1000));
+    REQUIRE(session.ping());
+    REQUIRE(network.connects == 1);
+
+    // Silent loss: Wi-Fi keeps its address, the session and the probes just stop getting answers,
+    // so it takes max_probe_failures probes to notice, then one reconnect through cellular
+    const auto failover_bound = milliseconds((max_probe_failures + 1) * cycle_ms);
+    network.set_up(UPLINK_WIFI, false);
+    CHECK_FALSE(session.ping());
+    auto failover = run_until_connected(policy, network, session, UPLINK_CELLULAR, milliseconds(5000));
+    INFO("Silent loss failover took " << failover.count() << " ms");
+    CHECK(failover <= failover_bound);
+    CHECK(session.ping());
+    CHECK(network.connects == 2);
+
+    // Coming back, Wi-Fi has to stay better for the hold time,
+    // after the loss recorded during the outage decays below the margin
+    network.set_up(UPLINK_WIFI, true);
+    auto failback = run_until_connected(policy, network, session, UPLINK_WIFI, milliseconds(5000));
+    CHECK(failback >= milliseconds(config.hold_ms));
+    CHECK(failback <= milliseconds(config.hold_ms + 10 * cycle_ms));
+    CHECK(session.ping());
+    CHECK(policy.switches == 3);
+
+    // Link down event: the session moves on the next evaluation, without waiting for the probes
+    network.set_up(UPLINK_WIFI, false);
+    uplink_policy_set_link(&policy, UPLINK_WIFI, false);
+    CHECK(run_until_connected(policy, network, session, UPLINK_CELLULAR, milliseconds(5000)) < milliseconds(cycle_ms));
+    CHECK(session.ping());
+
+    // No uplink at all: the session is dropped rather than left on a dead path
+    network.set_up(UPLINK_CELLULAR, false);
+    for (uint32_t i = 0; i < max_probe_failures; i++) {
+        run_cycle(policy, network, session);
+    }
+    CHECK_FALSE(session.connected);
+    CHECK(policy.active == UPLINK_NONE);
+}
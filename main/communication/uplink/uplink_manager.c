@@ -0,0 +1,298 @@
+#include <string.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_netif.h"
+#include "esp_wifi.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "ping/ping_sock.h"
+#include "lwip/inet.h"
+#include "sdkconfig.h"
+#include "core_mqtt_agent_manager.h"
+#include "pppos_client.h"
+#include "uplink_manager.h"
+
+/* Quality assumed for the cellular uplink when the modem cannot be queried in data mode */
+#define UPLINK_QUALITY_UNKNOWN 50
+
+
+static const char *TAG = "uplink_manager";
+
+static const char *const s_ifkeys[UPLINK_COUNT] = {
+    [UPLINK_WIFI] = "WIFI_STA_DEF",
+    [UPLINK_CELLULAR] = "PPP_DEF",
+};
+static const char *const s_names[UPLINK_COUNT] = {
+    [UPLINK_WIFI] = "wifi",
+    [UPLINK_CELLULAR] = "cellular",
+};
+
+/* Selection state; guarded by s_mutex as it's fed from the event loop and the probe tasks */
+static uplink_policy_t s_policy;
+static uplink_id_t s_route = UPLINK_NONE;           /* Uplink the default route points to */
+static esp_netif_dns_info_t s_dns[UPLINK_COUNT];    /* DNS server received with the address */
+static uint32_t s_last_ok_ms[UPLINK_COUNT];         /* Last time the uplink was known to work */
+static uint32_t s_last_failover_ms;
+static SemaphoreHandle_t s_mutex = NULL;
+
+/* Owned by the manager task */
+static esp_ping_handle_t s_probes[UPLINK_COUNT];
+static TaskHandle_t s_task = NULL;
+
+static uint32_t uplink_now_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static esp_netif_t *uplink_netif(uplink_id_t id)
+{
+    return esp_netif_get_handle_from_ifkey(s_ifkeys[id]);
+}
+
+static void uplink_set_link(uplink_id_t id, bool up, esp_netif_t *netif)
+{
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    uplink_policy_set_link(&s_policy, id, up);
+    if (up) {
+        s_last_ok_ms[id] = uplink_now_ms();
+        esp_netif_get_dns_info(netif, ESP_NETIF_DNS_MAIN, &s_dns[id]);
+    }
+    uplink_id_t route = s_route;
+    xSemaphoreGive(s_mutex);
+
+    /* esp_netif moves the default route to the interface which has just come up, put it back */
+    if (up && route != UPLINK_NONE && route != id) {
+        esp_netif_set_default_netif(uplink_netif(route));
+    }
+    ESP_LOGI(TAG, "%s uplink %s", s_names[id], up ? "up" : "down");
+    xTaskNotifyGive(s_task);
+}
+
+static void on_ip_event(void *arg, esp_event_base_t event_base,
+                        int32_t event_id, void *event_data)
+{
+    switch (event_id) {
+    case IP_EVENT_STA_GOT_IP:
+        uplink_set_link(UPLINK_WIFI, true, ((ip_event_got_ip_t *)event_data)->esp_netif);
+        break;
+    case IP_EVENT_STA_LOST_IP:
+        uplink_set_link(UPLINK_WIFI, false, NULL);
+        break;
+    case IP_EVENT_PPP_GOT_IP:
+        uplink_set_link(UPLINK_CELLULAR, true, ((ip_event_got_ip_t *)event_data)->esp_netif);
+        break;
+    case IP_EVENT_PPP_LOST_IP:
+        uplink_set_link(UPLINK_CELLULAR, false, NULL);
+        break;
+    default:
+        break;
+    }
+}
+
+static void on_wifi_event(void *arg, esp_event_base_t event_base,
+                          int32_t event_id, void *event_data)
+{
+    /* Don't wait for IP_EVENT_STA_LOST_IP, it only comes after the lost IP timer expires */
+    if (event_id == WIFI_EVENT_STA_DISCONNECTED) {
+        uplink_set_link(UPLINK_WIFI, false, NULL);
+    }
+}
+
+static void on_probe_success(esp_ping_handle_t hdl, void *args)
+{
+    uplink_id_t id = (uplink_id_t)(intptr_t)args;
+    uint32_t rtt_ms = 0;
+    esp_ping_get_profile(hdl, ESP_PING_PROF_TIMEGAP, &rtt_ms, sizeof(rtt_ms));
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    uplink_policy_report_probe(&s_policy, id, true, rtt_ms);
+    s_last_ok_ms[id] = uplink_now_ms();
+    xSemaphoreGive(s_mutex);
+}
+
+static void on_probe_timeout(esp_ping_handle_t hdl, void *args)
+{
+    uplink_id_t id = (uplink_id_t)(intptr_t)args;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    uplink_policy_report_probe(&s_policy, id, false, 0);
+    bool usable = uplink_policy_usable(&s_policy, id);
+    xSemaphoreGive(s_mutex);
+
+    if (!usable) {
+        /* Evaluate right away rather than on the next tick */
+        xTaskNotifyGive(s_task);
+    }
+}
+
+/* Probes run only while the interface has an address, bound to that interface */
+static void uplink_update_probe(uplink_id_t id, bool up)
+{
+    if (up && s_probes[id] == NULL) {
+        esp_ping_config_t config = ESP_PING_DEFAULT_CONFIG();
+        ipaddr_aton(CONFIG_PB_UPLINK_PROBE_HOST, &config.target_addr);
+        config.count = ESP_PING_COUNT_INFINITE;
+        config.interval_ms = CONFIG_PB_UPLINK_PROBE_INTERVAL_MS;
+        config.timeout_ms = CONFIG_PB_UPLINK_PROBE_TIMEOUT_MS;
+        config.interface = esp_netif_get_netif_impl_index(uplink_netif(id));
+        esp_ping_callbacks_t callbacks = {
+            .cb_args = (void *)(intptr_t)id,
+            .on_ping_success = on_probe_success,
+            .on_ping_timeout = on_probe_timeout,
+            .on_ping_end = NULL,
+        };
+        if (esp_ping_new_session(&config, &callbacks, &s_probes[id]) != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to create %s probe", s_names[id]);
+            s_probes[id] = NULL;
+            return;
+        }
+        esp_ping_start(s_probes[id]);
+    } else if (!up && s_probes[id] != NULL) {
+        esp_ping_stop(s_probes[id]);
+        esp_ping_delete_session(s_probes[id]);
+        s_probes[id] = NULL;
+    }
+}
+
+static void uplink_apply_route(uplink_id_t route)
+{
+    if (route != UPLINK_NONE) {
+        esp_netif_t *netif = uplink_netif(route);
+        esp_netif_set_default_netif(netif);
+        /* lwIP keeps one set of DNS servers, the last interface to get an address has set them */
+        xSemaphoreTake(s_mutex, portMAX_DELAY);
+        esp_netif_dns_info_t dns = s_dns[route];
+        xSemaphoreGive(s_mutex);
+        if (dns.ip.u_addr.ip4.addr != 0) {
+            esp_netif_set_dns_info(netif, ESP_NETIF_DNS_MAIN, &dns);
+        }
+        ESP_LOGI(TAG, "Routing through %s", s_names[route]);
+    } else {
+        ESP_LOGW(TAG, "No usable uplink");
+    }
+    /* The radio must not sleep (PB_MODEM_POWER_SAVING) while cellular carries the session.
+     * Behind Wi-Fi it may: losing Wi-Fi drops the session, whose hold wakes the radio up */
+    pppos_radio_hold(PPPOS_RADIO_HOLD_UPLINK, route == UPLINK_CELLULAR);
+    /* The TLS socket is bound to the old route, make the MQTT session reconnect */
+    vCoreMqttAgentManagerUplinkChanged(route != UPLINK_NONE ? pdTRUE : pdFALSE);
+}
+
+static void uplink_manager_task(void *arg)
+{
+    uint32_t last_cellular_query_ms = 0;
+    bool cellular_queried = false;
+    uplink_id_t route = UPLINK_NONE;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONFIG_PB_UPLINK_PROBE_INTERVAL_MS));
+        uint32_t now = uplink_now_ms();
+
+        /* Query the signal outside of the lock, AT commands take a while */
+        wifi_ap_record_t ap_info;
+        int wifi_quality = -1;
+        if (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK) {
+            wifi_quality = uplink_quality_from_wifi_rssi(ap_info.rssi);
+        }
+        int cellular_quality = -1;
+        if (!cellular_queried || (uint32_t)(now - last_cellular_query_ms) >= CONFIG_PB_UPLINK_CELLULAR_QUALITY_MS) {
+            pppos_link_quality_t quality;
+            esp_err_t err = pppos_get_link_quality(&quality);
+            if (err == ESP_OK) {
+                cellular_quality = uplink_quality_from_csq(quality.rssi);
+            } else if (err == ESP_ERR_NOT_SUPPORTED) {
+                cellular_quality = UPLINK_QUALITY_UNKNOWN;
+            }
+            cellular_queried = true;
+            last_cellular_query_ms = now;
+        }
+
+        bool up[UPLINK_COUNT];
+        xSemaphoreTake(s_mutex, portMAX_DELAY);
+        if (wifi_quality >= 0) {
+            uplink_policy_set_quality(&s_policy, UPLINK_WIFI, wifi_quality);
+        }
+        if (cellular_quality >= 0) {
+            uplink_policy_set_quality(&s_policy, UPLINK_CELLULAR, cellular_quality);
+        }
+        for (int id = 0; id < UPLINK_COUNT; id++) {
+            up[id] = s_policy.metrics[id].up;
+        }
+        uplink_id_t previous = s_policy.active;
+        uplink_id_t next = uplink_policy_evaluate(&s_policy, now);
+        if (previous != UPLINK_NONE && next != previous && !uplink_policy_usable(&s_policy, previous)) {
+            s_last_failover_ms = now - s_last_ok_ms[previous];
+            ESP_LOGW(TAG, "%s uplink lost, failing over after %" PRIu32 " ms", s_names[previous], s_last_failover_ms);
+        }
+        s_route = next;
+        xSemaphoreGive(s_mutex);
+
+        for (int id = 0; id < UPLINK_COUNT; id++) {
+            uplink_update_probe(id, up[id]);
+        }
+
+        if (next != route) {
+            route = next;
+            uplink_apply_route(route);
+        } else if (route != UPLINK_NONE && esp_netif_get_default_netif() != uplink_netif(route)) {
+            esp_netif_set_default_netif(uplink_netif(route));
+        }
+    }
+}
+
+esp_err_t uplink_manager_start(void)
+{
+    if (s_mutex != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    for (int id = 0; id < UPLINK_COUNT; id++) {
+        if (uplink_netif(id) == NULL) {
+            ESP_LOGE(TAG, "No %s interface, create it before starting the uplink manager", s_names[id]);
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+
+    const uplink_policy_config_t config = {
+        .hysteresis = CONFIG_PB_UPLINK_HYSTERESIS,
+        .hold_ms = CONFIG_PB_UPLINK_HOLD_MS,
+        .max_probe_failures = CONFIG_PB_UPLINK_MAX_PROBE_FAILURES,
+        .bias = {
+            [UPLINK_WIFI] = 0,
+            [UPLINK_CELLULAR] = CONFIG_PB_UPLINK_CELLULAR_BIAS,
+        },
+    };
+    uplink_policy_init(&s_policy, &config);
+
+    s_mutex = xSemaphoreCreateMutex();
+    if (s_mutex == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreate(uplink_manager_task, "uplink_manager", CONFIG_PB_UPLINK_TASK_STACK_SIZE, NULL,
+                    CONFIG_PB_UPLINK_TASK_PRIORITY, &s_task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t err = esp_event_handler_register(IP_EVENT, ESP_EVENT_ANY_ID, &on_ip_event, NULL);
+    if (err == ESP_OK) {
+        err = esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &on_wifi_event, NULL);
+    }
+    return err;
+}
+
+esp_err_t uplink_manager_get_status(uplink_status_t *status)
+{
+    if (status == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    status->active = s_policy.active;
+    status->switches = s_policy.switches;
+    status->last_failover_ms = s_last_failover_ms;
+    memcpy(status->metrics, s_policy.metrics, sizeof(status->metrics));
+    xSemaphoreGive(s_mutex);
+    return ESP_OK;
+}
@@ -0,0 +1,24 @@
+// uplink_manager.h
+#ifndef UPLINK_MANAGER_H
+#define UPLINK_MANAGER_H
+
+#include "esp_err.h"
+#include "uplink_policy.h"
+
+/* Snapshot of the uplink selection */
+typedef struct {
+    uplink_id_t active;
+    uint32_t switches;                          /* Number of times the MQTT session was moved */
+    uint32_t last_failover_ms;                  /* Time from losing the active uplink to routing through another */
+    uplink_metrics_t metrics[UPLINK_COUNT];
+} uplink_status_t;
+
+/*
+ * Starts the uplink manager, which probes the Wi-Fi station and PPP interfaces,
+ * routes through the best one and moves the MQTT session when it changes.
+ * Both interfaces have to be created before (app_wifi_init() and pppos_start()).
+ */
+esp_err_t uplink_manager_start(void);
+esp_err_t uplink_manager_get_status(uplink_status_t *status);
+
+#endif // UPLINK_MANAGER_H
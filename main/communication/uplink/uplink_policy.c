@@ -0,0 +1,138 @@
+#include <string.h>
+#include "uplink_policy.h"
+
+/* Weight of a new sample in the smoothed loss and RTT (1/4) */
+#define UPLINK_EWMA_SHIFT 2
+/* RTT contributes at most this much to the score (at 1 point per 10 ms) */
+#define UPLINK_RTT_PENALTY_MAX 100
+/* AT+CSQ reports 99 when there is no signal */
+#define UPLINK_CSQ_UNKNOWN 99
+
+static uint32_t uplink_ewma(uint32_t average, uint32_t sample)
+{
+    return (average * ((1 << UPLINK_EWMA_SHIFT) - 1) + sample) >> UPLINK_EWMA_SHIFT;
+}
+
+void uplink_policy_init(uplink_policy_t *policy, const uplink_policy_config_t *config)
+{
+    memset(policy, 0, sizeof(*policy));
+    policy->config = *config;
+    policy->active = UPLINK_NONE;
+    policy->candidate = UPLINK_NONE;
+}
+
+void uplink_policy_set_link(uplink_policy_t *policy, uplink_id_t id, bool up)
+{
+    uplink_metrics_t *metrics = &policy->metrics[id];
+    if (up && !metrics->up) {
+        metrics->loss = 0;
+        metrics->rtt_ms = 0;
+        metrics->probe_failures = 0;
+    }
+    metrics->up = up;
+}
+
+void uplink_policy_set_quality(uplink_policy_t *policy, uplink_id_t id, uint8_t quality)
+{
+    policy->metrics[id].quality = quality > 100 ? 100 : quality;
+}
+
+void uplink_policy_report_probe(uplink_policy_t *policy, uplink_id_t id, bool ok, uint32_t rtt_ms)
+{
+    uplink_metrics_t *metrics = &policy->metrics[id];
+    metrics->loss = uplink_ewma(metrics->loss, ok ? 0 : 100);
+    if (ok) {
+        metrics->probe_failures = 0;
+        metrics->rtt_ms = metrics->rtt_ms == 0 ? rtt_ms : uplink_ewma(metrics->rtt_ms, rtt_ms);
+    } else {
+        metrics->probe_failures++;
+    }
+}
+
+bool uplink_policy_usable(const uplink_policy_t *policy, uplink_id_t id)
+{
+    if (id == UPLINK_NONE) {
+        return false;
+    }
+    const uplink_metrics_t *metrics = &policy->metrics[id];
+    return metrics->up && metrics->probe_failures < policy->config.max_probe_failures;
+}
+
+int32_t uplink_policy_score(const uplink_policy_t *policy, uplink_id_t id)
+{
+    if (!uplink_policy_usable(policy, id)) {
+        return UPLINK_SCORE_UNUSABLE;
+    }
+    const uplink_metrics_t *metrics = &policy->metrics[id];
+    uint32_t rtt_penalty = metrics->rtt_ms / 10;
+    if (rtt_penalty > UPLINK_RTT_PENALTY_MAX) {
+        rtt_penalty = UPLINK_RTT_PENALTY_MAX;
+    }
+    return policy->config.bias[id] + metrics->quality - 2 * (int32_t)metrics->loss - (int32_t)rtt_penalty;
+}
+
+uplink_id_t uplink_policy_evaluate(uplink_policy_t *policy, uint32_t now_ms)
+{
+    uplink_id_t best = UPLINK_NONE;
+    int32_t best_score = UPLINK_SCORE_UNUSABLE;
+    for (int id = 0; id < UPLINK_COUNT; id++) {
+        if (id == policy->active || !uplink_policy_usable(policy, id)) {
+            continue;
+        }
+        int32_t score = uplink_policy_score(policy, id);
+        if (best == UPLINK_NONE || score > best_score) {
+            best = id;
+            best_score = score;
+        }
+    }
+
+    if (!uplink_policy_usable(policy, policy->active)) {
+        /* Failover: no hold time, the active uplink cannot carry traffic anyway */
+        policy->candidate = UPLINK_NONE;
+        if (best != policy->active) {
+            policy->active = best;
+            if (best != UPLINK_NONE) {
+                policy->switches++;
+            }
+        }
+        return policy->active;
+    }
+
+    if (best != UPLINK_NONE && best_score >= uplink_policy_score(policy, policy->active) + policy->config.hysteresis) {
+        if (policy->candidate != best) {
+            policy->candidate = best;
+            policy->candidate_since_ms = now_ms;
+        } else if ((uint32_t)(now_ms - policy->candidate_since_ms) >= policy->config.hold_ms) {
+            policy->active = best;
+            policy->candidate = UPLINK_NONE;
+            policy->switches++;
+        }
+    } else {
+        policy->candidate = UPLINK_NONE;
+    }
+    return policy->active;
+}
+
+uint8_t uplink_quality_from_wifi_rssi(int rssi_dbm)
+{
+    /* -100 dBm and below is unusable, -50 dBm and above is excellent */
+    if (rssi_dbm <= -100) {
+        return 0;
+    }
+    if (rssi_dbm >= -50) {
+        return 100;
+    }
+    return (uint8_t)(2 * (rssi_dbm + 100));
+}
+
+uint8_t uplink_quality_from_csq(int csq)
+{
+    if (csq < 0 || csq == UPLINK_CSQ_UNKNOWN) {
+        return 0;
+    }
+    if (csq > 31) {
+        csq = 31;
+    }
+    /* CSQ 0..31 maps linearly to -113..-51 dBm */
+    return (uint8_t)(csq * 100 / 31);
+}
@@ -0,0 +1,74 @@
+// uplink_policy.h
+#ifndef UPLINK_POLICY_H
+#define UPLINK_POLICY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Score of an uplink which cannot carry traffic */
+#define UPLINK_SCORE_UNUSABLE INT32_MIN
+
+typedef enum {
+    UPLINK_NONE = -1,
+    UPLINK_WIFI = 0,
+    UPLINK_CELLULAR,
+    UPLINK_COUNT,
+} uplink_id_t;
+
+typedef struct {
+    int32_t hysteresis;             /* Score margin a candidate has to beat the active uplink by */
+    uint32_t hold_ms;               /* ... continuously for this long before we switch to it */
+    uint32_t max_probe_failures;    /* Consecutive failed probes which make an uplink unusable */
+    int32_t bias[UPLINK_COUNT];     /* Static preference added to the score (e.g. metered cellular) */
+} uplink_policy_config_t;
+
+typedef struct {
+    bool up;                        /* Interface has an IP address */
+    uint8_t quality;                /* Signal quality 0..100 */
+    uint8_t loss;                   /* Smoothed probe loss 0..100 */
+    uint32_t rtt_ms;                /* Smoothed probe round trip time, 0 until the first reply */
+    uint32_t probe_failures;        /* Consecutive failed probes */
+} uplink_metrics_t;
+
+/*
+ * Uplink selection with hysteresis. Has no platform dependencies, the caller feeds
+ * link events, signal quality and probe results and calls uplink_policy_evaluate()
+ * periodically. Not thread safe.
+ */
+typedef struct {
+    uplink_policy_config_t config;
+    uplink_metrics_t metrics[UPLINK_COUNT];
+    uplink_id_t active;
+    uplink_id_t candidate;
+    uint32_t candidate_since_ms;
+    uint32_t switches;
+} uplink_policy_t;
+
+void uplink_policy_init(uplink_policy_t *policy, const uplink_policy_config_t *config);
+/* Interface got (up = true) or lost its IP address; a new link starts with clean probe history */
+void uplink_policy_set_link(uplink_policy_t *policy, uplink_id_t id, bool up);
+void uplink_policy_set_quality(uplink_policy_t *policy, uplink_id_t id, uint8_t quality);
+void uplink_policy_report_probe(uplink_policy_t *policy, uplink_id_t id, bool ok, uint32_t rtt_ms);
+bool uplink_policy_usable(const uplink_policy_t *policy, uplink_id_t id);
+int32_t uplink_policy_score(const uplink_policy_t *policy, uplink_id_t id);
+/*
+ * Picks the uplink to route through. Leaves an unusable uplink immediately, otherwise
+ * switches only to a candidate which stays better by the hysteresis margin for hold_ms.
+ * Returns the active uplink, UPLINK_NONE if none is usable.
+ */
+uplink_id_t uplink_policy_evaluate(uplink_policy_t *policy, uint32_t now_ms);
+
+/* Maps the Wi-Fi RSSI (dBm) to 0..100 */
+uint8_t uplink_quality_from_wifi_rssi(int rssi_dbm);
+/* Maps the AT+CSQ rssi (0..31, 99 unknown) to 0..100 */
+uint8_t uplink_quality_from_csq(int csq);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // UPLINK_POLICY_H
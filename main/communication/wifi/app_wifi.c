@@ -12,6 +12,8 @@
 #include <esp_wifi.h>
 #include <esp_event.h>
 #include <esp_log.h>
+#include <esp_timer.h>
+#include <inttypes.h>
 #include <esp_idf_version.h>
 #if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL( 4, 1, 0 )
 /* Features supported in 4.1+ */
@@ -49,6 +51,113 @@ static EventGroupHandle_t wifi_event_group;
 #define CREDENTIALS_NAMESPACE    "creds"
 #define RANDOM_NVS_KEY           "random"
 
+#define FAST_RECONNECT_NAMESPACE "wifi_fast"
+#define FAST_RECONNECT_NVS_KEY   "ap"
+
+#define QR_CACHE_NAMESPACE       "wifi_qr"
+#define QR_CACHE_KEY_NVS_KEY     "key"
+#define QR_CACHE_CODE_NVS_KEY    "code"
+#define QR_MAX_VERSION           10
+
+/* Access point of the last connection that got an IP address */
+typedef struct
+{
+    uint8_t ssid[ 32 ];
+    uint8_t bssid[ 6 ];
+    uint8_t channel; /* 0 when nothing is cached */
+} app_wifi_ap_cache_t;
+
+static esp_timer_handle_t reconnect_timer;
+static uint32_t reconnect_attempts;
+static int64_t disconnected_us;
+static bool directed_connect;
+static app_wifi_reconnect_stats_t reconnect_stats;
+/* Guards the reconnect attempts, directed_connect and the stats: the attempts
+ * are made from the event handler and from the esp_timer task */
+static portMUX_TYPE reconnect_lock = portMUX_INITIALIZER_UNLOCKED;
+
+#ifdef CONFIG_APP_WIFI_FAST_RECONNECT
+    static app_wifi_ap_cache_t ap_cache;
+    static app_wifi_ap_cache_t connected_ap;
+#endif
+
+#ifdef CONFIG_APP_WIFI_PROV_SHOW_QR
+
+/* The QR code of the payload is cached in NVS and only encoded when it changes */
+static void app_wifi_show_qr( const char * payload )
+{
+    esp_qrcode_config_t cfg = ESP_QRCODE_CONFIG_DEFAULT();
+    const size_t max_len = ESP_QRCODE_BUFFER_LEN_FOR_VERSION( QR_MAX_VERSION );
+    char key[ 170 ];
+    char cached_key[ 170 ];
+    size_t len = sizeof( cached_key );
+    bool cached = false;
+    bool opened;
+    nvs_handle_t handle = 0;
+    uint8_t * qrcode;
+    esp_err_t err = ESP_OK;
+
+    cfg.max_qrcode_version = QR_MAX_VERSION;
+    cfg.qrcode_version = CONFIG_APP_WIFI_PROV_QR_VERSION;
+    cfg.qrcode_mask = CONFIG_APP_WIFI_PROV_QR_MASK + 1; /* -1 is ESP_QRCODE_MASK_AUTO */
+
+    qrcode = malloc( max_len );
+
+    if( !qrcode )
+    {
+        ESP_LOGW( TAG, "No memory for the QR code." );
+        return;
+    }
+
+    /* A cached code is only valid for the same payload and encoder settings */
+    snprintf( key, sizeof( key ), "%d/%d/%s", cfg.qrcode_version, cfg.qrcode_mask, payload );
+    opened = ( nvs_open( QR_CACHE_NAMESPACE, NVS_READWRITE, &handle ) == ESP_OK );
+
+    if( opened && ( nvs_get_str( handle, QR_CACHE_KEY_NVS_KEY, cached_key, &len ) == ESP_OK ) && ( strcmp( key, cached_key ) == 0 ) )
+    {
+        len = max_len;
+        cached = ( nvs_get_blob( handle, QR_CACHE_CODE_NVS_KEY, qrcode, &len ) == ESP_OK ) &&
+                 ( qrcode[ 0 ] >= 21 ) && ( qrcode[ 0 ] <= QR_MAX_VERSION * 4 + 17 ) &&
+                 ( len == esp_qrcode_get_len( qrcode ) );
+    }
+
+    if( !cached )
+    {
+        if( esp_qrcode_encode( &cfg, payload, qrcode ) != ESP_OK )
+        {
+            ESP_LOGW( TAG, "Cannot encode the QR code." );
+            qrcode[ 0 ] = 0;
+        }
+        else if( opened )
+        {
+            /* The code first, so that the key never describes an older code */
+            if( ( ( err = nvs_set_blob( handle, QR_CACHE_CODE_NVS_KEY, qrcode, esp_qrcode_get_len( qrcode ) ) ) == ESP_OK ) &&
+                ( ( err = nvs_set_str( handle, QR_CACHE_KEY_NVS_KEY, key ) ) == ESP_OK ) )
+            {
+                err = nvs_commit( handle );
+            }
+
+            if( err != ESP_OK )
+            {
+                ESP_LOGW( TAG, "Failed to cache the QR code: %s", esp_err_to_name( err ) );
+            }
+        }
+    }
+
+    if( opened )
+    {
+        nvs_close( handle );
+    }
+
+    if( qrcode[ 0 ] != 0 )
+    {
+        esp_qrcode_print_console( qrcode );
+    }
+
+    free( qrcode );
+}
+#endif /* CONFIG_APP_WIFI_PROV_SHOW_QR */
+
 static void app_wifi_print_qr( const char * name,
                                const char * pop,
                                const char * transport )
@@ -65,11 +174,198 @@ static void app_wifi_print_qr( const char * name,
               PROV_QR_VERSION, name, pop, transport );
     #ifdef CONFIG_APP_WIFI_PROV_SHOW_QR
         ESP_LOGI( TAG, "Scan this QR code from the phone app for Provisioning." );
-        qrcode_display( payload );
+        app_wifi_show_qr( payload );
     #endif /* CONFIG_APP_WIFI_PROV_SHOW_QR */
     ESP_LOGI( TAG, "If QR code is not visible, copy paste the below URL in a browser.\n%s?data=%s", QRCODE_BASE_URL, payload );
 }
 
+#ifdef CONFIG_APP_WIFI_FAST_RECONNECT
+static void ap_cache_load( void )
+{
+    nvs_handle_t handle;
+    size_t len = sizeof( ap_cache );
+
+    if( nvs_open( FAST_RECONNECT_NAMESPACE, NVS_READONLY, &handle ) == ESP_OK )
+    {
+        if( ( nvs_get_blob( handle, FAST_RECONNECT_NVS_KEY, &ap_cache, &len ) != ESP_OK ) || ( len != sizeof( ap_cache ) ) )
+        {
+            memset( &ap_cache, 0, sizeof( ap_cache ) );
+        }
+
+        nvs_close( handle );
+    }
+}
+
+static void ap_cache_store( const app_wifi_ap_cache_t * ap )
+{
+    nvs_handle_t handle;
+    esp_err_t err;
+
+    /* Most reconnects are to the same access point, don't wear the flash for them */
+    if( memcmp( ap, &ap_cache, sizeof( ap_cache ) ) == 0 )
+    {
+        return;
+    }
+
+    ap_cache = *ap;
+
+    if( ( err = nvs_open( FAST_RECONNECT_NAMESPACE, NVS_READWRITE, &handle ) ) == ESP_OK )
+    {
+        if( ( err = nvs_set_blob( handle, FAST_RECONNECT_NVS_KEY, &ap_cache, sizeof( ap_cache ) ) ) == ESP_OK )
+        {
+            err = nvs_commit( handle );
+        }
+
+        nvs_close( handle );
+    }
+
+    if( err != ESP_OK )
+    {
+        ESP_LOGW( TAG, "Failed to cache the access point: %s", esp_err_to_name( err ) );
+    }
+}
+#endif /* CONFIG_APP_WIFI_FAST_RECONNECT */
+
+/* The first attempt goes straight to the cached access point, on its channel.
+ * Later attempts, and all of them without a cache, scan every channel. */
+static void app_wifi_connect_attempt( void )
+{
+    wifi_config_t wifi_config;
+    bool directed = false;
+    uint32_t attempts;
+
+    taskENTER_CRITICAL( &reconnect_lock );
+    attempts = reconnect_attempts;
+    taskEXIT_CRITICAL( &reconnect_lock );
+
+    if( esp_wifi_get_config( WIFI_IF_STA, &wifi_config ) == ESP_OK )
+    {
+        #ifdef CONFIG_APP_WIFI_FAST_RECONNECT
+            directed = ( attempts == 0 ) && ( ap_cache.channel != 0 ) &&
+                       ( memcmp( ap_cache.ssid, wifi_config.sta.ssid, sizeof( ap_cache.ssid ) ) == 0 );
+        #endif
+
+        wifi_sta_config_t sta = wifi_config.sta;
+
+        if( directed )
+        {
+            #ifdef CONFIG_APP_WIFI_FAST_RECONNECT
+                wifi_config.sta.bssid_set = true;
+                memcpy( wifi_config.sta.bssid, ap_cache.bssid, sizeof( ap_cache.bssid ) );
+                wifi_config.sta.channel = ap_cache.channel;
+                wifi_config.sta.scan_method = WIFI_FAST_SCAN;
+            #endif
+        }
+        else
+        {
+            wifi_config.sta.bssid_set = false;
+            wifi_config.sta.channel = 0;
+            wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+            wifi_config.sta.sort_method = WIFI_CONNECT_AP_BY_SIGNAL;
+        }
+
+        /* The config lives in flash, only write it when it changes */
+        if( memcmp( &sta, &wifi_config.sta, sizeof( sta ) ) != 0 )
+        {
+            if( esp_wifi_set_config( WIFI_IF_STA, &wifi_config ) != ESP_OK )
+            {
+                ESP_LOGW( TAG, "Failed to set the scan parameters" );
+            }
+        }
+    }
+
+    taskENTER_CRITICAL( &reconnect_lock );
+    directed_connect = directed;
+    reconnect_attempts++;
+    taskEXIT_CRITICAL( &reconnect_lock );
+    esp_wifi_connect();
+}
+
+static void app_wifi_reset_attempts( void )
+{
+    taskENTER_CRITICAL( &reconnect_lock );
+    reconnect_attempts = 0;
+    taskEXIT_CRITICAL( &reconnect_lock );
+}
+
+static void reconnect_timer_callback( void * arg )
+{
+    ( void ) arg;
+
+    /* The timer may have fired just before the link came up */
+    if( ( xEventGroupGetBits( wifi_event_group ) & WIFI_CONNECTED_EVENT ) == 0 )
+    {
+        app_wifi_connect_attempt();
+    }
+}
+
+static void app_wifi_schedule_reconnect( void )
+{
+    uint32_t delay_ms = 0;
+    uint32_t attempts;
+    esp_err_t err;
+
+    taskENTER_CRITICAL( &reconnect_lock );
+    attempts = reconnect_attempts;
+    taskEXIT_CRITICAL( &reconnect_lock );
+
+    /* The directed connect and the first full scan go out right away, later scans back off */
+    if( attempts >= 2 )
+    {
+        uint32_t shift = attempts - 2;
+        delay_ms = CONFIG_APP_WIFI_RECONNECT_BACKOFF_MAX_MS;
+
+        if( ( shift < 16 ) && ( ( ( uint32_t ) CONFIG_APP_WIFI_RECONNECT_BACKOFF_MIN_MS << shift ) < delay_ms ) )
+        {
+            delay_ms = ( uint32_t ) CONFIG_APP_WIFI_RECONNECT_BACKOFF_MIN_MS << shift;
+        }
+    }
+
+    if( delay_ms == 0 )
+    {
+        app_wifi_connect_attempt();
+    }
+    else
+    {
+        ESP_LOGI( TAG, "Connecting to the AP again in %" PRIu32 " ms...", delay_ms );
+        err = esp_timer_start_once( reconnect_timer, ( uint64_t ) delay_ms * 1000 );
+
+        /* ESP_ERR_INVALID_STATE: an attempt is already pending */
+        if( ( err != ESP_OK ) && ( err != ESP_ERR_INVALID_STATE ) )
+        {
+            /* Don't stop reconnecting, try right away instead */
+            ESP_LOGE( TAG, "Failed to start the reconnect timer: %s", esp_err_to_name( err ) );
+            app_wifi_connect_attempt();
+        }
+    }
+}
+
+static void app_wifi_report_connected( void )
+{
+    uint32_t latency_ms = ( uint32_t ) ( ( esp_timer_get_time() - disconnected_us ) / 1000 );
+    bool directed;
+    uint32_t attempts;
+    uint32_t avg_ms;
+
+    /* A backed off attempt may still be pending */
+    esp_timer_stop( reconnect_timer );
+
+    taskENTER_CRITICAL( &reconnect_lock );
+    reconnect_stats.avg_ms = ( reconnect_stats.connections == 0 ) ? latency_ms :
+                             reconnect_stats.avg_ms - ( reconnect_stats.avg_ms >> 2 ) + ( latency_ms >> 2 );
+    reconnect_stats.connections++;
+    reconnect_stats.directed += directed_connect ? 1 : 0;
+    reconnect_stats.last_ms = latency_ms;
+    directed = directed_connect;
+    attempts = reconnect_attempts;
+    avg_ms = reconnect_stats.avg_ms;
+    reconnect_attempts = 0;
+    taskEXIT_CRITICAL( &reconnect_lock );
+
+    ESP_LOGI( TAG, "Got IP %" PRIu32 " ms after losing the link (%s, %" PRIu32 " attempts, avg %" PRIu32 " ms)",
+              latency_ms, directed ? "directed connect" : "full scan", attempts, avg_ms );
+}
+
 /* Event handler for catching system events */
 static void event_handler( void * arg,
                            esp_event_base_t event_base,
@@ -119,19 +415,43 @@ static void event_handler( void * arg,
     }
     else if( ( event_base == WIFI_EVENT ) && ( event_id == WIFI_EVENT_STA_START ) )
     {
-        esp_wifi_connect();
+        disconnected_us = esp_timer_get_time();
+        app_wifi_reset_attempts();
+        app_wifi_connect_attempt();
+    }
+    else if( ( event_base == WIFI_EVENT ) && ( event_id == WIFI_EVENT_STA_CONNECTED ) )
+    {
+        #ifdef CONFIG_APP_WIFI_FAST_RECONNECT
+            wifi_event_sta_connected_t * event = ( wifi_event_sta_connected_t * ) event_data;
+            memset( &connected_ap, 0, sizeof( connected_ap ) );
+            memcpy( connected_ap.ssid, event->ssid, event->ssid_len < sizeof( connected_ap.ssid ) ? event->ssid_len : sizeof( connected_ap.ssid ) );
+            memcpy( connected_ap.bssid, event->bssid, sizeof( connected_ap.bssid ) );
+            connected_ap.channel = event->channel;
+        #endif
     }
     else if( ( event_base == IP_EVENT ) && ( event_id == IP_EVENT_STA_GOT_IP ) )
     {
         ip_event_got_ip_t * event = ( ip_event_got_ip_t * ) event_data;
         ESP_LOGI( TAG, "Connected with IP Address:" IPSTR, IP2STR( &event->ip_info.ip ) );
+        app_wifi_report_connected();
+        #ifdef CONFIG_APP_WIFI_FAST_RECONNECT
+            ap_cache_store( &connected_ap );
+        #endif
         /* Signal main application to continue execution */
         xEventGroupSetBits( wifi_event_group, WIFI_CONNECTED_EVENT );
     }
     else if( ( event_base == WIFI_EVENT ) && ( event_id == WIFI_EVENT_STA_DISCONNECTED ) )
     {
-        ESP_LOGI( TAG, "Disconnected. Connecting to the AP again..." );
-        esp_wifi_connect();
+        /* Latency is measured from the loss of the link, not from the failed attempts */
+        if( xEventGroupClearBits( wifi_event_group, WIFI_CONNECTED_EVENT ) & WIFI_CONNECTED_EVENT )
+        {
+            disconnected_us = esp_timer_get_time();
+            app_wifi_reset_attempts();
+        }
+
+        ESP_LOGI( TAG, "Disconnected (reason %d). Connecting to the AP again...",
+                  ( ( wifi_event_sta_disconnected_t * ) event_data )->reason );
+        app_wifi_schedule_reconnect();
     }
 }
 
@@ -275,6 +595,17 @@ void app_wifi_init( void )
     #endif
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK( esp_wifi_init( &cfg ) );
+
+    const esp_timer_create_args_t reconnect_timer_args =
+    {
+        .callback = reconnect_timer_callback,
+        .name     = "wifi_reconnect",
+    };
+    ESP_ERROR_CHECK( esp_timer_create( &reconnect_timer_args, &reconnect_timer ) );
+
+    #ifdef CONFIG_APP_WIFI_FAST_RECONNECT
+        ap_cache_load();
+    #endif
 }
 
 esp_err_t app_wifi_start( app_wifi_pop_type_t pop_type )
@@ -406,11 +737,18 @@ esp_err_t app_wifi_start( app_wifi_pop_type_t pop_type )
         wifi_init_sta();
     }
 
-    /* Wait for Wi-Fi connection */
-    vWaitOnWifiConnected();
+    /* Association and DHCP go on in the background, use
+     * vWaitOnWifiConnected() to wait for them. */
     return ESP_OK;
 }
 
+void app_wifi_get_reconnect_stats( app_wifi_reconnect_stats_t * stats )
+{
+    taskENTER_CRITICAL( &reconnect_lock );
+    *stats = reconnect_stats;
+    taskEXIT_CRITICAL( &reconnect_lock );
+}
+
 void vWaitOnWifiConnected( void )
 {
     xEventGroupWaitBits( wifi_event_group, WIFI_CONNECTED_EVENT, false, true, portMAX_DELAY );
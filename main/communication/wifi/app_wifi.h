@@ -6,6 +6,7 @@
  * CONDITIONS OF ANY KIND, either express or implied.
  */
 #pragma once
+#include <stdint.h>
 #include <esp_err.h>
 
 /* *INDENT-OFF* */
@@ -23,12 +24,22 @@ typedef enum
     POP_TYPE_RANDOM
 } app_wifi_pop_type_t;
 
+/** Time to get an IP address, from Wi-Fi start or from the loss of the link */
+typedef struct
+{
+    uint32_t connections; /* Connections that got an IP address */
+    uint32_t directed;    /* Connections made straight to the cached access point */
+    uint32_t last_ms;
+    uint32_t avg_ms;      /* Moving average */
+} app_wifi_reconnect_stats_t;
+
 void app_wifi_init();
 esp_err_t app_wifi_start( app_wifi_pop_type_t pop_type );
 
 esp_err_t app_wifi_connect();
 bool app_wifi_is_connected();
 void vWaitOnWifiConnected( void );
+void app_wifi_get_reconnect_stats( app_wifi_reconnect_stats_t * stats );
 
 /* *INDENT-OFF* */
 #ifdef __cplusplus
@@ -8,6 +8,7 @@
 #include "app_driver.h"
 #include "esp_timer.h"
 #include "esp_err.h"
+#include "pb_trace.h"
 
 static const char *TAG = "barrier_driver";
 
@@ -56,6 +57,7 @@ void barrier_driver_init(void)
 void barrier_driver_open(void)
 {
     ESP_LOGI(TAG, "Opening the barrier.");
+    PB_TRACE_BEGIN(PB_TRACE_BARRIER_OPEN, 0);
 
     // Activate the motor to open the barrier
     mcpwm_set_duty(MCPWM_UNIT_0, MCPWM_TIMER_0, MCPWM_OPR_A, 100.0);
@@ -83,6 +85,7 @@ void barrier_driver_open(void)
         {
             ESP_LOGE(TAG, "Timeout occurred while opening the barrier.");
             stop_motor();
+            PB_TRACE_END(PB_TRACE_BARRIER_OPEN, ESP_ERR_TIMEOUT);
             return;
         }
         vTaskDelay(pdMS_TO_TICKS(10));
@@ -91,12 +94,14 @@ void barrier_driver_open(void)
     // Stop the motor
     stop_motor();
     app_driver_led_unlocked();
+    PB_TRACE_END(PB_TRACE_BARRIER_OPEN, ESP_OK);
     ESP_LOGI(TAG, "Barrier opened.");
 }
 
 void barrier_driver_close(void)
 {
     ESP_LOGI(TAG, "Closing the barrier.");
+    PB_TRACE_BEGIN(PB_TRACE_BARRIER_CLOSE, 0);
 
     // Activate the motor to close the barrier
     mcpwm_set_duty(MCPWM_UNIT_0, MCPWM_TIMER_0, MCPWM_OPR_A, 0.0);
@@ -123,6 +128,7 @@ void barrier_driver_close(void)
         {
             ESP_LOGE(TAG, "Timeout occurred while closing the barrier.");
             stop_motor();
+            PB_TRACE_END(PB_TRACE_BARRIER_CLOSE, ESP_ERR_TIMEOUT);
             return;
         }
         vTaskDelay(pdMS_TO_TICKS(10));
@@ -131,9 +137,21 @@ void barrier_driver_close(void)
     // Stop the motor
     stop_motor();
     app_driver_led_locked();
+    PB_TRACE_END(PB_TRACE_BARRIER_CLOSE, ESP_OK);
     ESP_LOGI(TAG, "Barrier closed.");
 }
 
+// The limit switches are active low
+bool barrier_driver_is_locked(void)
+{
+    return gpio_get_level(LOCKED_LIMIT_SWITCH_GPIO) == 0;
+}
+
+bool barrier_driver_is_unlocked(void)
+{
+    return gpio_get_level(UNLOCKED_LIMIT_SWITCH_GPIO) == 0;
+}
+
 void barrier_driver_test_limit_switches(void)
 {
     ESP_LOGI(TAG, "Testing limit switches.");
@@ -4,6 +4,7 @@
 #include <esp_timer.h>
 #include "hcsr04_sensor.h"
 #include "esp_log.h"
+#include "pb_trace.h"
 
 #define TRIGGER_LOW_DELAY_US 2
 #define TRIGGER_HIGH_DELAY_US 10
@@ -46,6 +47,7 @@ esp_err_t hcsr04_sensor_measure_raw(const hcsr04_sensor_t *dev, uint32_t max_tim
 {
     CHECK_ARG(dev && time_us);
 
+    PB_TRACE_BEGIN(PB_TRACE_HCSR04_MEASURE, dev->trigger_pin);
     gpio_set_level(dev->trigger_pin, 0);
     esp_rom_delay_us(TRIGGER_LOW_DELAY_US);
     gpio_set_level(dev->trigger_pin, 1);
@@ -55,6 +57,7 @@ esp_err_t hcsr04_sensor_measure_raw(const hcsr04_sensor_t *dev, uint32_t max_tim
     int64_t start_time = esp_timer_get_time();
     while (gpio_get_level(dev->echo_pin) == 0) {
         if (timeout_expired(start_time, PING_TIMEOUT_US)) {
+            PB_TRACE_END(PB_TRACE_HCSR04_MEASURE, ESP_ERR_TIMEOUT);
             return ESP_ERR_TIMEOUT;
         }
     }
@@ -68,6 +71,7 @@ esp_err_t hcsr04_sensor_measure_raw(const hcsr04_sensor_t *dev, uint32_t max_tim
     int64_t echo_end = esp_timer_get_time();
 
     *time_us = echo_end - echo_start;
+    PB_TRACE_END(PB_TRACE_HCSR04_MEASURE, *time_us);
 
     return ESP_OK;
 }
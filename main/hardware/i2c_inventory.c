@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "i2c_inventory.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+
+#define I2C_INVENTORY_NVS_NAMESPACE  "i2c_inv"
+#define I2C_INVENTORY_FIRST_ADDR     0x08   // 0x00-0x07 and 0x78-0x7f are reserved
+#define I2C_INVENTORY_LAST_ADDR      0x77
+#define I2C_INVENTORY_PROBE_TIMEOUT_MS 10   // An idle device answers within a byte time
+#define I2C_INVENTORY_MAX_TIMEOUTS   3      // Consecutive bus timeouts after which the bus is considered stuck
+
+static const char *TAG = "i2c_inventory";
+
+static TickType_t i2c_inventory_timeout(void)
+{
+    TickType_t ticks = pdMS_TO_TICKS(I2C_INVENTORY_PROBE_TIMEOUT_MS);
+    return ticks > 0 ? ticks : 1;
+}
+
+static esp_err_t i2c_inventory_probe(i2c_port_t port, uint8_t address)
+{
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, (address << 1) | I2C_MASTER_WRITE, true);
+    i2c_master_stop(cmd);
+    esp_err_t ret = i2c_master_cmd_begin(port, cmd, i2c_inventory_timeout());
+    i2c_cmd_link_delete(cmd);
+    return ret;
+}
+
+static esp_err_t i2c_inventory_read_id(i2c_port_t port, uint8_t address, uint8_t reg, uint16_t *id)
+{
+    uint8_t data[2];
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, (address << 1) | I2C_MASTER_WRITE, true);
+    i2c_master_write_byte(cmd, reg, true);
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, (address << 1) | I2C_MASTER_READ, true);
+    i2c_master_read(cmd, data, sizeof(data), I2C_MASTER_LAST_NACK);
+    i2c_master_stop(cmd);
+    esp_err_t ret = i2c_master_cmd_begin(port, cmd, i2c_inventory_timeout());
+    i2c_cmd_link_delete(cmd);
+    if (ret == ESP_OK) {
+        *id = (data[0] << 8) | data[1];
+    }
+    return ret;
+}
+
+static void i2c_inventory_key(i2c_port_t port, char *key, size_t size)
+{
+    snprintf(key, size, "port%d", (int)port);
+}
+
+static esp_err_t i2c_inventory_load(i2c_port_t port, i2c_inventory_t *inventory)
+{
+    char key[16];
+    nvs_handle_t handle;
+    i2c_inventory_key(port, key, sizeof(key));
+    memset(inventory, 0, sizeof(*inventory));
+
+    esp_err_t ret = nvs_open(I2C_INVENTORY_NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    size_t len = sizeof(inventory->devices);
+    ret = nvs_get_blob(handle, key, inventory->devices, &len);
+    nvs_close(handle);
+    if (ret == ESP_OK) {
+        inventory->count = len / sizeof(inventory->devices[0]);
+    }
+    return ret;
+}
+
+static esp_err_t i2c_inventory_save(i2c_port_t port, const i2c_inventory_t *inventory)
+{
+    char key[16];
+    nvs_handle_t handle;
+    i2c_inventory_key(port, key, sizeof(key));
+
+    esp_err_t ret = nvs_open(I2C_INVENTORY_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = nvs_set_blob(handle, key, inventory->devices, inventory->count * sizeof(inventory->devices[0]));
+    if (ret == ESP_OK) {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return ret;
+}
+
+static const i2c_inventory_device_t *i2c_inventory_find(const i2c_inventory_t *inventory, uint8_t address)
+{
+    for (int i = 0; i < inventory->count; i++) {
+        if (inventory->devices[i].address == address) {
+            return &inventory->devices[i];
+        }
+    }
+    return NULL;
+}
+
+// Expected devices have to be found with the expected ID, or any ID if none is given
+static bool i2c_inventory_matches(const i2c_inventory_t *inventory, const i2c_inventory_device_t *expected, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        const i2c_inventory_device_t *device = i2c_inventory_find(inventory, expected[i].address);
+        if (device == NULL || (expected[i].id != 0 && device->id != expected[i].id)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+esp_err_t i2c_inventory_scan(i2c_port_t port, const i2c_inventory_device_t *expected, size_t count, i2c_inventory_t *inventory)
+{
+    int64_t start_us = esp_timer_get_time();
+    int timeouts = 0;
+
+    memset(inventory, 0, sizeof(*inventory));
+    ESP_LOGI(TAG, "Scanning I2C bus %d...", (int)port);
+    for (int address = I2C_INVENTORY_FIRST_ADDR; address <= I2C_INVENTORY_LAST_ADDR; address++) {
+        esp_err_t ret = i2c_inventory_probe(port, address);
+        if (ret == ESP_ERR_TIMEOUT) {
+            // A held line times out every probe, don't spend the timeout on each of the addresses
+            if (++timeouts >= I2C_INVENTORY_MAX_TIMEOUTS) {
+                ESP_LOGE(TAG, "I2C bus %d stuck, scan aborted at 0x%02x", (int)port, address);
+                return ESP_ERR_TIMEOUT;
+            }
+            continue;
+        }
+        timeouts = 0;
+        if (ret != ESP_OK) {
+            continue;
+        }
+        if (inventory->count == I2C_INVENTORY_MAX_DEVICES) {
+            ESP_LOGW(TAG, "More than %d devices, 0x%02x not recorded", I2C_INVENTORY_MAX_DEVICES, address);
+            continue;
+        }
+
+        i2c_inventory_device_t *device = &inventory->devices[inventory->count++];
+        device->address = address;
+        // Only the registers of known devices are read, reads have side effects on some parts
+        for (size_t i = 0; i < count; i++) {
+            if (expected[i].address == address) {
+                device->id_reg = expected[i].id_reg;
+                i2c_inventory_read_id(port, address, device->id_reg, &device->id);
+                break;
+            }
+        }
+        ESP_LOGI(TAG, "Found device at: 0x%02x (id 0x%04x)", address, device->id);
+    }
+    inventory->scan_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+    ESP_LOGI(TAG, "I2C scan completed in %" PRIu32 " ms, %d devices.", inventory->scan_ms, inventory->count);
+
+    esp_err_t ret = i2c_inventory_save(port, inventory);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to save the inventory: %s", esp_err_to_name(ret));
+    }
+    return ESP_OK;
+}
+
+esp_err_t i2c_inventory_verify(i2c_port_t port, const i2c_inventory_device_t *expected, size_t count)
+{
+    i2c_inventory_t inventory;
+    int64_t start_us = esp_timer_get_time();
+    bool verified = false;
+
+    if (i2c_inventory_load(port, &inventory) != ESP_OK) {
+        ESP_LOGI(TAG, "No inventory of I2C bus %d", (int)port);
+    } else if (!i2c_inventory_matches(&inventory, expected, count)) {
+        ESP_LOGW(TAG, "Inventory of I2C bus %d lacks expected devices", (int)port);
+    } else {
+        verified = true;
+        for (size_t i = 0; i < count && verified; i++) {
+            uint16_t id = 0;
+            const i2c_inventory_device_t *device = i2c_inventory_find(&inventory, expected[i].address);
+            esp_err_t ret = i2c_inventory_read_id(port, device->address, device->id_reg, &id);
+            if (ret != ESP_OK || id != device->id) {
+                ESP_LOGW(TAG, "Device 0x%02x doesn't answer as recorded (%s, id 0x%04x)", device->address, esp_err_to_name(ret), id);
+                verified = false;
+            }
+        }
+    }
+
+    if (verified) {
+        ESP_LOGI(TAG, "%d devices on I2C bus %d verified in %" PRIu32 " ms", (int)count, (int)port,
+                 (uint32_t)((esp_timer_get_time() - start_us) / 1000));
+        return ESP_OK;
+    }
+
+    esp_err_t ret = i2c_inventory_scan(port, expected, count, &inventory);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    return i2c_inventory_matches(&inventory, expected, count) ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
@@ -0,0 +1,40 @@
+#ifndef I2C_INVENTORY_H
+#define I2C_INVENTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "driver/i2c.h"
+#include "esp_err.h"
+
+#define I2C_INVENTORY_MAX_DEVICES 16
+
+// Device on the bus; also used to describe the devices a driver expects
+typedef struct {
+    uint8_t address;
+    uint8_t id_reg;     // Register holding the device ID, read as a big-endian word
+    uint16_t id;        // 0 for devices found by a scan without a known ID register
+} i2c_inventory_device_t;
+
+// Bus topology found by the last full scan, kept in NVS
+typedef struct {
+    uint8_t count;
+    i2c_inventory_device_t devices[I2C_INVENTORY_MAX_DEVICES];
+    uint32_t scan_ms;   // Duration of the scan, 0 when loaded from NVS
+} i2c_inventory_t;
+
+/**
+ * @brief Checks that the expected devices are on the bus. When the inventory saved by the last
+ * scan lists them, only their ID registers are read, with a short timeout. The full scan runs
+ * only without an inventory or when a device doesn't answer as recorded.
+ *
+ * @return ESP_OK if all expected devices were found, ESP_ERR_NOT_FOUND otherwise
+ */
+esp_err_t i2c_inventory_verify(i2c_port_t port, const i2c_inventory_device_t *expected, size_t count);
+
+/**
+ * @brief Probes every address of the bus and saves the result as the new inventory.
+ * The ID registers of the expected devices are read on the way. Meant for diagnostics.
+ */
+esp_err_t i2c_inventory_scan(i2c_port_t port, const i2c_inventory_device_t *expected, size_t count, i2c_inventory_t *inventory);
+
+#endif // I2C_INVENTORY_H
@@ -1,5 +1,7 @@
 #include "ina3221_sensor.h"
+#include "i2c_inventory.h"
 #include "esp_log.h"
+#include "pb_log.h"
 #include "driver/i2c.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -9,25 +11,29 @@
 #define I2C_MASTER_NUM             I2C_NUM_1  // I2C port number for master
 #define I2C_MASTER_FREQ_HZ         100000 // I2C master clock frequency
 #define INA3221_ADDR               0x40   // Updated INA3221 I2C address
+#define INA3221_REG_DIE_ID         0xFF
+#define INA3221_DIE_ID             0x3220
 #define I2C_RETRY_COUNT            5      // Number of retry attempts for I2C operations
 
 static const char *TAG = "INA3221";
 
-void i2c_scanner(void)
+static const i2c_inventory_device_t s_expected_devices[] = {
+    { .address = INA3221_ADDR, .id_reg = INA3221_REG_DIE_ID, .id = INA3221_DIE_ID },
+};
+
+static esp_err_t prvWriteConfig(uint16_t config)
 {
-    ESP_LOGI(TAG, "Scanning I2C bus...");
-    for (int i = 1; i < 127; i++) {
-        i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-        i2c_master_start(cmd);
-        i2c_master_write_byte(cmd, (i << 1) | I2C_MASTER_WRITE, true);
-        i2c_master_stop(cmd);
-        esp_err_t espRc = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, 1000 / portTICK_PERIOD_MS);
-        i2c_cmd_link_delete(cmd);
-        if (espRc == ESP_OK) {
-            ESP_LOGI(TAG, "Found device at: 0x%02x", i);
-        }
-    }
-    ESP_LOGI(TAG, "I2C scan completed.");
+    uint8_t config_data[3] = { INA3221_REG_CONFIG, (config >> 8) & 0xFF, (config & 0xFF) };
+
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, (INA3221_ADDR << 1) | I2C_MASTER_WRITE, true);
+    i2c_master_write(cmd, config_data, sizeof(config_data), true);
+    i2c_master_stop(cmd);
+    esp_err_t ret = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, 1000 / portTICK_PERIOD_MS);
+    i2c_cmd_link_delete(cmd);
+
+    return ret;
 }
 
 esp_err_t ina3221_init(void)
@@ -53,20 +59,14 @@ esp_err_t ina3221_init(void)
         return ret;
     }
 
-    i2c_scanner(); // Call the I2C scanner to check for devices
+    // Only the devices found by the last scan are checked, the bus is scanned again if one is missing
+    ret = i2c_inventory_verify(I2C_MASTER_NUM, s_expected_devices, sizeof(s_expected_devices) / sizeof(s_expected_devices[0]));
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "INA3221 not found on the bus: %s", esp_err_to_name(ret));
+    }
 
     // Configure the INA3221 to enable all channels
-    uint16_t config = INA3221_CONFIG_ENABLE_CH1 | INA3221_CONFIG_ENABLE_CH2 | INA3221_CONFIG_ENABLE_CH3 | INA3221_CONFIG_DEFAULT;
-    uint8_t config_data[3] = { INA3221_REG_CONFIG, (config >> 8) & 0xFF, (config & 0xFF) };
-
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (INA3221_ADDR << 1) | I2C_MASTER_WRITE, true);
-    i2c_master_write(cmd, config_data, sizeof(config_data), true);
-    i2c_master_stop(cmd);
-    ret = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, 1000 / portTICK_PERIOD_MS);
-    i2c_cmd_link_delete(cmd);
-
+    ret = prvWriteConfig(INA3221_CONFIG_ENABLE_CH1 | INA3221_CONFIG_ENABLE_CH2 | INA3221_CONFIG_ENABLE_CH3 | INA3221_CONFIG_DEFAULT);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to configure INA3221: %s", esp_err_to_name(ret));
     }
@@ -74,6 +74,11 @@ esp_err_t ina3221_init(void)
     return ret;
 }
 
+esp_err_t ina3221_scan_bus(i2c_inventory_t *inventory)
+{
+    return i2c_inventory_scan(I2C_MASTER_NUM, s_expected_devices, sizeof(s_expected_devices) / sizeof(s_expected_devices[0]), inventory);
+}
+
 esp_err_t ina3221_read(uint8_t reg, uint8_t *data_rd, size_t length)
 {
     esp_err_t ret;
@@ -94,11 +99,11 @@ esp_err_t ina3221_read(uint8_t reg, uint8_t *data_rd, size_t length)
         if (ret == ESP_OK) {
             return ESP_OK;
         }
-        ESP_LOGW(TAG, "I2C read attempt %d failed: %s (reg: 0x%02x, len: %d)", i + 1, esp_err_to_name(ret), reg, length);
+        PB_LOGW(TAG, "I2C read attempt %d failed: %s (reg: 0x%02x, len: %d)", i + 1, esp_err_to_name(ret), reg, (int)length);
         vTaskDelay(200 / portTICK_PERIOD_MS);
     }
 
-    ESP_LOGE(TAG, "Failed to read from INA3221 after %d attempts: %s", I2C_RETRY_COUNT, esp_err_to_name(ret));
+    PB_LOGE(TAG, "Failed to read from INA3221 after %d attempts: %s", I2C_RETRY_COUNT, esp_err_to_name(ret));
     return ret;
 }
 
@@ -127,7 +132,7 @@ esp_err_t ina3221_read_channel(uint8_t channel, ina3221_reading_t *reading)
     // Read shunt voltage
     esp_err_t ret = ina3221_read(reg_shunt, data, 2);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to read shunt voltage from channel %d", channel);
+        PB_LOGE(TAG, "Failed to read shunt voltage from channel %d", channel);
         return ret;
     }
     int16_t shunt_voltage_raw = (data[0] << 8) | data[1];
@@ -135,7 +140,7 @@ esp_err_t ina3221_read_channel(uint8_t channel, ina3221_reading_t *reading)
     // Read bus voltage
     ret = ina3221_read(reg_bus, data, 2);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to read bus voltage from channel %d", channel);
+        PB_LOGE(TAG, "Failed to read bus voltage from channel %d", channel);
         return ret;
     }
     int16_t bus_voltage_raw = (data[0] << 8) | data[1];
@@ -146,8 +151,24 @@ esp_err_t ina3221_read_channel(uint8_t channel, ina3221_reading_t *reading)
     reading->load_voltage = reading->bus_voltage - (reading->shunt_voltage * 0.001); // Convert mV to V
     reading->current = reading->shunt_voltage / SHUNT_RESISTOR_OHMS; // Current in mA
 
-    ESP_LOGI(TAG, "Channel %d - Bus Voltage: %.2f V, Shunt Voltage: %.2f mV, Load Voltage: %.2f V, Current: %.2f mA",
+    /* Published by the power perception task, only logged when debugging the sensor */
+    ESP_LOGD(TAG, "Channel %d - Bus Voltage: %.2f V, Shunt Voltage: %.2f mV, Load Voltage: %.2f V, Current: %.2f mA",
              channel, reading->bus_voltage, reading->shunt_voltage, reading->load_voltage, reading->current);
 
     return ESP_OK;
 }
+
+esp_err_t ina3221_trigger(uint32_t *conversion_ms)
+{
+    // Writing the configuration in a single-shot mode starts the conversion, the device powers down after it
+    uint16_t config = INA3221_CONFIG_ENABLE_CH1 | INA3221_CONFIG_ENABLE_CH2 | INA3221_CONFIG_ENABLE_CH3 |
+                      (INA3221_CONFIG_DEFAULT & ~INA3221_CONFIG_MODE_MASK) | INA3221_CONFIG_MODE_SINGLE_SHOT;
+    esp_err_t ret = prvWriteConfig(config);
+    if (ret != ESP_OK) {
+        PB_LOGE(TAG, "Failed to trigger a conversion: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    *conversion_ms = INA3221_CONVERSION_MS;
+    return ESP_OK;
+}
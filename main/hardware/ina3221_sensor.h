@@ -3,6 +3,7 @@
 
 #include "driver/i2c_master.h"
 #include "esp_err.h"
+#include "i2c_inventory.h"
 
 
 // INA3221 Registers
@@ -19,6 +20,11 @@
 #define INA3221_CONFIG_ENABLE_CH2  0x2000
 #define INA3221_CONFIG_ENABLE_CH3  0x1000
 #define INA3221_CONFIG_DEFAULT     0x7127
+#define INA3221_CONFIG_MODE_MASK   0x0007
+#define INA3221_CONFIG_MODE_SINGLE_SHOT 0x0003 // Shunt and bus voltages, once
+
+// Single-shot conversion of the 3 channels, shunt and bus at 1.1 ms each without averaging
+#define INA3221_CONVERSION_MS      7
 
 // Shunt resistor value in Ohms
 #define SHUNT_RESISTOR_OHMS        0.1
@@ -35,5 +41,9 @@ typedef struct {
 esp_err_t ina3221_init(void);
 esp_err_t ina3221_read(uint8_t reg, uint8_t *data_rd, size_t length);
 esp_err_t ina3221_read_channel(uint8_t channel, ina3221_reading_t *reading);
+// Starts a single-shot conversion of all channels, read them with ina3221_read_channel() after conversion_ms
+esp_err_t ina3221_trigger(uint32_t *conversion_ms);
+// Full scan of the INA3221 bus, refreshes the cached inventory
+esp_err_t ina3221_scan_bus(i2c_inventory_t *inventory);
 
 #endif // INA3221_SENSOR_H
@@ -27,7 +27,7 @@ static void stop_led_task(void) {
 
 // LED Task functions
 void led_blink_task(void *param) {
-    uint32_t color = (uint32_t)param;
+    uint32_t color = (uint32_t)(uintptr_t)param;
     while (1) {
         for (int i = 0; i < LED_STRIP_LED_NUMBERS; i++) {
             ESP_ERROR_CHECK(led_strip_set_pixel(led_strip, i, (color >> 16) & 0xFF, (color >> 8) & 0xFF, color & 0xFF));
@@ -26,6 +26,13 @@
 /* WiFi provisioning/connection handler include. */
 #include "app_wifi.h"
 #include "pppos_client.h" 
+#include "uplink_manager.h"
+
+/* Boot orchestration include. */
+#include "boot_orchestrator.h"
+
+/* Deferred console output include. */
+#include "pb_log.h"
 /* Demo includes. */
 #if CONFIG_PB_LED
     #include "pubsub.h"
@@ -35,14 +42,27 @@
     #include "ina3221_sensor.h"
     #include "power_perception.h"
     #include "obstacle_perception.h"
+    #include "sensor_sampler.h"
     #include "wifi_perception.h"
+    #include "cellular_perception.h"
+    #include "impact_perception.h"
     #include "driver/gpio.h"
     #include "buzzer_control.h"
+    #include "buzzer_driver.h"
+    #include "app_driver.h"
 
 
 
 #endif /* CONFIG_GRI_ENABLE_SUB_PUB_UNSUB */
 
+#if CONFIG_PB_SYSTEM_PERCEPTION
+    #include "system_perception.h"
+#endif /* CONFIG_PB_SYSTEM_PERCEPTION */
+
+#if CONFIG_PB_TRACE
+    #include "pb_trace.h"
+#endif /* CONFIG_PB_TRACE */
+
 #if CONFIG_GRI_ENABLE_TEMPERATURE_PUB_SUB_AND_LED_CONTROL
     #include "temp_sub_pub_and_led_control.h"
 #endif /* CONFIG_GRI_ENABLE_TEMPERATURE_PUB_SUB_AND_LED_CONTROL */
@@ -99,6 +119,15 @@ static BaseType_t prvInitializeNetworkContext( void );
  */
 static void prvStartEnabledDemos( void );
 
+#if CONFIG_PB_LED
+
+/**
+ * @brief Initializes the hardware drivers, run in the background while the
+ * radio connects.
+ */
+    static void prvInitializeDrivers( void );
+#endif /* CONFIG_PB_LED */
+
 #if CONFIG_GRI_RUN_QUALIFICATION_TEST
     extern BaseType_t xQualificationStart( void );
 #endif /* CONFIG_GRI_RUN_QUALIFICATION_TEST */
@@ -225,35 +254,52 @@ static BaseType_t prvInitializeNetworkContext( void )
     return xRet;
 }
 
+#if CONFIG_PB_LED
+    static void prvInitializeDrivers( void )
+    {
+        /* Barrier (MCPWM), LED (RMT) and ultrasonic sensor. */
+        app_driver_init();
+        buzzer_driver_init();
+
+        if( ina3221_init() != ESP_OK )
+        {
+            ESP_LOGE( TAG, "Failed to initialize the INA3221." );
+        }
+    }
+#endif /* CONFIG_PB_LED */
+
 static void prvStartEnabledDemos( void )
 {
-    BaseType_t xResult;
+    #if CONFIG_GRI_RUN_QUALIFICATION_TEST
+        BaseType_t xResult;
+    #endif /* CONFIG_GRI_RUN_QUALIFICATION_TEST */
 
     #if ( CONFIG_GRI_RUN_QUALIFICATION_TEST == 0 )
-        
-
-        /* Initialize and start the coreMQTT-Agent network manager. This handles
-         * establishing a TLS connection and MQTT connection to the MQTT broker.
-         * This needs to be started before starting WiFi so it can handle WiFi
-         * connection events. */
-        xResult = xCoreMqttAgentManagerStart( &xNetworkContext );
-
-        if( xResult != pdPASS )
-        {
-            ESP_LOGE( TAG, "Failed to initialize and start coreMQTT-Agent network "
-                           "manager." );
-
-            configASSERT( xResult == pdPASS );
-        }
 
+        /* The tasks wait for the drivers and the first MQTT connection
+         * before subscribing, see boot_wait(). */
         #if CONFIG_PB_LED
             vStartLEDControl();
             vStartBarrierControl();
+            ESP_ERROR_CHECK( sensor_sampler_start() );
             vStartPowerPerception();
             vStartObstaclePerception();
             vStartWifiPerception();
+            #if CONFIG_PB_CELLULAR_PERCEPTION
+                vStartCellularPerception();
+            #endif /* CONFIG_PB_CELLULAR_PERCEPTION */
+            #if CONFIG_PB_IMPACT_PERCEPTION
+                if( impact_perception_start() != ESP_OK )
+                {
+                    ESP_LOGE( TAG, "Failed to start the impact perception." );
+                }
+            #endif /* CONFIG_PB_IMPACT_PERCEPTION */
         #endif /* CONFIG_GRI_ENABLE_SIMPLE_PUB_SUB */
 
+        #if CONFIG_PB_SYSTEM_PERCEPTION
+            vStartSystemPerception();
+        #endif /* CONFIG_PB_SYSTEM_PERCEPTION */
+
         #if CONFIG_GRI_ENABLE_TEMPERATURE_PUB_SUB_AND_LED_CONTROL
             vStartTempSubPubAndLEDControlDemo();
         #endif /* CONFIG_GRI_ENABLE_TEMPERATURE_LED_PUB_SUB */
@@ -298,21 +344,26 @@ static void prvStartEnabledDemos( void )
  */
 void app_main( void )
 {
-    
     /* This is used to store the return of initialization functions. */
     BaseType_t xRet;
 
     /* This is used to store the error return of ESP-IDF functions. */
     esp_err_t xEspErrRet;
 
-    /* Initialize global network context. */
-    xRet = prvInitializeNetworkContext();
+    /* Wi-Fi association and DHCP take the longest, so the radio is started
+     * first and everything independent of it is done while it connects:
+     * the credentials are read here, the drivers are initialized in the
+     * background and the tasks wait for what they need with boot_wait(). */
+    #if CONFIG_PB_TRACE
+        /* Before the first trace point is reached. */
+        ESP_ERROR_CHECK( pb_trace_init() );
+    #endif /* CONFIG_PB_TRACE */
 
-    if( xRet != pdPASS )
-    {
-        ESP_LOGE( TAG, "Failed to initialize global network context." );
-        return;
-    }
+    /* From here on, the console is written by a low priority task. */
+    ESP_ERROR_CHECK( pb_log_init() );
+
+    ESP_ERROR_CHECK( esp_event_loop_create_default() );
+    ESP_ERROR_CHECK( boot_orchestrator_init() );
 
     /* Initialize NVS partition. This needs to be done before initializing
      * WiFi. */
@@ -329,17 +380,64 @@ void app_main( void )
         ESP_ERROR_CHECK( nvs_flash_init() );
     }
 
+    boot_stage_done( BOOT_STAGE_NVS );
 
-    ESP_ERROR_CHECK( esp_event_loop_create_default() );
+    #if ( CONFIG_GRI_RUN_QUALIFICATION_TEST == 0 )
 
+        /* Initialize and start the coreMQTT-Agent network manager. This handles
+         * establishing a TLS connection and MQTT connection to the MQTT broker.
+         * This needs to be started before starting WiFi so it can handle WiFi
+         * connection events. It connects once the credentials are read. */
+        xRet = xCoreMqttAgentManagerStart( &xNetworkContext );
 
-    prvStartEnabledDemos();
-    //pppos_start();
+        if( xRet != pdPASS )
+        {
+            ESP_LOGE( TAG, "Failed to initialize and start coreMQTT-Agent network "
+                           "manager." );
+
+            configASSERT( xRet == pdPASS );
+        }
+    #endif /* CONFIG_GRI_RUN_QUALIFICATION_TEST == 0 */
+
+    #if CONFIG_PB_UPLINK_MANAGER
+        /* Bring the modem up right away, so it's ready to take over from WiFi. */
+        pppos_start();
+    #endif /* CONFIG_PB_UPLINK_MANAGER */
 
     /* Start WiFi. */
     app_wifi_init();
-    app_wifi_start( POP_TYPE_MAC );
 
-   
-}
+    #if CONFIG_PB_UPLINK_MANAGER
+        /* Both interfaces exist now, start routing before either gets an address. */
+        ESP_ERROR_CHECK( uplink_manager_start() );
+    #endif /* CONFIG_PB_UPLINK_MANAGER */
 
+    if( app_wifi_start( POP_TYPE_MAC ) != ESP_OK )
+    {
+        ESP_LOGE( TAG, "Failed to start WiFi." );
+    }
+
+    boot_stage_done( BOOT_STAGE_RADIO );
+
+    #if CONFIG_PB_LED
+        ESP_ERROR_CHECK( boot_run_async( "BootDrivers", prvInitializeDrivers, 4096, BOOT_STAGE_DRIVERS ) );
+    #else
+        boot_stage_done( BOOT_STAGE_DRIVERS );
+    #endif /* CONFIG_PB_LED */
+
+    /* Initialize global network context. */
+    xRet = prvInitializeNetworkContext();
+
+    if( xRet != pdPASS )
+    {
+        ESP_LOGE( TAG, "Failed to initialize global network context." );
+        /* Releases the coreMQTT-Agent connection task waiting for them. */
+        boot_stage_failed( BOOT_STAGE_CREDENTIALS );
+        return;
+    }
+
+    boot_stage_done( BOOT_STAGE_CREDENTIALS );
+
+    prvStartEnabledDemos();
+    boot_stage_done( BOOT_STAGE_TASKS );
+}
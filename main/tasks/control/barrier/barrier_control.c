@@ -13,6 +13,7 @@
 #include "core_mqtt_agent_manager_events.h"
 #include "core_json.h"
 #include "subscription_manager.h"
+#include "boot_orchestrator.h"
 #include "app_driver.h"
 #include "barrier_control.h"
 #include "barrier_control_config.h"
@@ -79,7 +80,7 @@ static void prvParseIncomingPublish(char * publishPayload, size_t publishPayload
     JSONStatus_t result = JSONSuccess;
     char command[32] = {0};
 
-    ESP_LOGI(TAG, "Parsing incoming publish: %.*s", publishPayloadLength, publishPayload);
+    ESP_LOGI(TAG, "Parsing incoming publish: %.*s", (int)publishPayloadLength, publishPayload);
 
     result = JSON_Validate(publishPayload, publishPayloadLength);
 
@@ -201,7 +202,8 @@ static void prvBarrierControlTask(void * pvParameters)
 
     pcTaskName = pcTaskGetName(xTaskGetCurrentTaskHandle());
 
-    app_driver_init();
+    /* Drivers are initialized in the background at boot */
+    boot_wait(BOOT_READY(BOOT_STAGE_DRIVERS), portMAX_DELAY);
     app_driver_led_disconnected();
 
     xNetworkEventGroup = xEventGroupCreate();
@@ -214,6 +216,9 @@ static void prvBarrierControlTask(void * pvParameters)
     snprintf(unlockTopicBuf, BARRIER_CONTROL_STRING_BUFFER_LENGTH, "cmd/pb/%s/%s/%s/%s/barrier/unlock", CONFIG_PB_CITY, CONFIG_PB_AREA, CONFIG_PB_ZONE, CONFIG_GRI_THING_NAME);
     snprintf(lockTopicBuf, BARRIER_CONTROL_STRING_BUFFER_LENGTH, "cmd/pb/%s/%s/%s/%s/barrier/lock", CONFIG_PB_CITY, CONFIG_PB_AREA, CONFIG_PB_ZONE, CONFIG_GRI_THING_NAME);
 
+    /* Subscribing before the first connection would fail */
+    boot_wait(BOOT_READY(BOOT_STAGE_MQTT), portMAX_DELAY);
+
     if(!prvSubscribeToTopic(xQoS, unlockTopicBuf))
     {
         ESP_LOGE(TAG, "Failed to subscribe to topic %s", unlockTopicBuf);
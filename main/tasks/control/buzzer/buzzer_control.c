@@ -13,6 +13,7 @@
 #include "core_mqtt_agent_manager_events.h"
 #include "core_json.h"
 #include "subscription_manager.h"
+#include "boot_orchestrator.h"
 #include "app_driver.h"
 #include "buzzer_control.h"
 #include "buzzer_control_config.h"
@@ -79,7 +80,7 @@ static void prvParseIncomingPublish(char * publishPayload, size_t publishPayload
     JSONStatus_t result = JSONSuccess;
     char type[32] = {0};
 
-    ESP_LOGI(TAG, "Parsing incoming publish: %.*s", publishPayloadLength, publishPayload);
+    ESP_LOGI(TAG, "Parsing incoming publish: %.*s", (int)publishPayloadLength, publishPayload);
 
     result = JSON_Validate(publishPayload, publishPayloadLength);
 
@@ -235,7 +236,8 @@ static void prvBuzzerControlTask(void * pvParameters)
 
     pcTaskName = pcTaskGetName(xTaskGetCurrentTaskHandle());
 
-    buzzer_driver_init();
+    /* Drivers are initialized in the background at boot */
+    boot_wait(BOOT_READY(BOOT_STAGE_DRIVERS), portMAX_DELAY);
 
     xNetworkEventGroup = xEventGroupCreate();
     xEventGroupSetBits(xNetworkEventGroup, CORE_MQTT_AGENT_OTA_NOT_IN_PROGRESS_BIT);
@@ -246,6 +248,9 @@ static void prvBuzzerControlTask(void * pvParameters)
 
     snprintf(buzzerTopicBuf, BUZZER_CONTROL_STRING_BUFFER_LENGTH, "cmd/pb/%s/%s/%s/%s/buzzer", CONFIG_PB_CITY, CONFIG_PB_AREA, CONFIG_PB_ZONE, CONFIG_GRI_THING_NAME);
 
+    /* Subscribing before the first connection would fail */
+    boot_wait(BOOT_READY(BOOT_STAGE_MQTT), portMAX_DELAY);
+
     if(!prvSubscribeToTopic(xQoS, buzzerTopicBuf))
     {
         ESP_LOGE(TAG, "Failed to subscribe to topic %s", buzzerTopicBuf);
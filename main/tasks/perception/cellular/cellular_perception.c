@@ -0,0 +1,275 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <time.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "esp_log.h"
+#include "esp_event.h"
+#include "core_mqtt.h"
+#include "core_mqtt_agent.h"
+#include "core_mqtt_agent_manager.h"
+#include "core_mqtt_agent_manager_events.h"
+#include "pppos_client.h"
+
+#define CORE_MQTT_AGENT_CONNECTED_BIT (1 << 0)
+#define CORE_MQTT_AGENT_OTA_NOT_IN_PROGRESS_BIT (1 << 1)
+
+/* AT+CSQ reports 99 when the value is not known or not detectable */
+#define CSQ_UNKNOWN 99
+/* AT+CSQ ber classes 4 and above correspond to more than 1.6% bit errors */
+#define CSQ_BER_DEGRADED 4
+
+static const char *TAG = "cellular_perception";
+extern MQTTAgentContext_t xGlobalMqttAgentContext;
+static EventGroupHandle_t xNetworkEventGroup;
+
+typedef struct MQTTAgentCommandContext
+{
+    MQTTStatus_t xReturnStatus;
+    TaskHandle_t xTaskToNotify;
+    uint32_t ulNotificationValue;
+    void *pArgs;
+} MQTTAgentCommandContext_t;
+
+/* State of the adaptive poll loop */
+typedef struct {
+    bool xHaveBaseline;
+    int32_t lBaselineDbm;   /* Exponentially smoothed signal strength of the stable link */
+    int lAct;
+    char cOperator[PPPOS_OPERATOR_NAME_MAX];
+    uint32_t ulPollMs;
+} CellularLinkState_t;
+
+static void prvCoreMqttAgentEventHandler(void *pvHandlerArg, esp_event_base_t xEventBase, int32_t lEventId, void *pvEventData);
+static void prvCellularPerceptionTask(void *pvParameters);
+static void publish_cellular_telemetry(const pppos_link_quality_t *quality, const int32_t *dbm, const char *state, uint32_t poll_ms);
+
+static void prvCoreMqttAgentEventHandler(void *pvHandlerArg, esp_event_base_t xEventBase, int32_t lEventId, void *pvEventData)
+{
+    (void)pvHandlerArg;
+    (void)xEventBase;
+    (void)pvEventData;
+
+    switch (lEventId) {
+        case CORE_MQTT_AGENT_CONNECTED_EVENT:
+            ESP_LOGI(TAG, "coreMQTT-Agent connected.");
+            xEventGroupSetBits(xNetworkEventGroup, CORE_MQTT_AGENT_CONNECTED_BIT);
+            break;
+
+        case CORE_MQTT_AGENT_DISCONNECTED_EVENT:
+            ESP_LOGI(TAG, "coreMQTT-Agent disconnected. Preventing coreMQTT-Agent commands from being enqueued.");
+            xEventGroupClearBits(xNetworkEventGroup, CORE_MQTT_AGENT_CONNECTED_BIT);
+            break;
+
+        case CORE_MQTT_AGENT_OTA_STARTED_EVENT:
+            ESP_LOGI(TAG, "OTA started. Preventing coreMQTT-Agent commands from being enqueued.");
+            xEventGroupClearBits(xNetworkEventGroup, CORE_MQTT_AGENT_OTA_NOT_IN_PROGRESS_BIT);
+            break;
+
+        case CORE_MQTT_AGENT_OTA_STOPPED_EVENT:
+            ESP_LOGI(TAG, "OTA stopped. No longer preventing coreMQTT-Agent commands from being enqueued.");
+            xEventGroupSetBits(xNetworkEventGroup, CORE_MQTT_AGENT_OTA_NOT_IN_PROGRESS_BIT);
+            break;
+
+        default:
+            ESP_LOGE(TAG, "coreMQTT-Agent event handler received unexpected event: %" PRIu32 "", lEventId);
+            break;
+    }
+}
+
+static void prvPublishCommandCallback(MQTTAgentCommandContext_t *pxCommandContext, MQTTAgentReturnInfo_t *pxReturnInfo)
+{
+    if (pxCommandContext != NULL) {
+        pxCommandContext->xReturnStatus = pxReturnInfo->returnCode;
+        xTaskNotify(pxCommandContext->xTaskToNotify, pxCommandContext->ulNotificationValue, eSetValueWithOverwrite);
+    }
+}
+
+static BaseType_t prvWaitForCommandAcknowledgment(uint32_t *pulNotifiedValue)
+{
+    return xTaskNotifyWait(0, 0, pulNotifiedValue, portMAX_DELAY);
+}
+
+/* Returns false if the modem doesn't know the signal strength (CSQ 99) */
+static bool prvCsqToDbm(int rssi, int32_t *plDbm)
+{
+    if (rssi < 0 || rssi > 31) {
+        return false;
+    }
+    /* 0 -> -113 dBm ... 31 -> -51 dBm, in 2 dB steps */
+    *plDbm = -113 + 2 * rssi;
+    return true;
+}
+
+/*
+ * Classifies the new sample against the smoothed baseline and returns the next poll interval:
+ * the fast interval while the link degrades (or changes operator/technology), otherwise
+ * the interval doubles on every stable sample up to the slow interval.
+ * Only samples with a known signal strength are classified.
+ */
+static uint32_t prvNextPollInterval(CellularLinkState_t *pxState, const pppos_link_quality_t *pxQuality, int32_t lDbm, bool *pxDegrading)
+{
+    bool xDegrading = false;
+
+    if (lDbm <= CONFIG_PB_CELLULAR_WEAK_SIGNAL_DBM) {
+        xDegrading = true;
+    }
+    if (pxState->xHaveBaseline && lDbm <= pxState->lBaselineDbm - CONFIG_PB_CELLULAR_DEGRADE_THRESHOLD_DB) {
+        xDegrading = true;
+    }
+    if (pxQuality->ber != CSQ_UNKNOWN && pxQuality->ber >= CSQ_BER_DEGRADED) {
+        xDegrading = true;
+    }
+    if (pxState->xHaveBaseline &&
+        (pxQuality->act != pxState->lAct || strncmp(pxQuality->operator_name, pxState->cOperator, sizeof(pxState->cOperator)) != 0)) {
+        ESP_LOGI(TAG, "Serving network changed: \"%s\"/%d -> \"%s\"/%d",
+                 pxState->cOperator, pxState->lAct, pxQuality->operator_name, pxQuality->act);
+        xDegrading = true;
+    }
+
+    if (!pxState->xHaveBaseline) {
+        pxState->lBaselineDbm = lDbm;
+        pxState->xHaveBaseline = true;
+    } else {
+        /* EWMA with alpha = 1/4 */
+        pxState->lBaselineDbm += (lDbm - pxState->lBaselineDbm) / 4;
+    }
+    pxState->lAct = pxQuality->act;
+    strlcpy(pxState->cOperator, pxQuality->operator_name, sizeof(pxState->cOperator));
+
+    if (xDegrading) {
+        pxState->ulPollMs = CONFIG_PB_CELLULAR_POLL_FAST_MS;
+    } else if (pxState->ulPollMs < CONFIG_PB_CELLULAR_POLL_SLOW_MS / 2) {
+        pxState->ulPollMs *= 2;
+    } else {
+        pxState->ulPollMs = CONFIG_PB_CELLULAR_POLL_SLOW_MS;
+    }
+    *pxDegrading = xDegrading;
+    return pxState->ulPollMs;
+}
+
+static void publish_cellular_telemetry(const pppos_link_quality_t *quality, const int32_t *dbm, const char *state, uint32_t poll_ms)
+{
+    char telemetry_topic[128];
+    char telemetry_payload[256];
+    char dbm_value[12] = "null";
+    time_t now;
+    time(&now);
+    struct tm *timeinfo = gmtime(&now);
+    char timestamp[32];
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", timeinfo);
+
+    snprintf(telemetry_topic, sizeof(telemetry_topic), "dt/pb/%s/%s/%s/%s/cellular",
+             CONFIG_PB_CITY, CONFIG_PB_AREA, CONFIG_PB_ZONE, CONFIG_GRI_THING_NAME);
+
+    ESP_LOGD(TAG, "Publishing cellular telemetry data to telemetry topic: %s", telemetry_topic);
+
+    /* Radio-on time tells how well the modem duty cycle (PB_MODEM_POWER_SAVING) saves the battery */
+    pppos_link_stats_t stats = { 0 };
+    pppos_get_link_stats(&stats);
+
+    if (dbm != NULL) {
+        snprintf(dbm_value, sizeof(dbm_value), "%" PRId32, *dbm);
+    }
+
+    /* Compact keys: the link is sampled every few seconds while degrading */
+    snprintf(telemetry_payload, sizeof(telemetry_payload),
+             "{\"ts\":\"%s\",\"csq\":%d,\"dbm\":%s,\"ber\":%d,\"op\":\"%.32s\",\"act\":%d,\"mode\":%d,\"poll_ms\":%" PRIu32 ",\"state\":\"%s\","
+             "\"radio_on_s\":%" PRIu32 ",\"sleeps\":%" PRIu32 "}",
+             timestamp, quality->rssi, dbm_value, quality->ber, quality->operator_name, quality->act, quality->system_mode,
+             poll_ms, state, (uint32_t)(stats.radio_on_ms / 1000), stats.sleep_cycles);
+
+    MQTTStatus_t status;
+    MQTTPublishInfo_t publishInfo = {
+        .qos = MQTTQoS0,
+        .pTopicName = telemetry_topic,
+        .topicNameLength = (uint16_t)strlen(telemetry_topic),
+        .pPayload = telemetry_payload,
+        .payloadLength = strlen(telemetry_payload),
+        .retain = false,
+        .dup = false
+    };
+
+    MQTTAgentCommandContext_t xCommandContext = {0};
+    xCommandContext.xTaskToNotify = xTaskGetCurrentTaskHandle();
+    xCommandContext.ulNotificationValue = 1;
+
+    MQTTAgentCommandInfo_t commandInfo = {
+        .cmdCompleteCallback = prvPublishCommandCallback,
+        .pCmdCompleteCallbackContext = &xCommandContext,
+        .blockTimeMs = 1000
+    };
+
+    status = MQTTAgent_Publish(&xGlobalMqttAgentContext, &publishInfo, &commandInfo);
+    if (status != MQTTSuccess) {
+        ESP_LOGE(TAG, "Failed to publish telemetry: %s", MQTT_Status_strerror(status));
+        return;
+    }
+
+    uint32_t ulNotifiedValue;
+    if (prvWaitForCommandAcknowledgment(&ulNotifiedValue) != pdTRUE || ulNotifiedValue != 1 || xCommandContext.xReturnStatus != MQTTSuccess) {
+        ESP_LOGE(TAG, "Telemetry publish failed or not acknowledged");
+    }
+}
+
+static void prvCellularPerceptionTask(void *pvParameters)
+{
+    CellularLinkState_t xState = {
+        .xHaveBaseline = false,
+        .lAct = -1,
+        .ulPollMs = CONFIG_PB_CELLULAR_POLL_FAST_MS
+    };
+    pppos_link_quality_t xQuality;
+
+    xNetworkEventGroup = xEventGroupCreate();
+    xEventGroupSetBits(xNetworkEventGroup, CORE_MQTT_AGENT_OTA_NOT_IN_PROGRESS_BIT);
+
+    xCoreMqttAgentManagerRegisterHandler(prvCoreMqttAgentEventHandler);
+
+    while (1) {
+        esp_err_t err = pppos_get_link_quality(&xQuality);
+        if (err == ESP_OK) {
+            int32_t lDbm;
+            bool xKnown = prvCsqToDbm(xQuality.rssi, &lDbm);
+            const char *pcState = "unknown";
+
+            if (xKnown) {
+                bool xDegrading;
+                prvNextPollInterval(&xState, &xQuality, lDbm, &xDegrading);
+                pcState = xDegrading ? "degrading" : "stable";
+                ESP_LOGI(TAG, "csq=%d (%" PRId32 " dBm) ber=%d op=\"%s\" act=%d mode=%d -> %s, next poll in %" PRIu32 " ms",
+                         xQuality.rssi, lDbm, xQuality.ber, xQuality.operator_name, xQuality.act, xQuality.system_mode,
+                         pcState, xState.ulPollMs);
+            } else {
+                /* Not a measurement: neither degrading nor stable, keep the baseline and the poll interval */
+                ESP_LOGI(TAG, "csq=%d (signal unknown) op=\"%s\" act=%d mode=%d, next poll in %" PRIu32 " ms",
+                         xQuality.rssi, xQuality.operator_name, xQuality.act, xQuality.system_mode, xState.ulPollMs);
+            }
+
+            EventBits_t uxBits = xEventGroupGetBits(xNetworkEventGroup);
+            if ((uxBits & (CORE_MQTT_AGENT_CONNECTED_BIT | CORE_MQTT_AGENT_OTA_NOT_IN_PROGRESS_BIT)) ==
+                (CORE_MQTT_AGENT_CONNECTED_BIT | CORE_MQTT_AGENT_OTA_NOT_IN_PROGRESS_BIT)) {
+                publish_cellular_telemetry(&xQuality, xKnown ? &lDbm : NULL, pcState, xState.ulPollMs);
+            }
+        } else if (err == ESP_ERR_INVALID_STATE) {
+            /* PPP session not up yet (or torn down), retry at the slow pace */
+            xState.ulPollMs = CONFIG_PB_CELLULAR_POLL_SLOW_MS;
+        } else if (err == ESP_ERR_NOT_SUPPORTED) {
+            ESP_LOGW(TAG, "Link quality needs CMUX (PB_MODEM_USE_CMUX), stopping cellular perception");
+            vTaskDelete(NULL);
+        } else {
+            ESP_LOGW(TAG, "Failed to query link quality: %s", esp_err_to_name(err));
+            xState.ulPollMs = CONFIG_PB_CELLULAR_POLL_FAST_MS;
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(xState.ulPollMs));
+    }
+}
+
+void vStartCellularPerception(void)
+{
+    xTaskCreate(prvCellularPerceptionTask, "CellularPerception", 4096, NULL, 5, NULL);
+}
@@ -0,0 +1,9 @@
+#ifndef CELLULAR_PERCEPTION_H
+#define CELLULAR_PERCEPTION_H
+
+#include "esp_err.h"
+
+// Function to start the cellular link-quality perception task
+void vStartCellularPerception(void);
+
+#endif // CELLULAR_PERCEPTION_H
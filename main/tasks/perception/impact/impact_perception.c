@@ -0,0 +1,352 @@
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "sdkconfig.h"
+#include "driver/gpio.h"
+#include "core_mqtt.h"
+#include "core_mqtt_agent.h"
+#include "i2cdev.h"
+#include "mpu6050.h"
+#include "boot_orchestrator.h"
+#include "pb_log.h"
+#include "impact_perception.h"
+#include "pppos_client.h"
+
+/*
+ * The MPU6050 on the barrier arm streams its acceleration through the FIFO at
+ * PB_IMPACT_SAMPLE_RATE_HZ. Its Data Ready pulses are counted in the ISR and the
+ * stream task is woken every PB_IMPACT_BATCH_FRAMES of them, to drain the FIFO in
+ * one burst into the ring. The gravity is removed with a 0.5 Hz high-pass and the
+ * RMS and peak of the remaining acceleration are computed per PB_IMPACT_WINDOW_MS.
+ *
+ * Only the events are published, on dt/pb/<city>/<area>/<zone>/<thing>/barrier/impact:
+ * - "impact", a window peaking above PB_IMPACT_PEAK_MG, then nothing for PB_IMPACT_HOLDOFF_MS,
+ * - "tamper", PB_IMPACT_TAMPER_WINDOWS windows in a row with an RMS above PB_IMPACT_TAMPER_RMS_MG,
+ *   once until the RMS drops below it.
+ */
+
+#define IMPACT_TOPIC_BUFFER_LENGTH 128
+#define IMPACT_EVENT_QUEUE_LENGTH 8
+/* More than the 170 frames of acceleration the FIFO holds */
+#define IMPACT_RING_FRAMES 256
+#define IMPACT_WINDOW_FRAMES (CONFIG_PB_IMPACT_SAMPLE_RATE_HZ * CONFIG_PB_IMPACT_WINDOW_MS / 1000)
+/* Wakes the stream task if a pulse is missed, twice the batch period */
+#define IMPACT_DRAIN_TIMEOUT_MS (2 * CONFIG_PB_IMPACT_BATCH_FRAMES * 1000 / CONFIG_PB_IMPACT_SAMPLE_RATE_HZ + 1)
+#define IMPACT_GRAVITY_CUTOFF_HZ 0.5f
+/* At ±8 g */
+#define IMPACT_MG_PER_LSB (1000.0f / 4096.0f)
+
+_Static_assert(IMPACT_WINDOW_FRAMES > 0, "PB_IMPACT_WINDOW_MS shorter than a sample");
+
+#if CONFIG_IDF_TARGET_ESP32
+/* Wired to the SPI flash */
+#define IMPACT_IS_FLASH_GPIO(gpio) ((gpio) >= 6 && (gpio) <= 11)
+_Static_assert(!IMPACT_IS_FLASH_GPIO(CONFIG_PB_IMPACT_SDA_GPIO) && !IMPACT_IS_FLASH_GPIO(CONFIG_PB_IMPACT_SCL_GPIO) &&
+               !IMPACT_IS_FLASH_GPIO(CONFIG_PB_IMPACT_INT_GPIO), "PB_IMPACT_*_GPIO must not be GPIO 6 to 11, the SPI flash pins");
+#endif
+_Static_assert(!PPPOS_IS_MODEM_GPIO(CONFIG_PB_IMPACT_SDA_GPIO) && !PPPOS_IS_MODEM_GPIO(CONFIG_PB_IMPACT_SCL_GPIO) &&
+               !PPPOS_IS_MODEM_GPIO(CONFIG_PB_IMPACT_INT_GPIO), "PB_IMPACT_*_GPIO must not be one of the MODEM_* pins");
+
+typedef enum {
+    IMPACT_EVENT_IMPACT,
+    IMPACT_EVENT_TAMPER,
+} impact_event_type_t;
+
+typedef struct {
+    impact_event_type_t type;
+    int64_t timestamp_us;
+    float peak_mg;
+    float rms_mg;
+    uint32_t windows;
+} impact_event_t;
+
+/* Features of the current window, the gravity is tracked across windows */
+typedef struct {
+    float gravity[3];
+    float alpha;
+    bool settled;
+    uint32_t frames;
+    float sum_sq;
+    float peak_sq;
+    int64_t holdoff_until_us;
+    uint32_t tamper_windows;
+} impact_features_t;
+
+static const char *TAG = "impact_perception";
+extern MQTTAgentContext_t xGlobalMqttAgentContext;
+
+typedef struct MQTTAgentCommandContext
+{
+    MQTTStatus_t xReturnStatus;
+    TaskHandle_t xTaskToNotify;
+    uint32_t ulNotificationValue;
+    void *pArgs;
+} MQTTAgentCommandContext_t;
+
+static mpu6050_dev_t s_mpu;
+static mpu6050_raw_motion_t s_ring[IMPACT_RING_FRAMES];
+static size_t s_ring_head;
+static impact_features_t s_features;
+static QueueHandle_t s_events;
+static TaskHandle_t s_stream_task;
+static uint32_t s_pulses;
+
+static void prvPublishCommandCallback(MQTTAgentCommandContext_t *pxCommandContext, MQTTAgentReturnInfo_t *pxReturnInfo)
+{
+    if (pxCommandContext != NULL) {
+        pxCommandContext->xReturnStatus = pxReturnInfo->returnCode;
+        xTaskNotify(pxCommandContext->xTaskToNotify, pxCommandContext->ulNotificationValue, eSetValueWithOverwrite);
+    }
+}
+
+static BaseType_t prvWaitForCommandAcknowledgment(uint32_t *pulNotifiedValue)
+{
+    return xTaskNotifyWait(0, 0, pulNotifiedValue, portMAX_DELAY);
+}
+
+static void prvPublish(const char *topic, const char *payload)
+{
+    MQTTStatus_t status;
+    MQTTPublishInfo_t publishInfo = {
+        .qos = MQTTQoS1,
+        .pTopicName = topic,
+        .topicNameLength = (uint16_t)strlen(topic),
+        .pPayload = payload,
+        .payloadLength = strlen(payload),
+        .retain = false,
+        .dup = false
+    };
+
+    MQTTAgentCommandContext_t xCommandContext = {0};
+    xCommandContext.xTaskToNotify = xTaskGetCurrentTaskHandle();
+    xCommandContext.ulNotificationValue = 1;
+
+    MQTTAgentCommandInfo_t commandInfo = {
+        .cmdCompleteCallback = prvPublishCommandCallback,
+        .pCmdCompleteCallbackContext = &xCommandContext,
+        .blockTimeMs = 1000
+    };
+
+    xTaskNotifyStateClear(NULL);
+
+    status = MQTTAgent_Publish(&xGlobalMqttAgentContext, &publishInfo, &commandInfo);
+    if (status != MQTTSuccess) {
+        ESP_LOGE(TAG, "Failed to publish to %s: %s", topic, MQTT_Status_strerror(status));
+        return;
+    }
+
+    uint32_t ulNotifiedValue;
+    if (prvWaitForCommandAcknowledgment(&ulNotifiedValue) == pdTRUE && ulNotifiedValue == 1 && xCommandContext.xReturnStatus == MQTTSuccess) {
+        ESP_LOGI(TAG, "Publish to %s acknowledged", topic);
+    } else {
+        ESP_LOGE(TAG, "Publish to %s failed or not acknowledged", topic);
+    }
+}
+
+/* Data Ready pulse, the FIFO is drained every PB_IMPACT_BATCH_FRAMES of them */
+static void IRAM_ATTR prvDataReadyIsr(void *arg)
+{
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    if (++s_pulses >= CONFIG_PB_IMPACT_BATCH_FRAMES) {
+        s_pulses = 0;
+        vTaskNotifyGiveFromISR(s_stream_task, &xHigherPriorityTaskWoken);
+    }
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+static void prvQueueEvent(impact_event_type_t type, float peak_mg, float rms_mg, uint32_t windows)
+{
+    impact_event_t event = {
+        .type = type,
+        .timestamp_us = esp_timer_get_time(),
+        .peak_mg = peak_mg,
+        .rms_mg = rms_mg,
+        .windows = windows,
+    };
+
+    if (xQueueSend(s_events, &event, 0) != pdTRUE) {
+        PB_LOGW(TAG, "Event queue full, %s dropped", type == IMPACT_EVENT_IMPACT ? "impact" : "tamper");
+    }
+}
+
+static void prvCloseWindow(impact_features_t *f)
+{
+    float rms_mg = sqrtf(f->sum_sq / f->frames) * IMPACT_MG_PER_LSB;
+    float peak_mg = sqrtf(f->peak_sq) * IMPACT_MG_PER_LSB;
+    int64_t now = esp_timer_get_time();
+
+    if (peak_mg >= CONFIG_PB_IMPACT_PEAK_MG && now >= f->holdoff_until_us) {
+        f->holdoff_until_us = now + (int64_t)CONFIG_PB_IMPACT_HOLDOFF_MS * 1000;
+        prvQueueEvent(IMPACT_EVENT_IMPACT, peak_mg, rms_mg, 1);
+    }
+
+    if (rms_mg < CONFIG_PB_IMPACT_TAMPER_RMS_MG) {
+        f->tamper_windows = 0;
+    } else if (++f->tamper_windows == CONFIG_PB_IMPACT_TAMPER_WINDOWS) {
+        prvQueueEvent(IMPACT_EVENT_TAMPER, peak_mg, rms_mg, f->tamper_windows);
+    }
+
+    f->frames = 0;
+    f->sum_sq = 0;
+    f->peak_sq = 0;
+}
+
+/* High-passes each frame against the gravity and accumulates the window */
+static void prvExtractFeatures(impact_features_t *f, const mpu6050_raw_motion_t *frames, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        const float a[3] = { frames[i].accel.x, frames[i].accel.y, frames[i].accel.z };
+        float sq = 0;
+
+        if (!f->settled) {
+            /* Starts from the first frame rather than 0 g, not to report the mounting as an impact */
+            memcpy(f->gravity, a, sizeof(a));
+            f->settled = true;
+        }
+        for (int axis = 0; axis < 3; axis++) {
+            f->gravity[axis] += f->alpha * (a[axis] - f->gravity[axis]);
+            float d = a[axis] - f->gravity[axis];
+            sq += d * d;
+        }
+        f->sum_sq += sq;
+        if (sq > f->peak_sq) {
+            f->peak_sq = sq;
+        }
+        if (++f->frames == IMPACT_WINDOW_FRAMES) {
+            prvCloseWindow(f);
+        }
+    }
+}
+
+static esp_err_t prvStartStream(void)
+{
+    esp_err_t ret = mpu6050_init_desc(&s_mpu, MPU6050_I2C_ADDRESS_LOW, CONFIG_PB_IMPACT_I2C_PORT,
+                                      CONFIG_PB_IMPACT_SDA_GPIO, CONFIG_PB_IMPACT_SCL_GPIO);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if ((ret = mpu6050_init(&s_mpu)) != ESP_OK ||
+        (ret = mpu6050_set_full_scale_accel_range(&s_mpu, MPU6050_ACCEL_RANGE_8)) != ESP_OK) {
+        return ret;
+    }
+
+    gpio_config_t io_conf = {
+        .pin_bit_mask = 1ULL << CONFIG_PB_IMPACT_INT_GPIO,
+        .mode = GPIO_MODE_INPUT,
+        .intr_type = GPIO_INTR_POSEDGE,
+    };
+    if ((ret = gpio_config(&io_conf)) != ESP_OK) {
+        return ret;
+    }
+    ret = gpio_install_isr_service(0);
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+        return ret;
+    }
+    if ((ret = gpio_isr_handler_add(CONFIG_PB_IMPACT_INT_GPIO, prvDataReadyIsr, NULL)) != ESP_OK) {
+        return ret;
+    }
+
+    return mpu6050_start_fifo_stream(&s_mpu, CONFIG_PB_IMPACT_SAMPLE_RATE_HZ, false);
+}
+
+static void prvImpactStreamTask(void *pvParameters)
+{
+    boot_wait(BOOT_READY(BOOT_STAGE_DRIVERS), portMAX_DELAY);
+
+    esp_err_t ret = prvStartStream();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start the MPU6050 stream: %s", esp_err_to_name(ret));
+        vTaskDelete(NULL);
+        return;
+    }
+    s_features.alpha = 1.0f - expf(-2.0f * (float)M_PI * IMPACT_GRAVITY_CUTOFF_HZ / CONFIG_PB_IMPACT_SAMPLE_RATE_HZ);
+    ESP_LOGI(TAG, "Streaming at %d Hz, %d frames per burst", CONFIG_PB_IMPACT_SAMPLE_RATE_HZ, CONFIG_PB_IMPACT_BATCH_FRAMES);
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(IMPACT_DRAIN_TIMEOUT_MS));
+
+        /* Up to the end of the ring per burst, a second one from its start if that filled it */
+        size_t count, max;
+        do {
+            max = IMPACT_RING_FRAMES - s_ring_head;
+            ret = mpu6050_read_fifo_stream(&s_mpu, &s_ring[s_ring_head], max, &count);
+            if (ret == ESP_ERR_INVALID_SIZE) {
+                PB_LOGW(TAG, "FIFO overflowed and was reset, the stream task is too slow");
+            } else if (ret != ESP_OK) {
+                PB_LOGE(TAG, "FIFO read failed: %s", esp_err_to_name(ret));
+            }
+            prvExtractFeatures(&s_features, &s_ring[s_ring_head], count);
+            s_ring_head = (s_ring_head + count) % IMPACT_RING_FRAMES;
+        } while (ret == ESP_OK && count == max);
+    }
+}
+
+static void publish_event(const impact_event_t *event)
+{
+    char topic[IMPACT_TOPIC_BUFFER_LENGTH];
+    char payload[256];
+    char timestamp[32];
+    time_t now;
+
+    time(&now);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    snprintf(topic, sizeof(topic), "dt/pb/%s/%s/%s/%s/barrier/impact",
+             CONFIG_PB_CITY, CONFIG_PB_AREA, CONFIG_PB_ZONE, CONFIG_GRI_THING_NAME);
+    snprintf(payload, sizeof(payload),
+             "{\"timestamp\": \"%s\", \"event\": \"%s\", \"age_ms\": %" PRId64 ", \"peak_mg\": %.0f, \"rms_mg\": %.0f, \"windows\": %" PRIu32 "}",
+             timestamp, event->type == IMPACT_EVENT_IMPACT ? "impact" : "tamper",
+             (esp_timer_get_time() - event->timestamp_us) / 1000, event->peak_mg, event->rms_mg, event->windows);
+
+    prvPublish(topic, payload);
+}
+
+static void prvImpactPerceptionTask(void *pvParameters)
+{
+    boot_wait(BOOT_READY(BOOT_STAGE_MQTT), portMAX_DELAY);
+
+    while (1) {
+        impact_event_t event;
+        xQueueReceive(s_events, &event, portMAX_DELAY);
+        ESP_LOGI(TAG, "%s: peak %.0f mg, RMS %.0f mg", event.type == IMPACT_EVENT_IMPACT ? "Impact" : "Tamper",
+                 event.peak_mg, event.rms_mg);
+#if CONFIG_PB_MODEM_POWER_SAVING
+        if (pppos_radio_acquire(CONFIG_PB_MODEM_RADIO_WAKE_TIMEOUT_MS) == ESP_ERR_TIMEOUT) {
+            ESP_LOGW(TAG, "Cellular link not up, publishing anyway");
+        }
+        publish_event(&event);
+        pppos_radio_release();
+#else
+        publish_event(&event);
+#endif
+    }
+}
+
+esp_err_t impact_perception_start(void)
+{
+    /* Once, it resets the state of every i2cdev port */
+    esp_err_t ret = i2cdev_init();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    s_events = xQueueCreate(IMPACT_EVENT_QUEUE_LENGTH, sizeof(impact_event_t));
+    if (s_events == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    /* Above the other perception tasks, the FIFO overflows after 170 ms at 1 kHz */
+    if (xTaskCreate(prvImpactStreamTask, "ImpactStream", CONFIG_PB_IMPACT_TASK_STACK_SIZE, NULL, 6, &s_stream_task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreate(prvImpactPerceptionTask, "ImpactPerception", 4096, NULL, 5, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
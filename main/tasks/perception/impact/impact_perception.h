@@ -0,0 +1,10 @@
+#ifndef IMPACT_PERCEPTION_H
+#define IMPACT_PERCEPTION_H
+
+#include "esp_err.h"
+
+// Starts streaming the MPU6050 on the barrier arm, impact and tamper events are published.
+// Initializes i2cdev, returns its error or ESP_ERR_NO_MEM.
+esp_err_t impact_perception_start(void);
+
+#endif // IMPACT_PERCEPTION_H
@@ -13,6 +13,8 @@
 #include "core_mqtt_agent_manager.h"
 #include "core_mqtt_agent_manager_events.h"
 #include "hcsr04_sensor.h"
+#include "pb_log.h"
+#include "sensor_sampler.h"
 #include "driver/gpio.h"
 #include "obstacle_perception.h"
 
@@ -25,6 +27,8 @@
 #define LOCKED_LIMIT_SWITCH_GPIO CONFIG_PB_LOCKED_LIMIT_SWITCH_GPIO
 #define UNLOCKED_LIMIT_SWITCH_GPIO CONFIG_PB_UNLOCKED_LIMIT_SWITCH_GPIO
 
+#define OBSTACLE_SAMPLE_RING_LENGTH 8
+
 static const char *TAG = "obstacle_perception";
 extern MQTTAgentContext_t xGlobalMqttAgentContext;
 static EventGroupHandle_t xNetworkEventGroup;
@@ -34,7 +38,16 @@ static hcsr04_sensor_t sensor = {
 };
 
 static void prvCoreMqttAgentEventHandler(void *pvHandlerArg, esp_event_base_t xEventBase, int32_t lEventId, void *pvEventData);
-static void prvObstaclePerceptionTask(void *pvParameters);
+static esp_err_t prvObstacleCollect(void *ctx, sensor_sample_t *sample);
+
+static sensor_sample_t s_obstacle_ring[OBSTACLE_SAMPLE_RING_LENGTH];
+static sensor_sampler_sensor_t s_obstacle_sensor = {
+    .name = "HC-SR04",
+    .period_ms = CONFIG_PB_OBSTACLE_SAMPLE_PERIOD_MS,
+    .collect = prvObstacleCollect,
+    .ring = s_obstacle_ring,
+    .ring_len = OBSTACLE_SAMPLE_RING_LENGTH,
+};
 
 typedef struct MQTTAgentCommandContext
 {
@@ -77,75 +90,51 @@ static void prvCoreMqttAgentEventHandler(void *pvHandlerArg, esp_event_base_t xE
     }
 }
 
-static void prvObstaclePerceptionTask(void *pvParameters)
+/* Runs in the sampler task: distance, then the locked and unlocked limit switches */
+static esp_err_t prvObstacleCollect(void *ctx, sensor_sample_t *sample)
 {
-    ESP_LOGI(TAG, "Initializing obstacle perception task");
-
-    hcsr04_sensor_init(&sensor);
-
-    while (1) {
-        uint32_t distance_cm;
-
-        esp_err_t result = hcsr04_sensor_measure_cm(&sensor, 500, &distance_cm);
+    uint32_t distance_cm;
 
-        if (result != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to measure distance: %s", esp_err_to_name(result));
-        }
+    (void)ctx;
+    esp_err_t result = hcsr04_sensor_measure_cm(&sensor, 100, &distance_cm); // Start with a max distance of 100 cm
+    if (result != ESP_OK) {
+        return result;
+    }
 
-        // Check the status of the limit switches
-        if (gpio_get_level(LOCKED_LIMIT_SWITCH_GPIO) == 0) {
-            ESP_LOGI(TAG, "Obstacle detected: Distance = %" PRIu32 " cm", distance_cm);
-            // Publish an obstacle detected event
-            // Add your MQTT publish logic here if needed
-        }
+    int locked = gpio_get_level(LOCKED_LIMIT_SWITCH_GPIO);
+    int unlocked = gpio_get_level(UNLOCKED_LIMIT_SWITCH_GPIO);
 
-        if (gpio_get_level(UNLOCKED_LIMIT_SWITCH_GPIO) == 1) {
-            ESP_LOGI(TAG, "Vehicle detected: Distance = %" PRIu32 " cm", distance_cm);
-            // Publish a vehicle detected event
-            // Add your MQTT publish logic here if needed
-        }
+    // Check the status of the limit switches
+    if (locked == 1) {
+        PB_LOGI(TAG, "Obstacle detected: Distance = %" PRIu32 " cm", distance_cm);
+        // Publish an obstacle detected event
+        // Add your MQTT publish logic here if needed
+    }
 
-        vTaskDelay(pdMS_TO_TICKS(1000)); // Measure every 1 second
+    if (unlocked == 1) {
+        PB_LOGI(TAG, "Vehicle detected: Distance = %" PRIu32 " cm", distance_cm);
+        // Publish a vehicle detected event
+        // Add your MQTT publish logic here if needed
     }
+
+    sample->values[0] = distance_cm;
+    sample->values[1] = locked;
+    sample->values[2] = unlocked;
+    return ESP_OK;
 }
 
-void ultrasonic_test_task(void *pvParameters)
+void vStartObstaclePerception(void)
 {
     ESP_LOGI(TAG, "Initializing ultrasonic sensor");
 
     esp_err_t init_result = hcsr04_sensor_init(&sensor);
     if (init_result != ESP_OK) {
         ESP_LOGE(TAG, "Failed to initialize ultrasonic sensor: %s", esp_err_to_name(init_result));
-        vTaskDelete(NULL);
+        return;
     }
 
-    while (1) {
-        uint32_t distance_cm;
-
-        esp_err_t result = hcsr04_sensor_measure_cm(&sensor, 100, &distance_cm); // Start with a max distance of 100 cm
-
-        if (result != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to measure distance: %s (0x%x)", esp_err_to_name(result), result);
-        }
-
-        // Check the status of the limit switches
-        if (gpio_get_level(LOCKED_LIMIT_SWITCH_GPIO) == 1) {
-            ESP_LOGI(TAG, "Obstacle detected: Distance = %" PRIu32 " cm", distance_cm);
-            // Publish an obstacle detected event
-            // Add your MQTT publish logic here if needed
-        }
-
-        if (gpio_get_level(UNLOCKED_LIMIT_SWITCH_GPIO) == 1) {
-            ESP_LOGI(TAG, "Vehicle detected: Distance = %" PRIu32 " cm", distance_cm);
-            // Publish a vehicle detected event
-            // Add your MQTT publish logic here if needed
-        }
-
-        vTaskDelay(pdMS_TO_TICKS(1000)); // Measure every 1 second
+    // Measured every PB_OBSTACLE_SAMPLE_PERIOD_MS by the sampler task
+    if (sensor_sampler_register(&s_obstacle_sensor) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register the ultrasonic sensor with the sampler");
     }
 }
-
-void vStartObstaclePerception(void)
-{
-    xTaskCreate(ultrasonic_test_task, "ObstaclePerception", 4096, NULL, 5, NULL);
-}
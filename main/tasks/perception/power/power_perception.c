@@ -11,19 +11,49 @@
 #include "core_mqtt_agent.h"
 #include "core_mqtt_agent_manager.h"
 #include "core_mqtt_agent_manager_events.h"
+#include "core_json.h"
+#include "subscription_manager.h"
 #include "ina3221_sensor.h"
+#include "boot_orchestrator.h"
+#include "sensor_sampler.h"
 #include "power_perception.h"
+#if CONFIG_PB_MODEM_POWER_SAVING
+#include "pppos_client.h"
+#endif
 
 #define CORE_MQTT_AGENT_CONNECTED_BIT (1 << 0)
 #define CORE_MQTT_AGENT_OTA_NOT_IN_PROGRESS_BIT (1 << 1)
 
+#define POWER_I2C_SCAN_REQUESTED_BIT (1 << 2)
+
+#define POWER_PUBLISH_INTERVAL_MS 180000
+#define POWER_TOPIC_BUFFER_LENGTH 128
+#define POWER_SAMPLE_RING_LENGTH 4
+
 static const char *TAG = "power_perception";
 extern MQTTAgentContext_t xGlobalMqttAgentContext;
 static EventGroupHandle_t xNetworkEventGroup;
+static char diagnosticsTopicBuf[POWER_TOPIC_BUFFER_LENGTH];
 
 static void prvCoreMqttAgentEventHandler(void *pvHandlerArg, esp_event_base_t xEventBase, int32_t lEventId, void *pvEventData);
 static void prvPowerPerceptionTask(void *pvParameters);
 static void publish_telemetry(ina3221_reading_t readings[3]);
+static void publish_i2c_inventory(void);
+static esp_err_t prvPowerTrigger(void *ctx, uint32_t *conversion_ms);
+static esp_err_t prvPowerCollect(void *ctx, sensor_sample_t *sample);
+
+_Static_assert(3 * sizeof(ina3221_reading_t) <= sizeof(((sensor_sample_t *)0)->values),
+               "PB_SENSOR_SAMPLER_MAX_VALUES too small for the 3 INA3221 channels");
+
+static sensor_sample_t s_power_ring[POWER_SAMPLE_RING_LENGTH];
+static sensor_sampler_sensor_t s_power_sensor = {
+    .name = "INA3221",
+    .period_ms = CONFIG_PB_POWER_SAMPLE_PERIOD_MS,
+    .trigger = prvPowerTrigger,
+    .collect = prvPowerCollect,
+    .ring = s_power_ring,
+    .ring_len = POWER_SAMPLE_RING_LENGTH,
+};
 
 typedef struct MQTTAgentCommandContext
 {
@@ -79,40 +109,15 @@ static BaseType_t prvWaitForCommandAcknowledgment(uint32_t *pulNotifiedValue)
     return xTaskNotifyWait(0, 0, pulNotifiedValue, portMAX_DELAY);
 }
 
-static void publish_telemetry(ina3221_reading_t readings[3])
+static void prvPublish(const char *topic, const char *payload)
 {
-    char telemetry_topic[128];
-    char telemetry_payload[512];
-    time_t now;
-    time(&now);
-    struct tm *timeinfo = gmtime(&now);
-    char timestamp[32];
-    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", timeinfo);
-
-    snprintf(telemetry_topic, sizeof(telemetry_topic), "dt/pb/%s/%s/%s/%s/power",
-             CONFIG_PB_CITY, CONFIG_PB_AREA, CONFIG_PB_ZONE, CONFIG_GRI_THING_NAME);
-
-    ESP_LOGI(TAG, "Publishing power sensor data to telemetry topic: %s", telemetry_topic);
-
-    snprintf(telemetry_payload, sizeof(telemetry_payload),
-             "{\"timestamp\": \"%s\", \"channels\": ["
-             "{\"channel\": 1, \"type\": \"regulator\", \"bus_voltage_v\": %.2f, \"shunt_voltage_mv\": %.2f, \"load_voltage_v\": %.2f, \"current_ma\": %.2f},"
-             "{\"channel\": 2, \"type\": \"battery\", \"bus_voltage_v\": %.2f, \"shunt_voltage_mv\": %.2f, \"load_voltage_v\": %.2f, \"current_ma\": %.2f},"
-             "{\"channel\": 3, \"type\": \"motor\", \"bus_voltage_v\": %.2f, \"shunt_voltage_mv\": %.2f, \"load_voltage_v\": %.2f, \"current_ma\": %.2f}"
-             "], \"session-id\": \"session-987654321\", \"status\": \"ok\"}",
-             timestamp,
-             readings[0].bus_voltage, readings[0].shunt_voltage, readings[0].load_voltage, readings[0].current,
-             readings[1].bus_voltage, readings[1].shunt_voltage, readings[1].load_voltage, readings[1].current,
-             readings[2].bus_voltage, readings[2].shunt_voltage, readings[2].load_voltage, readings[2].current);
-
-
     MQTTStatus_t status;
     MQTTPublishInfo_t publishInfo = {
         .qos = MQTTQoS1,
-        .pTopicName = telemetry_topic,
-        .topicNameLength = (uint16_t)strlen(telemetry_topic),
-        .pPayload = telemetry_payload,
-        .payloadLength = strlen(telemetry_payload),
+        .pTopicName = topic,
+        .topicNameLength = (uint16_t)strlen(topic),
+        .pPayload = payload,
+        .payloadLength = strlen(payload),
         .retain = false,
         .dup = false
     };
@@ -137,37 +142,218 @@ static void publish_telemetry(ina3221_reading_t readings[3])
 
     status = MQTTAgent_Publish(&xGlobalMqttAgentContext, &publishInfo, &commandInfo);
     if (status != MQTTSuccess) {
-        ESP_LOGE(TAG, "Failed to publish telemetry: %s", MQTT_Status_strerror(status));
+        ESP_LOGE(TAG, "Failed to publish to %s: %s", topic, MQTT_Status_strerror(status));
         return;
     }
 
     uint32_t ulNotifiedValue;
     if (prvWaitForCommandAcknowledgment(&ulNotifiedValue) == pdTRUE && ulNotifiedValue == 1 && xCommandContext.xReturnStatus == MQTTSuccess) {
-        ESP_LOGI(TAG, "Telemetry publish acknowledged");
+        ESP_LOGI(TAG, "Publish to %s acknowledged", topic);
+    } else {
+        ESP_LOGE(TAG, "Publish to %s failed or not acknowledged", topic);
+    }
+}
+
+/* Runs in the agent task; the scan itself is left to the perception task */
+static void prvIncomingPublishCallback(void *pvIncomingPublishCallbackContext, MQTTPublishInfo_t *pxPublishInfo)
+{
+    char *outValue = NULL;
+    size_t outValueLength = 0;
+    const char *payload = (const char *)pxPublishInfo->pPayload;
+
+    (void)pvIncomingPublishCallbackContext;
+
+    if (JSON_Validate(payload, pxPublishInfo->payloadLength) != JSONSuccess ||
+        JSON_Search((char *)payload, pxPublishInfo->payloadLength, "command", strlen("command"), &outValue, &outValueLength) != JSONSuccess) {
+        ESP_LOGE(TAG, "Invalid diagnostics command: %.*s", (int)pxPublishInfo->payloadLength, payload);
+        return;
+    }
+
+    if (outValueLength == strlen("i2c_scan") && strncmp(outValue, "i2c_scan", outValueLength) == 0) {
+        ESP_LOGI(TAG, "I2C scan requested");
+        xEventGroupSetBits(xNetworkEventGroup, POWER_I2C_SCAN_REQUESTED_BIT);
     } else {
-        ESP_LOGE(TAG, "Telemetry publish failed or not acknowledged");
+        ESP_LOGE(TAG, "Unknown command: %.*s", (int)outValueLength, outValue);
+    }
+}
+
+static void prvSubscribeCommandCallback(MQTTAgentCommandContext_t *pxCommandContext, MQTTAgentReturnInfo_t *pxReturnInfo)
+{
+    MQTTAgentSubscribeArgs_t *pxSubscribeArgs = (MQTTAgentSubscribeArgs_t *)pxCommandContext->pArgs;
+
+    pxCommandContext->xReturnStatus = pxReturnInfo->returnCode;
+
+    if (pxReturnInfo->returnCode == MQTTSuccess &&
+        !addSubscription((SubscriptionElement_t *)xGlobalMqttAgentContext.pIncomingCallbackContext,
+                         pxSubscribeArgs->pSubscribeInfo->pTopicFilter,
+                         pxSubscribeArgs->pSubscribeInfo->topicFilterLength,
+                         prvIncomingPublishCallback,
+                         NULL)) {
+        ESP_LOGE(TAG, "Failed to register an incoming publish callback for topic %.*s.",
+                 pxSubscribeArgs->pSubscribeInfo->topicFilterLength,
+                 pxSubscribeArgs->pSubscribeInfo->pTopicFilter);
     }
+
+    xTaskNotify(pxCommandContext->xTaskToNotify, (uint32_t)(pxReturnInfo->returnCode), eSetValueWithOverwrite);
+}
+
+static bool prvSubscribeToTopic(MQTTQoS_t xQoS, char *pcTopicFilter)
+{
+    MQTTStatus_t xCommandAdded;
+    MQTTAgentSubscribeArgs_t xSubscribeArgs;
+    MQTTSubscribeInfo_t xSubscribeInfo;
+    MQTTAgentCommandContext_t xApplicationDefinedContext = {0};
+    MQTTAgentCommandInfo_t xCommandParams = {0};
+
+    xTaskNotifyStateClear(NULL);
+
+    xSubscribeInfo.pTopicFilter = pcTopicFilter;
+    xSubscribeInfo.topicFilterLength = (uint16_t)strlen(pcTopicFilter);
+    xSubscribeInfo.qos = xQoS;
+    xSubscribeArgs.pSubscribeInfo = &xSubscribeInfo;
+    xSubscribeArgs.numSubscriptions = 1;
+
+    xApplicationDefinedContext.xTaskToNotify = xTaskGetCurrentTaskHandle();
+    xApplicationDefinedContext.pArgs = (void *)&xSubscribeArgs;
+
+    xCommandParams.blockTimeMs = 1000;
+    xCommandParams.cmdCompleteCallback = prvSubscribeCommandCallback;
+    xCommandParams.pCmdCompleteCallbackContext = (void *)&xApplicationDefinedContext;
+
+    do {
+        xCommandAdded = MQTTAgent_Subscribe(&xGlobalMqttAgentContext, &xSubscribeArgs, &xCommandParams);
+    } while (xCommandAdded != MQTTSuccess);
+
+    if (prvWaitForCommandAcknowledgment(NULL) != pdTRUE || xApplicationDefinedContext.xReturnStatus != MQTTSuccess) {
+        ESP_LOGE(TAG, "Error or timed out waiting for ack to subscribe message topic %s", pcTopicFilter);
+        return false;
+    }
+    return true;
+}
+
+static esp_err_t prvPowerTrigger(void *ctx, uint32_t *conversion_ms)
+{
+    (void)ctx;
+    return ina3221_trigger(conversion_ms);
+}
+
+/* Runs in the sampler task, once the conversion of the 3 channels is done */
+static esp_err_t prvPowerCollect(void *ctx, sensor_sample_t *sample)
+{
+    ina3221_reading_t readings[3];
+
+    (void)ctx;
+    for (uint8_t channel = 1; channel <= 3; channel++) {
+        esp_err_t ret = ina3221_read_channel(channel, &readings[channel - 1]);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    memcpy(sample->values, readings, sizeof(readings));
+    return ESP_OK;
+}
+
+static void publish_i2c_inventory(void)
+{
+    char topic[POWER_TOPIC_BUFFER_LENGTH];
+    char payload[512];
+    i2c_inventory_t inventory;
+
+    esp_err_t ret = ina3221_scan_bus(&inventory);
+
+    snprintf(topic, sizeof(topic), "dt/pb/%s/%s/%s/%s/power/i2c_inventory",
+             CONFIG_PB_CITY, CONFIG_PB_AREA, CONFIG_PB_ZONE, CONFIG_GRI_THING_NAME);
+
+    size_t len = snprintf(payload, sizeof(payload), "{\"status\": \"%s\", \"scan_ms\": %" PRIu32 ", \"devices\": [",
+                          ret == ESP_OK ? "ok" : esp_err_to_name(ret), inventory.scan_ms);
+    /* 16 devices fit in the payload, so no need to handle truncation mid-array */
+    for (int i = 0; i < inventory.count; i++) {
+        len += snprintf(payload + len, sizeof(payload) - len, "%s{\"address\": %u, \"id\": %u}",
+                        i == 0 ? "" : ", ", inventory.devices[i].address, inventory.devices[i].id);
+    }
+    snprintf(payload + len, sizeof(payload) - len, "]}");
+
+    prvPublish(topic, payload);
+}
+
+static void publish_telemetry(ina3221_reading_t readings[3])
+{
+    char telemetry_topic[128];
+    char telemetry_payload[512];
+    time_t now;
+    time(&now);
+    struct tm *timeinfo = gmtime(&now);
+    char timestamp[32];
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", timeinfo);
+
+    snprintf(telemetry_topic, sizeof(telemetry_topic), "dt/pb/%s/%s/%s/%s/power",
+             CONFIG_PB_CITY, CONFIG_PB_AREA, CONFIG_PB_ZONE, CONFIG_GRI_THING_NAME);
+
+    ESP_LOGI(TAG, "Publishing power sensor data to telemetry topic: %s", telemetry_topic);
+
+    snprintf(telemetry_payload, sizeof(telemetry_payload),
+             "{\"timestamp\": \"%s\", \"channels\": ["
+             "{\"channel\": 1, \"type\": \"regulator\", \"bus_voltage_v\": %.2f, \"shunt_voltage_mv\": %.2f, \"load_voltage_v\": %.2f, \"current_ma\": %.2f},"
+             "{\"channel\": 2, \"type\": \"battery\", \"bus_voltage_v\": %.2f, \"shunt_voltage_mv\": %.2f, \"load_voltage_v\": %.2f, \"current_ma\": %.2f},"
+             "{\"channel\": 3, \"type\": \"motor\", \"bus_voltage_v\": %.2f, \"shunt_voltage_mv\": %.2f, \"load_voltage_v\": %.2f, \"current_ma\": %.2f}"
+             "], \"session-id\": \"session-987654321\", \"status\": \"ok\"}",
+             timestamp,
+             readings[0].bus_voltage, readings[0].shunt_voltage, readings[0].load_voltage, readings[0].current,
+             readings[1].bus_voltage, readings[1].shunt_voltage, readings[1].load_voltage, readings[1].current,
+             readings[2].bus_voltage, readings[2].shunt_voltage, readings[2].load_voltage, readings[2].current);
+
+    prvPublish(telemetry_topic, telemetry_payload);
 }
 
 static void prvPowerPerceptionTask(void *pvParameters)
 {
-    ina3221_init();
+    /* The INA3221 is initialized with the other drivers at boot */
+    boot_wait(BOOT_READY(BOOT_STAGE_DRIVERS) | BOOT_READY(BOOT_STAGE_MQTT), portMAX_DELAY);
     ina3221_reading_t readings[3];
 
+    xNetworkEventGroup = xEventGroupCreate();
+    snprintf(diagnosticsTopicBuf, sizeof(diagnosticsTopicBuf), "cmd/pb/%s/%s/%s/%s/power/diagnostics",
+             CONFIG_PB_CITY, CONFIG_PB_AREA, CONFIG_PB_ZONE, CONFIG_GRI_THING_NAME);
+    if (!prvSubscribeToTopic(MQTTQoS1, diagnosticsTopicBuf)) {
+        ESP_LOGE(TAG, "Failed to subscribe to topic %s, I2C scans on request disabled", diagnosticsTopicBuf);
+    }
+
     while (1) {
-        for (uint8_t channel = 1; channel <= 3; channel++) {
-            if (ina3221_read_channel(channel, &readings[channel - 1]) != ESP_OK) {
-                ESP_LOGE(TAG, "Failed to read channel %d", channel);
+        /* The channels are sampled by the sampler task, the last sample is published */
+        sensor_sample_t sample;
+        if (!sensor_sampler_latest(&s_power_sensor, &sample) || sample.status != ESP_OK) {
+            ESP_LOGE(TAG, "No power sample to publish");
+        } else {
+            memcpy(readings, sample.values, sizeof(readings));
+#if CONFIG_PB_MODEM_POWER_SAVING
+            /* Keep the modem awake for the publish window and tell it when the next one opens */
+            if (pppos_radio_acquire(CONFIG_PB_MODEM_RADIO_WAKE_TIMEOUT_MS) == ESP_ERR_TIMEOUT) {
+                ESP_LOGW(TAG, "Cellular link not up, publishing anyway");
             }
+            publish_telemetry(readings);
+            pppos_radio_schedule(POWER_PUBLISH_INTERVAL_MS);
+            pppos_radio_release();
+#else
+            publish_telemetry(readings);
+#endif
         }
 
-        publish_telemetry(readings);
-
-        vTaskDelay(pdMS_TO_TICKS(180000)); // Publish every 30 seconds
+        /* Bus scans are only run on request, between two publish windows */
+        TimeOut_t xTimeOut;
+        TickType_t xTicksToWait = pdMS_TO_TICKS(POWER_PUBLISH_INTERVAL_MS);
+        vTaskSetTimeOutState(&xTimeOut);
+        while (xTaskCheckForTimeOut(&xTimeOut, &xTicksToWait) == pdFALSE) {
+            if (xEventGroupWaitBits(xNetworkEventGroup, POWER_I2C_SCAN_REQUESTED_BIT, pdTRUE, pdFALSE, xTicksToWait) & POWER_I2C_SCAN_REQUESTED_BIT) {
+                publish_i2c_inventory();
+            }
+        }
     }
 }
 
 void vStartPowerPerception(void)
 {
+    if (sensor_sampler_register(&s_power_sensor) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register the INA3221 with the sampler");
+    }
     xTaskCreate(prvPowerPerceptionTask, "PowerPerception", 4096, NULL, 5, NULL);
 }
@@ -0,0 +1,227 @@
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "boot_orchestrator.h"
+#include "pb_log.h"
+#include "sensor_sampler.h"
+
+static const char *TAG = "sensor_sampler";
+
+/* Min-heap of the registered sensors on deadline_us, a sensor being sampled is out of it */
+static sensor_sampler_sensor_t *s_heap[CONFIG_PB_SENSOR_SAMPLER_MAX_SENSORS];
+static size_t s_heap_len;
+static size_t s_registered;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t s_task;
+
+static void prvHeapPush(sensor_sampler_sensor_t *sensor)
+{
+    size_t i = s_heap_len++;
+
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (s_heap[parent]->deadline_us <= sensor->deadline_us) {
+            break;
+        }
+        s_heap[i] = s_heap[parent];
+        i = parent;
+    }
+    s_heap[i] = sensor;
+}
+
+static sensor_sampler_sensor_t *prvHeapPop(void)
+{
+    sensor_sampler_sensor_t *top = s_heap[0];
+    sensor_sampler_sensor_t *last = s_heap[--s_heap_len];
+    size_t i = 0;
+
+    while (2 * i + 1 < s_heap_len) {
+        size_t child = 2 * i + 1;
+        if (child + 1 < s_heap_len && s_heap[child + 1]->deadline_us < s_heap[child]->deadline_us) {
+            child++;
+        }
+        if (last->deadline_us <= s_heap[child]->deadline_us) {
+            break;
+        }
+        s_heap[i] = s_heap[child];
+        i = child;
+    }
+    if (s_heap_len > 0) {
+        s_heap[i] = last;
+    }
+    return top;
+}
+
+static TickType_t prvTicksUntil(int64_t delta_us)
+{
+    const int64_t tick_us = portTICK_PERIOD_MS * 1000;
+    TickType_t ticks = (TickType_t)((delta_us + tick_us - 1) / tick_us);
+
+    return ticks > 0 ? ticks : 1;
+}
+
+static void prvStoreSample(sensor_sampler_sensor_t *sensor, const sensor_sample_t *sample)
+{
+    taskENTER_CRITICAL(&s_lock);
+    sensor->ring[sensor->head] = *sample;
+    sensor->head = (sensor->head + 1) % sensor->ring_len;
+    if (sensor->count < sensor->ring_len) {
+        sensor->count++;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+/* Runs the due phase of the sensor and sets the deadline of the next one */
+static void prvSample(sensor_sampler_sensor_t *sensor, int64_t now)
+{
+    sensor_sample_t sample = { 0 };
+    const int64_t period_us = (int64_t)sensor->period_ms * 1000;
+
+    if (!sensor->converting && sensor->trigger != NULL) {
+        uint32_t conversion_ms = 0;
+        sample.status = sensor->trigger(sensor->ctx, &conversion_ms);
+        if (sample.status == ESP_OK) {
+            /* Collected once the conversion is done, the other sensors run meanwhile */
+            sensor->converting = true;
+            sensor->deadline_us = now + (int64_t)conversion_ms * 1000;
+            return;
+        }
+    } else {
+        sample.status = sensor->collect(sensor->ctx, &sample);
+    }
+    sensor->converting = false;
+    sample.timestamp_us = esp_timer_get_time();
+    if (sample.status != ESP_OK) {
+        PB_LOGW(TAG, "Sampling %s failed: %s", sensor->name, esp_err_to_name(sample.status));
+    }
+    prvStoreSample(sensor, &sample);
+
+    /* The next period starts from the release time, so that the conversions don't make it drift */
+    sensor->release_us += period_us;
+    if (sensor->release_us <= now) {
+        int64_t missed = (now - sensor->release_us) / period_us + 1;
+        sensor->overruns += missed;
+        sensor->release_us += missed * period_us;
+        PB_LOGW(TAG, "%s late, %" PRId64 " periods skipped", sensor->name, missed);
+    }
+    sensor->deadline_us = sensor->release_us;
+}
+
+static void prvSensorSamplerTask(void *pvParameters)
+{
+    /* The sensors are initialized with the other drivers at boot */
+    boot_wait(BOOT_READY(BOOT_STAGE_DRIVERS), portMAX_DELAY);
+
+    /* The periods of the sensors registered meanwhile start now, they aren't late.
+     * The deadlines are all the same, so the heap stays ordered */
+    int64_t start = esp_timer_get_time();
+    taskENTER_CRITICAL(&s_lock);
+    for (size_t i = 0; i < s_heap_len; i++) {
+        s_heap[i]->release_us = start;
+        s_heap[i]->deadline_us = start;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+
+    while (1) {
+        sensor_sampler_sensor_t *sensor = NULL;
+        TickType_t xTicksToWait = portMAX_DELAY;
+        int64_t now = esp_timer_get_time();
+
+        taskENTER_CRITICAL(&s_lock);
+        if (s_heap_len > 0) {
+            if (s_heap[0]->deadline_us <= now) {
+                sensor = prvHeapPop();
+            } else {
+                xTicksToWait = prvTicksUntil(s_heap[0]->deadline_us - now);
+            }
+        }
+        taskEXIT_CRITICAL(&s_lock);
+
+        if (sensor == NULL) {
+            /* Woken early by a registration, the deadlines are checked again */
+            ulTaskNotifyTake(pdTRUE, xTicksToWait);
+            continue;
+        }
+
+        prvSample(sensor, now);
+
+        taskENTER_CRITICAL(&s_lock);
+        prvHeapPush(sensor);
+        taskEXIT_CRITICAL(&s_lock);
+    }
+}
+
+esp_err_t sensor_sampler_start(void)
+{
+    if (s_task != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (xTaskCreate(prvSensorSamplerTask, "SensorSampler", CONFIG_PB_SENSOR_SAMPLER_TASK_STACK_SIZE, NULL, 5, &s_task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create the sampler task");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t sensor_sampler_register(sensor_sampler_sensor_t *sensor)
+{
+    if (sensor == NULL || sensor->collect == NULL || sensor->ring == NULL || sensor->ring_len == 0 || sensor->period_ms == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    sensor->release_us = esp_timer_get_time();
+    sensor->deadline_us = sensor->release_us;
+    sensor->converting = false;
+    sensor->head = 0;
+    sensor->count = 0;
+    sensor->overruns = 0;
+
+    taskENTER_CRITICAL(&s_lock);
+    if (s_registered == CONFIG_PB_SENSOR_SAMPLER_MAX_SENSORS) {
+        taskEXIT_CRITICAL(&s_lock);
+        ESP_LOGE(TAG, "No room for %s, raise PB_SENSOR_SAMPLER_MAX_SENSORS", sensor->name);
+        return ESP_ERR_NO_MEM;
+    }
+    s_registered++;
+    prvHeapPush(sensor);
+    taskEXIT_CRITICAL(&s_lock);
+
+    if (s_task != NULL) {
+        xTaskNotifyGive(s_task);
+    }
+    ESP_LOGI(TAG, "%s sampled every %" PRIu32 " ms%s", sensor->name, sensor->period_ms,
+             sensor->trigger != NULL ? ", triggered" : "");
+    return ESP_OK;
+}
+
+bool sensor_sampler_latest(sensor_sampler_sensor_t *sensor, sensor_sample_t *sample)
+{
+    bool found = false;
+
+    taskENTER_CRITICAL(&s_lock);
+    if (sensor->count > 0) {
+        *sample = sensor->ring[(sensor->head + sensor->ring_len - 1) % sensor->ring_len];
+        found = true;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+    return found;
+}
+
+size_t sensor_sampler_read(sensor_sampler_sensor_t *sensor, sensor_sample_t *samples, size_t max_samples)
+{
+    size_t copied = 0;
+
+    taskENTER_CRITICAL(&s_lock);
+    size_t tail = (sensor->head + sensor->ring_len - sensor->count) % sensor->ring_len;
+    while (copied < max_samples && copied < sensor->count) {
+        samples[copied++] = sensor->ring[tail];
+        tail = (tail + 1) % sensor->ring_len;
+    }
+    sensor->count -= copied;
+    taskEXIT_CRITICAL(&s_lock);
+    return copied;
+}
@@ -0,0 +1,76 @@
+#ifndef SENSOR_SAMPLER_H
+#define SENSOR_SAMPLER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+/*
+ * Single task sampling every sensor at its own period, in deadline order.
+ *
+ * A sensor with a trigger() is sampled in two phases: trigger() starts the
+ * conversion and returns its duration, collect() is called once it has
+ * elapsed. Other sensors are collected directly. The sampler runs other
+ * sensors in between, no task waits for a conversion. Samples go to a ring
+ * buffer of the sensor, read by the publishing task.
+ *
+ * Triggered drivers of esp-idf-lib fit this directly, for example sht3x:
+ * sht3x_start_measurement() and sht3x_get_measurement_duration() in trigger(),
+ * sht3x_get_results() in collect().
+ */
+
+typedef struct {
+    int64_t timestamp_us;   // esp_timer time of the collection
+    esp_err_t status;       // Of trigger() or collect(), values are invalid unless ESP_OK
+    float values[CONFIG_PB_SENSOR_SAMPLER_MAX_VALUES];
+} sensor_sample_t;
+
+typedef struct sensor_sampler_sensor {
+    const char *name;
+    uint32_t period_ms;
+    // Starts a conversion and sets its duration. NULL if the sensor is read directly
+    esp_err_t (*trigger)(void *ctx, uint32_t *conversion_ms);
+    // Reads the sample, called from the sampler task: mustn't block for long
+    esp_err_t (*collect)(void *ctx, sensor_sample_t *sample);
+    void *ctx;
+    sensor_sample_t *ring;  // Storage of the samples, the oldest is overwritten when full
+    size_t ring_len;
+
+    // Private to the sampler
+    int64_t release_us;     // Start of the current period
+    int64_t deadline_us;    // Of the next phase
+    bool converting;
+    size_t head;
+    size_t count;
+    uint32_t overruns;      // Periods skipped because the sampler was late
+} sensor_sampler_sensor_t;
+
+/**
+ * @brief Creates the sampler task. The first samples are taken once the drivers are initialized.
+ */
+esp_err_t sensor_sampler_start(void);
+
+/**
+ * @brief Adds a sensor, sampled from now on. The descriptor and its ring must stay valid.
+ *
+ * @return ESP_ERR_NO_MEM when CONFIG_PB_SENSOR_SAMPLER_MAX_SENSORS are already registered
+ */
+esp_err_t sensor_sampler_register(sensor_sampler_sensor_t *sensor);
+
+/**
+ * @brief Copies the last sample, leaving it in the ring
+ *
+ * @return false if the sensor has no sample yet
+ */
+bool sensor_sampler_latest(sensor_sampler_sensor_t *sensor, sensor_sample_t *sample);
+
+/**
+ * @brief Moves the samples out of the ring, oldest first
+ *
+ * @return The number of samples copied
+ */
+size_t sensor_sampler_read(sensor_sampler_sensor_t *sensor, sensor_sample_t *samples, size_t max_samples);
+
+#endif // SENSOR_SAMPLER_H
@@ -0,0 +1,519 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <time.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/event_groups.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "core_mqtt.h"
+#include "core_mqtt_agent.h"
+#include "freertos_agent_message.h"
+#include "boot_orchestrator.h"
+#include "system_perception.h"
+#if CONFIG_PB_TLS_SESSION_CACHE
+#include "tls_session_cache.h"
+#endif
+#if CONFIG_PB_UPLINK_MANAGER
+#include "uplink_manager.h"
+#endif
+#if CONFIG_PB_TRACE
+#include "core_json.h"
+#include "subscription_manager.h"
+#include "pb_trace.h"
+#endif
+
+/*
+ * Publishes what is needed to size the firmware from the fleet, on
+ * dt/pb/<city>/<area>/<zone>/<thing>/system:
+ * - heap free, minimum free since boot and largest free block, per capability,
+ * - depth of the coreMQTT-Agent command queue, sampled every second,
+ * - per task: [name, priority, stack never used in bytes, CPU in per mille of
+ *   one core since the last publish], the tasks closest to overflowing first,
+ * - with CONFIG_PB_TLS_SESSION_CACHE, the count, average time and bytes of the
+ *   full and the resumed MQTT TLS handshakes, the resumptions the broker
+ *   rejected and whether a session is cached,
+ * - with CONFIG_PB_UPLINK_MANAGER, the uplink the MQTT session is routed through,
+ *   the number of switches, the duration of the last failover and per uplink:
+ *   [up, signal quality, probe loss, probe RTT in ms].
+ *
+ * With CONFIG_PB_TRACE, {"command": "trace_dump"} on
+ * cmd/pb/<city>/<area>/<zone>/<thing>/system/diagnostics publishes the trace
+ * rings to .../system/trace, as lines of text in chunks of the payload buffer.
+ * "trace_dump_uart" prints them on the console instead.
+ */
+
+#define SYSTEM_SAMPLE_INTERVAL_MS 1000
+#define SYSTEM_TOPIC_BUFFER_LENGTH 128
+#if CONFIG_PB_TLS_SESSION_CACHE
+#define SYSTEM_TLS_LENGTH 192
+#else
+#define SYSTEM_TLS_LENGTH 0
+#endif
+#if CONFIG_PB_UPLINK_MANAGER
+#define SYSTEM_UPLINK_LENGTH 160
+#else
+#define SYSTEM_UPLINK_LENGTH 0
+#endif
+#define SYSTEM_PAYLOAD_BUFFER_LENGTH (384 + SYSTEM_TLS_LENGTH + SYSTEM_UPLINK_LENGTH + CONFIG_PB_SYSTEM_PERCEPTION_MAX_TASKS * 40)
+
+#define SYSTEM_TRACE_DUMP_MQTT_BIT (1 << 0)
+#define SYSTEM_TRACE_DUMP_UART_BIT (1 << 1)
+
+static const char *TAG = "system_perception";
+extern MQTTAgentContext_t xGlobalMqttAgentContext;
+
+typedef struct MQTTAgentCommandContext
+{
+    MQTTStatus_t xReturnStatus;
+    TaskHandle_t xTaskToNotify;
+    uint32_t ulNotificationValue;
+    void *pArgs;
+} MQTTAgentCommandContext_t;
+
+/* Occupancy of the agent command queue between two publishes */
+typedef struct {
+    uint32_t ulSamples;
+    uint32_t ulSum;
+    UBaseType_t uxMax;
+} AgentQueueStats_t;
+
+#if configUSE_TRACE_FACILITY
+static TaskStatus_t xTaskStatus[CONFIG_PB_SYSTEM_PERCEPTION_MAX_TASKS];
+#endif
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+/* Run time counters of the previous publish, to report the CPU used in between */
+typedef struct {
+    UBaseType_t uxTaskNumber;
+    configRUN_TIME_COUNTER_TYPE ulRunTime;
+} TaskRunTime_t;
+
+static TaskRunTime_t xPreviousRunTime[CONFIG_PB_SYSTEM_PERCEPTION_MAX_TASKS];
+static configRUN_TIME_COUNTER_TYPE ulTaskRunTime[CONFIG_PB_SYSTEM_PERCEPTION_MAX_TASKS];
+static UBaseType_t uxPreviousTasks;
+static configRUN_TIME_COUNTER_TYPE ulPreviousTotalRunTime;
+#endif
+static char cPayload[SYSTEM_PAYLOAD_BUFFER_LENGTH];
+#if CONFIG_PB_TRACE
+static EventGroupHandle_t xCommandEventGroup;
+static char diagnosticsTopicBuf[SYSTEM_TOPIC_BUFFER_LENGTH];
+
+/* Chunk of the trace dump being filled in cPayload */
+typedef struct {
+    char topic[SYSTEM_TOPIC_BUFFER_LENGTH];
+    size_t len;
+} TraceChunk_t;
+#endif
+
+static void prvPublishCommandCallback(MQTTAgentCommandContext_t *pxCommandContext, MQTTAgentReturnInfo_t *pxReturnInfo)
+{
+    if (pxCommandContext != NULL) {
+        pxCommandContext->xReturnStatus = pxReturnInfo->returnCode;
+        xTaskNotify(pxCommandContext->xTaskToNotify, pxCommandContext->ulNotificationValue, eSetValueWithOverwrite);
+    }
+}
+
+static BaseType_t prvWaitForCommandAcknowledgment(uint32_t *pulNotifiedValue)
+{
+    return xTaskNotifyWait(0, 0, pulNotifiedValue, portMAX_DELAY);
+}
+
+static void prvPublish(const char *topic, const char *payload)
+{
+    MQTTStatus_t status;
+    MQTTPublishInfo_t publishInfo = {
+        .qos = MQTTQoS1,
+        .pTopicName = topic,
+        .topicNameLength = (uint16_t)strlen(topic),
+        .pPayload = payload,
+        .payloadLength = strlen(payload),
+        .retain = false,
+        .dup = false
+    };
+
+    MQTTAgentCommandContext_t xCommandContext = {0};
+    xCommandContext.xTaskToNotify = xTaskGetCurrentTaskHandle();
+    xCommandContext.ulNotificationValue = 1;
+
+    MQTTAgentCommandInfo_t commandInfo = {
+        .cmdCompleteCallback = prvPublishCommandCallback,
+        .pCmdCompleteCallbackContext = &xCommandContext,
+        .blockTimeMs = 1000
+    };
+
+    xTaskNotifyStateClear(NULL);
+
+    status = MQTTAgent_Publish(&xGlobalMqttAgentContext, &publishInfo, &commandInfo);
+    if (status != MQTTSuccess) {
+        ESP_LOGE(TAG, "Failed to publish to %s: %s", topic, MQTT_Status_strerror(status));
+        return;
+    }
+
+    uint32_t ulNotifiedValue;
+    if (prvWaitForCommandAcknowledgment(&ulNotifiedValue) == pdTRUE && ulNotifiedValue == 1 && xCommandContext.xReturnStatus == MQTTSuccess) {
+        ESP_LOGI(TAG, "Publish to %s acknowledged", topic);
+    } else {
+        ESP_LOGE(TAG, "Publish to %s failed or not acknowledged", topic);
+    }
+}
+
+#if CONFIG_PB_TRACE
+/* Runs in the agent task; the dump itself is left to the perception task */
+static void prvIncomingPublishCallback(void *pvIncomingPublishCallbackContext, MQTTPublishInfo_t *pxPublishInfo)
+{
+    char *outValue = NULL;
+    size_t outValueLength = 0;
+    const char *payload = (const char *)pxPublishInfo->pPayload;
+
+    (void)pvIncomingPublishCallbackContext;
+
+    if (JSON_Validate(payload, pxPublishInfo->payloadLength) != JSONSuccess ||
+        JSON_Search((char *)payload, pxPublishInfo->payloadLength, "command", strlen("command"), &outValue, &outValueLength) != JSONSuccess) {
+        ESP_LOGE(TAG, "Invalid diagnostics command: %.*s", (int)pxPublishInfo->payloadLength, payload);
+        return;
+    }
+
+    if (outValueLength == strlen("trace_dump") && strncmp(outValue, "trace_dump", outValueLength) == 0) {
+        ESP_LOGI(TAG, "Trace dump requested");
+        xEventGroupSetBits(xCommandEventGroup, SYSTEM_TRACE_DUMP_MQTT_BIT);
+    } else if (outValueLength == strlen("trace_dump_uart") && strncmp(outValue, "trace_dump_uart", outValueLength) == 0) {
+        ESP_LOGI(TAG, "Trace dump on the console requested");
+        xEventGroupSetBits(xCommandEventGroup, SYSTEM_TRACE_DUMP_UART_BIT);
+    } else {
+        ESP_LOGE(TAG, "Unknown command: %.*s", (int)outValueLength, outValue);
+    }
+}
+
+static void prvSubscribeCommandCallback(MQTTAgentCommandContext_t *pxCommandContext, MQTTAgentReturnInfo_t *pxReturnInfo)
+{
+    MQTTAgentSubscribeArgs_t *pxSubscribeArgs = (MQTTAgentSubscribeArgs_t *)pxCommandContext->pArgs;
+
+    pxCommandContext->xReturnStatus = pxReturnInfo->returnCode;
+
+    if (pxReturnInfo->returnCode == MQTTSuccess &&
+        !addSubscription((SubscriptionElement_t *)xGlobalMqttAgentContext.pIncomingCallbackContext,
+                         pxSubscribeArgs->pSubscribeInfo->pTopicFilter,
+                         pxSubscribeArgs->pSubscribeInfo->topicFilterLength,
+                         prvIncomingPublishCallback,
+                         NULL)) {
+        ESP_LOGE(TAG, "Failed to register an incoming publish callback for topic %.*s.",
+                 pxSubscribeArgs->pSubscribeInfo->topicFilterLength,
+                 pxSubscribeArgs->pSubscribeInfo->pTopicFilter);
+    }
+
+    xTaskNotify(pxCommandContext->xTaskToNotify, (uint32_t)(pxReturnInfo->returnCode), eSetValueWithOverwrite);
+}
+
+static bool prvSubscribeToTopic(MQTTQoS_t xQoS, char *pcTopicFilter)
+{
+    MQTTStatus_t xCommandAdded;
+    MQTTAgentSubscribeArgs_t xSubscribeArgs;
+    MQTTSubscribeInfo_t xSubscribeInfo;
+    MQTTAgentCommandContext_t xApplicationDefinedContext = {0};
+    MQTTAgentCommandInfo_t xCommandParams = {0};
+
+    xTaskNotifyStateClear(NULL);
+
+    xSubscribeInfo.pTopicFilter = pcTopicFilter;
+    xSubscribeInfo.topicFilterLength = (uint16_t)strlen(pcTopicFilter);
+    xSubscribeInfo.qos = xQoS;
+    xSubscribeArgs.pSubscribeInfo = &xSubscribeInfo;
+    xSubscribeArgs.numSubscriptions = 1;
+
+    xApplicationDefinedContext.xTaskToNotify = xTaskGetCurrentTaskHandle();
+    xApplicationDefinedContext.pArgs = (void *)&xSubscribeArgs;
+
+    xCommandParams.blockTimeMs = 1000;
+    xCommandParams.cmdCompleteCallback = prvSubscribeCommandCallback;
+    xCommandParams.pCmdCompleteCallbackContext = (void *)&xApplicationDefinedContext;
+
+    do {
+        xCommandAdded = MQTTAgent_Subscribe(&xGlobalMqttAgentContext, &xSubscribeArgs, &xCommandParams);
+    } while (xCommandAdded != MQTTSuccess);
+
+    if (prvWaitForCommandAcknowledgment(NULL) != pdTRUE || xApplicationDefinedContext.xReturnStatus != MQTTSuccess) {
+        ESP_LOGE(TAG, "Error or timed out waiting for ack to subscribe message topic %s", pcTopicFilter);
+        return false;
+    }
+    return true;
+}
+#endif /* CONFIG_PB_TRACE */
+
+/* snprintf at the end of the payload, the length stops at the end of the buffer on truncation */
+static size_t prvAppend(size_t len, const char *format, ...)
+{
+    va_list args;
+
+    if (len >= sizeof(cPayload) - 1) {
+        return len;
+    }
+
+    va_start(args, format);
+    int written = vsnprintf(cPayload + len, sizeof(cPayload) - len, format, args);
+    va_end(args);
+
+    if (written < 0) {
+        return len;
+    }
+    return (len + written < sizeof(cPayload)) ? len + written : sizeof(cPayload) - 1;
+}
+
+static size_t prvAppendHeap(size_t len, const char *name, uint32_t caps)
+{
+    multi_heap_info_t info;
+
+    heap_caps_get_info(&info, caps);
+    if (info.total_free_bytes + info.total_allocated_bytes == 0) {
+        /* No heap with these capabilities, e.g. without PSRAM */
+        return len;
+    }
+
+    return prvAppend(len, "%s\"%s\": {\"free\": %u, \"min\": %u, \"largest\": %u}",
+                     cPayload[len - 1] == '{' ? "" : ", ", name,
+                     (unsigned)info.total_free_bytes, (unsigned)info.minimum_free_bytes, (unsigned)info.largest_free_block);
+}
+
+#if CONFIG_PB_TLS_SESSION_CACHE
+static size_t prvAppendTls(size_t len)
+{
+    tls_session_stats_t stats;
+
+    if (tls_session_cache_get_stats(&stats) != ESP_OK) {
+        return len;
+    }
+
+    return prvAppend(len, ", \"tls\": {\"cached\": %s, \"rejected\": %" PRIu32
+                     ", \"full\": {\"count\": %" PRIu32 ", \"avg_ms\": %" PRIu32 ", \"avg_bytes\": %" PRIu32 "}"
+                     ", \"resumed\": {\"count\": %" PRIu32 ", \"avg_ms\": %" PRIu32 ", \"avg_bytes\": %" PRIu32 "}}",
+                     stats.cached ? "true" : "false", stats.rejected,
+                     stats.full.count, stats.full.avg_ms, stats.full.avg_bytes,
+                     stats.resumed.count, stats.resumed.avg_ms, stats.resumed.avg_bytes);
+}
+#endif /* CONFIG_PB_TLS_SESSION_CACHE */
+
+#if CONFIG_PB_UPLINK_MANAGER
+static size_t prvAppendUplink(size_t len)
+{
+    static const char *const pcUplinkNames[UPLINK_COUNT] = {
+        [UPLINK_WIFI] = "wifi",
+        [UPLINK_CELLULAR] = "cellular",
+    };
+    uplink_status_t status;
+
+    if (uplink_manager_get_status(&status) != ESP_OK) {
+        return len;
+    }
+
+    len = prvAppend(len, ", \"uplink\": {\"active\": \"%s\", \"switches\": %" PRIu32 ", \"last_failover_ms\": %" PRIu32,
+                    status.active == UPLINK_NONE ? "none" : pcUplinkNames[status.active],
+                    status.switches, status.last_failover_ms);
+    for (int id = 0; id < UPLINK_COUNT; id++) {
+        const uplink_metrics_t *pxMetrics = &status.metrics[id];
+        len = prvAppend(len, ", \"%s\": [%s, %u, %u, %" PRIu32 "]", pcUplinkNames[id],
+                        pxMetrics->up ? "true" : "false", (unsigned)pxMetrics->quality,
+                        (unsigned)pxMetrics->loss, pxMetrics->rtt_ms);
+    }
+    return prvAppend(len, "}");
+}
+#endif /* CONFIG_PB_UPLINK_MANAGER */
+
+#if configUSE_TRACE_FACILITY
+static int prvCompareStackHeadroom(const void *a, const void *b)
+{
+    const TaskStatus_t *pxA = a;
+    const TaskStatus_t *pxB = b;
+
+    return (pxA->usStackHighWaterMark > pxB->usStackHighWaterMark) - (pxA->usStackHighWaterMark < pxB->usStackHighWaterMark);
+}
+
+static size_t prvAppendTasks(size_t len)
+{
+    configRUN_TIME_COUNTER_TYPE ulTotalRunTime = 0;
+    UBaseType_t uxTasks = uxTaskGetSystemState(xTaskStatus, CONFIG_PB_SYSTEM_PERCEPTION_MAX_TASKS, &ulTotalRunTime);
+
+    if (uxTasks == 0) {
+        ESP_LOGW(TAG, "More than %d tasks, raise PB_SYSTEM_PERCEPTION_MAX_TASKS", CONFIG_PB_SYSTEM_PERCEPTION_MAX_TASKS);
+        return prvAppend(len, ", \"task_count\": %u", (unsigned)uxTaskGetNumberOfTasks());
+    }
+
+    len = prvAppend(len, ", \"task_count\": %u, \"tasks\": [", (unsigned)uxTasks);
+
+#if configGENERATE_RUN_TIME_STATS
+    /* Unsigned differences stay right across one wrap of the counters */
+    configRUN_TIME_COUNTER_TYPE ulElapsed = ulTotalRunTime - ulPreviousTotalRunTime;
+
+    for (UBaseType_t i = 0; i < uxTasks; i++) {
+        ulTaskRunTime[i] = xTaskStatus[i].ulRunTimeCounter;
+        for (UBaseType_t j = 0; j < uxPreviousTasks; j++) {
+            if (xPreviousRunTime[j].uxTaskNumber == xTaskStatus[i].xTaskNumber) {
+                ulTaskRunTime[i] -= xPreviousRunTime[j].ulRunTime;
+                break;
+            }
+        }
+    }
+
+    /* The counter carries the per mille through the sort by stack headroom */
+    for (UBaseType_t i = 0; i < uxTasks; i++) {
+        xPreviousRunTime[i].uxTaskNumber = xTaskStatus[i].xTaskNumber;
+        xPreviousRunTime[i].ulRunTime = xTaskStatus[i].ulRunTimeCounter;
+        xTaskStatus[i].ulRunTimeCounter = ulElapsed ? (configRUN_TIME_COUNTER_TYPE)((uint64_t)ulTaskRunTime[i] * 1000 / ulElapsed) : 0;
+    }
+    uxPreviousTasks = uxTasks;
+    ulPreviousTotalRunTime = ulTotalRunTime;
+#endif
+
+    qsort(xTaskStatus, uxTasks, sizeof(xTaskStatus[0]), prvCompareStackHeadroom);
+
+    for (UBaseType_t i = 0; i < uxTasks; i++) {
+        /* StackType_t is a byte on ESP-IDF, the high water mark is in bytes */
+        len = prvAppend(len, "%s[\"%s\", %u, %u, %" PRIu32 "]", i == 0 ? "" : ", ",
+                        xTaskStatus[i].pcTaskName, (unsigned)xTaskStatus[i].uxCurrentPriority,
+                        (unsigned)xTaskStatus[i].usStackHighWaterMark,
+#if configGENERATE_RUN_TIME_STATS
+                        (uint32_t)xTaskStatus[i].ulRunTimeCounter
+#else
+                        (uint32_t)0
+#endif
+                       );
+    }
+
+    return prvAppend(len, "]");
+}
+#endif /* configUSE_TRACE_FACILITY */
+
+static void publish_system_telemetry(AgentQueueStats_t *queue_stats)
+{
+    char topic[SYSTEM_TOPIC_BUFFER_LENGTH];
+    time_t now;
+    time(&now);
+    struct tm *timeinfo = gmtime(&now);
+    char timestamp[32];
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", timeinfo);
+
+    snprintf(topic, sizeof(topic), "dt/pb/%s/%s/%s/%s/system",
+             CONFIG_PB_CITY, CONFIG_PB_AREA, CONFIG_PB_ZONE, CONFIG_GRI_THING_NAME);
+
+    size_t len = prvAppend(0, "{\"timestamp\": \"%s\", \"uptime_s\": %" PRIu32 ", \"heap\": {",
+                           timestamp, (uint32_t)(esp_timer_get_time() / 1000000));
+    len = prvAppendHeap(len, "internal", MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    len = prvAppendHeap(len, "dma", MALLOC_CAP_DMA);
+    len = prvAppendHeap(len, "spiram", MALLOC_CAP_SPIRAM);
+    len = prvAppend(len, "}, \"agent_queue\": {\"length\": %u, \"max\": %u, \"avg\": %.2f}",
+                    (unsigned)(uxQueueMessagesWaiting(xGlobalMqttAgentContext.agentInterface.pMsgCtx->queue) +
+                               uxQueueSpacesAvailable(xGlobalMqttAgentContext.agentInterface.pMsgCtx->queue)),
+                    (unsigned)queue_stats->uxMax,
+                    queue_stats->ulSamples ? (double)queue_stats->ulSum / queue_stats->ulSamples : 0.0);
+#if CONFIG_PB_TLS_SESSION_CACHE
+    len = prvAppendTls(len);
+#endif
+#if CONFIG_PB_UPLINK_MANAGER
+    len = prvAppendUplink(len);
+#endif
+#if configUSE_TRACE_FACILITY
+    len = prvAppendTasks(len);
+#endif
+    len = prvAppend(len, ", \"status\": \"ok\"}");
+
+    if (len >= sizeof(cPayload) - 1) {
+        ESP_LOGW(TAG, "System telemetry truncated to %u bytes", (unsigned)len);
+        return;
+    }
+
+    ESP_LOGI(TAG, "Publishing system telemetry (%u bytes) to topic: %s", (unsigned)len, topic);
+    prvPublish(topic, cPayload);
+
+    memset(queue_stats, 0, sizeof(*queue_stats));
+}
+
+#if CONFIG_PB_TRACE
+static void prvTraceChunkWriter(const char *line, void *ctx)
+{
+    TraceChunk_t *pxChunk = ctx;
+
+    /* Lines are never split across chunks, each chunk converts on its own */
+    if (pxChunk->len + strlen(line) + 1 >= sizeof(cPayload) - 1) {
+        prvPublish(pxChunk->topic, cPayload);
+        pxChunk->len = 0;
+    }
+    pxChunk->len = prvAppend(pxChunk->len, "%s\n", line);
+}
+
+static void publish_trace(void)
+{
+    static TraceChunk_t xChunk;
+
+    snprintf(xChunk.topic, sizeof(xChunk.topic), "dt/pb/%s/%s/%s/%s/system/trace",
+             CONFIG_PB_CITY, CONFIG_PB_AREA, CONFIG_PB_ZONE, CONFIG_GRI_THING_NAME);
+    xChunk.len = 0;
+
+    esp_err_t ret = pb_trace_dump(prvTraceChunkWriter, &xChunk);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to dump the trace: %s", esp_err_to_name(ret));
+        return;
+    }
+    if (xChunk.len > 0) {
+        prvPublish(xChunk.topic, cPayload);
+    }
+}
+
+static void prvHandleCommands(void)
+{
+    EventBits_t uxBits = xEventGroupClearBits(xCommandEventGroup, SYSTEM_TRACE_DUMP_MQTT_BIT | SYSTEM_TRACE_DUMP_UART_BIT);
+
+    if (uxBits & SYSTEM_TRACE_DUMP_MQTT_BIT) {
+        publish_trace();
+    }
+    if (uxBits & SYSTEM_TRACE_DUMP_UART_BIT) {
+        pb_trace_dump_to_console();
+    }
+}
+#endif /* CONFIG_PB_TRACE */
+
+static void prvSystemPerceptionTask(void *pvParameters)
+{
+    AgentQueueStats_t xQueueStats = {0};
+    TickType_t xLastWake;
+
+    boot_wait(BOOT_READY(BOOT_STAGE_MQTT) | BOOT_READY(BOOT_STAGE_TASKS), portMAX_DELAY);
+
+    /* The queue exists once the agent is initialized */
+    QueueHandle_t xAgentQueue = xGlobalMqttAgentContext.agentInterface.pMsgCtx->queue;
+
+#if CONFIG_PB_TRACE
+    xCommandEventGroup = xEventGroupCreate();
+    snprintf(diagnosticsTopicBuf, sizeof(diagnosticsTopicBuf), "cmd/pb/%s/%s/%s/%s/system/diagnostics",
+             CONFIG_PB_CITY, CONFIG_PB_AREA, CONFIG_PB_ZONE, CONFIG_GRI_THING_NAME);
+    if (!prvSubscribeToTopic(MQTTQoS1, diagnosticsTopicBuf)) {
+        ESP_LOGE(TAG, "Failed to subscribe to topic %s, trace dumps on request disabled", diagnosticsTopicBuf);
+    }
+#endif
+
+    xLastWake = xTaskGetTickCount();
+    while (1) {
+        for (uint32_t i = 0; i < CONFIG_PB_SYSTEM_PERCEPTION_INTERVAL_S * 1000 / SYSTEM_SAMPLE_INTERVAL_MS; i++) {
+            UBaseType_t uxDepth = uxQueueMessagesWaiting(xAgentQueue);
+
+            xQueueStats.ulSamples++;
+            xQueueStats.ulSum += uxDepth;
+            xQueueStats.uxMax = (uxDepth > xQueueStats.uxMax) ? uxDepth : xQueueStats.uxMax;
+#if CONFIG_PB_TRACE
+            /* Dumps are handled between two samples */
+            prvHandleCommands();
+#endif
+            vTaskDelayUntil(&xLastWake, pdMS_TO_TICKS(SYSTEM_SAMPLE_INTERVAL_MS));
+        }
+
+        publish_system_telemetry(&xQueueStats);
+    }
+}
+
+void vStartSystemPerception(void)
+{
+    xTaskCreate(prvSystemPerceptionTask, "SystemPerception", CONFIG_PB_SYSTEM_PERCEPTION_TASK_STACK_SIZE, NULL, 5, NULL);
+}
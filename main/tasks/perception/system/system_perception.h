@@ -0,0 +1,9 @@
+#ifndef SYSTEM_PERCEPTION_H
+#define SYSTEM_PERCEPTION_H
+
+#include "esp_err.h"
+
+// Function to start the task, stack, heap and agent queue diagnostics task
+void vStartSystemPerception(void);
+
+#endif // SYSTEM_PERCEPTION_H
@@ -4,6 +4,7 @@
 #include <inttypes.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/event_groups.h"
 #include "esp_log.h"
 #include "esp_event.h"
 #include "esp_wifi.h"
@@ -11,6 +12,7 @@
 #include "core_mqtt_agent.h"
 #include "core_mqtt_agent_manager.h"
 #include "core_mqtt_agent_manager_events.h"
+#include "app_wifi.h"
 
 #define CORE_MQTT_AGENT_CONNECTED_BIT (1 << 0)
 #define CORE_MQTT_AGENT_OTA_NOT_IN_PROGRESS_BIT (1 << 1)
@@ -80,7 +82,8 @@ static BaseType_t prvWaitForCommandAcknowledgment(uint32_t *pulNotifiedValue)
 static void publish_wifi_telemetry(int32_t rssi, const char *ssid)
 {
     char telemetry_topic[128];
-    char telemetry_payload[256];
+    char telemetry_payload[320];
+    app_wifi_reconnect_stats_t reconnect_stats;
     time_t now;
     time(&now);
     struct tm *timeinfo = gmtime(&now);
@@ -92,9 +95,14 @@ static void publish_wifi_telemetry(int32_t rssi, const char *ssid)
 
     ESP_LOGI(TAG, "Publishing WiFi telemetry data to telemetry topic: %s", telemetry_topic);
 
+    app_wifi_get_reconnect_stats(&reconnect_stats);
+
     snprintf(telemetry_payload, sizeof(telemetry_payload),
-             "{\"timestamp\": \"%s\", \"rssi\": %" PRId32 ", \"ssid\": \"%s\", \"session-id\": \"session-789456123\", \"status\": \"ok\"}",
-             timestamp, rssi, ssid);
+             "{\"timestamp\": \"%s\", \"rssi\": %" PRId32 ", \"ssid\": \"%s\", "
+             "\"connections\": %" PRIu32 ", \"directed_connections\": %" PRIu32 ", \"last_connect_ms\": %" PRIu32 ", \"avg_connect_ms\": %" PRIu32 ", "
+             "\"session-id\": \"session-789456123\", \"status\": \"ok\"}",
+             timestamp, rssi, ssid,
+             reconnect_stats.connections, reconnect_stats.directed, reconnect_stats.last_ms, reconnect_stats.avg_ms);
 
     MQTTStatus_t status;
     MQTTPublishInfo_t publishInfo = {
@@ -72,6 +72,9 @@
 /* Subscription manager include. */
 #include "subscription_manager.h"
 
+/* Rate limited logging include. */
+#include "pb_log.h"
+
 /* Public functions include. */
 #include "pubsub.h"
 
@@ -499,7 +502,7 @@ static void prvPublishToTopic( MQTTQoS_t xQoS,
                              pdTRUE,
                              portMAX_DELAY );
 
-        ESP_LOGI( TAG,
+        ESP_LOGD( TAG,
                   "Task \"%s\" sending publish request to coreMQTT-Agent with message \"%s\" on topic \"%s\" with ID %" PRIu32 ".",
                   pcTaskGetName( NULL ),
                   pcPayload,
@@ -514,7 +517,7 @@ static void prvPublishToTopic( MQTTQoS_t xQoS,
         {
             /* For QoS 1 and 2, wait for the publish acknowledgment.  For QoS0,
              * wait for the publish to be sent. */
-            ESP_LOGI( TAG,
+            ESP_LOGD( TAG,
                       "Task \"%s\" waiting for publish %" PRIu32 " to complete.",
                       pcTaskGetName( NULL ),
                       ulPublishMessageId );
@@ -540,10 +543,10 @@ static void prvPublishToTopic( MQTTQoS_t xQoS,
         }
         else
         {
-            ESP_LOGI( TAG,
-                      "Publish %" PRIu32 " succeeded for task \"%s\".",
-                      ulPublishMessageId,
-                      pcTaskGetName( NULL ) );
+            PB_LOGI( TAG,
+                     "Publish %" PRIu32 " succeeded for task \"%s\".",
+                     ulPublishMessageId,
+                     pcTaskGetName( NULL ) );
         }
     } while( ( xReceivedEvent & MQTT_PUBLISH_COMMAND_COMPLETED_BIT ) == 0 ||
              ( xCommandContext.xReturnStatus != MQTTSuccess ) );
@@ -611,7 +614,7 @@ static void prvSubscribeToTopic( IncomingPublishCallbackContext_t * pxIncomingPu
                              pdTRUE,
                              portMAX_DELAY );
 
-        ESP_LOGI( TAG,
+        ESP_LOGD( TAG,
                   "Task \"%s\" sending subscribe request to coreMQTT-Agent for topic filter: %s with id %" PRIu32 "",
                   pcTaskGetName( NULL ),
                   pcTopicFilter,
@@ -646,11 +649,11 @@ static void prvSubscribeToTopic( IncomingPublishCallbackContext_t * pxIncomingPu
         }
         else
         {
-            ESP_LOGI( TAG,
-                      "Subscribe %" PRIu32 " for topic filter %s succeeded for task \"%s\".",
-                      ulSubscribeMessageId,
-                      pcTopicFilter,
-                      pcTaskGetName( NULL ) );
+            PB_LOGI( TAG,
+                     "Subscribe %" PRIu32 " for topic filter %s succeeded for task \"%s\".",
+                     ulSubscribeMessageId,
+                     pcTopicFilter,
+                     pcTaskGetName( NULL ) );
         }
     } while( ( ( xReceivedEvent & MQTT_SUBSCRIBE_COMMAND_COMPLETED_BIT ) == 0 ) ||
              ( xCommandContext.xReturnStatus != MQTTSuccess ) );
@@ -715,7 +718,7 @@ static void prvUnsubscribeToTopic( MQTTQoS_t xQoS,
                              pdFALSE,
                              pdTRUE,
                              portMAX_DELAY );
-        ESP_LOGI( TAG,
+        ESP_LOGD( TAG,
                   "Task \"%s\" sending unsubscribe request to coreMQTT-Agent for topic filter: %s with id %" PRIu32 "",
                   pcTaskGetName( NULL ),
                   pcTopicFilter,
@@ -750,11 +753,11 @@ static void prvUnsubscribeToTopic( MQTTQoS_t xQoS,
         }
         else
         {
-            ESP_LOGI( TAG,
-                      "Unsubscribe %" PRIu32 " for topic filter %s succeeded for task \"%s\".",
-                      ulUnsubscribeMessageId,
-                      pcTopicFilter,
-                      pcTaskGetName( NULL ) );
+            PB_LOGI( TAG,
+                     "Unsubscribe %" PRIu32 " for topic filter %s succeeded for task \"%s\".",
+                     ulUnsubscribeMessageId,
+                     pcTopicFilter,
+                     pcTaskGetName( NULL ) );
         }
     } while( ( ( xReceivedEvent & MQTT_UNSUBSCRIBE_COMMAND_COMPLETED_BIT ) == 0 ) ||
              ( xCommandContext.xReturnStatus != MQTTSuccess ) );
@@ -805,16 +808,16 @@ static void prvSubscribePublishUnsubscribeTask( void * pvParameters )
 
         prvWaitForEvent( xMqttEventGroup, MQTT_INCOMING_PUBLISH_RECEIVED_BIT );
 
-        ESP_LOGI( TAG,
-                  "Task \"%s\" received: %s",
-                  pcTaskGetName( NULL ),
-                  xIncomingPublishCallbackContext.pcIncomingPublish );
+        PB_LOGI( TAG,
+                 "Task \"%s\" received: %s",
+                 pcTaskGetName( NULL ),
+                 xIncomingPublishCallbackContext.pcIncomingPublish );
 
         prvUnsubscribeToTopic( xQoS, pcTopicBuffer, xMqttEventGroup );
 
-        ESP_LOGI( TAG,
-                  "Task \"%s\" completed a loop. Delaying before next loop.",
-                  pcTaskGetName( NULL ) );
+        PB_LOGI( TAG,
+                 "Task \"%s\" completed a loop. Delaying before next loop.",
+                 pcTaskGetName( NULL ) );
 
         vTaskDelay( pdMS_TO_TICKS( subpubunsubconfigDELAY_BETWEEN_SUB_PUB_UNSUB_LOOPS_MS ) );
     }